@@ -0,0 +1,614 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+/**
+ * @file archive.c
+ * @brief Implementation of the puzzle archives.
+ *
+ * An archive holds many puzzles in a single file. Readers map the file and
+ * reach a puzzle in constant time through the index, by id or by hash.
+ * Writers append the records then write a new index and finally the header,
+ * so that an archive interrupted while being appended stays readable.
+ */
+#include "./archive.h"
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "./nonogram.h"
+
+#include "./nonogram.inc"
+#include "./archive.inc"
+
+/**
+ * @brief Magic bytes of an archive
+ */
+#define ARCHIVE_MAGIC "NONOGRAM"
+
+/**
+ * @brief Version of the archive format
+ */
+#define ARCHIVE_VERSION 2
+
+/**
+ * @brief Byte order mark of an archive
+ */
+#define ARCHIVE_BYTE_ORDER 0x01020304u
+
+/**
+ * @brief Entry flag of a record holding a solution
+ */
+#define ARCHIVE_SOLUTION 1u
+
+/**
+ * @brief Entry flag of a record holding given cells
+ */
+#define ARCHIVE_GIVEN 2u
+
+/**
+ * @brief Alignment of the records and of the index
+ */
+#define ARCHIVE_ALIGNMENT 8
+
+/**
+ * @brief Largest number of rows or columns of a puzzle
+ */
+#define ARCHIVE_MAX_LENGTH 65535
+
+/**
+ * @brief Size of the buffer of the archive writers
+ */
+#define ARCHIVE_BUFFER_SIZE (1 << 20)
+
+/**
+ * @brief Get the number of bytes of a bit-packed board
+ * @param rows_count The number of rows
+ * @param cols_count The number of columns
+ * @return The number of bytes
+ */
+static size_t _board_size(uint32_t rows_count, uint32_t cols_count) {
+  return ((size_t) rows_count * cols_count + 7) / 8;
+}
+
+/**
+ * @brief Get the number of blocks of a line
+ * @param line The zero-terminated clue of the line
+ * @param length The length of the line
+ * @return The number of blocks
+ */
+static int _count_blocks(const int *line, int length) {
+  int count = 0;
+  while (count < length && line[count]) {
+    count++;
+  }
+  return count;
+}
+
+/**
+ * @brief Open an archive
+ * @param filename The name of the archive file
+ * @return A new archive, or NULL if the file cannot be mapped or is not a
+ *         valid archive
+ */
+NonoGramArchive *nonogram_archive_open(const char *filename) {
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat status;
+  if (fstat(fd, &status) < 0
+      || (size_t) status.st_size < sizeof(NonoGramArchiveHeader)) {
+    close(fd);
+    return NULL;
+  }
+  void *data = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return NULL;
+  }
+  NonoGramArchive *archive = malloc(sizeof(NonoGramArchive));
+  if (!archive) {
+    munmap(data, status.st_size);
+    return NULL;
+  }
+  archive->data = data;
+  archive->size = status.st_size;
+  archive->header = data;
+  const NonoGramArchiveHeader *header = archive->header;
+  uint64_t size = archive->size;
+  if (memcmp(header->magic, ARCHIVE_MAGIC, sizeof header->magic)
+      || header->version != ARCHIVE_VERSION
+      || header->byte_order != ARCHIVE_BYTE_ORDER
+      || header->count > UINT32_MAX - 1
+      || header->index_offset % ARCHIVE_ALIGNMENT
+      || header->index_offset > size
+      || header->count * sizeof(NonoGramArchiveEntry)
+         > size - header->index_offset
+      || header->table_offset % ARCHIVE_ALIGNMENT
+      || header->table_offset > size
+      || header->table_size < 2
+      || header->table_size & (header->table_size - 1)
+      || header->table_size <= header->count
+      || header->table_size
+         > (size - header->table_offset) / sizeof(uint32_t)) {
+    nonogram_archive_close(archive);
+    return NULL;
+  }
+  archive->entries =
+    (const NonoGramArchiveEntry *) (archive->data + header->index_offset);
+  archive->table = (const uint32_t *) (archive->data + header->table_offset);
+  return archive;
+}
+
+/**
+ * @brief Close an archive
+ * @param archive The archive
+ */
+void nonogram_archive_close(NonoGramArchive *archive) {
+  munmap((void *) archive->data, archive->size);
+  free(archive);
+}
+
+/**
+ * @brief Get the number of puzzles of an archive
+ * @param archive The archive
+ * @return The number of puzzles
+ */
+long nonogram_archive_get_count(NonoGramArchive *archive) {
+  return archive->header->count;
+}
+
+/**
+ * @brief Get the record of a puzzle
+ * @param archive The archive
+ * @param id The id of the puzzle
+ * @return The record, or NULL if it lies outside of the file or if its
+ *         parts do not add up to its length
+ */
+static const NonoGramArchiveRecord *_record(NonoGramArchive *archive, long id) {
+  if (id < 0 || (uint64_t) id >= archive->header->count) {
+    return NULL;
+  }
+  const NonoGramArchiveEntry *entry = &archive->entries[id];
+  if (entry->offset % ARCHIVE_ALIGNMENT
+      || entry->offset > archive->size
+      || entry->length > archive->size - entry->offset
+      || entry->length < sizeof(NonoGramArchiveRecord)) {
+    return NULL;
+  }
+  const NonoGramArchiveRecord *record =
+    (const NonoGramArchiveRecord *) (archive->data + entry->offset);
+  if (!record->rows_count || record->rows_count > ARCHIVE_MAX_LENGTH
+      || !record->cols_count || record->cols_count > ARCHIVE_MAX_LENGTH) {
+    return NULL;
+  }
+  uint64_t length = sizeof(NonoGramArchiveRecord)
+    + (uint64_t) record->values_count * sizeof(uint16_t)
+    + record->metadata_length;
+  if (entry->flags & ARCHIVE_GIVEN) {
+    length += (uint64_t) record->rows_count * record->cols_count;
+  }
+  if (entry->flags & ARCHIVE_SOLUTION) {
+    length += _board_size(record->rows_count, record->cols_count);
+  }
+  return length == entry->length ? record : NULL;
+}
+
+/**
+ * @brief Decode the clues of lines
+ * @param pvalues A pointer to the next value of the record
+ * @param end The end of the values of the record
+ * @param lines The clues to fill
+ * @param count The number of lines
+ * @param length The length of the lines
+ * @return false if the values are corrupt
+ */
+static bool _decode_lines(
+  const uint16_t **pvalues,
+  const uint16_t *end,
+  int **lines,
+  int count,
+  int length
+) {
+  for (int line = 0; line < count; line++) {
+    if (*pvalues >= end) {
+      return false;
+    }
+    int blocks = *(*pvalues)++;
+    if (blocks > end - *pvalues) {
+      return false;
+    }
+    int used = 0;
+    for (int block = 0; block < blocks; block++) {
+      int value = *(*pvalues)++;
+      used += block ? value + 1 : value;
+      if (!value || used > length) {
+        return false;
+      }
+      lines[line][block] = value;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Get the hints of a puzzle of an archive
+ * @param archive The archive
+ * @param id The id of the puzzle
+ * @return A new nonogram hints object, or NULL if the record is corrupt or if
+ *         memory allocation fails
+ */
+NonoGramHints *nonogram_archive_get_hints(NonoGramArchive *archive, long id) {
+  const NonoGramArchiveRecord *record = _record(archive, id);
+  if (!record) {
+    return NULL;
+  }
+  NonoGramHints *hints =
+    nonogram_hints_create_empty(record->rows_count, record->cols_count);
+  if (!hints) {
+    return NULL;
+  }
+  const uint16_t *values = (const uint16_t *) (record + 1);
+  const uint16_t *end = values + record->values_count;
+  if (!_decode_lines(
+        &values, end, hints->rows, hints->rows_count, hints->cols_count)
+      || !_decode_lines(
+        &values, end, hints->cols, hints->cols_count, hints->rows_count)
+      || values != end) {
+    nonogram_hints_destroy(hints);
+    return NULL;
+  }
+  if (archive->entries[id].flags & ARCHIVE_GIVEN) {
+    const signed char *given = (const signed char *) end;
+    for (int cell = 0; cell < hints->rows_count * hints->cols_count; cell++) {
+      if (given[cell] < -1 || given[cell] > 1) {
+        nonogram_hints_destroy(hints);
+        return NULL;
+      }
+    }
+    if (!nonogram_hints_set_given(hints, given)) {
+      nonogram_hints_destroy(hints);
+      return NULL;
+    }
+  }
+  return hints;
+}
+
+/**
+ * @brief Get the hash of a puzzle of an archive
+ * @param archive The archive
+ * @param id The id of the puzzle
+ * @return The hash of the hints of the puzzle, 0 if there is no such puzzle
+ */
+uint64_t nonogram_archive_get_hash(NonoGramArchive *archive, long id) {
+  if (id < 0 || (uint64_t) id >= archive->header->count) {
+    return 0;
+  }
+  return archive->entries[id].hash;
+}
+
+/**
+ * @brief Get a cell of the solution of a puzzle of an archive
+ * @param archive The archive
+ * @param id The id of the puzzle
+ * @param row The row index
+ * @param col The col index
+ * @return 1 if the cell is filled, 0 if it is empty, -1 if the puzzle has no
+ *         solution in the archive
+ */
+int nonogram_archive_get_cell(
+  NonoGramArchive *archive,
+  long id,
+  int row,
+  int col
+) {
+  const NonoGramArchiveRecord *record = _record(archive, id);
+  if (!record || !(archive->entries[id].flags & ARCHIVE_SOLUTION)
+      || row < 0 || (uint32_t) row >= record->rows_count
+      || col < 0 || (uint32_t) col >= record->cols_count) {
+    return -1;
+  }
+  const unsigned char *board = (const unsigned char *) (record + 1)
+    + record->values_count * sizeof(uint16_t);
+  if (archive->entries[id].flags & ARCHIVE_GIVEN) {
+    board += (size_t) record->rows_count * record->cols_count;
+  }
+  size_t cell = (size_t) row * record->cols_count + col;
+  return (board[cell / 8] >> (cell % 8)) & 1;
+}
+
+/**
+ * @brief Get the metadata of a puzzle of an archive
+ * @param archive The archive
+ * @param id The id of the puzzle
+ * @return The null-terminated metadata, or NULL if the puzzle has none
+ */
+const char *nonogram_archive_get_metadata(NonoGramArchive *archive, long id) {
+  const NonoGramArchiveRecord *record = _record(archive, id);
+  if (!record || !record->metadata_length) {
+    return NULL;
+  }
+  const char *metadata = (const char *) record
+    + archive->entries[id].length - record->metadata_length;
+  return metadata[record->metadata_length - 1] ? NULL : metadata;
+}
+
+/**
+ * @brief Find a puzzle in an archive
+ * @param archive The archive
+ * @param hints The hints of the puzzle
+ * @return The id of the first puzzle with these hints, or -1 if there is none
+ */
+long nonogram_archive_find(NonoGramArchive *archive, NonoGramHints *hints) {
+  uint64_t hash = nonogram_hints_hash(hints);
+  uint64_t mask = archive->header->table_size - 1;
+  // A corrupt table may have no empty slot: each slot is probed once at most
+  uint64_t slot = hash & mask;
+  for (uint64_t probe = 0; probe <= mask && archive->table[slot];
+       probe++, slot = (slot + 1) & mask) {
+    long id = archive->table[slot] - 1;
+    if ((uint64_t) id >= archive->header->count
+        || archive->entries[id].hash != hash) {
+      continue;
+    }
+    NonoGramHints *other = nonogram_archive_get_hints(archive, id);
+    if (other) {
+      bool equal = nonogram_hints_equal(hints, other);
+      nonogram_hints_destroy(other);
+      if (equal) {
+        return id;
+      }
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief Write bytes to an archive
+ * @param writer The archive writer
+ * @param data The bytes
+ * @param size The number of bytes
+ * @note An error is recorded in the writer
+ */
+static void _write(
+  NonoGramArchiveWriter *writer,
+  const void *data,
+  size_t size
+) {
+  if (size && fwrite(data, 1, size, writer->file) != size) {
+    writer->failed = true;
+  }
+  writer->offset += size;
+}
+
+/**
+ * @brief Write padding up to the archive alignment
+ * @param writer The archive writer
+ */
+static void _align(NonoGramArchiveWriter *writer) {
+  static const unsigned char zeros[ARCHIVE_ALIGNMENT];
+  _write(writer, zeros, -writer->offset % ARCHIVE_ALIGNMENT);
+}
+
+/**
+ * @brief Open an archive for writing
+ * @param filename The name of the archive file
+ * @param append Whether to add puzzles to an existing archive
+ * @return A new archive writer, or NULL if the file cannot be opened or is
+ *         not a valid archive
+ */
+NonoGramArchiveWriter *nonogram_archive_writer_open(
+  const char *filename,
+  bool append
+) {
+  NonoGramArchiveWriter *writer = calloc(1, sizeof(NonoGramArchiveWriter));
+  if (!writer) {
+    return NULL;
+  }
+  NonoGramArchive *archive = NULL;
+  if (append && access(filename, F_OK) == 0) {
+    archive = nonogram_archive_open(filename);
+    if (!archive) {
+      free(writer);
+      return NULL;
+    }
+    writer->count = writer->capacity = archive->header->count;
+    writer->entries = malloc(
+      (writer->capacity ? writer->capacity : 1) * sizeof(NonoGramArchiveEntry));
+    if (!writer->entries) {
+      nonogram_archive_close(archive);
+      free(writer);
+      return NULL;
+    }
+    memcpy(writer->entries, archive->entries,
+           writer->count * sizeof(NonoGramArchiveEntry));
+    writer->offset = archive->size;
+    nonogram_archive_close(archive);
+    writer->file = fopen(filename, "r+b");
+  } else {
+    writer->file = fopen(filename, "wb");
+  }
+  if (!writer->file) {
+    free(writer->entries);
+    free(writer);
+    return NULL;
+  }
+  setvbuf(writer->file, NULL, _IOFBF, ARCHIVE_BUFFER_SIZE);
+  if (archive) {
+    // New records go after the old index, which stays valid until the end
+    if (fseek(writer->file, writer->offset, SEEK_SET) < 0) {
+      writer->failed = true;
+    }
+  } else {
+    // The header is written last: the file is not an archive until then
+    NonoGramArchiveHeader header;
+    memset(&header, 0, sizeof header);
+    _write(writer, &header, sizeof header);
+  }
+  _align(writer);
+  return writer;
+}
+
+/**
+ * @brief Add a puzzle to an archive
+ * @param writer The archive writer
+ * @param hints The hints of the puzzle
+ * @param board The solution of the puzzle, or NULL
+ * @param metadata The null-terminated metadata of the puzzle, or NULL
+ * @return The id of the puzzle, or -1 if an error occurred
+ */
+long nonogram_archive_writer_add(
+  NonoGramArchiveWriter *writer,
+  NonoGramHints *hints,
+  int **board,
+  const char *metadata
+) {
+  if (hints->rows_count > ARCHIVE_MAX_LENGTH
+      || hints->cols_count > ARCHIVE_MAX_LENGTH
+      || writer->count >= UINT32_MAX - 1) {
+    return -1;
+  }
+  NonoGramArchiveRecord record = {
+    .rows_count = hints->rows_count,
+    .cols_count = hints->cols_count,
+    .values_count = hints->rows_count + hints->cols_count,
+    .metadata_length = metadata ? strlen(metadata) + 1 : 0,
+  };
+  for (int row = 0; row < hints->rows_count; row++) {
+    record.values_count += _count_blocks(hints->rows[row], hints->cols_count);
+  }
+  for (int col = 0; col < hints->cols_count; col++) {
+    record.values_count += _count_blocks(hints->cols[col], hints->rows_count);
+  }
+  size_t given_size =
+    hints->given ? (size_t) record.rows_count * record.cols_count : 0;
+  size_t board_size =
+    board ? _board_size(record.rows_count, record.cols_count) : 0;
+  size_t length = sizeof record + record.values_count * sizeof(uint16_t)
+    + given_size + board_size + record.metadata_length;
+  if (length > UINT32_MAX) {
+    return -1;
+  }
+  if (length > writer->record_capacity) {
+    unsigned char *buffer = realloc(writer->record, length);
+    if (!buffer) {
+      return -1;
+    }
+    writer->record = buffer;
+    writer->record_capacity = length;
+  }
+  if (writer->count == writer->capacity) {
+    long capacity = writer->capacity ? 2 * writer->capacity : 64;
+    NonoGramArchiveEntry *entries =
+      realloc(writer->entries, capacity * sizeof(NonoGramArchiveEntry));
+    if (!entries) {
+      return -1;
+    }
+    writer->entries = entries;
+    writer->capacity = capacity;
+  }
+
+  memcpy(writer->record, &record, sizeof record);
+  uint16_t *values = (uint16_t *) (writer->record + sizeof record);
+  for (int line = 0; line < hints->rows_count + hints->cols_count; line++) {
+    bool is_row = line < hints->rows_count;
+    int *clue = is_row
+      ? hints->rows[line]
+      : hints->cols[line - hints->rows_count];
+    int blocks =
+      _count_blocks(clue, is_row ? hints->cols_count : hints->rows_count);
+    *values++ = blocks;
+    for (int block = 0; block < blocks; block++) {
+      *values++ = clue[block];
+    }
+  }
+  unsigned char *bits = (unsigned char *) values;
+  if (hints->given) {
+    memcpy(bits, hints->given, given_size);
+    bits += given_size;
+  }
+  memset(bits, 0, board_size);
+  for (int row = 0; board && row < hints->rows_count; row++) {
+    for (int col = 0; col < hints->cols_count; col++) {
+      size_t cell = (size_t) row * hints->cols_count + col;
+      if (board[row][col] == 1) {
+        bits[cell / 8] |= 1 << (cell % 8);
+      }
+    }
+  }
+  if (metadata) {
+    memcpy(bits + board_size, metadata, record.metadata_length);
+  }
+
+  NonoGramArchiveEntry *entry = &writer->entries[writer->count];
+  entry->offset = writer->offset;
+  entry->hash = nonogram_hints_hash(hints);
+  entry->length = length;
+  entry->flags =
+    (board ? ARCHIVE_SOLUTION : 0) | (hints->given ? ARCHIVE_GIVEN : 0);
+  _write(writer, writer->record, length);
+  _align(writer);
+  return writer->failed ? -1 : writer->count++;
+}
+
+/**
+ * @brief Write the index of an archive and close it
+ * @param writer The archive writer
+ * @return false if an error occurred since the writer has been opened
+ */
+bool nonogram_archive_writer_close(NonoGramArchiveWriter *writer) {
+  NonoGramArchiveHeader header = {
+    .version = ARCHIVE_VERSION,
+    .byte_order = ARCHIVE_BYTE_ORDER,
+    .count = writer->count,
+    .index_offset = writer->offset,
+    .table_size = 2,
+  };
+  memcpy(header.magic, ARCHIVE_MAGIC, sizeof header.magic);
+  while (header.table_size < 2 * header.count) {
+    header.table_size *= 2;
+  }
+  uint32_t *table = calloc(header.table_size, sizeof(uint32_t));
+  if (!table) {
+    writer->failed = true;
+  } else {
+    uint64_t mask = header.table_size - 1;
+    for (long id = 0; id < writer->count; id++) {
+      uint64_t slot = writer->entries[id].hash & mask;
+      while (table[slot]) {
+        slot = (slot + 1) & mask;
+      }
+      table[slot] = id + 1;
+    }
+    _write(writer, writer->entries,
+           writer->count * sizeof(NonoGramArchiveEntry));
+    header.table_offset = writer->offset;
+    _write(writer, table, header.table_size * sizeof(uint32_t));
+    free(table);
+  }
+  if (fflush(writer->file) || ftruncate(fileno(writer->file), writer->offset)) {
+    writer->failed = true;
+  }
+  if (!writer->failed) {
+    // The header commits the new index
+    if (fseek(writer->file, 0, SEEK_SET) < 0
+        || fwrite(&header, sizeof header, 1, writer->file) != 1) {
+      writer->failed = true;
+    }
+  }
+  if (fclose(writer->file)) {
+    writer->failed = true;
+  }
+  bool succeeded = !writer->failed;
+  free(writer->entries);
+  free(writer->record);
+  free(writer);
+  return succeeded;
+}
@@ -0,0 +1,135 @@
+#ifndef ARCHIVE_H_
+#define ARCHIVE_H_
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "./nonogram.h"
+
+/**
+ * NonoGramArchive is a opaque structure that represents a read-only archive
+ * of puzzles mapped in memory.
+ */
+typedef struct _NonoGramArchive NonoGramArchive;
+
+/**
+ * NonoGramArchiveWriter is a opaque structure that represents an archive
+ * being written.
+ */
+typedef struct _NonoGramArchiveWriter NonoGramArchiveWriter;
+
+/**
+ * @brief Open an archive
+ * @param filename The name of the archive file
+ * @return A new archive, or NULL if the file cannot be mapped or is not a
+ *         valid archive
+ * @note Puzzles are read from the mapping on demand, opening does not
+ *       depend on the number of puzzles
+ */
+extern NonoGramArchive *nonogram_archive_open(const char *filename);
+/**
+ * @brief Close an archive
+ * @param archive The archive
+ */
+extern void nonogram_archive_close(NonoGramArchive *archive);
+
+/**
+ * @brief Get the number of puzzles of an archive
+ * @param archive The archive
+ * @return The number of puzzles, their ids range from 0 to this number
+ */
+extern long nonogram_archive_get_count(NonoGramArchive *archive);
+/**
+ * @brief Get the hints of a puzzle of an archive
+ * @param archive The archive
+ * @param id The id of the puzzle
+ * @return A new nonogram hints object, or NULL if the record is corrupt or if
+ *         memory allocation fails
+ */
+extern NonoGramHints *nonogram_archive_get_hints(
+  NonoGramArchive *archive,
+  long id
+);
+/**
+ * @brief Get the hash of a puzzle of an archive
+ * @param archive The archive
+ * @param id The id of the puzzle
+ * @return The hash of the hints of the puzzle, see nonogram_hints_hash, 0
+ *         if there is no such puzzle
+ */
+extern uint64_t nonogram_archive_get_hash(NonoGramArchive *archive, long id);
+/**
+ * @brief Get a cell of the solution of a puzzle of an archive
+ * @param archive The archive
+ * @param id The id of the puzzle
+ * @param row The row index
+ * @param col The col index
+ * @return 1 if the cell is filled, 0 if it is empty, -1 if the puzzle has no
+ *         solution in the archive
+ */
+extern int nonogram_archive_get_cell(
+  NonoGramArchive *archive,
+  long id,
+  int row,
+  int col
+);
+/**
+ * @brief Get the metadata of a puzzle of an archive
+ * @param archive The archive
+ * @param id The id of the puzzle
+ * @return The null-terminated metadata, or NULL if the puzzle has none
+ * @note The string points into the mapping and lives as long as the archive
+ */
+extern const char *nonogram_archive_get_metadata(
+  NonoGramArchive *archive,
+  long id
+);
+/**
+ * @brief Find a puzzle in an archive
+ * @param archive The archive
+ * @param hints The hints of the puzzle
+ * @return The id of the first puzzle with these hints, or -1 if there is none
+ * @note The lookup goes through the hash table of the archive
+ */
+extern long nonogram_archive_find(
+  NonoGramArchive *archive,
+  NonoGramHints *hints
+);
+
+/**
+ * @brief Open an archive for writing
+ * @param filename The name of the archive file
+ * @param append Whether to add puzzles to an existing archive
+ * @return A new archive writer, or NULL if the file cannot be opened or is
+ *         not a valid archive
+ * @note The existing puzzles are left untouched when appending: until the
+ *       writer is closed, the archive still reads as before
+ */
+extern NonoGramArchiveWriter *nonogram_archive_writer_open(
+  const char *filename,
+  bool append
+);
+/**
+ * @brief Add a puzzle to an archive
+ * @param writer The archive writer
+ * @param hints The hints of the puzzle
+ * @param board The solution of the puzzle, or NULL
+ * @param metadata The null-terminated metadata of the puzzle, or NULL
+ * @return The id of the puzzle, or -1 if an error occurred
+ */
+extern long nonogram_archive_writer_add(
+  NonoGramArchiveWriter *writer,
+  NonoGramHints *hints,
+  int **board,
+  const char *metadata
+);
+/**
+ * @brief Write the index of an archive and close it
+ * @param writer The archive writer
+ * @return false if an error occurred since the writer has been opened
+ */
+extern bool nonogram_archive_writer_close(NonoGramArchiveWriter *writer);
+
+#endif  // ARCHIVE_H_
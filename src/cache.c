@@ -0,0 +1,181 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+/**
+ * @file cache.c
+ * @brief Implementation of the solution cache.
+ *
+ * Puzzles are found by the low bits of their hash in set-associative
+ * buckets. Lookups do not record anything, eviction is first in first out
+ * per bucket, so that a hit only reads shared memory; the buckets are
+ * locked by stripes of reader-writer locks.
+ */
+#include "./cache.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "./nonogram.h"
+
+#include "./cache.inc"
+
+/**
+ * @brief Create a new cache
+ * @param capacity The maximal number of puzzles kept
+ * @return A new empty cache, or NULL if memory allocation fails
+ */
+NonoGramCache *nonogram_cache_create(size_t capacity) {
+  NonoGramCache *cache = calloc(1, sizeof(NonoGramCache));
+  if (!cache) {
+    return NULL;
+  }
+  size_t buckets_count = 1;
+  while (buckets_count * CACHE_WAYS < capacity) {
+    buckets_count *= 2;
+  }
+  cache->stripes_count =
+    buckets_count < CACHE_STRIPES ? buckets_count : CACHE_STRIPES;
+  cache->buckets = calloc(buckets_count, sizeof(NonoGramCacheBucket));
+  cache->stripes = calloc(cache->stripes_count, sizeof(NonoGramCacheStripe));
+  if (!cache->buckets || !cache->stripes) {
+    free(cache->buckets);
+    free(cache->stripes);
+    free(cache);
+    return NULL;
+  }
+  cache->mask = buckets_count - 1;
+  for (size_t index = 0; index < cache->stripes_count; index++) {
+    pthread_rwlock_init(&cache->stripes[index].lock, NULL);
+  }
+  atomic_init(&cache->count, 0);
+  return cache;
+}
+
+/**
+ * @brief Destroy a cache
+ * @param cache The cache
+ */
+void nonogram_cache_destroy(NonoGramCache *cache) {
+  for (size_t bucket = 0; bucket <= cache->mask; bucket++) {
+    for (int way = 0; way < CACHE_WAYS; way++) {
+      NonoGramCacheEntry *entry = &cache->buckets[bucket].entries[way];
+      if (entry->hints) {
+        nonogram_hints_destroy(entry->hints);
+        free(entry->cells);
+      }
+    }
+  }
+  for (size_t index = 0; index < cache->stripes_count; index++) {
+    pthread_rwlock_destroy(&cache->stripes[index].lock);
+  }
+  free(cache->stripes);
+  free(cache->buckets);
+  free(cache);
+}
+
+/**
+ * @brief Get the lock of a bucket
+ * @param cache The cache
+ * @param bucket The index of the bucket
+ * @return The lock
+ */
+static pthread_rwlock_t *_lock(NonoGramCache *cache, size_t bucket) {
+  return &cache->stripes[bucket & (cache->stripes_count - 1)].lock;
+}
+
+/**
+ * @brief Look a puzzle up
+ * @param cache The cache
+ * @param hints The hints of the puzzle
+ * @param cells The buffer receiving the board, row by row
+ * @return true if the puzzle is in the cache
+ */
+bool nonogram_cache_get(
+  NonoGramCache *cache,
+  NonoGramHints *hints,
+  signed char *cells
+) {
+  uint64_t hash = nonogram_hints_hash(hints);
+  size_t index = hash & cache->mask;
+  NonoGramCacheBucket *bucket = &cache->buckets[index];
+  size_t size = (size_t) nonogram_hints_get_rows_count(hints)
+    * nonogram_hints_get_cols_count(hints);
+  bool found = false;
+  pthread_rwlock_rdlock(_lock(cache, index));
+  for (int way = 0; !found && way < CACHE_WAYS; way++) {
+    NonoGramCacheEntry *entry = &bucket->entries[way];
+    if (entry->hints && entry->hash == hash
+        && nonogram_hints_equal(entry->hints, hints)) {
+      memcpy(cells, entry->cells, size);
+      found = true;
+    }
+  }
+  pthread_rwlock_unlock(_lock(cache, index));
+  return found;
+}
+
+/**
+ * @brief Add a solved puzzle
+ * @param cache The cache
+ * @param hints The hints of the puzzle, owned by the cache
+ * @param cells The board, row by row
+ */
+void nonogram_cache_put(
+  NonoGramCache *cache,
+  NonoGramHints *hints,
+  const signed char *cells
+) {
+  uint64_t hash = nonogram_hints_hash(hints);
+  size_t index = hash & cache->mask;
+  NonoGramCacheBucket *bucket = &cache->buckets[index];
+  size_t size = (size_t) nonogram_hints_get_rows_count(hints)
+    * nonogram_hints_get_cols_count(hints);
+  signed char *copy = malloc(size ? size : 1);
+  if (!copy) {
+    nonogram_hints_destroy(hints);
+    return;
+  }
+  memcpy(copy, cells, size);
+  NonoGramHints *evicted = NULL;
+  signed char *evicted_cells = copy;
+  pthread_rwlock_wrlock(_lock(cache, index));
+  bool present = false;
+  for (int way = 0; !present && way < CACHE_WAYS; way++) {
+    NonoGramCacheEntry *entry = &bucket->entries[way];
+    present = entry->hints && entry->hash == hash
+      && nonogram_hints_equal(entry->hints, hints);
+  }
+  if (present) {
+    evicted = hints;
+  } else {
+    NonoGramCacheEntry *entry = &bucket->entries[bucket->next];
+    bucket->next = (bucket->next + 1) % CACHE_WAYS;
+    evicted = entry->hints;
+    evicted_cells = entry->cells;
+    entry->hash = hash;
+    entry->hints = hints;
+    entry->cells = copy;
+    if (!evicted) {
+      atomic_fetch_add_explicit(&cache->count, 1, memory_order_relaxed);
+    }
+  }
+  pthread_rwlock_unlock(_lock(cache, index));
+  // The evicted puzzle is freed outside of the lock
+  if (evicted) {
+    nonogram_hints_destroy(evicted);
+  }
+  free(evicted_cells);
+}
+
+/**
+ * @brief Get the number of puzzles in a cache
+ * @param cache The cache
+ * @return The number of puzzles
+ */
+size_t nonogram_cache_get_count(NonoGramCache *cache) {
+  return atomic_load_explicit(&cache->count, memory_order_relaxed);
+}
@@ -0,0 +1,63 @@
+#ifndef CACHE_H_
+#define CACHE_H_
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "./nonogram.h"
+
+/**
+ * NonoGramCache is a opaque structure that represents a bounded table of
+ * solved puzzles, shared by threads that mostly look it up.
+ */
+typedef struct _NonoGramCache NonoGramCache;
+
+/**
+ * @brief Create a new cache
+ * @param capacity The maximal number of puzzles kept
+ * @return A new empty cache, or NULL if memory allocation fails
+ * @note The capacity is rounded up to a power of two
+ */
+extern NonoGramCache *nonogram_cache_create(size_t capacity);
+/**
+ * @brief Destroy a cache
+ * @param cache The cache
+ */
+extern void nonogram_cache_destroy(NonoGramCache *cache);
+
+/**
+ * @brief Look a puzzle up
+ * @param cache The cache
+ * @param hints The hints of the puzzle
+ * @param cells The buffer receiving the board, row by row
+ * @return true if the puzzle is in the cache
+ * @note A lookup only takes a shared lock and writes nothing, so that
+ *       concurrent lookups do not contend
+ */
+extern bool nonogram_cache_get(
+  NonoGramCache *cache,
+  NonoGramHints *hints,
+  signed char *cells
+);
+/**
+ * @brief Add a solved puzzle
+ * @param cache The cache
+ * @param hints The hints of the puzzle, owned by the cache
+ * @param cells The board, row by row
+ * @note When its bucket is full, the oldest puzzle of the bucket is evicted
+ */
+extern void nonogram_cache_put(
+  NonoGramCache *cache,
+  NonoGramHints *hints,
+  const signed char *cells
+);
+/**
+ * @brief Get the number of puzzles in a cache
+ * @param cache The cache
+ * @return The number of puzzles
+ */
+extern size_t nonogram_cache_get_count(NonoGramCache *cache);
+
+#endif  // CACHE_H_
@@ -0,0 +1,497 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+/**
+ * @file corpus.c
+ * @brief Implementation of the parallel corpus reader.
+ *
+ * The mapped file is cut into more chunks than threads, on line boundaries.
+ * Threads take chunks from a shared counter twice: first to count the
+ * puzzles of each chunk, which gives the id of the first puzzle of every
+ * chunk, then to parse the chunks and hand the puzzles over.
+ *
+ * The files of a directory, hints objects or PBM images, are loaded in
+ * memory by a batched loader, with io_uring when the kernel has it; each
+ * file is then a record, as the puzzles of an archive.
+ */
+#include "./corpus.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "./archive.h"
+#include "./loader.h"
+#include "./nonogram.h"
+
+#include "./corpus.inc"
+
+/**
+ * @brief Number of chunks per thread, to balance the load
+ */
+#define CORPUS_CHUNKS_PER_THREAD 8
+
+/**
+ * @brief Smallest chunk of an NDJSON file in bytes
+ */
+#define CORPUS_MIN_CHUNK (64 * 1024)
+
+/**
+ * @brief Smallest chunk of an archive in puzzles
+ */
+#define CORPUS_MIN_PUZZLES 64
+
+/**
+ * @brief Number of files of a directory loaded at once
+ */
+#define CORPUS_IO_DEPTH 64
+
+/**
+ * @brief Keep the content of a file of a corpus
+ * @param index The index of the file
+ * @param content The content of the file, or NULL
+ * @param length The length of the content
+ * @param data The corpus
+ * @return true to read every file
+ */
+static bool _keep_file(long index, char *content, size_t length, void *data) {
+  NonoGramCorpus *corpus = data;
+  corpus->files[index] = content;
+  corpus->lengths[index] = length;
+  return true;
+}
+
+/**
+ * @brief Open a corpus made of files
+ * @param filenames The names of the files, hints objects or PBM images
+ * @param count The number of files
+ * @param depth The number of files loaded at once
+ * @return A new corpus, or NULL if memory allocation fails
+ */
+NonoGramCorpus *nonogram_corpus_open_files(
+  const char *const *filenames,
+  long count,
+  int depth
+) {
+  NonoGramCorpus *corpus = calloc(1, sizeof(NonoGramCorpus));
+  NonoGramLoader *loader = nonogram_loader_create(depth, true);
+  if (corpus) {
+    corpus->files = calloc(count ? count : 1, sizeof(char *));
+    corpus->lengths = calloc(count ? count : 1, sizeof(size_t));
+    corpus->files_count = count;
+  }
+  if (!corpus || !loader || !corpus->files || !corpus->lengths
+      || nonogram_loader_read(loader, filenames, count, _keep_file, corpus)
+         < 0) {
+    if (loader) {
+      nonogram_loader_destroy(loader);
+    }
+    if (corpus) {
+      nonogram_corpus_close(corpus);
+    }
+    return NULL;
+  }
+  nonogram_loader_destroy(loader);
+  return corpus;
+}
+
+/**
+ * @brief Compare two file names
+ * @param a A pointer to the first name
+ * @param b A pointer to the second name
+ * @return The order of the names
+ */
+static int _compare_names(const void *a, const void *b) {
+  return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+/**
+ * @brief Open a corpus made of the files of a directory
+ * @param path The path of the directory
+ * @return A new corpus, or NULL if the directory cannot be listed
+ * @note The files are sorted by name, hidden files are ignored
+ */
+static NonoGramCorpus *_open_directory(const char *path) {
+  DIR *directory = opendir(path);
+  if (!directory) {
+    return NULL;
+  }
+  char **filenames = NULL;
+  long count = 0;
+  long capacity = 0;
+  bool failed = false;
+  struct dirent *entry;
+  while (!failed && (entry = readdir(directory))) {
+    if (entry->d_name[0] == '.'
+        || (entry->d_type != DT_REG && entry->d_type != DT_UNKNOWN)) {
+      continue;
+    }
+    if (count == capacity) {
+      capacity = capacity ? capacity * 2 : 256;
+      char **new_filenames = realloc(filenames, capacity * sizeof(char *));
+      if (!new_filenames) {
+        failed = true;
+        break;
+      }
+      filenames = new_filenames;
+    }
+    size_t length = strlen(path) + strlen(entry->d_name) + 2;
+    filenames[count] = malloc(length);
+    if (!filenames[count]) {
+      failed = true;
+      break;
+    }
+    snprintf(filenames[count++], length, "%s/%s", path, entry->d_name);
+  }
+  closedir(directory);
+  NonoGramCorpus *corpus = NULL;
+  if (!failed) {
+    qsort(filenames, count, sizeof(char *), _compare_names);
+    corpus = nonogram_corpus_open_files(
+      (const char *const *) filenames, count, CORPUS_IO_DEPTH);
+  }
+  for (long index = 0; index < count; index++) {
+    free(filenames[index]);
+  }
+  free(filenames);
+  return corpus;
+}
+
+/**
+ * @brief Open a corpus
+ * @param filename The name of the NDJSON or archive file
+ * @return A new corpus, or NULL if the file cannot be mapped
+ */
+NonoGramCorpus *nonogram_corpus_open(const char *filename) {
+  struct stat status;
+  if (stat(filename, &status) == 0 && S_ISDIR(status.st_mode)) {
+    return _open_directory(filename);
+  }
+  NonoGramCorpus *corpus = calloc(1, sizeof(NonoGramCorpus));
+  if (!corpus) {
+    return NULL;
+  }
+  corpus->archive = nonogram_archive_open(filename);
+  if (corpus->archive) {
+    return corpus;
+  }
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0 || fstat(fd, &status) < 0) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    free(corpus);
+    return NULL;
+  }
+  corpus->size = status.st_size;
+  if (corpus->size) {
+    void *data = mmap(NULL, corpus->size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      free(corpus);
+      return NULL;
+    }
+    madvise(data, corpus->size, MADV_SEQUENTIAL);
+    corpus->data = data;
+  }
+  close(fd);
+  return corpus;
+}
+
+/**
+ * @brief Close a corpus
+ * @param corpus The corpus
+ */
+void nonogram_corpus_close(NonoGramCorpus *corpus) {
+  if (corpus->archive) {
+    nonogram_archive_close(corpus->archive);
+  }
+  for (long index = 0; corpus->files && index < corpus->files_count;
+       index++) {
+    free(corpus->files[index]);
+  }
+  free(corpus->files);
+  free(corpus->lengths);
+  if (corpus->data) {
+    munmap((void *) corpus->data, corpus->size);
+  }
+  free(corpus);
+}
+
+/**
+ * @brief Get the end of a line
+ * @param data The start of the line
+ * @param end The end of the file
+ * @return The position of the newline, or end for the last line
+ */
+static const char *_line_end(const char *data, const char *end) {
+  const char *newline = memchr(data, '\n', end - data);
+  return newline ? newline : end;
+}
+
+/**
+ * @brief Check whether a line is blank
+ * @param data The start of the line
+ * @param end The end of the line
+ * @return true if the line only holds white spaces
+ */
+static bool _blank(const char *data, const char *end) {
+  while (data < end
+         && (*data == ' ' || *data == '\t' || *data == '\r')) {
+    data++;
+  }
+  return data == end;
+}
+
+/**
+ * @brief Count the puzzles of the chunks
+ * @param data The reader
+ * @return NULL
+ */
+static void *_count_chunks(void *data) {
+  NonoGramCorpusReader *reader = data;
+  const char *text = reader->corpus->data;
+  int index;
+  while ((index = atomic_fetch_add(&reader->next_count, 1))
+         < reader->chunks_count) {
+    NonoGramCorpusChunk *chunk = &reader->chunks[index];
+    if (reader->corpus->archive || reader->corpus->files) {
+      chunk->count = chunk->end - chunk->start;
+      continue;
+    }
+    const char *end = text + chunk->end;
+    for (const char *line = text + chunk->start; line < end;) {
+      const char *line_end = _line_end(line, end);
+      chunk->count += !_blank(line, line_end);
+      line = line_end + 1;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Parse the chunks and hand the puzzles over to the callback
+ * @param data The reader
+ * @return NULL
+ */
+static void *_parse_chunks(void *data) {
+  NonoGramCorpusReader *reader = data;
+  const char *text = reader->corpus->data;
+  int index;
+  while (!atomic_load(&reader->stopped)
+         && (index = atomic_fetch_add(&reader->next_parse, 1))
+            < reader->chunks_count) {
+    NonoGramCorpusChunk *chunk = &reader->chunks[index];
+    long id = chunk->first;
+    if (reader->corpus->archive || reader->corpus->files) {
+      for (; id < chunk->first + chunk->count; id++) {
+        NonoGramHints *hints =
+          nonogram_corpus_parse(reader->corpus, id, NULL, 0);
+        if (!reader->callback(id, hints, reader->data)) {
+          atomic_store(&reader->stopped, true);
+          break;
+        }
+      }
+      continue;
+    }
+    const char *end = text + chunk->end;
+    for (const char *line = text + chunk->start; line < end;) {
+      const char *line_end = _line_end(line, end);
+      if (!_blank(line, line_end)) {
+        NonoGramHints *hints =
+          nonogram_corpus_parse(reader->corpus, id, line, line_end - line);
+        if (!reader->callback(id++, hints, reader->data)) {
+          atomic_store(&reader->stopped, true);
+          break;
+        }
+      }
+      line = line_end + 1;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Run a function on several threads, the calling thread included
+ * @param reader The reader given to the function
+ * @param threads The number of threads
+ * @param function The function
+ * @note Threads that cannot be started are ignored: the chunks are shared
+ *       dynamically, so the others do their work
+ */
+static void _run(
+  NonoGramCorpusReader *reader,
+  int threads,
+  void *(*function)(void *)
+) {
+  pthread_t ids[threads > 1 ? threads - 1 : 1];
+  bool started[threads > 1 ? threads - 1 : 1];
+  for (int thread = 0; thread < threads - 1; thread++) {
+    started[thread] = !pthread_create(&ids[thread], NULL, function, reader);
+  }
+  function(reader);
+  for (int thread = 0; thread < threads - 1; thread++) {
+    if (started[thread]) {
+      pthread_join(ids[thread], NULL);
+    }
+  }
+}
+
+/**
+ * @brief Parse the puzzles of a corpus in parallel
+ * @param corpus The corpus
+ * @param threads The number of parsing threads
+ * @param callback The callback receiving the puzzles
+ * @param data The data given to the callback
+ * @return The number of puzzles, or -1 if memory allocation fails
+ */
+long nonogram_corpus_read(
+  NonoGramCorpus *corpus,
+  int threads,
+  NonoGramCorpusCallback callback,
+  void *data
+) {
+  if (threads < 1) {
+    threads = 1;
+  }
+  bool records = corpus->archive || corpus->files;
+  size_t size = corpus->archive
+    ? (size_t) nonogram_archive_get_count(corpus->archive)
+    : corpus->files ? (size_t) corpus->files_count : corpus->size;
+  size_t minimum = records ? CORPUS_MIN_PUZZLES : CORPUS_MIN_CHUNK;
+  size_t chunks_count = (size_t) threads * CORPUS_CHUNKS_PER_THREAD;
+  if (chunks_count > size / minimum) {
+    chunks_count = size / minimum;
+  }
+  if (!chunks_count) {
+    chunks_count = 1;
+  }
+  NonoGramCorpusReader reader = {
+    .corpus = corpus,
+    .chunks = calloc(chunks_count, sizeof(NonoGramCorpusChunk)),
+    .chunks_count = chunks_count,
+    .callback = callback,
+    .data = data,
+  };
+  if (!reader.chunks) {
+    return -1;
+  }
+  atomic_init(&reader.next_count, 0);
+  atomic_init(&reader.next_parse, 0);
+  atomic_init(&reader.stopped, false);
+
+  // Cut the corpus, NDJSON chunks start after a newline
+  size_t start = 0;
+  for (size_t index = 0; index < chunks_count; index++) {
+    size_t end = index + 1 == chunks_count
+      ? size
+      : size / chunks_count * (index + 1);
+    if (!records && end < size && end > start) {
+      end = _line_end(corpus->data + end - 1, corpus->data + size)
+        - corpus->data + 1;
+      if (end > size) {
+        end = size;
+      }
+    }
+    if (end < start) {
+      end = start;
+    }
+    reader.chunks[index].start = start;
+    reader.chunks[index].end = end;
+    start = end;
+  }
+
+  _run(&reader, threads, _count_chunks);
+  long count = 0;
+  for (size_t index = 0; index < chunks_count; index++) {
+    reader.chunks[index].first = count;
+    count += reader.chunks[index].count;
+  }
+  _run(&reader, threads, _parse_chunks);
+  free(reader.chunks);
+  return count;
+}
+
+/**
+ * @brief Walk through the records of a corpus without parsing them
+ * @param corpus The corpus
+ * @param callback The callback receiving the records
+ * @param data The data given to the callback
+ * @return The number of records given to the callback
+ */
+long nonogram_corpus_scan(
+  NonoGramCorpus *corpus,
+  NonoGramCorpusScanCallback callback,
+  void *data
+) {
+  long id = 0;
+  if (corpus->files) {
+    while (id < corpus->files_count
+           && callback(id, corpus->files[id], corpus->lengths[id], data)) {
+      id++;
+    }
+    return id < corpus->files_count ? id + 1 : id;
+  }
+  if (corpus->archive) {
+    long count = nonogram_archive_get_count(corpus->archive);
+    while (id < count && callback(id, NULL, 0, data)) {
+      id++;
+    }
+    return id < count ? id + 1 : id;
+  }
+  const char *end = corpus->data + corpus->size;
+  for (const char *line = corpus->data; line && line < end;) {
+    const char *line_end = _line_end(line, end);
+    if (!_blank(line, line_end)) {
+      if (!callback(id++, line, line_end - line, data)) {
+        break;
+      }
+    }
+    line = line_end + 1;
+  }
+  return id;
+}
+
+/**
+ * @brief Parse a record of a corpus
+ * @param corpus The corpus
+ * @param id The index of the puzzle in the corpus
+ * @param data The line of the puzzle, or NULL for an archive
+ * @param length The length of the line
+ * @return The hints of the puzzle, or NULL if the puzzle is invalid
+ */
+NonoGramHints *nonogram_corpus_parse(
+  NonoGramCorpus *corpus,
+  long id,
+  const char *data,
+  size_t length
+) {
+  if (corpus->archive) {
+    return nonogram_archive_get_hints(corpus->archive, id);
+  }
+  if (corpus->files) {
+    if (!data) {
+      data = corpus->files[id];
+      length = corpus->lengths[id];
+    }
+    // A file is either a PBM image or a hints object
+    const char *start = data;
+    while (start && start < data + length && strchr(" \t\r\n", *start)) {
+      start++;
+    }
+    if (!start) {
+      return NULL;
+    }
+    if (start < data + length && *start == 'P') {
+      return nonogram_hints_parse_pbm(data, length);
+    }
+  }
+  return nonogram_hints_parse(data, length);
+}
@@ -0,0 +1,126 @@
+#ifndef CORPUS_H_
+#define CORPUS_H_
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "./nonogram.h"
+
+/**
+ * NonoGramCorpus is a opaque structure that represents a file of puzzles
+ * mapped in memory: either NDJSON, a hints object per line, or an archive;
+ * or files of a puzzle each, hints objects or PBM images, loaded in memory.
+ */
+typedef struct _NonoGramCorpus NonoGramCorpus;
+
+/**
+ * NonoGramCorpusCallback receives the puzzles of a corpus.
+ * @param id The index of the puzzle in the corpus
+ * @param hints The hints of the puzzle, owned by the callback, or NULL if
+ *        the puzzle is invalid
+ * @param data The data given to the reader
+ * @return false to stop reading
+ * @note The callback is called concurrently by the parsing threads
+ */
+typedef bool (*NonoGramCorpusCallback)(
+  long id,
+  NonoGramHints *hints,
+  void *data
+);
+
+/**
+ * NonoGramCorpusScanCallback receives the unparsed records of a corpus.
+ * @param id The index of the puzzle in the corpus
+ * @param data The line of the puzzle, or NULL for an archive
+ * @param length The length of the line
+ * @param user_data The data given to the scan
+ * @return false to stop scanning
+ */
+typedef bool (*NonoGramCorpusScanCallback)(
+  long id,
+  const char *data,
+  size_t length,
+  void *user_data
+);
+
+/**
+ * @brief Open a corpus
+ * @param filename The name of the NDJSON or archive file, or of a directory
+ * @return A new corpus, or NULL if the file cannot be mapped
+ * @note The files of a directory are sorted by name, hidden files are
+ *       ignored
+ */
+extern NonoGramCorpus *nonogram_corpus_open(const char *filename);
+/**
+ * @brief Open a corpus made of files
+ * @param filenames The names of the files, hints objects or PBM images
+ * @param count The number of files
+ * @param depth The number of files loaded at once
+ * @return A new corpus, or NULL if memory allocation fails
+ * @note The files are loaded with batched system calls, through io_uring
+ *       when the kernel has it. The ids of the puzzles are the indexes of
+ *       the files, unreadable files are invalid puzzles
+ */
+extern NonoGramCorpus *nonogram_corpus_open_files(
+  const char *const *filenames,
+  long count,
+  int depth
+);
+/**
+ * @brief Close a corpus
+ * @param corpus The corpus
+ */
+extern void nonogram_corpus_close(NonoGramCorpus *corpus);
+
+/**
+ * @brief Parse the puzzles of a corpus in parallel
+ * @param corpus The corpus
+ * @param threads The number of parsing threads
+ * @param callback The callback receiving the puzzles
+ * @param data The data given to the callback
+ * @return The number of puzzles, or -1 if memory allocation fails
+ * @note The file is cut into chunks on line boundaries. The threads first
+ *       count the lines of the chunks, so that ids follow the file order,
+ *       then parse the chunks; blank lines are skipped
+ * @note The calling thread is one of the parsing threads, this returns once
+ *       every puzzle has been given to the callback
+ */
+extern long nonogram_corpus_read(
+  NonoGramCorpus *corpus,
+  int threads,
+  NonoGramCorpusCallback callback,
+  void *data
+);
+
+/**
+ * @brief Walk through the records of a corpus without parsing them
+ * @param corpus The corpus
+ * @param callback The callback receiving the records
+ * @param data The data given to the callback
+ * @return The number of records given to the callback
+ * @note Records stay valid until the corpus is closed, so that they can be
+ *       parsed later by other threads with nonogram_corpus_parse
+ */
+extern long nonogram_corpus_scan(
+  NonoGramCorpus *corpus,
+  NonoGramCorpusScanCallback callback,
+  void *data
+);
+/**
+ * @brief Parse a record of a corpus
+ * @param corpus The corpus
+ * @param id The index of the puzzle in the corpus
+ * @param data The line of the puzzle, or NULL for an archive
+ * @param length The length of the line
+ * @return The hints of the puzzle, or NULL if the puzzle is invalid
+ */
+extern NonoGramHints *nonogram_corpus_parse(
+  NonoGramCorpus *corpus,
+  long id,
+  const char *data,
+  size_t length
+);
+
+#endif  // CORPUS_H_
@@ -0,0 +1,475 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+/**
+ * @file generator.c
+ * @brief Implementation of the generator of unique puzzles.
+ *
+ * Most random boards give ambiguous puzzles, and drawing boards until one
+ * is unique wastes most of them. A board is rather mutated: an unknown
+ * cell of its puzzle, empty if possible, is filled or emptied, which
+ * changes the clues of one row and one column only. The clues are edited in
+ * place and the solver is reset rather than created again. A check
+ * propagates the lines, then computes the backbone once few cells are left
+ * unknown: the board, a solution of its own puzzle, is found first by
+ * following the phases, and only the search for the cells differing from it
+ * is left.
+ */
+#include "./generator.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "./nonogram.h"
+#include "./solver.h"
+
+#include "./nonogram.inc"
+#include "./generator.inc"
+
+/**
+ * @brief Default fraction of filled cells of random boards
+ */
+#define GENERATOR_DENSITY 0.5
+
+/**
+ * @brief Default number of flips per cell of a board
+ */
+#define GENERATOR_MUTATIONS 1
+
+/**
+ * @brief Number of decisions per cell of a uniqueness check
+ */
+#define CHECK_NODES 4
+
+/**
+ * @brief Fraction of the cells left unknown by propagation under which a
+ *        uniqueness check searches
+ */
+#define CHECK_UNKNOWN 0.1
+
+/**
+ * @brief Number of decisions per cell of a rating
+ */
+#define RATE_NODES 16
+
+/**
+ * @brief Change of the density after a puzzle rejected by its rating
+ */
+#define DENSITY_STEP 0.02
+
+/**
+ * @brief Lowest density steered toward
+ */
+#define DENSITY_MIN 0.2
+
+/**
+ * @brief Highest density steered toward
+ */
+#define DENSITY_MAX 0.8
+
+/**
+ * @brief Draw a random number
+ * @param generator The generator
+ * @return A random 64 bits number
+ */
+static unsigned long long _random(NonoGramGenerator *generator) {
+  generator->random ^= generator->random >> 12;
+  generator->random ^= generator->random << 25;
+  generator->random ^= generator->random >> 27;
+  return generator->random * 2685821657736338717ULL;
+}
+
+/**
+ * @brief Compute the clue of a line of the board
+ * @param generator The generator
+ * @param line The line index, rows first, then columns
+ */
+static void _set_clue(NonoGramGenerator *generator, int line) {
+  bool is_row = line < generator->rows_count;
+  int index = is_row ? line : line - generator->rows_count;
+  int length = is_row ? generator->cols_count : generator->rows_count;
+  int step = is_row ? 1 : generator->cols_count;
+  const signed char *cell =
+    generator->board + (is_row ? index * generator->cols_count : index);
+  int *values = is_row ? generator->hints->rows[index]
+                       : generator->hints->cols[index];
+  int count = 0;
+  int block = 0;
+  for (int position = 0; position < length; position++, cell += step) {
+    if (*cell) {
+      block++;
+    } else if (block) {
+      values[count++] = block;
+      block = 0;
+    }
+  }
+  if (block) {
+    values[count++] = block;
+  }
+  memset(values + count, 0, (length - count) * sizeof(int));
+}
+
+/**
+ * @brief Flip a cell of the board and update the clues of its lines
+ * @param generator The generator
+ * @param cell The cell index
+ */
+static void _flip(NonoGramGenerator *generator, int cell) {
+  generator->board[cell] = !generator->board[cell];
+  _set_clue(generator, cell / generator->cols_count);
+  _set_clue(generator, generator->rows_count + cell % generator->cols_count);
+}
+
+/**
+ * @brief Collect the cells left unknown by the solver
+ *
+ * Empty cells come first, so that flips can favour filling cells: lines
+ * with more filled cells have fewer placements.
+ *
+ * @param generator The generator
+ * @return The number of unknown cells
+ */
+static int _collect(NonoGramGenerator *generator) {
+  int count = 0;
+  int empty = 0;
+  for (int cell = 0; cell < generator->cells_count; cell++) {
+    if (nonogram_solver_get_cell(generator->solver,
+                                 cell / generator->cols_count,
+                                 cell % generator->cols_count) != -1) {
+      continue;
+    }
+    generator->varying[count++] = cell;
+    if (!generator->board[cell]) {
+      generator->varying[count - 1] = generator->varying[empty];
+      generator->varying[empty++] = cell;
+    }
+  }
+  generator->varying_count = count;
+  generator->empty_count = empty;
+  return count;
+}
+
+/**
+ * @brief Find the cells differing between the solutions of the board
+ *
+ * Propagation first settles the cells fixed by the lines alone, then
+ * probing when harder puzzles are wanted, and a puzzle solved by a stage
+ * below the lowest rating is rejected before any search. The search then
+ * computes the backbone, if the range of ratings allows puzzles needing
+ * it and, for easy puzzles, once few cells are left unknown. The unknown
+ * cells of a check stopped earlier are a superset of the cells differing
+ * between solutions, and the puzzle is then taken as ambiguous.
+ *
+ * @param generator The generator
+ * @return The number of cells differing between solutions, more than the
+ *         number of cells if the puzzle is too easy
+ */
+static int _check(NonoGramGenerator *generator) {
+  NonoGramSolver *solver = generator->solver;
+  nonogram_solver_reset(solver);
+  generator->stats.checks++;
+  generator->level = 0;
+  nonogram_solver_solve(solver, NONOGRAM_ENGINE_LINE);
+  int count = _collect(generator);
+  int level = 1;
+  if (count && generator->minimum > 1) {
+    nonogram_solver_probe(solver);
+    count = _collect(generator);
+    level = 2;
+  }
+  if (!count) {
+    generator->level = level;
+    if (level < generator->minimum) {
+      generator->stats.easy++;
+      return generator->cells_count + 1;
+    }
+    return 0;
+  }
+  if ((generator->maximum && generator->maximum <= level)
+      || (generator->minimum <= 1
+          && count > CHECK_UNKNOWN * generator->cells_count)) {
+    return count;
+  }
+  for (int cell = 0; cell < generator->cells_count; cell++) {
+    nonogram_solver_set_phase(solver, cell / generator->cols_count,
+                              cell % generator->cols_count,
+                              generator->board[cell]);
+  }
+  nonogram_solver_set_node_limit(
+    solver, nonogram_solver_get_stats(solver)->nodes
+              + CHECK_NODES * generator->cells_count);
+  // The board is a solution: the puzzle cannot fail
+  nonogram_solver_backbone(solver);
+  return _collect(generator);
+}
+
+/**
+ * @brief Rate the puzzle of the board, known to be unique
+ * @param generator The generator
+ * @return The rating, 0 if it needs too many decisions
+ */
+static int _rate(NonoGramGenerator *generator) {
+  if (generator->level) {
+    return generator->level;
+  }
+  NonoGramSolver *solver = generator->solver;
+  nonogram_solver_reset(solver);
+  for (int cell = 0; cell < generator->cells_count; cell++) {
+    nonogram_solver_set_phase(solver, cell / generator->cols_count,
+                              cell % generator->cols_count, -1);
+  }
+  nonogram_solver_set_node_limit(
+    solver, nonogram_solver_get_stats(solver)->nodes
+              + RATE_NODES * generator->cells_count);
+  return nonogram_solver_rate(solver);
+}
+
+/**
+ * @brief Move the density of the boards after a rejected rating
+ *
+ * Sparser boards give puzzles with fewer settled lines, which are harder.
+ *
+ * @param generator The generator
+ * @param rating The rating of the rejected puzzle, 0 if too hard
+ */
+static void _steer(NonoGramGenerator *generator, int rating) {
+  bool easier = !rating
+    || (generator->maximum && rating > generator->maximum);
+  generator->density += easier ? DENSITY_STEP : -DENSITY_STEP;
+  if (generator->density < DENSITY_MIN) {
+    generator->density = DENSITY_MIN;
+  } else if (generator->density > DENSITY_MAX) {
+    generator->density = DENSITY_MAX;
+  }
+}
+
+/**
+ * @brief Draw a random board
+ * @param generator The generator
+ */
+static void _draw(NonoGramGenerator *generator) {
+  for (int cell = 0; cell < generator->cells_count; cell++) {
+    double uniform = (_random(generator) >> 11) * (1.0 / 9007199254740992.0);
+    generator->board[cell] = uniform < generator->density;
+  }
+  for (int line = 0; line < generator->rows_count + generator->cols_count;
+       line++) {
+    _set_clue(generator, line);
+  }
+  generator->stats.candidates++;
+}
+
+/**
+ * @brief Create a new generator
+ * @param rows_count The number of rows of the puzzles
+ * @param cols_count The number of columns of the puzzles
+ * @param seed The seed of the random generator
+ * @return A new generator, or NULL if memory allocation fails
+ */
+NonoGramGenerator *nonogram_generator_create(
+  int rows_count,
+  int cols_count,
+  unsigned long seed
+) {
+  if (rows_count <= 0 || cols_count <= 0) {
+    return NULL;
+  }
+  NonoGramGenerator *generator = calloc(1, sizeof(NonoGramGenerator));
+  if (!generator) {
+    return NULL;
+  }
+  generator->rows_count = rows_count;
+  generator->cols_count = cols_count;
+  generator->cells_count = rows_count * cols_count;
+  generator->density = GENERATOR_DENSITY;
+  generator->mutations = GENERATOR_MUTATIONS * generator->cells_count;
+  generator->random = (seed ^ 0x9E3779B97F4A7C15ULL) | 1;
+  generator->hints = nonogram_hints_create_empty(rows_count, cols_count);
+  generator->solver =
+    generator->hints ? nonogram_solver_create(generator->hints) : NULL;
+  generator->board = calloc(generator->cells_count, sizeof(signed char));
+  generator->varying = malloc(generator->cells_count * sizeof(int));
+  generator->previous = malloc(generator->cells_count * sizeof(int));
+  if (!generator->solver || !generator->board || !generator->varying
+      || !generator->previous) {
+    nonogram_generator_destroy(generator);
+    return NULL;
+  }
+  return generator;
+}
+
+/**
+ * @brief Destroy a generator
+ * @param generator The generator
+ */
+void nonogram_generator_destroy(NonoGramGenerator *generator) {
+  if (generator->solver) {
+    nonogram_solver_destroy(generator->solver);
+  }
+  if (generator->hints) {
+    nonogram_hints_destroy(generator->hints);
+  }
+  free(generator->board);
+  free(generator->varying);
+  free(generator->previous);
+  free(generator);
+}
+
+/**
+ * @brief Set the fraction of filled cells of the random boards
+ * @param generator The generator
+ * @param density The density, between 0 and 1
+ */
+void nonogram_generator_set_density(
+  NonoGramGenerator *generator,
+  double density
+) {
+  assert(density >= 0.0 && density <= 1.0);
+  generator->density = density;
+}
+
+/**
+ * @brief Set the number of cells flipped in a board before drawing another
+ * @param generator The generator
+ * @param mutations The number of flips, 0 to generate and test
+ */
+void nonogram_generator_set_mutations(
+  NonoGramGenerator *generator,
+  long mutations
+) {
+  generator->mutations = mutations > 0 ? mutations : 0;
+}
+
+/**
+ * @brief Set the range of the ratings of the puzzles
+ * @param generator The generator
+ * @param minimum The lowest rating
+ * @param maximum The highest rating, 0 for none
+ */
+void nonogram_generator_set_rating(
+  NonoGramGenerator *generator,
+  int minimum,
+  int maximum
+) {
+  generator->minimum = minimum;
+  generator->maximum = maximum;
+}
+
+/**
+ * @brief Copy the clues of the board
+ * @param generator The generator
+ * @return The hints of the board, or NULL if memory allocation fails
+ */
+static NonoGramHints *_copy_hints(NonoGramGenerator *generator) {
+  NonoGramHints *hints =
+    nonogram_hints_create_empty(generator->rows_count, generator->cols_count);
+  if (!hints) {
+    return NULL;
+  }
+  for (int row = 0; row < generator->rows_count; row++) {
+    memcpy(hints->rows[row], generator->hints->rows[row],
+           generator->cols_count * sizeof(int));
+  }
+  for (int col = 0; col < generator->cols_count; col++) {
+    memcpy(hints->cols[col], generator->hints->cols[col],
+           generator->rows_count * sizeof(int));
+  }
+  return hints;
+}
+
+/**
+ * @brief Generate a puzzle having a unique solution
+ *
+ * A flip leaving more cells unknown is undone, and the unknown cells of the
+ * board before it are restored.
+ *
+ * @param generator The generator
+ * @param candidates The maximal number of random boards drawn, 0 for none
+ * @return The hints of the puzzle, or NULL if no puzzle has been found
+ */
+NonoGramHints *nonogram_generator_next(
+  NonoGramGenerator *generator,
+  long candidates
+) {
+  for (long candidate = 0; !candidates || candidate < candidates;
+       candidate++) {
+    _draw(generator);
+    int count = _check(generator);
+    if (count > generator->cells_count) {
+      continue;
+    }
+    for (long mutation = 0; count > 0 && mutation < generator->mutations;
+         mutation++) {
+      // Filling cells leads to puzzles solved by propagation
+      int empty = generator->empty_count;
+      int choices = empty && generator->minimum <= 1 ? empty : count;
+      int cell = generator->varying[_random(generator) % choices];
+      int *previous = generator->varying;
+      generator->varying = generator->previous;
+      generator->previous = previous;
+      _flip(generator, cell);
+      generator->stats.mutations++;
+      int flipped = _check(generator);
+      if (flipped > count) {
+        _flip(generator, cell);
+        generator->previous = generator->varying;
+        generator->varying = previous;
+        generator->varying_count = count;
+        generator->empty_count = empty;
+      } else {
+        count = flipped;
+      }
+    }
+    if (!count) {
+      int rating = _rate(generator);
+      if (rating && rating >= generator->minimum
+          && (!generator->maximum || rating <= generator->maximum)) {
+        generator->rating = rating;
+        generator->stats.puzzles++;
+        return _copy_hints(generator);
+      }
+      generator->stats.rejected++;
+      _steer(generator, rating);
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Get the solution of the last generated puzzle
+ * @param generator The generator
+ * @param row The row index
+ * @param col The col index
+ * @return 1 if the cell is filled, 0 if it is empty
+ */
+int nonogram_generator_get_cell(
+  NonoGramGenerator *generator,
+  int row,
+  int col
+) {
+  assert(row < generator->rows_count);
+  assert(col < generator->cols_count);
+  return generator->board[row * generator->cols_count + col];
+}
+
+/**
+ * @brief Get the rating of the last generated puzzle
+ * @param generator The generator
+ * @return The rating
+ */
+int nonogram_generator_get_rating(NonoGramGenerator *generator) {
+  return generator->rating;
+}
+
+/**
+ * @brief Get the counters of a generator
+ * @param generator The generator
+ * @return The counters of the generator
+ */
+const NonoGramGeneratorStats *nonogram_generator_get_stats(
+  NonoGramGenerator *generator
+) {
+  return &generator->stats;
+}
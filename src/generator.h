@@ -0,0 +1,131 @@
+#ifndef GENERATOR_H_
+#define GENERATOR_H_
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+#include "./nonogram.h"
+
+/**
+ * NonoGramGenerator is a opaque structure that represents a generator of
+ * puzzles having a unique solution.
+ */
+typedef struct _NonoGramGenerator NonoGramGenerator;
+
+/**
+ * NonoGramGeneratorStats holds the counters of a generator.
+ */
+typedef struct {
+  long candidates;  // Number of random boards drawn
+  long mutations;   // Number of cells flipped
+  long checks;      // Number of uniqueness checks
+  long easy;        // Checks rejected as too easy before any search
+  long rejected;    // Unique puzzles rejected by their rating
+  long puzzles;     // Number of puzzles generated
+} NonoGramGeneratorStats;
+
+/**
+ * @brief Create a new generator
+ * @param rows_count The number of rows of the puzzles
+ * @param cols_count The number of columns of the puzzles
+ * @param seed The seed of the random generator
+ * @return A new generator, or NULL if memory allocation fails
+ */
+extern NonoGramGenerator *nonogram_generator_create(
+  int rows_count,
+  int cols_count,
+  unsigned long seed
+);
+
+/**
+ * @brief Destroy a generator
+ * @param generator The generator
+ */
+extern void nonogram_generator_destroy(NonoGramGenerator *generator);
+
+/**
+ * @brief Set the fraction of filled cells of the random boards
+ * @param generator The generator
+ * @param density The density, between 0 and 1
+ */
+extern void nonogram_generator_set_density(
+  NonoGramGenerator *generator,
+  double density
+);
+
+/**
+ * @brief Set the number of cells flipped in a board before drawing another
+ * @param generator The generator
+ * @param mutations The number of flips, 0 to generate and test random
+ *        boards
+ */
+extern void nonogram_generator_set_mutations(
+  NonoGramGenerator *generator,
+  long mutations
+);
+
+/**
+ * @brief Set the range of the ratings of the puzzles
+ * @param generator The generator
+ * @param minimum The lowest rating
+ * @param maximum The highest rating, 0 for none
+ * @note See nonogram_solver_rate for the ratings
+ */
+extern void nonogram_generator_set_rating(
+  NonoGramGenerator *generator,
+  int minimum,
+  int maximum
+);
+
+/**
+ * @brief Generate a puzzle having a unique solution
+ * @param generator The generator
+ * @param candidates The maximal number of random boards drawn, 0 for none
+ * @return The hints of the puzzle, to destroy by the caller, or NULL if no
+ *         puzzle has been found or if memory allocation fails
+ * @note A board whose puzzle is ambiguous is mutated: a cell left unknown
+ *       by the check, empty if possible, is flipped, and the flip is kept
+ *       unless more cells are unknown afterwards. Only the clues of the row
+ *       and of the column of the cell change, and the same solver checks
+ *       every mutation, starting with the board as its first solution.
+ * @note Below a lowest rating of 2, boards are steered toward puzzles
+ *       solved by propagation. Otherwise a board solved by propagation, or
+ *       by probing above a lowest rating of 2, is rejected at once, before
+ *       any search, and flips leading to one are undone. A unique puzzle
+ *       out of the range of ratings is rejected, and the density of the
+ *       next boards moves toward the range.
+ */
+extern NonoGramHints *nonogram_generator_next(
+  NonoGramGenerator *generator,
+  long candidates
+);
+
+/**
+ * @brief Get the solution of the last generated puzzle
+ * @param generator The generator
+ * @param row The row index
+ * @param col The col index
+ * @return 1 if the cell is filled, 0 if it is empty
+ */
+extern int nonogram_generator_get_cell(
+  NonoGramGenerator *generator,
+  int row,
+  int col
+);
+
+/**
+ * @brief Get the rating of the last generated puzzle
+ * @param generator The generator
+ * @return The rating, see nonogram_solver_rate
+ */
+extern int nonogram_generator_get_rating(NonoGramGenerator *generator);
+
+/**
+ * @brief Get the counters of a generator
+ * @param generator The generator
+ * @return The counters of the generator
+ */
+extern const NonoGramGeneratorStats *nonogram_generator_get_stats(
+  NonoGramGenerator *generator
+);
+
+#endif  // GENERATOR_H_
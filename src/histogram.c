@@ -0,0 +1,246 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+/**
+ * @file histogram.c
+ * @brief Implementation of the lock-free histograms of durations.
+ *
+ * Durations are counted in nanoseconds in log-linear buckets, as in HDR
+ * histograms: a bucket per power of two, split linearly in a few
+ * sub-buckets. Recording is three relaxed atomic additions, readers sum the
+ * buckets without stopping the writers.
+ */
+#include "./histogram.h"
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "./histogram.inc"
+
+/**
+ * @brief Exponent of the smallest bound of the Prometheus buckets
+ */
+#define HISTOGRAM_MIN_BOUND 10
+
+/**
+ * @brief Create a new histogram
+ * @return A new empty histogram, or NULL if memory allocation fails
+ */
+NonoGramHistogram *nonogram_histogram_create(void) {
+  NonoGramHistogram *histogram = malloc(sizeof(NonoGramHistogram));
+  if (!histogram) {
+    return NULL;
+  }
+  for (int index = 0; index < HISTOGRAM_BUCKETS; index++) {
+    atomic_init(&histogram->buckets[index], 0);
+  }
+  atomic_init(&histogram->count, 0);
+  atomic_init(&histogram->sum, 0);
+  return histogram;
+}
+
+/**
+ * @brief Destroy a histogram
+ * @param histogram The histogram
+ */
+void nonogram_histogram_destroy(NonoGramHistogram *histogram) {
+  free(histogram);
+}
+
+/**
+ * @brief Get the bucket of a value
+ * @param value The value in nanoseconds
+ * @return The index of the bucket
+ */
+static int _bucket(uint64_t value) {
+  if (value < HISTOGRAM_SUB_COUNT) {
+    return value;
+  }
+  int exponent = 63 - __builtin_clzll(value);
+  if (exponent > HISTOGRAM_MAX_EXPONENT) {
+    return HISTOGRAM_BUCKETS - 1;
+  }
+  int sub = (value >> (exponent - HISTOGRAM_SUB_BITS))
+    & (HISTOGRAM_SUB_COUNT - 1);
+  return (exponent - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_COUNT + sub;
+}
+
+/**
+ * @brief Get the upper bound of a bucket
+ * @param index The index of the bucket
+ * @return The smallest value in nanoseconds above the bucket
+ */
+static uint64_t _bound(int index) {
+  index++;
+  if (index < 2 * HISTOGRAM_SUB_COUNT) {
+    return index;
+  }
+  int exponent = index / HISTOGRAM_SUB_COUNT + HISTOGRAM_SUB_BITS - 1;
+  uint64_t sub = index % HISTOGRAM_SUB_COUNT;
+  return (HISTOGRAM_SUB_COUNT + sub) << (exponent - HISTOGRAM_SUB_BITS);
+}
+
+/**
+ * @brief Record a duration
+ * @param histogram The histogram
+ * @param seconds The duration in seconds
+ */
+void nonogram_histogram_record(NonoGramHistogram *histogram, double seconds) {
+  uint64_t value = seconds > 0.0 ? (uint64_t) (seconds * 1e9 + 0.5) : 0;
+  atomic_fetch_add_explicit(
+    &histogram->buckets[_bucket(value)], 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&histogram->count, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&histogram->sum, value, memory_order_relaxed);
+}
+
+/**
+ * @brief Add the durations of a histogram to another one
+ * @param histogram The histogram receiving the durations
+ * @param other The histogram whose durations are added
+ */
+void nonogram_histogram_add(
+  NonoGramHistogram *histogram,
+  NonoGramHistogram *other
+) {
+  for (int index = 0; index < HISTOGRAM_BUCKETS; index++) {
+    unsigned long count =
+      atomic_load_explicit(&other->buckets[index], memory_order_relaxed);
+    if (count) {
+      atomic_fetch_add_explicit(
+        &histogram->buckets[index], count, memory_order_relaxed);
+    }
+  }
+  atomic_fetch_add_explicit(
+    &histogram->count,
+    atomic_load_explicit(&other->count, memory_order_relaxed),
+    memory_order_relaxed);
+  atomic_fetch_add_explicit(
+    &histogram->sum,
+    atomic_load_explicit(&other->sum, memory_order_relaxed),
+    memory_order_relaxed);
+}
+
+/**
+ * @brief Get the number of durations recorded
+ * @param histogram The histogram
+ * @return The number of durations
+ */
+long nonogram_histogram_get_count(NonoGramHistogram *histogram) {
+  return atomic_load_explicit(&histogram->count, memory_order_relaxed);
+}
+
+/**
+ * @brief Get the sum of the durations recorded
+ * @param histogram The histogram
+ * @return The sum in seconds
+ */
+double nonogram_histogram_get_sum(NonoGramHistogram *histogram) {
+  return atomic_load_explicit(&histogram->sum, memory_order_relaxed) * 1e-9;
+}
+
+/**
+ * @brief Get a quantile of the durations recorded
+ * @param histogram The histogram
+ * @param quantile The quantile, between 0 and 1
+ * @return The upper bound of the bucket holding the quantile in seconds
+ */
+double nonogram_histogram_get_quantile(
+  NonoGramHistogram *histogram,
+  double quantile
+) {
+  // The buckets are summed, so that the rank fits the counts read
+  unsigned long counts[HISTOGRAM_BUCKETS];
+  unsigned long total = 0;
+  for (int index = 0; index < HISTOGRAM_BUCKETS; index++) {
+    counts[index] =
+      atomic_load_explicit(&histogram->buckets[index], memory_order_relaxed);
+    total += counts[index];
+  }
+  if (!total) {
+    return 0.0;
+  }
+  unsigned long rank = quantile <= 0.0 ? 1
+    : quantile >= 1.0 ? total
+    : (unsigned long) (quantile * total + 0.5);
+  if (rank < 1) {
+    rank = 1;
+  }
+  unsigned long seen = 0;
+  for (int index = 0; index < HISTOGRAM_BUCKETS; index++) {
+    seen += counts[index];
+    if (seen >= rank) {
+      return _bound(index) * 1e-9;
+    }
+  }
+  return _bound(HISTOGRAM_BUCKETS - 1) * 1e-9;
+}
+
+/**
+ * @brief Append formatted text to a buffer
+ * @param buffer The buffer, or NULL
+ * @param size The size of the buffer
+ * @param length The length of the text, updated even past the buffer
+ * @param format The format, as for printf
+ */
+static void _print(
+  char *buffer,
+  size_t size,
+  size_t *length,
+  const char *format,
+  ...
+) {
+  va_list arguments;
+  va_start(arguments, format);
+  int written = vsnprintf(*length < size ? buffer + *length : NULL,
+                          *length < size ? size - *length : 0,
+                          format, arguments);
+  va_end(arguments);
+  *length += written > 0 ? written : 0;
+}
+
+/**
+ * @brief Format a histogram in the Prometheus text format
+ * @param histogram The histogram
+ * @param name The name of the metric
+ * @param help The description of the metric
+ * @param buffer The buffer receiving the text, or NULL
+ * @param size The size of the buffer
+ * @return The length of the text
+ */
+size_t nonogram_histogram_format(
+  NonoGramHistogram *histogram,
+  const char *name,
+  const char *help,
+  char *buffer,
+  size_t size
+) {
+  size_t length = 0;
+  _print(buffer, size, &length, "# HELP %s %s\n# TYPE %s histogram\n",
+         name, help, name);
+  unsigned long cumulative = 0;
+  int index = 0;
+  for (int exponent = HISTOGRAM_MIN_BOUND;
+       exponent <= HISTOGRAM_MAX_EXPONENT; exponent++) {
+    uint64_t bound = (uint64_t) 1 << exponent;
+    while (index < HISTOGRAM_BUCKETS - 1 && _bound(index) <= bound) {
+      cumulative += atomic_load_explicit(
+        &histogram->buckets[index++], memory_order_relaxed);
+    }
+    _print(buffer, size, &length, "%s_bucket{le=\"%.9g\"} %lu\n",
+           name, bound * 1e-9, cumulative);
+  }
+  while (index < HISTOGRAM_BUCKETS) {
+    cumulative += atomic_load_explicit(
+      &histogram->buckets[index++], memory_order_relaxed);
+  }
+  _print(buffer, size, &length, "%s_bucket{le=\"+Inf\"} %lu\n",
+         name, cumulative);
+  _print(buffer, size, &length, "%s_sum %.9f\n",
+         name, nonogram_histogram_get_sum(histogram));
+  // The count matches the +Inf bucket even while durations are recorded
+  _print(buffer, size, &length, "%s_count %lu\n", name, cumulative);
+  return length;
+}
@@ -0,0 +1,93 @@
+#ifndef HISTOGRAM_H_
+#define HISTOGRAM_H_
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+#include <stddef.h>
+
+/**
+ * NonoGramHistogram is a opaque structure that represents a lock-free
+ * histogram of durations, with a bounded relative error.
+ */
+typedef struct _NonoGramHistogram NonoGramHistogram;
+
+/**
+ * @brief Create a new histogram
+ * @return A new empty histogram, or NULL if memory allocation fails
+ */
+extern NonoGramHistogram *nonogram_histogram_create(void);
+/**
+ * @brief Destroy a histogram
+ * @param histogram The histogram
+ */
+extern void nonogram_histogram_destroy(NonoGramHistogram *histogram);
+
+/**
+ * @brief Record a duration
+ * @param histogram The histogram
+ * @param seconds The duration in seconds
+ * @note This can be called concurrently by any number of threads, durations
+ *       are counted with a resolution of a nanosecond and a relative error
+ *       below 1/8, up to about 18 minutes
+ */
+extern void nonogram_histogram_record(
+  NonoGramHistogram *histogram,
+  double seconds
+);
+/**
+ * @brief Add the durations of a histogram to another one
+ * @param histogram The histogram receiving the durations
+ * @param other The histogram whose durations are added
+ * @note Both histograms can be recorded concurrently, as when the
+ *       histograms of several threads are aggregated
+ */
+extern void nonogram_histogram_add(
+  NonoGramHistogram *histogram,
+  NonoGramHistogram *other
+);
+
+/**
+ * @brief Get the number of durations recorded
+ * @param histogram The histogram
+ * @return The number of durations
+ */
+extern long nonogram_histogram_get_count(NonoGramHistogram *histogram);
+/**
+ * @brief Get the sum of the durations recorded
+ * @param histogram The histogram
+ * @return The sum in seconds
+ */
+extern double nonogram_histogram_get_sum(NonoGramHistogram *histogram);
+/**
+ * @brief Get a quantile of the durations recorded
+ * @param histogram The histogram
+ * @param quantile The quantile, between 0 and 1
+ * @return The upper bound of the bucket holding the quantile in seconds, or
+ *         0 if the histogram is empty
+ */
+extern double nonogram_histogram_get_quantile(
+  NonoGramHistogram *histogram,
+  double quantile
+);
+
+/**
+ * @brief Format a histogram in the Prometheus text format
+ * @param histogram The histogram
+ * @param name The name of the metric
+ * @param help The description of the metric
+ * @param buffer The buffer receiving the text, or NULL
+ * @param size The size of the buffer
+ * @return The length of the text, which is truncated if it does not fit, as
+ *         with snprintf
+ * @note The buckets are bounded by powers of two from about a microsecond,
+ *       the same ones at every call so that they can be aggregated
+ */
+extern size_t nonogram_histogram_format(
+  NonoGramHistogram *histogram,
+  const char *name,
+  const char *help,
+  char *buffer,
+  size_t size
+);
+
+#endif  // HISTOGRAM_H_
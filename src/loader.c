@@ -0,0 +1,644 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+/**
+ * @file loader.c
+ * @brief Implementation of the batched file loader.
+ *
+ * Every file goes through the same stages, open, read or write, close,
+ * in one of depth slots. With io_uring, the next operation of every slot
+ * is queued in the submission ring when the previous one completes, and a
+ * single io_uring_enter submits them all and waits for a completion; the
+ * ring is set up with the raw system calls, without liburing. Otherwise,
+ * files are opened depth files ahead with a read-ahead advice, so that
+ * the kernel reads them while earlier files are read with pread: regular
+ * files cannot be polled with epoll.
+ */
+#include "./loader.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+// Headers from Linux 5.6 have the operations on files
+#if defined(IORING_FEAT_CUR_PERSONALITY) && defined(__NR_io_uring_setup)
+#define LOADER_URING
+#endif
+
+#include "./loader.inc"
+
+#ifdef LOADER_URING
+
+/**
+ * @brief Check that a ring has the operations of the loader
+ * @param fd The ring
+ * @return true if the operations are supported
+ */
+static bool _ring_supports(int fd) {
+  struct io_uring_probe *probe = calloc(
+    1, sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op));
+  if (!probe) {
+    return false;
+  }
+  bool supported =
+    syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256)
+    >= 0;
+  const int operations[] = {
+    IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_CLOSE
+  };
+  for (int index = 0; supported && index < 4; index++) {
+    supported = operations[index] <= probe->last_op
+      && (probe->ops[operations[index]].flags & IO_URING_OP_SUPPORTED);
+  }
+  free(probe);
+  return supported;
+}
+
+/**
+ * @brief Unmap and close a ring
+ * @param ring The ring
+ */
+static void _ring_close(NonoGramLoaderRing *ring) {
+  if (ring->sqes && ring->sqes != MAP_FAILED) {
+    munmap(ring->sqes, ring->sqes_size);
+  }
+  if (ring->cq_map && ring->cq_map != MAP_FAILED
+      && ring->cq_map != ring->sq_map) {
+    munmap(ring->cq_map, ring->cq_size);
+  }
+  if (ring->sq_map && ring->sq_map != MAP_FAILED) {
+    munmap(ring->sq_map, ring->sq_size);
+  }
+  close(ring->fd);
+  ring->fd = -1;
+}
+
+/**
+ * @brief Set a ring up
+ * @param ring The ring, its fd set to -1 if io_uring is not available
+ * @param entries The number of submissions
+ */
+static void _ring_open(NonoGramLoaderRing *ring, unsigned entries) {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof params);
+  ring->fd = syscall(__NR_io_uring_setup, entries, &params);
+  if (ring->fd < 0) {
+    ring->fd = -1;
+    return;
+  }
+  if (!_ring_supports(ring->fd)) {
+    _ring_close(ring);
+    return;
+  }
+  ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_size =
+    params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single && ring->cq_size > ring->sq_size) {
+    ring->sq_size = ring->cq_size;
+  }
+  ring->sq_map = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, ring->fd, IORING_OFF_SQ_RING);
+  ring->cq_map = single
+    ? ring->sq_map
+    : mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+           ring->fd, IORING_OFF_CQ_RING);
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED, ring->fd, IORING_OFF_SQES);
+  if (ring->sq_map == MAP_FAILED || ring->cq_map == MAP_FAILED
+      || ring->sqes == MAP_FAILED) {
+    _ring_close(ring);
+    return;
+  }
+  char *sq = ring->sq_map;
+  char *cq = ring->cq_map;
+  ring->sq_head = (unsigned *) (sq + params.sq_off.head);
+  ring->sq_tail = (unsigned *) (sq + params.sq_off.tail);
+  ring->sq_mask = *(unsigned *) (sq + params.sq_off.ring_mask);
+  ring->sq_array = (unsigned *) (sq + params.sq_off.array);
+  ring->cq_head = (unsigned *) (cq + params.cq_off.head);
+  ring->cq_tail = (unsigned *) (cq + params.cq_off.tail);
+  ring->cq_mask = *(unsigned *) (cq + params.cq_off.ring_mask);
+  ring->cqes = cq + params.cq_off.cqes;
+}
+
+/**
+ * @brief Queue an operation in the submission ring
+ * @param ring The ring
+ * @param opcode The operation
+ * @param fd The file, or AT_FDCWD to open
+ * @param address The buffer, or the name of the file to open
+ * @param length The size of the buffer, or the mode of the file to open
+ * @param offset The offset in the file
+ * @param flags The flags of the file to open
+ * @param slot The slot of the operation
+ */
+static void _ring_queue(
+  NonoGramLoaderRing *ring,
+  int opcode,
+  int fd,
+  const void *address,
+  unsigned length,
+  uint64_t offset,
+  unsigned flags,
+  long slot
+) {
+  // The loader is the only writer of the tail
+  unsigned tail = *ring->sq_tail;
+  unsigned index = tail & ring->sq_mask;
+  struct io_uring_sqe *sqe = (struct io_uring_sqe *) ring->sqes + index;
+  memset(sqe, 0, sizeof *sqe);
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->addr = (uintptr_t) address;
+  sqe->len = length;
+  sqe->off = offset;
+  sqe->open_flags = flags;
+  sqe->user_data = slot;
+  ring->sq_array[index] = index;
+  atomic_store_explicit(
+    (_Atomic unsigned *) ring->sq_tail, tail + 1, memory_order_release);
+  ring->queued++;
+}
+
+/**
+ * @brief Queue the next operation of a slot
+ * @param loader The loader
+ * @param job The files
+ * @param slot The index of the slot
+ */
+static void _ring_next(
+  NonoGramLoader *loader,
+  NonoGramLoaderJob *job,
+  long slot
+) {
+  NonoGramLoaderSlot *file = &loader->slots[slot];
+  NonoGramLoaderRing *ring = &loader->ring;
+  if (file->stage == LOADER_OPEN) {
+    int flags = job->contents
+      ? O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC
+      : O_RDONLY | O_CLOEXEC;
+    _ring_queue(ring, IORING_OP_OPENAT, AT_FDCWD,
+                job->filenames[file->index], 0644, 0, flags, slot);
+  } else if (file->stage == LOADER_TRANSFER && job->contents) {
+    _ring_queue(ring, IORING_OP_WRITE, file->fd,
+                job->contents[file->index] + file->length,
+                job->lengths[file->index] - file->length, file->length, 0,
+                slot);
+  } else if (file->stage == LOADER_TRANSFER) {
+    _ring_queue(ring, IORING_OP_READ, file->fd, file->buffer + file->length,
+                file->capacity - file->length, file->length, 0, slot);
+  } else {
+    _ring_queue(ring, IORING_OP_CLOSE, file->fd, NULL, 0, 0, 0, slot);
+  }
+}
+
+/**
+ * @brief Handle the completion of an operation
+ * @param loader The loader
+ * @param job The files
+ * @param slot The index of the slot
+ * @param result The result of the operation
+ * @return true if the file is done
+ */
+static bool _ring_complete(
+  NonoGramLoader *loader,
+  NonoGramLoaderJob *job,
+  long slot,
+  int result
+) {
+  NonoGramLoaderSlot *file = &loader->slots[slot];
+  if (file->stage == LOADER_OPEN) {
+    if (result < 0) {
+      file->failed = true;
+      return true;
+    }
+    file->fd = result;
+    file->stage = job->contents && !job->lengths[file->index]
+      ? LOADER_CLOSE
+      : LOADER_TRANSFER;
+  } else if (file->stage == LOADER_TRANSFER) {
+    if (result < 0 || (job->contents && !result)) {
+      file->failed = true;
+      file->stage = LOADER_CLOSE;
+    } else if (job->contents) {
+      file->length += result;
+      if (file->length == job->lengths[file->index]) {
+        file->stage = LOADER_CLOSE;
+      }
+    } else {
+      file->length += result;
+      // A short read of a regular file reaches its end
+      if (file->length < file->capacity) {
+        file->stage = LOADER_CLOSE;
+      } else {
+        char *buffer = realloc(file->buffer, file->capacity * 2 + 1);
+        if (buffer) {
+          file->buffer = buffer;
+          file->capacity *= 2;
+        } else {
+          file->failed = true;
+          file->stage = LOADER_CLOSE;
+        }
+      }
+    }
+  } else {
+    return true;
+  }
+  _ring_next(loader, job, slot);
+  return false;
+}
+
+/**
+ * @brief Tear a ring down after a failure and release the files in flight
+ * @param loader The loader, without io_uring afterwards
+ */
+static void _ring_abort(NonoGramLoader *loader) {
+  NonoGramLoaderRing *ring = &loader->ring;
+  // A close still in the submission ring has not reached the kernel
+  unsigned head = atomic_load_explicit(
+    (_Atomic unsigned *) ring->sq_head, memory_order_acquire);
+  for (; head != *ring->sq_tail; head++) {
+    struct io_uring_sqe *sqe = (struct io_uring_sqe *) ring->sqes
+      + ring->sq_array[head & ring->sq_mask];
+    if (sqe->opcode == IORING_OP_CLOSE) {
+      close(sqe->fd);
+    }
+  }
+  // Closing the ring cancels the operations in flight
+  _ring_close(ring);
+  for (int slot = 0; slot < loader->depth; slot++) {
+    NonoGramLoaderSlot *file = &loader->slots[slot];
+    if (file->index >= 0) {
+      if (file->stage == LOADER_TRANSFER && file->fd >= 0) {
+        close(file->fd);
+      }
+      free(file->buffer);
+      file->buffer = NULL;
+      file->index = -1;
+    }
+  }
+}
+
+#endif
+
+/**
+ * @brief Create a new loader
+ * @param depth The number of files being read or written at once
+ * @param async Whether io_uring is used when the kernel has it
+ * @return A new loader, or NULL if memory allocation fails
+ */
+NonoGramLoader *nonogram_loader_create(int depth, bool async) {
+  NonoGramLoader *loader = calloc(1, sizeof(NonoGramLoader));
+  if (!loader) {
+    return NULL;
+  }
+  loader->depth = depth > 0 ? depth : 1;
+  loader->slots = calloc(loader->depth, sizeof(NonoGramLoaderSlot));
+  if (!loader->slots) {
+    free(loader);
+    return NULL;
+  }
+  loader->ring.fd = -1;
+#ifdef LOADER_URING
+  if (async) {
+    _ring_open(&loader->ring, loader->depth);
+  }
+#else
+  (void) async;
+#endif
+  return loader;
+}
+
+/**
+ * @brief Destroy a loader
+ * @param loader The loader
+ */
+void nonogram_loader_destroy(NonoGramLoader *loader) {
+#ifdef LOADER_URING
+  if (loader->ring.fd >= 0) {
+    _ring_close(&loader->ring);
+  }
+#endif
+  free(loader->slots);
+  free(loader);
+}
+
+/**
+ * @brief Check whether a loader uses io_uring
+ * @param loader The loader
+ * @return true if the files go through io_uring
+ */
+bool nonogram_loader_is_async(NonoGramLoader *loader) {
+  return loader->ring.fd >= 0;
+}
+
+/**
+ * @brief Hand a file over once it is done
+ * @param job The files
+ * @param file The slot of the file, freed
+ * @param done The number of files done, updated
+ * @return false if the callback stopped reading
+ */
+static bool _finish(
+  NonoGramLoaderJob *job,
+  NonoGramLoaderSlot *file,
+  long *done
+) {
+  long index = file->index;
+  file->index = -1;
+  *done += !file->failed;
+  if (job->contents) {
+    return true;
+  }
+  if (file->failed) {
+    free(file->buffer);
+    file->buffer = NULL;
+    return job->callback(index, NULL, 0, job->data);
+  }
+  file->buffer[file->length] = '\0';
+  char *buffer = file->buffer;
+  file->buffer = NULL;
+  return job->callback(index, buffer, file->length, job->data);
+}
+
+/**
+ * @brief Start a file in a slot
+ * @param job The files
+ * @param file The slot
+ * @param index The index of the file
+ * @return false if memory allocation fails
+ */
+static bool _start(
+  NonoGramLoaderJob *job,
+  NonoGramLoaderSlot *file,
+  long index
+) {
+  file->index = index;
+  file->stage = LOADER_OPEN;
+  file->fd = -1;
+  file->length = 0;
+  file->failed = false;
+  file->capacity = LOADER_BUFFER;
+  file->buffer = NULL;
+  if (!job->contents) {
+    file->buffer = malloc(file->capacity + 1);
+    return file->buffer != NULL;
+  }
+  return true;
+}
+
+#ifdef LOADER_URING
+
+/**
+ * @brief Run a job with io_uring
+ * @param loader The loader
+ * @param job The files
+ * @return The number of files done, or -1 on error
+ */
+static long _run_ring(NonoGramLoader *loader, NonoGramLoaderJob *job) {
+  NonoGramLoaderRing *ring = &loader->ring;
+  long next = 0;
+  long done = 0;
+  int active = 0;
+  bool stopped = false;
+  bool failed = false;
+  for (int slot = 0; slot < loader->depth; slot++) {
+    loader->slots[slot].index = -1;
+  }
+  for (;;) {
+    for (int slot = 0; slot < loader->depth && !stopped && !failed
+                       && next < job->count; slot++) {
+      if (loader->slots[slot].index < 0) {
+        failed = !_start(job, &loader->slots[slot], next++);
+        if (!failed) {
+          _ring_next(loader, job, slot);
+          active++;
+        }
+      }
+    }
+    if (!active) {
+      break;
+    }
+    // Submit the queued operations and wait for a completion
+    int entered;
+    do {
+      entered = syscall(__NR_io_uring_enter, ring->fd, ring->queued, 1,
+                        IORING_ENTER_GETEVENTS, NULL, 0);
+    } while (entered < 0 && errno == EINTR);
+    if (entered < 0) {
+      _ring_abort(loader);
+      return -1;
+    }
+    ring->queued -= entered;
+    unsigned head = *ring->cq_head;
+    unsigned tail = atomic_load_explicit(
+      (_Atomic unsigned *) ring->cq_tail, memory_order_acquire);
+    for (; head != tail; head++) {
+      struct io_uring_cqe *cqe =
+        (struct io_uring_cqe *) ring->cqes + (head & ring->cq_mask);
+      long slot = cqe->user_data;
+      if (!_ring_complete(loader, job, slot, cqe->res)) {
+        continue;
+      }
+      active--;
+      if (stopped) {
+        // Files in flight when the callback stopped are not handed over
+        NonoGramLoaderSlot *file = &loader->slots[slot];
+        free(file->buffer);
+        file->buffer = NULL;
+        file->index = -1;
+      } else if (!_finish(job, &loader->slots[slot], &done)) {
+        stopped = true;
+      }
+    }
+    atomic_store_explicit(
+      (_Atomic unsigned *) ring->cq_head, head, memory_order_release);
+  }
+  return failed ? -1 : done;
+}
+
+#endif
+
+/**
+ * @brief Read or write a file opened by the fallback
+ * @param job The files
+ * @param file The slot of the file, its fd open
+ * @return false if the file cannot be read or written
+ */
+static bool _transfer(NonoGramLoaderJob *job, NonoGramLoaderSlot *file) {
+  if (job->contents) {
+    const char *content = job->contents[file->index];
+    size_t length = job->lengths[file->index];
+    while (file->length < length) {
+      ssize_t count = write(file->fd, content + file->length,
+                            length - file->length);
+      if (count <= 0 && errno != EINTR) {
+        return false;
+      }
+      file->length += count > 0 ? count : 0;
+    }
+    return true;
+  }
+  struct stat status;
+  if (fstat(file->fd, &status) == 0
+      && (size_t) status.st_size >= file->capacity) {
+    char *buffer = realloc(file->buffer, status.st_size + 1);
+    if (!buffer) {
+      return false;
+    }
+    file->buffer = buffer;
+    file->capacity = status.st_size;
+  }
+  for (;;) {
+    if (file->length == file->capacity) {
+      char *buffer = realloc(file->buffer, file->capacity * 2 + 1);
+      if (!buffer) {
+        return false;
+      }
+      file->buffer = buffer;
+      file->capacity *= 2;
+    }
+    ssize_t count = pread(file->fd, file->buffer + file->length,
+                          file->capacity - file->length, file->length);
+    if (count == 0) {
+      return true;
+    }
+    if (count < 0 && errno != EINTR) {
+      return false;
+    }
+    file->length += count > 0 ? count : 0;
+  }
+}
+
+/**
+ * @brief Run a job with blocking system calls
+ * @param loader The loader
+ * @param job The files
+ * @return The number of files done, or -1 if memory allocation fails
+ */
+static long _run_sync(NonoGramLoader *loader, NonoGramLoaderJob *job) {
+  long done = 0;
+  long opened = 0;
+  long index = 0;
+  bool failed = false;
+  for (; index < job->count && !failed; index++) {
+    // Files are opened ahead so that the kernel reads them meanwhile
+    for (; opened < job->count && opened < index + loader->depth; opened++) {
+      NonoGramLoaderSlot *file = &loader->slots[opened % loader->depth];
+      if (!_start(job, file, opened)) {
+        failed = true;
+        break;
+      }
+      file->fd = job->contents
+        ? open(job->filenames[opened],
+               O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)
+        : open(job->filenames[opened], O_RDONLY | O_CLOEXEC);
+      if (file->fd >= 0 && !job->contents) {
+        posix_fadvise(file->fd, 0, 0, POSIX_FADV_WILLNEED);
+      }
+    }
+    if (failed) {
+      break;
+    }
+    NonoGramLoaderSlot *file = &loader->slots[index % loader->depth];
+    file->failed = file->fd < 0 || !_transfer(job, file);
+    if (file->fd >= 0) {
+      close(file->fd);
+    }
+    if (!_finish(job, file, &done)) {
+      index++;
+      break;
+    }
+  }
+  // Files opened ahead of a stop are released
+  for (; index < opened; index++) {
+    NonoGramLoaderSlot *file = &loader->slots[index % loader->depth];
+    if (file->fd >= 0) {
+      close(file->fd);
+    }
+    free(file->buffer);
+    file->buffer = NULL;
+  }
+  return failed ? -1 : done;
+}
+
+/**
+ * @brief Run a job
+ * @param loader The loader
+ * @param job The files
+ * @return The number of files done, or -1 on error
+ */
+static long _run(NonoGramLoader *loader, NonoGramLoaderJob *job) {
+#ifdef LOADER_URING
+  if (loader->ring.fd >= 0) {
+    return _run_ring(loader, job);
+  }
+#endif
+  return _run_sync(loader, job);
+}
+
+/**
+ * @brief Read files
+ * @param loader The loader
+ * @param filenames The names of the files
+ * @param count The number of files
+ * @param callback The callback receiving the contents
+ * @param data The data given to the callback
+ * @return The number of files read, or -1 if memory allocation fails
+ */
+long nonogram_loader_read(
+  NonoGramLoader *loader,
+  const char *const *filenames,
+  long count,
+  NonoGramLoaderCallback callback,
+  void *data
+) {
+  NonoGramLoaderJob job = {
+    .filenames = filenames,
+    .count = count,
+    .callback = callback,
+    .data = data,
+  };
+  return _run(loader, &job);
+}
+
+/**
+ * @brief Write files
+ * @param loader The loader
+ * @param filenames The names of the files, created or truncated
+ * @param contents The contents of the files
+ * @param lengths The lengths of the contents
+ * @param count The number of files
+ * @return The number of files written, or -1 if memory allocation fails
+ */
+long nonogram_loader_write(
+  NonoGramLoader *loader,
+  const char *const *filenames,
+  const char *const *contents,
+  const size_t *lengths,
+  long count
+) {
+  NonoGramLoaderJob job = {
+    .filenames = filenames,
+    .count = count,
+    .contents = contents,
+    .lengths = lengths,
+  };
+  return _run(loader, &job);
+}
@@ -0,0 +1,89 @@
+#ifndef LOADER_H_
+#define LOADER_H_
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * NonoGramLoader is a opaque structure that represents batched reads and
+ * writes of many small files, with io_uring when the kernel has it.
+ */
+typedef struct _NonoGramLoader NonoGramLoader;
+
+/**
+ * NonoGramLoaderCallback receives the content of a file.
+ * @param index The index of the file in the list given to the loader
+ * @param content The content of the file, owned by the callback, or NULL if
+ *        the file cannot be read
+ * @param length The length of the content
+ * @param data The data given to the loader
+ * @return false to stop reading
+ * @note Files are given in completion order, by the calling thread
+ */
+typedef bool (*NonoGramLoaderCallback)(
+  long index,
+  char *content,
+  size_t length,
+  void *data
+);
+
+/**
+ * @brief Create a new loader
+ * @param depth The number of files being read or written at once
+ * @param async Whether io_uring is used when the kernel has it
+ * @return A new loader, or NULL if memory allocation fails
+ * @note Without io_uring, files are opened depth files ahead and the kernel
+ *       is asked to read them ahead, then they are read one at a time
+ */
+extern NonoGramLoader *nonogram_loader_create(int depth, bool async);
+/**
+ * @brief Destroy a loader
+ * @param loader The loader
+ */
+extern void nonogram_loader_destroy(NonoGramLoader *loader);
+
+/**
+ * @brief Check whether a loader uses io_uring
+ * @param loader The loader
+ * @return true if the files go through io_uring
+ */
+extern bool nonogram_loader_is_async(NonoGramLoader *loader);
+
+/**
+ * @brief Read files
+ * @param loader The loader
+ * @param filenames The names of the files
+ * @param count The number of files
+ * @param callback The callback receiving the contents
+ * @param data The data given to the callback
+ * @return The number of files read, or -1 if memory allocation fails
+ * @note With io_uring, the opens, reads and closes of depth files are
+ *       submitted together, so that a batch costs a single system call
+ */
+extern long nonogram_loader_read(
+  NonoGramLoader *loader,
+  const char *const *filenames,
+  long count,
+  NonoGramLoaderCallback callback,
+  void *data
+);
+/**
+ * @brief Write files
+ * @param loader The loader
+ * @param filenames The names of the files, created or truncated
+ * @param contents The contents of the files
+ * @param lengths The lengths of the contents
+ * @param count The number of files
+ * @return The number of files written, or -1 if memory allocation fails
+ */
+extern long nonogram_loader_write(
+  NonoGramLoader *loader,
+  const char *const *filenames,
+  const char *const *contents,
+  const size_t *lengths,
+  long count
+);
+
+#endif  // LOADER_H_
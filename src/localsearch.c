@@ -0,0 +1,549 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+/**
+ * @file localsearch.c
+ * @brief Implementation of the stochastic local search.
+ *
+ * The state is a placement of the blocks of every row, so that row clues
+ * always hold. A move moves one block of a row so that it flips a cell of a
+ * violated column: only the costs of the columns whose cell has changed are
+ * recomputed. Moves are accepted by simulated annealing.
+ */
+#include "./localsearch.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "./nonogram.h"
+
+#include "./nonogram.inc"
+#include "./localsearch.inc"
+
+/**
+ * @brief Initial annealing temperature
+ */
+#define TEMPERATURE_START 2.0
+/**
+ * @brief Final annealing temperature
+ */
+#define TEMPERATURE_END 0.5
+/**
+ * @brief Number of moves per cell of an annealing cycle
+ */
+#define CYCLE_MOVES 500
+/**
+ * @brief Number of moves between two checks of the limits
+ */
+#define CHECK_INTERVAL 1024
+/**
+ * @brief Number of rows tried to find a move flipping a violated column
+ */
+#define FOCUS_ATTEMPTS 8
+
+/**
+ * @brief Draw a random number
+ * @param search The local search
+ * @return A random 64 bits number
+ */
+static unsigned long long _random(NonoGramLocalSearch *search) {
+  search->random ^= search->random >> 12;
+  search->random ^= search->random << 25;
+  search->random ^= search->random >> 27;
+  return search->random * 2685821657736338717ULL;
+}
+
+/**
+ * @brief Draw a random number in [0, 1)
+ * @param search The local search
+ * @return A random number in [0, 1)
+ */
+static double _uniform(NonoGramLocalSearch *search) {
+  return (_random(search) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * @brief Get the current time
+ * @return The time in seconds of a monotonic clock
+ */
+static double _now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Compute the cost of a column
+ *
+ * The cost is the sum of the differences between the blocks of the column
+ * and its clue, a missing block counting as a block of length 0.
+ *
+ * @param search The local search
+ * @param col The col index
+ * @return The cost of the column, 0 if its clue is satisfied
+ */
+static int _column_cost(NonoGramLocalSearch *search, int col) {
+  const int *clue = search->cols[col];
+  int count = search->cols_blocks[col];
+  int cost = 0;
+  int index = 0;
+  int run = 0;
+  for (int row = 0; row <= search->rows_count; row++) {
+    if (row < search->rows_count
+        && search->cells[row * search->cols_count + col]) {
+      run++;
+    } else if (run) {
+      cost += abs(run - (index < count ? clue[index] : 0));
+      index++;
+      run = 0;
+    }
+  }
+  for (; index < count; index++) {
+    cost += clue[index];
+  }
+  return cost;
+}
+
+/**
+ * @brief Update the cost of a column
+ * @param search The local search
+ * @param col The col index
+ * @param cost The new cost of the column
+ */
+static void _set_cost(NonoGramLocalSearch *search, int col, int cost) {
+  search->cost += cost - search->costs[col];
+  search->costs[col] = cost;
+  int index = search->violated_index[col];
+  if (cost && index == -1) {
+    search->violated_index[col] = search->violated_count;
+    search->violated[search->violated_count++] = col;
+  } else if (!cost && index != -1) {
+    int last = search->violated[--search->violated_count];
+    search->violated[index] = last;
+    search->violated_index[last] = index;
+    search->violated_index[col] = -1;
+  }
+}
+
+/**
+ * @brief Get the legal starts of a block
+ * @param search The local search
+ * @param row The row index
+ * @param block The block index in the row
+ * @param lowest The lowest start keeping a gap with the previous block
+ * @param highest The highest start keeping a gap with the next block
+ */
+static void _range(
+  NonoGramLocalSearch *search,
+  int row,
+  int block,
+  int *lowest,
+  int *highest
+) {
+  int first = search->offsets[row];
+  int last = search->offsets[row + 1] - 1;
+  int index = first + block;
+  *lowest = index == first
+            ? 0
+            : search->starts[index - 1] + search->blocks[index - 1] + 1;
+  *highest = index == last ? search->cols_count
+                           : search->starts[index + 1] - 1;
+  *highest -= search->blocks[index];
+}
+
+/**
+ * @brief Move a block
+ * @param search The local search
+ * @param row The row index
+ * @param block The block index in the row
+ * @param start The new start of the block
+ * @param changed The columns whose cells have changed
+ * @return The number of columns whose cells have changed
+ */
+static int _move(
+  NonoGramLocalSearch *search,
+  int row,
+  int block,
+  int start,
+  int *changed
+) {
+  int index = search->offsets[row] + block;
+  int size = search->blocks[index];
+  int previous = search->starts[index];
+  unsigned char *cells = search->cells + row * search->cols_count;
+  int count = 0;
+  int lowest = previous < start ? previous : start;
+  int highest = (previous > start ? previous : start) + size;
+  for (int col = lowest; col < highest; col++) {
+    bool before = col >= previous && col < previous + size;
+    bool after = col >= start && col < start + size;
+    if (before != after) {
+      cells[col] = after;
+      changed[count++] = col;
+    }
+  }
+  search->starts[index] = start;
+  return count;
+}
+
+/**
+ * @brief Find a move flipping a given cell
+ *
+ * A block covering the cell is moved away from it; otherwise a block next to
+ * the cell is moved over it.
+ *
+ * @param search The local search
+ * @param row The row index
+ * @param col The col index
+ * @param block The block to move
+ * @param start The new start of the block
+ * @return true if a legal move flipping the cell exists
+ */
+static bool _find_move(
+  NonoGramLocalSearch *search,
+  int row,
+  int col,
+  int *block,
+  int *start
+) {
+  int first = search->offsets[row];
+  int count = search->offsets[row + 1] - first;
+  int index = 0;
+  while (index < count
+         && search->starts[first + index] + search->blocks[first + index]
+            <= col) {
+    index++;
+  }
+  int lowest;
+  int highest;
+  if (index < count && search->starts[first + index] <= col) {
+    // The cell is covered: choose a start on either side of it
+    int size = search->blocks[first + index];
+    _range(search, row, index, &lowest, &highest);
+    int left = col - size + 1 - lowest;
+    int right = highest - col;
+    left = left > 0 ? left : 0;
+    right = right > 0 ? right : 0;
+    if (!left && !right) {
+      return false;
+    }
+    int choice = _random(search) % (left + right);
+    *block = index;
+    *start = choice < left ? lowest + choice : col + 1 + choice - left;
+    return true;
+  }
+  // The cell is empty: cover it with the block before or after it
+  int candidates[2] = {index - 1, index};
+  int tried = _random(search) % 2;
+  for (int attempt = 0; attempt < 2; attempt++) {
+    int candidate = candidates[(tried + attempt) % 2];
+    if (candidate < 0 || candidate >= count) {
+      continue;
+    }
+    int size = search->blocks[first + candidate];
+    _range(search, row, candidate, &lowest, &highest);
+    if (lowest < col - size + 1) {
+      lowest = col - size + 1;
+    }
+    if (highest > col) {
+      highest = col;
+    }
+    if (lowest <= highest) {
+      *block = candidate;
+      *start = lowest + _random(search) % (highest - lowest + 1);
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Try one move
+ * @param search The local search
+ */
+static void _step(NonoGramLocalSearch *search) {
+  int col = search->violated[_random(search) % search->violated_count];
+  int row = 0;
+  int block = 0;
+  int start = 0;
+  bool found = false;
+  for (int attempt = 0; attempt < FOCUS_ATTEMPTS && !found; attempt++) {
+    row = _random(search) % search->rows_count;
+    found = _find_move(search, row, col, &block, &start);
+  }
+  if (!found) {
+    return;
+  }
+
+  int *changed = search->changed;
+  int *costs = search->trial;
+  int previous = search->starts[search->offsets[row] + block];
+  int count = _move(search, row, block, start, changed);
+  int delta = 0;
+  for (int index = 0; index < count; index++) {
+    costs[index] = _column_cost(search, changed[index]);
+    delta += costs[index] - search->costs[changed[index]];
+  }
+  if (delta <= 0
+      || _uniform(search) < exp(-delta / search->temperature)) {
+    for (int index = 0; index < count; index++) {
+      _set_cost(search, changed[index], costs[index]);
+    }
+  } else {
+    _move(search, row, block, previous, changed);
+  }
+}
+
+/**
+ * @brief Record the current board if it is the best one
+ * @param search The local search
+ */
+static void _keep_best(NonoGramLocalSearch *search) {
+  if (search->cost < search->best_cost) {
+    search->best_cost = search->cost;
+    search->best_violations = search->violated_count;
+    memcpy(search->best, search->cells,
+           search->rows_count * search->cols_count);
+  }
+}
+
+/**
+ * @brief Place the blocks of a row at random
+ * @param search The local search
+ * @param row The row index
+ * @param gaps A workspace of at least one more int than blocks in the row
+ * @return false if the clue of the row does not fit in the row
+ */
+static bool _place_row(NonoGramLocalSearch *search, int row, int *gaps) {
+  int first = search->offsets[row];
+  int count = search->offsets[row + 1] - first;
+  int slack = search->cols_count - (count ? count - 1 : 0);
+  for (int index = 0; index < count; index++) {
+    slack -= search->blocks[first + index];
+  }
+  if (slack < 0) {
+    return false;
+  }
+  memset(gaps, 0, (count + 1) * sizeof(int));
+  for (int unit = 0; unit < slack; unit++) {
+    gaps[_random(search) % (count + 1)]++;
+  }
+  unsigned char *cells = search->cells + row * search->cols_count;
+  int position = gaps[0];
+  for (int index = 0; index < count; index++) {
+    int size = search->blocks[first + index];
+    search->starts[first + index] = position;
+    memset(cells + position, 1, size);
+    position += size + 1 + gaps[index + 1];
+  }
+  return true;
+}
+
+/**
+ * @brief Create a new local search for a nonogram hints object
+ *
+ * This function copies the row clues, places the blocks of every row at
+ * random and computes the cost of every column.
+ *
+ * @param hints The nonogram hints object
+ * @param seed The seed of the random generator
+ * @return A new local search, or NULL if memory allocation fails or if a row
+ *         clue does not fit in its row
+ */
+NonoGramLocalSearch *nonogram_local_search_create(
+  NonoGramHints *hints,
+  unsigned long seed
+) {
+  if (!hints || hints->rows_count <= 0 || hints->cols_count <= 0) {
+    return NULL;
+  }
+  NonoGramLocalSearch *search = calloc(1, sizeof(NonoGramLocalSearch));
+  if (!search) {
+    return NULL;
+  }
+  int rows_count = hints->rows_count;
+  int cols_count = hints->cols_count;
+  search->rows_count = rows_count;
+  search->cols_count = cols_count;
+  search->cols = hints->cols;
+  search->random = (seed ^ 0x9E3779B97F4A7C15ULL) | 1;
+  search->temperature = TEMPERATURE_START;
+
+  search->offsets = malloc((rows_count + 1) * sizeof(int));
+  search->cols_blocks = malloc(cols_count * sizeof(int));
+  search->cells = calloc(rows_count * cols_count, sizeof(unsigned char));
+  search->best = malloc(rows_count * cols_count * sizeof(unsigned char));
+  search->costs = calloc(cols_count, sizeof(int));
+  search->violated = malloc(cols_count * sizeof(int));
+  search->violated_index = malloc(cols_count * sizeof(int));
+  search->changed = malloc(cols_count * sizeof(int));
+  search->trial = malloc(cols_count * sizeof(int));
+  int *gaps = malloc((cols_count + 1) * sizeof(int));
+  if (!search->offsets || !search->cols_blocks || !search->cells
+      || !search->best || !search->costs || !search->violated
+      || !search->violated_index || !search->changed || !search->trial
+      || !gaps) {
+    free(gaps);
+    nonogram_local_search_destroy(search);
+    return NULL;
+  }
+
+  search->offsets[0] = 0;
+  for (int row = 0; row < rows_count; row++) {
+    int count = 0;
+    while (count < cols_count && hints->rows[row][count] > 0) {
+      count++;
+    }
+    search->offsets[row + 1] = search->offsets[row] + count;
+  }
+  for (int col = 0; col < cols_count; col++) {
+    int count = 0;
+    while (count < rows_count && hints->cols[col][count] > 0) {
+      count++;
+    }
+    search->cols_blocks[col] = count;
+    search->violated_index[col] = -1;
+  }
+  int blocks_count = search->offsets[rows_count];
+  search->blocks = malloc((blocks_count ? blocks_count : 1) * sizeof(int));
+  search->starts = malloc((blocks_count ? blocks_count : 1) * sizeof(int));
+  if (!search->blocks || !search->starts) {
+    free(gaps);
+    nonogram_local_search_destroy(search);
+    return NULL;
+  }
+  for (int row = 0; row < rows_count; row++) {
+    int first = search->offsets[row];
+    memcpy(search->blocks + first, hints->rows[row],
+           (search->offsets[row + 1] - first) * sizeof(int));
+    if (!_place_row(search, row, gaps)) {
+      free(gaps);
+      nonogram_local_search_destroy(search);
+      return NULL;
+    }
+  }
+  free(gaps);
+
+  for (int col = 0; col < cols_count; col++) {
+    _set_cost(search, col, _column_cost(search, col));
+  }
+  search->best_cost = LONG_MAX;
+  _keep_best(search);
+  return search;
+}
+
+/**
+ * @brief Destroy a local search
+ * @param search The local search
+ */
+void nonogram_local_search_destroy(NonoGramLocalSearch *search) {
+  free(search->blocks);
+  free(search->offsets);
+  free(search->starts);
+  free(search->cols_blocks);
+  free(search->cells);
+  free(search->best);
+  free(search->costs);
+  free(search->violated);
+  free(search->violated_index);
+  free(search->changed);
+  free(search->trial);
+  free(search);
+}
+
+/**
+ * @brief Run a local search
+ *
+ * The temperature decreases geometrically along annealing cycles of
+ * CYCLE_MOVES moves per cell, then rises again; the limits and the best
+ * board are checked every CHECK_INTERVAL moves. Both count the moves since
+ * the creation of the search, so that a search run in several calls
+ * anneals as in a single one.
+ *
+ * @param search The local search
+ * @param seconds The time limit in seconds, 0 for none
+ * @param moves The maximal number of moves, 0 for none
+ * @return true if a board satisfying every clue has been found
+ */
+bool nonogram_local_search_run(
+  NonoGramLocalSearch *search,
+  double seconds,
+  long moves
+) {
+  assert(seconds > 0 || moves > 0);
+  double start = _now();
+  long last = moves > 0 ? search->moves + moves : LONG_MAX;
+  long cycle = (long) CYCLE_MOVES * search->rows_count * search->cols_count;
+  while (search->cost > 0 && search->moves < last) {
+    if (search->moves % CHECK_INTERVAL == 0) {
+      _keep_best(search);
+      if (seconds > 0 && _now() - start >= seconds) {
+        break;
+      }
+      if (search->cancel
+          && atomic_load_explicit(search->cancel, memory_order_relaxed)) {
+        break;
+      }
+      double progress = (double) (search->moves % cycle) / cycle;
+      search->temperature = TEMPERATURE_START
+        * pow(TEMPERATURE_END / TEMPERATURE_START, progress);
+    }
+    _step(search);
+    search->moves++;
+  }
+  _keep_best(search);
+  return search->best_cost == 0;
+}
+
+/**
+ * @brief Set the cancellation flag of a local search
+ * @param search The local search
+ * @param cancel The flag, NULL for none
+ */
+void nonogram_local_search_set_cancel(
+  NonoGramLocalSearch *search,
+  atomic_bool *cancel
+) {
+  search->cancel = cancel;
+}
+
+/**
+ * @brief Get the number of columns violated by the best board
+ * @param search The local search
+ * @return The number of columns whose clue is not satisfied
+ */
+int nonogram_local_search_get_violations(NonoGramLocalSearch *search) {
+  return search->best_violations;
+}
+
+/**
+ * @brief Get a cell of the best board
+ * @param search The local search
+ * @param row The row index
+ * @param col The col index
+ * @return 1 if the cell is filled, 0 otherwise
+ */
+int nonogram_local_search_get_cell(
+  NonoGramLocalSearch *search,
+  int row,
+  int col
+) {
+  assert(row < search->rows_count);
+  assert(col < search->cols_count);
+  return search->best[row * search->cols_count + col];
+}
+
+/**
+ * @brief Get the number of moves tried by a local search
+ * @param search The local search
+ * @return The number of moves
+ */
+long nonogram_local_search_get_moves(NonoGramLocalSearch *search) {
+  return search->moves;
+}
@@ -0,0 +1,86 @@
+#ifndef LOCALSEARCH_H_
+#define LOCALSEARCH_H_
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "./nonogram.h"
+
+/**
+ * NonoGramLocalSearch is a opaque structure that represents a stochastic
+ * local search over the row placements of a nonogram.
+ */
+typedef struct _NonoGramLocalSearch NonoGramLocalSearch;
+
+/**
+ * @brief Create a new local search for a nonogram hints object
+ * @param hints The nonogram hints object
+ * @param seed The seed of the random generator
+ * @return A new local search, or NULL if memory allocation fails or if a row
+ *         clue does not fit in its row
+ * @note Every row starts from a random placement of its blocks
+ */
+extern NonoGramLocalSearch *nonogram_local_search_create(
+  NonoGramHints *hints,
+  unsigned long seed
+);
+/**
+ * @brief Destroy a local search
+ * @param search The local search
+ */
+extern void nonogram_local_search_destroy(NonoGramLocalSearch *search);
+
+/**
+ * @brief Run a local search
+ * @param search The local search
+ * @param seconds The time limit in seconds, 0 for none
+ * @param moves The maximal number of moves, 0 for none
+ * @return true if a board satisfying every clue has been found
+ * @note At least one of the limits must be set
+ * @note The search can be run again, it continues from its current state
+ */
+extern bool nonogram_local_search_run(
+  NonoGramLocalSearch *search,
+  double seconds,
+  long moves
+);
+
+/**
+ * @brief Set the cancellation flag of a local search
+ * @param search The local search
+ * @param cancel The flag, NULL for none
+ * @note A run stops within a bounded number of moves once the flag is raised
+ */
+extern void nonogram_local_search_set_cancel(
+  NonoGramLocalSearch *search,
+  atomic_bool *cancel
+);
+
+/**
+ * @brief Get the number of columns violated by the best board
+ * @param search The local search
+ * @return The number of columns whose clue is not satisfied
+ */
+extern int nonogram_local_search_get_violations(NonoGramLocalSearch *search);
+/**
+ * @brief Get a cell of the best board
+ * @param search The local search
+ * @param row The row index
+ * @param col The col index
+ * @return 1 if the cell is filled, 0 otherwise
+ */
+extern int nonogram_local_search_get_cell(
+  NonoGramLocalSearch *search,
+  int row,
+  int col
+);
+/**
+ * @brief Get the number of moves tried by a local search
+ * @param search The local search
+ * @return The number of moves
+ */
+extern long nonogram_local_search_get_moves(NonoGramLocalSearch *search);
+
+#endif  // LOCALSEARCH_H_
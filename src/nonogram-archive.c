@@ -0,0 +1,253 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+/**
+ * @file nonogram-archive.c
+ * @brief Pack, append, unpack and list puzzle archives.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "./archive.h"
+#include "./nonogram.h"
+#include "./pnmio.h"
+#include "./solver.h"
+
+/**
+ * @brief Read a whole file
+ * @param filename The name of the file
+ * @param plength A pointer to the length of the content
+ * @return The content of the file, or NULL if it cannot be read
+ */
+static char *_read_file(const char *filename, size_t *plength) {
+  FILE *file = fopen(filename, "rb");
+  if (!file) {
+    return NULL;
+  }
+  char *content = NULL;
+  if (fseek(file, 0, SEEK_END) == 0) {
+    long length = ftell(file);
+    content = length >= 0 ? malloc(length + 1) : NULL;
+    if (content) {
+      rewind(file);
+      *plength = fread(content, 1, length, file);
+      content[*plength] = '\0';
+    }
+  }
+  fclose(file);
+  return content;
+}
+
+/**
+ * @brief Solve a puzzle
+ * @param hints The hints of the puzzle
+ * @return A new board, or NULL if the puzzle has not been solved
+ */
+static int **_solve(NonoGramHints *hints) {
+  int rows_count = nonogram_hints_get_rows_count(hints);
+  int cols_count = nonogram_hints_get_cols_count(hints);
+  NonoGramSolver *solver = nonogram_solver_create(hints);
+  if (!solver) {
+    return NULL;
+  }
+  int **board = NULL;
+  if (nonogram_solver_solve(solver, NONOGRAM_ENGINE_AUTO)
+      == NONOGRAM_SOLVER_SOLVED) {
+    board = malloc(rows_count * sizeof(int *));
+    for (int row = 0; board && row < rows_count; row++) {
+      board[row] = malloc(cols_count * sizeof(int));
+      if (!board[row]) {
+        while (row--) {
+          free(board[row]);
+        }
+        free(board);
+        board = NULL;
+        break;
+      }
+      for (int col = 0; col < cols_count; col++) {
+        board[row][col] = nonogram_solver_get_cell(solver, row, col);
+      }
+    }
+  }
+  nonogram_solver_destroy(solver);
+  return board;
+}
+
+/**
+ * @brief Add puzzle files to an archive
+ * @param filename The name of the archive
+ * @param files The JSON hints files
+ * @param count The number of files
+ * @param append Whether to keep the puzzles of the archive
+ * @param solve Whether to store the solutions of the puzzles
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+static int _pack(
+  const char *filename,
+  char **files,
+  int count,
+  bool append,
+  bool solve
+) {
+  NonoGramArchiveWriter *writer =
+    nonogram_archive_writer_open(filename, append);
+  if (!writer) {
+    fprintf(stderr, "Error: Unable to open archive %s\n", filename);
+    return EXIT_FAILURE;
+  }
+  int status = EXIT_SUCCESS;
+  for (int index = 0; index < count; index++) {
+    size_t length;
+    char *content = _read_file(files[index], &length);
+    NonoGramHints *hints =
+      content ? nonogram_hints_parse(content, length) : NULL;
+    free(content);
+    if (!hints) {
+      fprintf(stderr, "Error: Invalid hints file %s\n", files[index]);
+      status = EXIT_FAILURE;
+      continue;
+    }
+    int **board = solve ? _solve(hints) : NULL;
+    if (nonogram_archive_writer_add(writer, hints, board, files[index]) < 0) {
+      fprintf(stderr, "Error: Unable to add %s\n", files[index]);
+      status = EXIT_FAILURE;
+    }
+    for (int row = 0; board && row < nonogram_hints_get_rows_count(hints);
+         row++) {
+      free(board[row]);
+    }
+    free(board);
+    nonogram_hints_destroy(hints);
+  }
+  if (!nonogram_archive_writer_close(writer)) {
+    fprintf(stderr, "Error: Unable to write archive %s\n", filename);
+    status = EXIT_FAILURE;
+  }
+  return status;
+}
+
+/**
+ * @brief Write the puzzles of an archive as files
+ * @param archive The archive
+ * @param directory The directory of the files
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ * @note Puzzle id is written to id.json, and to id.pbm if it has a solution
+ */
+static int _unpack(NonoGramArchive *archive, const char *directory) {
+  char filename[4096];
+  int status = EXIT_SUCCESS;
+  long count = nonogram_archive_get_count(archive);
+  for (long id = 0; id < count; id++) {
+    NonoGramHints *hints = nonogram_archive_get_hints(archive, id);
+    if (!hints) {
+      fprintf(stderr, "Error: Corrupt puzzle %ld\n", id);
+      status = EXIT_FAILURE;
+      break;
+    }
+    int rows_count = nonogram_hints_get_rows_count(hints);
+    int cols_count = nonogram_hints_get_cols_count(hints);
+    const char *string = nonogram_hints_to_string(hints);
+    nonogram_hints_destroy(hints);
+    if (!string) {
+      fprintf(stderr, "Error: Memory allocation failed\n");
+      status = EXIT_FAILURE;
+      break;
+    }
+    snprintf(filename, sizeof filename, "%s/%ld.json", directory, id);
+    FILE *file = fopen(filename, "w");
+    if (!file) {
+      fprintf(stderr, "Error: Unable to open file %s\n", filename);
+      status = EXIT_FAILURE;
+      break;
+    }
+    fprintf(file, "%s\n", string);
+    fclose(file);
+    if (nonogram_archive_get_cell(archive, id, 0, 0) < 0) {
+      continue;
+    }
+    int *data = malloc(rows_count * cols_count * sizeof(int));
+    snprintf(filename, sizeof filename, "%s/%ld.pbm", directory, id);
+    file = data ? fopen(filename, "w") : NULL;
+    if (!file) {
+      fprintf(stderr, "Error: Unable to open file %s\n", filename);
+      free(data);
+      status = EXIT_FAILURE;
+      break;
+    }
+    for (int cell = 0; cell < rows_count * cols_count; cell++) {
+      data[cell] = nonogram_archive_get_cell(
+        archive, id, cell / cols_count, cell % cols_count);
+    }
+    write_pbm_file(file, data, cols_count, rows_count, 1, 1, cols_count, 1);
+    fclose(file);
+    free(data);
+  }
+  // Release the buffer of the strings of the hints
+  nonogram_hints_to_string(NULL);
+  return status;
+}
+
+/**
+ * @brief List the puzzles of an archive
+ * @param archive The archive
+ * @return EXIT_SUCCESS
+ */
+static int _list(NonoGramArchive *archive) {
+  long count = nonogram_archive_get_count(archive);
+  for (long id = 0; id < count; id++) {
+    NonoGramHints *hints = nonogram_archive_get_hints(archive, id);
+    const char *metadata = nonogram_archive_get_metadata(archive, id);
+    printf("%ld\t%016llx\t", id,
+           (unsigned long long) nonogram_archive_get_hash(archive, id));
+    if (hints) {
+      printf("%dx%d", nonogram_hints_get_rows_count(hints),
+             nonogram_hints_get_cols_count(hints));
+      nonogram_hints_destroy(hints);
+    } else {
+      printf("corrupt");
+    }
+    printf("\t%s\t%s\n",
+           nonogram_archive_get_cell(archive, id, 0, 0) < 0 ? "-" : "solved",
+           metadata ? metadata : "");
+  }
+  return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    fprintf(stderr,
+            "Usage: %s pack|append archive [--solve] hints.json...\n"
+            "       %s unpack archive directory\n"
+            "       %s list archive\n",
+            argv[0], argv[0], argv[0]);
+    return EXIT_FAILURE;
+  }
+  const char *command = argv[1];
+  const char *filename = argv[2];
+  if (strcmp(command, "pack") == 0 || strcmp(command, "append") == 0) {
+    bool solve = argc > 3 && strcmp(argv[3], "--solve") == 0;
+    int first = solve ? 4 : 3;
+    return _pack(filename, argv + first, argc - first,
+                 strcmp(command, "append") == 0, solve);
+  }
+  if (strcmp(command, "unpack") != 0 && strcmp(command, "list") != 0) {
+    fprintf(stderr, "Error: Unknown command %s\n", command);
+    return EXIT_FAILURE;
+  }
+  if (strcmp(command, "unpack") == 0 && argc < 4) {
+    fprintf(stderr, "Error: Missing directory\n");
+    return EXIT_FAILURE;
+  }
+  NonoGramArchive *archive = nonogram_archive_open(filename);
+  if (!archive) {
+    fprintf(stderr, "Error: Invalid archive %s\n", filename);
+    return EXIT_FAILURE;
+  }
+  int status = strcmp(command, "unpack") == 0
+    ? _unpack(archive, argv[3])
+    : _list(archive);
+  nonogram_archive_close(archive);
+  return status;
+}
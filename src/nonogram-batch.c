@@ -0,0 +1,501 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+/**
+ * @file nonogram-batch.c
+ * @brief Solve every puzzle of a corpus on several threads.
+ *
+ * The puzzles flow through a pipeline: read splits the corpus into records,
+ * parse builds the hints, presolve propagates the lines and selects the
+ * engine, solve searches, serialize formats a JSON line and write outputs
+ * it, in input order unless --unordered is given. Each stage has its own
+ * threads and a bounded input queue, so a slow stage throttles the others.
+ * Solver threads are shared by a scheduler: puzzles that presolve leaves
+ * mostly unknown are solved in parallel on several of them, deterministically
+ * with --deterministic.
+ *
+ * The corpus can also be a directory of hints objects and PBM images, one
+ * puzzle per file, loaded in memory with batched I/O; ids then follow the
+ * order of the file names.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "./corpus.h"
+#include "./nonogram.h"
+#include "./pipeline.h"
+#include "./scheduler.h"
+#include "./solver.h"
+#include "./writer.h"
+
+/**
+ * @brief Default capacity of the queue of each stage
+ */
+#define QUEUE_CAPACITY 256
+
+/**
+ * @brief Default number of results waiting for a smaller id
+ */
+#define REORDER_WINDOW 65536
+
+/**
+ * @brief Default number of cells left unknown by presolve from which a
+ *        puzzle is solved in parallel
+ */
+#define LARGE_THRESHOLD 1000
+
+/**
+ * Job is a puzzle going through the pipeline.
+ */
+typedef struct {
+  long id;                 // Index of the puzzle in the corpus
+  const char *data;        // Record of the puzzle in the corpus
+  size_t length;           // Length of the record
+  NonoGramHints *hints;    // Hints of the puzzle, NULL if invalid
+  NonoGramSolver *solver;  // Solver of the puzzle
+  NonoGramEngine engine;   // Engine of the solve
+  double cost;             // Estimated cost of the solve
+  NonoGramStatus status;   // Status of the solve
+  char *text;              // JSON line of the result
+  size_t text_length;      // Length of the JSON line
+} Job;
+
+/**
+ * Batch holds the options and the state shared by the stages.
+ */
+typedef struct {
+  NonoGramCorpus *corpus;        // Corpus being solved
+  NonoGramPipeline *pipeline;    // Stages of the batch
+  NonoGramWriter *writer;        // Output of the results
+  NonoGramScheduler *scheduler;  // Sharing of the solver threads
+  NonoGramEngine engine;         // Engine of the solver
+  unsigned long seed;            // Seed of the randomized engines
+  double time_limit;             // Time limit of the local search
+  long node_limit;               // Maximal number of decisions
+  double threshold;              // Estimated cost of a large puzzle
+  int deterministic;             // Members of a deterministic parallel solve
+  int stage;                     // Index of the read stage
+} Batch;
+
+/**
+ * Names of the statuses, indexed by NonoGramStatus.
+ */
+static const char *const _status_names[] = {
+  "solved", "failed", "stopped", "stopped"
+};
+
+/**
+ * @brief Release a job
+ * @param job The job
+ */
+static void _free_job(Job *job) {
+  if (job->solver) {
+    nonogram_solver_destroy(job->solver);
+  }
+  if (job->hints) {
+    nonogram_hints_destroy(job->hints);
+  }
+  free(job->text);
+  free(job);
+}
+
+/**
+ * @brief Give a job to the next stage
+ * @param pipeline The pipeline
+ * @param stage The index of the current stage
+ * @param job The job, released if the pipeline has been stopped
+ */
+static void _emit(NonoGramPipeline *pipeline, int stage, Job *job) {
+  if (!nonogram_pipeline_emit(pipeline, stage, job)) {
+    _free_job(job);
+  }
+}
+
+/**
+ * @brief Create a job for a record
+ * @param id The index of the puzzle in the corpus
+ * @param data The record of the puzzle
+ * @param length The length of the record
+ * @param user_data The batch
+ * @return false if the pipeline has been stopped
+ */
+static bool _schedule(
+  long id,
+  const char *data,
+  size_t length,
+  void *user_data
+) {
+  Batch *batch = user_data;
+  Job *job = nonogram_writer_reserve(batch->writer, id)
+    ? calloc(1, sizeof(Job))
+    : NULL;
+  if (!job) {
+    nonogram_pipeline_stop(batch->pipeline);
+    return false;
+  }
+  job->id = id;
+  job->data = data;
+  job->length = length;
+  if (!nonogram_pipeline_emit(batch->pipeline, batch->stage, job)) {
+    free(job);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Read stage: split the corpus into records
+ */
+static void _read(
+  NonoGramPipeline *pipeline,
+  int stage,
+  void *item,
+  void *data
+) {
+  (void) pipeline;
+  (void) item;
+  Batch *batch = data;
+  batch->stage = stage;
+  nonogram_corpus_scan(batch->corpus, _schedule, batch);
+}
+
+/**
+ * @brief Parse stage: build the hints of a record
+ */
+static void _parse(
+  NonoGramPipeline *pipeline,
+  int stage,
+  void *item,
+  void *data
+) {
+  Batch *batch = data;
+  Job *job = item;
+  job->hints =
+    nonogram_corpus_parse(batch->corpus, job->id, job->data, job->length);
+  _emit(pipeline, stage, job);
+}
+
+/**
+ * @brief Presolve stage: propagate the lines and select the engine
+ */
+static void _presolve(
+  NonoGramPipeline *pipeline,
+  int stage,
+  void *item,
+  void *data
+) {
+  Batch *batch = data;
+  Job *job = item;
+  job->engine = batch->engine;
+  if (job->hints) {
+    job->solver = nonogram_solver_create(job->hints);
+  }
+  if (job->solver) {
+    nonogram_solver_set_seed(job->solver, batch->seed);
+    nonogram_solver_set_time_limit(job->solver, batch->time_limit);
+    nonogram_solver_set_node_limit(job->solver, batch->node_limit);
+    NonoGramFeatures features;
+    if (nonogram_solver_features(job->solver, &features)) {
+      job->cost = nonogram_scheduler_estimate(&features);
+      if (job->cost >= batch->threshold) {
+        // The result must not depend on the threads granted
+        nonogram_solver_set_deterministic(job->solver, batch->deterministic);
+      }
+      if (job->engine == NONOGRAM_ENGINE_AUTO) {
+        job->engine = nonogram_solver_select_engine(&features);
+      }
+    }
+  }
+  _emit(pipeline, stage, job);
+}
+
+/**
+ * @brief Solve stage: search from the presolved state
+ */
+static void _solve(
+  NonoGramPipeline *pipeline,
+  int stage,
+  void *item,
+  void *data
+) {
+  Batch *batch = data;
+  Job *job = item;
+  if (job->solver) {
+    int threads = nonogram_scheduler_acquire(batch->scheduler, job->cost);
+    job->status =
+      nonogram_solver_solve_parallel(job->solver, job->engine, threads);
+    nonogram_scheduler_release(batch->scheduler, threads, job->cost);
+  }
+  _emit(pipeline, stage, job);
+}
+
+/**
+ * @brief Append a string to the result of a job
+ * @param job The job
+ * @param pcapacity A pointer to the size of the result buffer
+ * @param string The string
+ * @param length The length of the string
+ * @return false if memory allocation fails
+ */
+static bool _append(
+  Job *job,
+  size_t *pcapacity,
+  const char *string,
+  size_t length
+) {
+  if (job->text_length + length > *pcapacity) {
+    size_t capacity = 2 * (job->text_length + length);
+    char *text = realloc(job->text, capacity);
+    if (!text) {
+      return false;
+    }
+    job->text = text;
+    *pcapacity = capacity;
+  }
+  memcpy(job->text + job->text_length, string, length);
+  job->text_length += length;
+  return true;
+}
+
+/**
+ * @brief Format the result of a job as a JSON line
+ * @param job The job
+ * @return false if memory allocation fails
+ */
+static bool _format(Job *job) {
+  char prefix[64];
+  size_t capacity = 0;
+  int size;
+  if (!job->hints) {
+    size = snprintf(prefix, sizeof prefix,
+                    "{\"id\":%ld,\"status\":\"invalid\"}\n", job->id);
+    return _append(job, &capacity, prefix, size);
+  }
+  if (!job->solver) {
+    return false;
+  }
+  size = snprintf(prefix, sizeof prefix, "{\"id\":%ld,\"status\":\"%s\"",
+                  job->id, _status_names[job->status]);
+  bool succeeded = _append(job, &capacity, prefix, size);
+  if (job->status == NONOGRAM_SOLVER_SOLVED) {
+    int rows_count = nonogram_hints_get_rows_count(job->hints);
+    int cols_count = nonogram_hints_get_cols_count(job->hints);
+    char row_buffer[cols_count + 4];
+    succeeded = succeeded && _append(job, &capacity, ",\"board\":[", 10);
+    for (int row = 0; succeeded && row < rows_count; row++) {
+      char *cell = row_buffer;
+      if (row) {
+        *cell++ = ',';
+      }
+      *cell++ = '"';
+      for (int col = 0; col < cols_count; col++) {
+        *cell++ = '0' + nonogram_solver_get_cell(job->solver, row, col);
+      }
+      *cell++ = '"';
+      succeeded = _append(job, &capacity, row_buffer, cell - row_buffer);
+    }
+    succeeded = succeeded && _append(job, &capacity, "]", 1);
+  }
+  return succeeded && _append(job, &capacity, "}\n", 2);
+}
+
+/**
+ * @brief Serialize stage: format the result and release the puzzle
+ */
+static void _serialize(
+  NonoGramPipeline *pipeline,
+  int stage,
+  void *item,
+  void *data
+) {
+  (void) data;
+  Job *job = item;
+  if (!_format(job)) {
+    // Every id is written, so that the following ones are not held back
+    char error[64];
+    int size = snprintf(error, sizeof error,
+                        "{\"id\":%ld,\"status\":\"error\"}\n", job->id);
+    free(job->text);
+    job->text = strdup(error);
+    job->text_length = job->text ? size : 0;
+    fprintf(stderr, "Error: Memory allocation failed\n");
+  }
+  if (job->solver) {
+    nonogram_solver_destroy(job->solver);
+    job->solver = NULL;
+  }
+  if (job->hints) {
+    nonogram_hints_destroy(job->hints);
+    job->hints = NULL;
+  }
+  _emit(pipeline, stage, job);
+}
+
+/**
+ * @brief Write stage: output the result
+ */
+static void _write(
+  NonoGramPipeline *pipeline,
+  int stage,
+  void *item,
+  void *data
+) {
+  (void) pipeline;
+  (void) stage;
+  Batch *batch = data;
+  Job *job = item;
+  nonogram_writer_write(
+    batch->writer, job->id, job->text ? job->text : "", job->text_length);
+  _free_job(job);
+}
+
+/**
+ * @brief Print the metrics of the stages
+ * @param pipeline The pipeline
+ */
+static void _print_stats(
+  NonoGramPipeline *pipeline,
+  NonoGramScheduler *scheduler
+) {
+  NonoGramSchedulerStats scheduled;
+  nonogram_scheduler_get_stats(scheduler, &scheduled);
+  fprintf(stderr, "scheduler small %ld  large %ld  threads per large %.1f\n",
+          scheduled.small, scheduled.large,
+          scheduled.large ? (double) scheduled.granted / scheduled.large : 0.0);
+  int count = nonogram_pipeline_get_stages_count(pipeline);
+  for (int stage = 0; stage < count; stage++) {
+    NonoGramStageStats stats;
+    nonogram_pipeline_get_stats(pipeline, stage, &stats);
+    double available = stats.elapsed * stats.threads;
+    if (available <= 0) {
+      available = 1.0;
+    }
+    fprintf(stderr,
+            "%-9s threads %2d  items %9ld  %10.1f/s  queue %5zu/%-5zu  "
+            "busy %5.1f%%  blocked %5.1f%%\n",
+            stats.name, stats.threads, stats.processed,
+            stats.elapsed > 0 ? stats.processed / stats.elapsed : 0.0,
+            stats.depth, stats.capacity,
+            100.0 * (stats.busy - stats.blocked) / available,
+            100.0 * stats.blocked / available);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr,
+            "Usage: %s corpus.ndjson|corpus.nga|directory [--threads n] "
+            "[--parsers n] [--presolvers n] [--serializers n] [--queue n] "
+            "[--engine auto|line|dfs|probe|local] [--seed n] "
+            "[--time-limit seconds] [--node-limit n] [--window n] "
+            "[--unordered] [--stats seconds] [--budget n] "
+            "[--large cells] [--deterministic members]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  Batch batch = {
+    .engine = NONOGRAM_ENGINE_AUTO,
+    .threshold = LARGE_THRESHOLD,
+  };
+  int threads = 1;
+  int parsers = 1;
+  int presolvers = 1;
+  int serializers = 1;
+  size_t capacity = QUEUE_CAPACITY;
+  size_t window = REORDER_WINDOW;
+  bool ordered = true;
+  double interval = 0.0;
+  int budget = 0;
+  for (int i = 2; i < argc; i++) {
+    if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--parsers") == 0 && i + 1 < argc) {
+      parsers = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--presolvers") == 0 && i + 1 < argc) {
+      presolvers = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--serializers") == 0 && i + 1 < argc) {
+      serializers = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--queue") == 0 && i + 1 < argc) {
+      capacity = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+      if (!nonogram_engine_from_string(argv[++i], &batch.engine)) {
+        fprintf(stderr, "Error: Unknown engine %s\n", argv[i]);
+        return EXIT_FAILURE;
+      }
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      batch.seed = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--time-limit") == 0 && i + 1 < argc) {
+      batch.time_limit = strtod(argv[++i], NULL);
+    } else if (strcmp(argv[i], "--node-limit") == 0 && i + 1 < argc) {
+      batch.node_limit = strtol(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+      window = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--unordered") == 0) {
+      ordered = false;
+    } else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+      interval = strtod(argv[++i], NULL);
+    } else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc) {
+      budget = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--large") == 0 && i + 1 < argc) {
+      batch.threshold = strtod(argv[++i], NULL);
+    } else if (strcmp(argv[i], "--deterministic") == 0 && i + 1 < argc) {
+      batch.deterministic = atoi(argv[++i]);
+    }
+  }
+
+  batch.corpus = nonogram_corpus_open(argv[1]);
+  if (!batch.corpus) {
+    fprintf(stderr, "Error: Unable to open file %s\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+  batch.writer = nonogram_writer_create(STDOUT_FILENO, window, ordered);
+  batch.scheduler = nonogram_scheduler_create(
+    threads, budget > 0 ? budget : threads, batch.threshold);
+  batch.pipeline = nonogram_pipeline_create();
+  NonoGramPipeline *pipeline = batch.pipeline;
+  bool created = batch.writer && batch.scheduler && pipeline
+    && nonogram_pipeline_add_stage(
+         pipeline, "read", 1, 0, _read, &batch) >= 0
+    && nonogram_pipeline_add_stage(
+         pipeline, "parse", parsers, capacity, _parse, &batch) >= 0
+    && nonogram_pipeline_add_stage(
+         pipeline, "presolve", presolvers, capacity, _presolve, &batch) >= 0
+    && nonogram_pipeline_add_stage(
+         pipeline, "solve", threads, capacity, _solve, &batch) >= 0
+    && nonogram_pipeline_add_stage(
+         pipeline, "serialize", serializers, capacity, _serialize,
+         &batch) >= 0
+    && nonogram_pipeline_add_stage(
+         pipeline, "write", 1, capacity, _write, &batch) >= 0;
+  int status = EXIT_SUCCESS;
+  if (!created) {
+    fprintf(stderr, "Error: Unable to create the pipeline\n");
+    status = EXIT_FAILURE;
+  } else {
+    if (!nonogram_pipeline_start(pipeline)) {
+      fprintf(stderr, "Error: Unable to start a thread\n");
+      status = EXIT_FAILURE;
+    }
+    while (!nonogram_pipeline_wait(pipeline, interval)) {
+      _print_stats(pipeline, batch.scheduler);
+    }
+    if (interval > 0) {
+      _print_stats(pipeline, batch.scheduler);
+    }
+  }
+
+  if (pipeline) {
+    nonogram_pipeline_destroy(pipeline);
+  }
+  if (batch.scheduler) {
+    nonogram_scheduler_destroy(batch.scheduler);
+  }
+  if (batch.writer && !nonogram_writer_close(batch.writer)) {
+    fprintf(stderr, "Error: Unable to write the results\n");
+    status = EXIT_FAILURE;
+  }
+  nonogram_corpus_close(batch.corpus);
+  return status;
+}
@@ -1,11 +1,162 @@
-//
-// Created by engouan on 30/04/2024.
-//
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
 
-#include<stdio.h>
+/**
+ * @file nonogram-create.c
+ * @brief Generate puzzles having a unique solution.
+ *
+ * Each puzzle is output as a hints object on its own line, the format read
+ * by nonogram-batch. Ambiguous random boards are mutated until their puzzle
+ * is unique; --mutations 0 draws random boards until one is unique
+ * instead. --min-rating and --max-rating restrict the solver-based rating
+ * of the puzzles: 1 for propagation alone, 2 for probing, 3 and more for
+ * searches doubling in size. --candidates bounds the random boards drawn
+ * for each puzzle, so that a range no board reaches fails instead of
+ * running forever. The counters of the generator and, for each rating,
+ * the puzzles generated per CPU-second are printed to stderr.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
-int main(){
+#include "./generator.h"
+#include "./nonogram.h"
 
-    printf("Hello world");
-    return 0;
-}
\ No newline at end of file
+/**
+ * @brief Number of ratings reported separately, higher ones are merged
+ */
+#define RATINGS 16
+
+/**
+ * @brief Default number of random boards drawn for a puzzle
+ */
+#define CANDIDATES 1000
+
+/**
+ * @brief Get the processor time of the process
+ * @return The time in seconds
+ */
+static double _cpu_time(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    fprintf(stderr,
+            "Usage: %s rows cols [--count n] [--density d] [--mutations n] "
+            "[--seed n] [--min-rating n] [--max-rating n] [--candidates n]\n",
+            argv[0]);
+    return EXIT_FAILURE;
+  }
+  int rows_count = atoi(argv[1]);
+  int cols_count = atoi(argv[2]);
+  long count = 1;
+  double density = -1.0;
+  long mutations = -1;
+  unsigned long seed = 0;
+  int minimum = 0;
+  int maximum = 0;
+  long candidates = CANDIDATES;
+  for (int i = 3; i < argc; i++) {
+    if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+      count = atol(argv[++i]);
+    } else if (strcmp(argv[i], "--density") == 0 && i + 1 < argc) {
+      density = strtod(argv[++i], NULL);
+    } else if (strcmp(argv[i], "--mutations") == 0 && i + 1 < argc) {
+      mutations = atol(argv[++i]);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      seed = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--min-rating") == 0 && i + 1 < argc) {
+      minimum = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--max-rating") == 0 && i + 1 < argc) {
+      maximum = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--candidates") == 0 && i + 1 < argc) {
+      candidates = atol(argv[++i]);
+    }
+  }
+  if (rows_count <= 0 || cols_count <= 0) {
+    fprintf(stderr, "Error: Invalid size %sx%s\n", argv[1], argv[2]);
+    return EXIT_FAILURE;
+  }
+  if (density > 1.0) {
+    fprintf(stderr, "Error: Invalid density %g\n", density);
+    return EXIT_FAILURE;
+  }
+  if (minimum < 0 || maximum < 0 || (maximum && maximum < minimum)) {
+    fprintf(stderr, "Error: Invalid rating range\n");
+    return EXIT_FAILURE;
+  }
+  if (candidates <= 0) {
+    fprintf(stderr, "Error: Invalid number of candidates %ld\n", candidates);
+    return EXIT_FAILURE;
+  }
+
+  NonoGramGenerator *generator =
+    nonogram_generator_create(rows_count, cols_count, seed);
+  if (!generator) {
+    fprintf(stderr, "Error: Memory allocation failed\n");
+    return EXIT_FAILURE;
+  }
+  if (density >= 0.0) {
+    nonogram_generator_set_density(generator, density);
+  }
+  if (mutations >= 0) {
+    nonogram_generator_set_mutations(generator, mutations);
+  }
+  nonogram_generator_set_rating(generator, minimum, maximum);
+  long puzzles[RATINGS] = {0};
+  double spent[RATINGS] = {0.0};
+  int status = EXIT_SUCCESS;
+  double start = _cpu_time();
+  double previous = start;
+  for (long index = 0; index < count; index++) {
+    NonoGramHints *hints = nonogram_generator_next(generator, candidates);
+    if (!hints) {
+      fprintf(stderr, "Error: No puzzle found within %ld candidates\n",
+              candidates);
+      status = EXIT_FAILURE;
+      break;
+    }
+    const char *string = nonogram_hints_to_string(hints);
+    if (!string) {
+      fprintf(stderr, "Error: Memory allocation failed\n");
+      status = EXIT_FAILURE;
+      nonogram_hints_destroy(hints);
+      break;
+    }
+    puts(string);
+    nonogram_hints_destroy(hints);
+    // The time since the previous puzzle is spent on the rating of this one
+    int rating = nonogram_generator_get_rating(generator);
+    double now = _cpu_time();
+    rating = rating < RATINGS ? rating : RATINGS - 1;
+    puzzles[rating]++;
+    spent[rating] += now - previous;
+    previous = now;
+  }
+  double seconds = _cpu_time() - start;
+  nonogram_hints_to_string(NULL);
+
+  const NonoGramGeneratorStats *stats = nonogram_generator_get_stats(generator);
+  fprintf(stderr,
+          "puzzles %ld  candidates %ld  mutations %ld  checks %ld  "
+          "easy %ld  rejected %ld  cpu %.3fs  puzzles/cpu-s %.1f\n",
+          stats->puzzles, stats->candidates, stats->mutations, stats->checks,
+          stats->easy, stats->rejected, seconds,
+          seconds > 0 ? stats->puzzles / seconds : 0.0);
+  for (int rating = 0; rating < RATINGS; rating++) {
+    if (puzzles[rating]) {
+      fprintf(stderr, "rating %2d%s  puzzles %ld  cpu %.3fs  "
+              "puzzles/cpu-s %.1f\n",
+              rating, rating == RATINGS - 1 ? "+" : " ", puzzles[rating],
+              spent[rating],
+              spent[rating] > 0 ? puzzles[rating] / spent[rating] : 0.0);
+    }
+  }
+  nonogram_generator_destroy(generator);
+  return status;
+}
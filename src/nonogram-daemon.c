@@ -0,0 +1,1186 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+/**
+ * @file nonogram-daemon.c
+ * @brief Answer solve requests on Unix or TCP sockets.
+ *
+ * Clients send a hints object per line, with an optional integer "id", an
+ * optional "priority" class, "interactive", "normal" or "bulk", and an
+ * optional "deadline" in milliseconds. They receive a JSON line per
+ * request, in completion order; requests that cannot meet their deadline
+ * are answered "rejected" without being solved. An event loop multiplexes
+ * its connections with epoll and hands the puzzles over to its own solve
+ * service; solver threads append the answers to the output of their
+ * connection and wake the loop through an eventfd. Requests for a puzzle
+ * already being solved by the loop share that solve.
+ *
+ * With --loops, several event loops run on their own threads and share
+ * nothing but the cache of solved puzzles: each one has its listeners, its
+ * solver threads and its in-flight table. On TCP, the loops listen on the
+ * same localhost port with SO_REUSEPORT and the kernel spreads the
+ * connections; on a Unix socket, the first loop listens on the given path
+ * and the others on the path followed by a dot and their index.
+ *
+ * With --capture, every request line is also written to a file after the
+ * time at which it has been read and a tab, for nonogram-replay.
+ *
+ * With --table, tiny puzzles are answered from a table file written by
+ * nonogram-table, mapped by the first request and shared by the loops.
+ */
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "./cJSON.h"
+#include "./cache.h"
+#include "./histogram.h"
+#include "./nonogram.h"
+#include "./service.h"
+#include "./solver.h"
+#include "./table.h"
+
+/**
+ * @brief Default number of solves waiting for a thread
+ */
+#define QUEUE_CAPACITY 256
+
+/**
+ * @brief Default number of cells left unknown by presolve from which a
+ *        puzzle is solved in parallel
+ */
+#define LARGE_THRESHOLD 1000
+
+/**
+ * @brief Default number of solved puzzles kept by the cache
+ */
+#define CACHE_CAPACITY 65536
+
+/**
+ * @brief Size of the reads from a connection
+ */
+#define READ_SIZE 65536
+
+/**
+ * @brief Maximal number of events handled per wake-up
+ */
+#define EVENTS_COUNT 64
+
+/**
+ * Connection is a client of the daemon.
+ */
+typedef struct _Connection {
+  int fd;                        // Socket of the client
+  char *input;                   // Bytes received, not a full line yet
+  size_t input_length;           // Number of bytes received
+  size_t input_capacity;         // Size of the input buffer
+  bool eof;                      // Whether the client stopped sending
+  bool closed;                   // Whether the socket has been closed
+  bool scraper;                  // Whether the client reads the metrics
+  uint32_t events;               // Events polled for the socket
+  pthread_mutex_t lock;          // Lock of the output and of pending
+  char *output;                  // Answers not sent yet
+  size_t output_length;          // Number of bytes to send
+  size_t output_capacity;        // Size of the output buffer
+  int pending;                   // Number of requests not answered yet
+  atomic_int references;         // The daemon and the pending requests
+  struct _Connection *previous;  // Previous connection of the daemon
+  struct _Connection *next;      // Next connection of the daemon
+} Connection;
+
+/**
+ * Names of the answers, as counted by the metrics.
+ */
+static const char *const _answer_names[] = {
+  "solved", "failed", "stopped", "rejected", "invalid", "error"
+};
+
+/**
+ * @brief Number of names of answers
+ */
+#define ANSWERS_COUNT 6
+
+typedef struct _Server Server;
+
+/**
+ * Daemon holds the state of an event loop.
+ */
+typedef struct {
+  Server *server;                      // Server running the loop
+  NonoGramService *service;            // Solver threads of the loop
+  int epoll;                           // Poll of the sockets
+  int listener;                        // Unix socket, or -1
+  char *path;                          // Path of the Unix socket, or NULL
+  int tcp;                             // TCP socket, or -1
+  int metrics;                         // Metrics socket, or -1
+  int wake;                            // Eventfd written by the solvers
+  Connection *connections;             // Open connections
+  Connection *closed;                  // Connections closed by the events
+  NonoGramHistogram *latency;          // Time from request to answer
+  atomic_long answers[ANSWERS_COUNT];  // Answers by name
+  pthread_t thread;                    // Thread of the loop
+  bool started;                        // Whether the thread is running
+} Daemon;
+
+/**
+ * Server holds the event loops and what they share.
+ */
+struct _Server {
+  Daemon *loops;          // Event loops
+  int loops_count;        // Number of event loops
+  NonoGramCache *cache;   // Solved puzzles, or NULL
+  NonoGramTable *table;   // Tiny puzzles, or NULL
+  FILE *capture;          // Capture of the requests, or NULL
+  double start;           // Time at which the daemon started
+};
+
+/**
+ * Request is a solve request waiting for its answer.
+ */
+typedef struct {
+  Connection *connection;  // Client of the request
+  long id;                 // Id given by the client
+  double received;         // Time at which the request has been read
+  Daemon *daemon;          // Daemon answering the request
+} Request;
+
+/**
+ * Names of the statuses, indexed by NonoGramStatus.
+ */
+static const char *const _status_names[] = {
+  "solved", "failed", "stopped", "stopped"
+};
+
+/**
+ * @brief Whether a termination signal has been received
+ */
+static atomic_bool _terminated = false;
+
+/**
+ * @brief Get the time of the monotonic clock
+ * @return The time in seconds
+ */
+static double _now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Append bytes to a buffer
+ * @param buffer The buffer, grown as needed
+ * @param length The number of bytes in the buffer, updated
+ * @param capacity The size of the buffer, updated
+ * @param data The bytes
+ * @param size The number of bytes
+ * @return false if memory allocation fails
+ */
+static bool _append(
+  char **buffer,
+  size_t *length,
+  size_t *capacity,
+  const char *data,
+  size_t size
+) {
+  if (*length + size > *capacity) {
+    size_t new_capacity = *capacity ? *capacity : 256;
+    while (new_capacity < *length + size) {
+      new_capacity *= 2;
+    }
+    char *new_buffer = realloc(*buffer, new_capacity);
+    if (!new_buffer) {
+      return false;
+    }
+    *buffer = new_buffer;
+    *capacity = new_capacity;
+  }
+  memcpy(*buffer + *length, data, size);
+  *length += size;
+  return true;
+}
+
+/**
+ * @brief Release a reference to a connection
+ * @param connection The connection, freed with its last reference
+ */
+static void _release(Connection *connection) {
+  if (atomic_fetch_sub(&connection->references, 1) == 1) {
+    pthread_mutex_destroy(&connection->lock);
+    free(connection->input);
+    free(connection->output);
+    free(connection);
+  }
+}
+
+/**
+ * @brief Format an answer as a JSON line
+ * @param id The id of the request
+ * @param status The name of the status
+ * @param result The result of the solve, or NULL
+ * @param length The length of the line
+ * @return The line, or NULL if memory allocation fails
+ */
+static char *_format(
+  long id,
+  const char *status,
+  const NonoGramServiceResult *result,
+  size_t *length
+) {
+  char *text = NULL;
+  size_t capacity = 0;
+  *length = 0;
+  char prefix[64];
+  int size = snprintf(prefix, sizeof prefix,
+                      "{\"id\":%ld,\"status\":\"%s\"", id, status);
+  bool succeeded = _append(&text, length, &capacity, prefix, size);
+  if (result && result->status == NONOGRAM_SOLVER_SOLVED) {
+    char row_buffer[result->cols_count + 4];
+    succeeded = succeeded
+      && _append(&text, length, &capacity, ",\"board\":[", 10);
+    for (int row = 0; succeeded && row < result->rows_count; row++) {
+      char *cell = row_buffer;
+      if (row) {
+        *cell++ = ',';
+      }
+      *cell++ = '"';
+      for (int col = 0; col < result->cols_count; col++) {
+        *cell++ = '0' + result->cells[row * result->cols_count + col];
+      }
+      *cell++ = '"';
+      succeeded =
+        _append(&text, length, &capacity, row_buffer, cell - row_buffer);
+    }
+    succeeded = succeeded && _append(&text, length, &capacity, "]", 1);
+  }
+  if (!succeeded || !_append(&text, length, &capacity, "}\n", 2)) {
+    free(text);
+    return NULL;
+  }
+  return text;
+}
+
+/**
+ * @brief Queue an answer on its connection
+ * @param request The request, released
+ * @param status The name of the status
+ * @param result The result of the solve, or NULL
+ */
+static void _answer(
+  Request *request,
+  const char *status,
+  const NonoGramServiceResult *result
+) {
+  Connection *connection = request->connection;
+  Daemon *daemon = request->daemon;
+  size_t length;
+  char *text = _format(request->id, status, result, &length);
+  char error[64];
+  if (!text) {
+    status = "error";
+    length = snprintf(error, sizeof error,
+                      "{\"id\":%ld,\"status\":\"error\"}\n", request->id);
+  }
+  for (int index = 0; index < ANSWERS_COUNT; index++) {
+    if (strcmp(status, _answer_names[index]) == 0) {
+      atomic_fetch_add_explicit(
+        &daemon->answers[index], 1, memory_order_relaxed);
+    }
+  }
+  nonogram_histogram_record(daemon->latency, _now() - request->received);
+  pthread_mutex_lock(&connection->lock);
+  if (!_append(&connection->output, &connection->output_length,
+               &connection->output_capacity, text ? text : error, length)) {
+    fprintf(stderr, "Error: Memory allocation failed\n");
+  }
+  connection->pending--;
+  pthread_mutex_unlock(&connection->lock);
+  free(text);
+  uint64_t one = 1;
+  if (write(daemon->wake, &one, sizeof one) < 0) {
+    fprintf(stderr, "Error: Unable to wake the daemon\n");
+  }
+  _release(connection);
+  free(request);
+}
+
+/**
+ * @brief Receive the result of a solve
+ * @param result The result
+ * @param data The request
+ */
+static void _on_result(const NonoGramServiceResult *result, void *data) {
+  _answer(data,
+          result->rejected ? "rejected" : _status_names[result->status],
+          result);
+}
+
+/**
+ * Names of the priority classes, indexed by NonoGramPriority.
+ */
+static const char *const _priority_names[] = {
+  "interactive", "normal", "bulk"
+};
+
+/**
+ * @brief Get the options of a request line
+ * @param line The line
+ * @param length The length of the line
+ * @param request The request whose id is set, -1 if there is none
+ * @param priority The "priority" class of the object, normal by default
+ * @param deadline The "deadline" of the object in seconds, 0 for none
+ * @note The deadline of the object is given in milliseconds
+ */
+static void _parse_options(
+  const char *line,
+  size_t length,
+  Request *request,
+  NonoGramPriority *priority,
+  double *deadline
+) {
+  request->id = -1;
+  *priority = NONOGRAM_PRIORITY_NORMAL;
+  *deadline = 0.0;
+  cJSON *root = cJSON_ParseWithLength(line, length);
+  if (!root) {
+    return;
+  }
+  cJSON *item = cJSON_GetObjectItem(root, "id");
+  if (cJSON_IsNumber(item)) {
+    request->id = (long) item->valuedouble;
+  }
+  item = cJSON_GetObjectItem(root, "priority");
+  for (int index = 0; cJSON_IsString(item) && index < 3; index++) {
+    if (strcmp(item->valuestring, _priority_names[index]) == 0) {
+      *priority = index;
+    }
+  }
+  item = cJSON_GetObjectItem(root, "deadline");
+  if (cJSON_IsNumber(item) && item->valuedouble > 0) {
+    *deadline = item->valuedouble / 1000.0;
+  }
+  cJSON_Delete(root);
+}
+
+/**
+ * @brief Submit the request of a line
+ * @param daemon The daemon
+ * @param connection The connection of the line
+ * @param line The line
+ * @param length The length of the line
+ */
+static void _submit(
+  Daemon *daemon,
+  Connection *connection,
+  const char *line,
+  size_t length
+) {
+  Request *request = malloc(sizeof(Request));
+  if (!request) {
+    fprintf(stderr, "Error: Memory allocation failed\n");
+    return;
+  }
+  request->connection = connection;
+  NonoGramPriority priority;
+  double deadline;
+  _parse_options(line, length, request, &priority, &deadline);
+  request->daemon = daemon;
+  request->received = _now();
+  Server *server = daemon->server;
+  if (server->capture) {
+    // Lines of the loops are not mixed, stdio locks the stream per call
+    fprintf(server->capture, "%.6f\t%.*s\n", request->received - server->start,
+            (int) length, line);
+  }
+  atomic_fetch_add(&connection->references, 1);
+  pthread_mutex_lock(&connection->lock);
+  connection->pending++;
+  pthread_mutex_unlock(&connection->lock);
+  NonoGramHints *hints = nonogram_hints_parse(line, length);
+  if (!hints) {
+    _answer(request, "invalid", NULL);
+  } else if (!nonogram_service_submit(
+               daemon->service, hints, priority, deadline, _on_result,
+               request)) {
+    _answer(request, "stopped", NULL);
+  }
+}
+
+/**
+ * @brief Update the events polled for a connection
+ * @param daemon The daemon
+ * @param connection The connection
+ * @param output Whether answers wait to be sent
+ */
+static void _poll(Daemon *daemon, Connection *connection, bool output) {
+  uint32_t events = (connection->eof ? 0 : EPOLLIN) | (output ? EPOLLOUT : 0);
+  if (events != connection->events) {
+    struct epoll_event event = {.events = events, .data.ptr = connection};
+    epoll_ctl(daemon->epoll, EPOLL_CTL_MOD, connection->fd, &event);
+    connection->events = events;
+  }
+}
+
+/**
+ * @brief Close a connection
+ * @param daemon The daemon
+ * @param connection The connection, released by the daemon once the current
+ *        events have been handled
+ */
+static void _close(Daemon *daemon, Connection *connection) {
+  epoll_ctl(daemon->epoll, EPOLL_CTL_DEL, connection->fd, NULL);
+  close(connection->fd);
+  connection->closed = true;
+  if (connection->previous) {
+    connection->previous->next = connection->next;
+  } else {
+    daemon->connections = connection->next;
+  }
+  if (connection->next) {
+    connection->next->previous = connection->previous;
+  }
+  connection->next = daemon->closed;
+  daemon->closed = connection;
+}
+
+/**
+ * @brief Release the connections closed by the current events
+ * @param daemon The daemon
+ */
+static void _release_closed(Daemon *daemon) {
+  while (daemon->closed) {
+    Connection *connection = daemon->closed;
+    daemon->closed = connection->next;
+    _release(connection);
+  }
+}
+
+/**
+ * @brief Send the answers of a connection
+ * @param daemon The daemon
+ * @param connection The connection, closed once the client stopped sending
+ *        and every answer has been sent
+ */
+static void _flush(Daemon *daemon, Connection *connection) {
+  pthread_mutex_lock(&connection->lock);
+  bool failed = false;
+  size_t sent = 0;
+  while (sent < connection->output_length) {
+    ssize_t count = send(connection->fd, connection->output + sent,
+                         connection->output_length - sent, MSG_NOSIGNAL);
+    if (count < 0) {
+      failed = errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR;
+      break;
+    }
+    sent += count;
+  }
+  memmove(connection->output, connection->output + sent,
+          connection->output_length - sent);
+  connection->output_length -= sent;
+  bool output = connection->output_length > 0;
+  bool done = connection->eof && !output && !connection->pending;
+  pthread_mutex_unlock(&connection->lock);
+  if (connection->scraper && !output) {
+    // The socket is closed once the scraper has closed its side
+    shutdown(connection->fd, SHUT_WR);
+  }
+  if (failed || done) {
+    _close(daemon, connection);
+  } else {
+    _poll(daemon, connection, output);
+  }
+}
+
+/**
+ * @brief Read the requests of a connection
+ * @param daemon The daemon
+ * @param connection The connection
+ */
+static void _receive(Daemon *daemon, Connection *connection) {
+  char buffer[READ_SIZE];
+  ssize_t count = recv(connection->fd, buffer, sizeof buffer, 0);
+  if (count < 0) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+      connection->eof = true;
+    }
+  } else if (count == 0) {
+    connection->eof = true;
+  } else if (connection->scraper) {
+    // The request of a scraper is ignored
+  } else if (!_append(&connection->input, &connection->input_length,
+                      &connection->input_capacity, buffer, count)) {
+    fprintf(stderr, "Error: Memory allocation failed\n");
+    connection->eof = true;
+  }
+  size_t start = 0;
+  for (;;) {
+    char *newline = memchr(connection->input + start, '\n',
+                           connection->input_length - start);
+    if (!newline && connection->eof) {
+      newline = connection->input + connection->input_length;
+    }
+    if (!newline) {
+      break;
+    }
+    size_t length = newline - (connection->input + start);
+    size_t index = 0;
+    while (index < length
+           && strchr(" \t\r", connection->input[start + index])) {
+      index++;
+    }
+    if (index < length) {
+      _submit(daemon, connection, connection->input + start, length);
+    }
+    start += length + 1;
+    if (start >= connection->input_length) {
+      start = connection->input_length;
+      break;
+    }
+  }
+  memmove(connection->input, connection->input + start,
+          connection->input_length - start);
+  connection->input_length -= start;
+  _flush(daemon, connection);
+}
+
+/**
+ * @brief Accept a new client
+ * @param daemon The daemon
+ * @param listener The listening socket
+ * @return The connection of the client, or NULL on error
+ */
+static Connection *_accept(Daemon *daemon, int listener) {
+  int fd = accept(listener, NULL, NULL);
+  if (fd < 0) {
+    return NULL;
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+  if (listener == daemon->tcp) {
+    // Answers are sent as soon as they are flushed
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+  }
+  Connection *connection = calloc(1, sizeof(Connection));
+  if (!connection) {
+    close(fd);
+    return NULL;
+  }
+  connection->fd = fd;
+  connection->events = EPOLLIN;
+  pthread_mutex_init(&connection->lock, NULL);
+  atomic_init(&connection->references, 1);
+  struct epoll_event event = {.events = EPOLLIN, .data.ptr = connection};
+  if (epoll_ctl(daemon->epoll, EPOLL_CTL_ADD, fd, &event) < 0) {
+    close(fd);
+    _release(connection);
+    return NULL;
+  }
+  connection->next = daemon->connections;
+  if (daemon->connections) {
+    daemon->connections->previous = connection;
+  }
+  daemon->connections = connection;
+  return connection;
+}
+
+/**
+ * @brief Open the listening socket
+ * @param path The path of the socket
+ * @return The socket, or -1 on error
+ */
+static int _listen(const char *path) {
+  struct sockaddr_un address = {.sun_family = AF_UNIX};
+  if (strlen(path) >= sizeof address.sun_path) {
+    return -1;
+  }
+  strcpy(address.sun_path, path);
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  unlink(path);
+  if (bind(fd, (struct sockaddr *) &address, sizeof address) < 0
+      || listen(fd, SOMAXCONN) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/**
+ * @brief Open a listening socket on a localhost TCP port
+ * @param port The port, 0 for any, set to the port of the socket
+ * @return The socket, or -1 on error
+ * @note The port can be shared by several sockets, the kernel spreads the
+ *       connections among them
+ */
+static int _listen_tcp(int *port) {
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  int one = 1;
+  struct sockaddr_in address = {
+    .sin_family = AF_INET,
+    .sin_port = htons(*port),
+    .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+  };
+  socklen_t length = sizeof address;
+  if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one) < 0
+      || setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof one) < 0
+      || bind(fd, (struct sockaddr *) &address, sizeof address) < 0
+      || listen(fd, SOMAXCONN) < 0
+      || getsockname(fd, (struct sockaddr *) &address, &length) < 0) {
+    close(fd);
+    return -1;
+  }
+  *port = ntohs(address.sin_port);
+  return fd;
+}
+
+/**
+ * @brief Format a counter in the Prometheus text format
+ * @param text The text, grown as needed
+ * @param length The length of the text, updated
+ * @param capacity The size of the text, updated
+ * @param name The name of the counter
+ * @param help The description of the counter
+ * @param type The type of the metric, counter or gauge
+ * @param value The value of the counter
+ * @return false if memory allocation fails
+ */
+static bool _append_metric(
+  char **text,
+  size_t *length,
+  size_t *capacity,
+  const char *name,
+  const char *help,
+  const char *type,
+  long value
+) {
+  char line[256];
+  int size = snprintf(line, sizeof line, "# HELP %s %s\n# TYPE %s %s\n%s %ld\n",
+                      name, help, name, type, name, value);
+  return size > 0 && (size_t) size < sizeof line
+    && _append(text, length, capacity, line, size);
+}
+
+/**
+ * @brief Format the sum of histograms in the Prometheus text format
+ * @param text The text, grown as needed
+ * @param length The length of the text, updated
+ * @param capacity The size of the text, updated
+ * @param histograms The histograms, one per event loop
+ * @param count The number of histograms
+ * @param name The name of the histogram
+ * @param help The description of the histogram
+ * @return false if memory allocation fails
+ */
+static bool _append_histogram(
+  char **text,
+  size_t *length,
+  size_t *capacity,
+  NonoGramHistogram **histograms,
+  int count,
+  const char *name,
+  const char *help
+) {
+  NonoGramHistogram *total = nonogram_histogram_create();
+  if (!total) {
+    return false;
+  }
+  for (int index = 0; index < count; index++) {
+    nonogram_histogram_add(total, histograms[index]);
+  }
+  size_t size = nonogram_histogram_format(total, name, help, NULL, 0);
+  char *buffer = malloc(size + 1);
+  bool succeeded = buffer != NULL;
+  if (succeeded) {
+    size = nonogram_histogram_format(total, name, help, buffer, size + 1);
+    succeeded = _append(text, length, capacity, buffer, size);
+  }
+  free(buffer);
+  nonogram_histogram_destroy(total);
+  return succeeded;
+}
+
+/**
+ * @brief Answer a metrics client
+ * @param daemon The event loop of the metrics socket
+ * @note The metrics are sent in the Prometheus text format, behind an HTTP
+ *       header so that the socket can be forwarded to a scraper, whatever
+ *       the client sends
+ * @note The metrics of the event loops are summed
+ */
+static void _serve_metrics(Daemon *daemon) {
+  Connection *connection = _accept(daemon, daemon->metrics);
+  if (!connection) {
+    return;
+  }
+  connection->scraper = true;
+  Server *server = daemon->server;
+  int count = server->loops_count;
+  NonoGramServiceStats stats = {0};
+  long answered[ANSWERS_COUNT] = {0};
+  NonoGramHistogram *waits[count];
+  NonoGramHistogram *solves[count];
+  NonoGramHistogram *latencies[count];
+  for (int loop = 0; loop < count; loop++) {
+    Daemon *other = &server->loops[loop];
+    NonoGramServiceStats loop_stats;
+    nonogram_service_get_stats(other->service, &loop_stats);
+    stats.requests += loop_stats.requests;
+    stats.solves += loop_stats.solves;
+    stats.coalesced += loop_stats.coalesced;
+    stats.cached += loop_stats.cached;
+    stats.tabled += loop_stats.tabled;
+    stats.rejected += loop_stats.rejected;
+    stats.expired += loop_stats.expired;
+    stats.queued += loop_stats.queued;
+    stats.running += loop_stats.running;
+    for (int index = 0; index < ANSWERS_COUNT; index++) {
+      answered[index] += atomic_load_explicit(
+        &other->answers[index], memory_order_relaxed);
+    }
+    waits[loop] = nonogram_service_get_wait_histogram(other->service);
+    solves[loop] = nonogram_service_get_solve_histogram(other->service);
+    latencies[loop] = other->latency;
+  }
+  char *text = NULL;
+  size_t length = 0;
+  size_t capacity = 0;
+  bool succeeded =
+    _append_metric(&text, &length, &capacity, "nonogram_requests_total",
+                   "Requests accepted by the solve service", "counter",
+                   stats.requests)
+    && _append_metric(&text, &length, &capacity, "nonogram_solves_total",
+                      "Solves run", "counter", stats.solves)
+    && _append_metric(&text, &length, &capacity, "nonogram_coalesced_total",
+                      "Requests answered by a solve already in flight",
+                      "counter", stats.coalesced)
+    && _append_metric(&text, &length, &capacity, "nonogram_cached_total",
+                      "Requests answered by the cache of solved puzzles",
+                      "counter", stats.cached)
+    && _append_metric(&text, &length, &capacity, "nonogram_tabled_total",
+                      "Requests answered by the table of tiny puzzles",
+                      "counter", stats.tabled)
+    && _append_metric(&text, &length, &capacity, "nonogram_rejected_total",
+                      "Requests rejected for their deadline or a full queue",
+                      "counter", stats.rejected)
+    && _append_metric(&text, &length, &capacity, "nonogram_timeouts_total",
+                      "Solves stopped by their deadline", "counter",
+                      stats.expired)
+    && _append_metric(&text, &length, &capacity, "nonogram_queued",
+                      "Solves waiting for a thread", "gauge", stats.queued)
+    && _append_metric(&text, &length, &capacity, "nonogram_running",
+                      "Solves running", "gauge", stats.running)
+    && _append_metric(&text, &length, &capacity, "nonogram_cache_entries",
+                      "Solved puzzles kept by the cache", "gauge",
+                      server->cache
+                        ? (long) nonogram_cache_get_count(server->cache)
+                        : 0);
+  const char *answers =
+    "# HELP nonogram_answers_total Answers sent by status\n"
+    "# TYPE nonogram_answers_total counter\n";
+  succeeded = succeeded
+    && _append(&text, &length, &capacity, answers, strlen(answers));
+  for (int index = 0; succeeded && index < ANSWERS_COUNT; index++) {
+    char line[128];
+    int size = snprintf(line, sizeof line,
+                        "nonogram_answers_total{status=\"%s\"} %ld\n",
+                        _answer_names[index], answered[index]);
+    succeeded = _append(&text, &length, &capacity, line, size);
+  }
+  succeeded = succeeded
+    && _append_histogram(
+         &text, &length, &capacity, waits, count,
+         "nonogram_queue_wait_seconds", "Time spent by solves in the queue")
+    && _append_histogram(
+         &text, &length, &capacity, solves, count,
+         "nonogram_solve_seconds", "Time spent by solves on a thread")
+    && _append_histogram(
+         &text, &length, &capacity, latencies, count,
+         "nonogram_request_latency_seconds",
+         "Time from the reading of a request to its answer");
+  char header[128];
+  int size = snprintf(header, sizeof header,
+                      "HTTP/1.0 200 OK\r\n"
+                      "Content-Type: text/plain; version=0.0.4\r\n"
+                      "Content-Length: %zu\r\n\r\n", length);
+  if (!succeeded
+      || !_append(&connection->output, &connection->output_length,
+                  &connection->output_capacity, header, size)
+      || !_append(&connection->output, &connection->output_length,
+                  &connection->output_capacity, text, length)) {
+    fprintf(stderr, "Error: Memory allocation failed\n");
+    connection->output_length = 0;
+  }
+  free(text);
+  _flush(daemon, connection);
+}
+
+/**
+ * @brief Run an event loop until a termination signal
+ * @param data The event loop
+ * @return NULL
+ */
+static void *_loop(void *data) {
+  Daemon *daemon = data;
+  struct epoll_event events[EVENTS_COUNT];
+  while (!atomic_load(&_terminated)) {
+    int count = epoll_wait(daemon->epoll, events, EVENTS_COUNT, -1);
+    for (int index = 0; index < count; index++) {
+      void *source = events[index].data.ptr;
+      if (source == &daemon->listener) {
+        _accept(daemon, daemon->listener);
+      } else if (source == &daemon->tcp) {
+        _accept(daemon, daemon->tcp);
+      } else if (source == &daemon->metrics) {
+        _serve_metrics(daemon);
+      } else if (source == &daemon->wake) {
+        uint64_t value;
+        if (read(daemon->wake, &value, sizeof value) < 0) {
+          continue;
+        }
+        // Answers may be waiting on any connection
+        Connection *connection = daemon->connections;
+        while (connection) {
+          Connection *next = connection->next;
+          _flush(daemon, connection);
+          connection = next;
+        }
+      } else {
+        Connection *connection = source;
+        if (connection->closed) {
+          continue;
+        }
+        if (events[index].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+          _receive(daemon, connection);
+        } else {
+          _flush(daemon, connection);
+        }
+      }
+    }
+    _release_closed(daemon);
+  }
+  return NULL;
+}
+
+/**
+ * @brief Watch a socket of an event loop
+ * @param daemon The event loop
+ * @param fd The socket, ignored if negative
+ */
+static void _watch(Daemon *daemon, int *fd) {
+  if (*fd >= 0) {
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = fd};
+    epoll_ctl(daemon->epoll, EPOLL_CTL_ADD, *fd, &event);
+  }
+}
+
+/**
+ * @brief Open the sockets of an event loop
+ * @param daemon The event loop, its sockets set to -1
+ * @param index The index of the loop
+ * @param path The path of the Unix socket, or NULL
+ * @param port The TCP port, or -1, set to the port of the socket
+ * @param metrics The path of the metrics socket, or NULL
+ * @param threads The number of solver threads
+ * @param capacity The number of solves that can wait for a thread
+ * @return false on error, which is reported
+ * @note Only the first loop answers the metrics
+ */
+static bool _open(
+  Daemon *daemon,
+  int index,
+  const char *path,
+  int *port,
+  const char *metrics,
+  int threads,
+  size_t capacity
+) {
+  daemon->epoll = epoll_create1(EPOLL_CLOEXEC);
+  daemon->wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  daemon->service = nonogram_service_create(threads, capacity);
+  daemon->latency = nonogram_histogram_create();
+  for (int answer = 0; answer < ANSWERS_COUNT; answer++) {
+    atomic_init(&daemon->answers[answer], 0);
+  }
+  if (daemon->epoll < 0 || daemon->wake < 0 || !daemon->service
+      || !daemon->latency) {
+    fprintf(stderr, "Error: Unable to create the service\n");
+    return false;
+  }
+  if (path) {
+    daemon->path = malloc(strlen(path) + 16);
+    if (!daemon->path) {
+      fprintf(stderr, "Error: Memory allocation failed\n");
+      return false;
+    }
+    if (index) {
+      sprintf(daemon->path, "%s.%d", path, index);
+    } else {
+      strcpy(daemon->path, path);
+    }
+    daemon->listener = _listen(daemon->path);
+    if (daemon->listener < 0) {
+      fprintf(stderr, "Error: Unable to listen on %s\n", daemon->path);
+      free(daemon->path);
+      daemon->path = NULL;
+      return false;
+    }
+  }
+  if (*port >= 0) {
+    daemon->tcp = _listen_tcp(port);
+    if (daemon->tcp < 0) {
+      fprintf(stderr, "Error: Unable to listen on port %d\n", *port);
+      return false;
+    }
+  }
+  if (metrics && !index) {
+    daemon->metrics = _listen(metrics);
+    if (daemon->metrics < 0) {
+      fprintf(stderr, "Error: Unable to listen on %s\n", metrics);
+      return false;
+    }
+  }
+  _watch(daemon, &daemon->listener);
+  _watch(daemon, &daemon->tcp);
+  _watch(daemon, &daemon->metrics);
+  _watch(daemon, &daemon->wake);
+  return true;
+}
+
+/**
+ * @brief Stop an event loop and close its sockets
+ * @param daemon The event loop, its thread joined
+ * @param stats The counters of its service, added to
+ * @note Pending requests are answered before the connections are closed
+ */
+static void _shut(Daemon *daemon, NonoGramServiceStats *stats) {
+  if (daemon->service) {
+    NonoGramServiceStats loop_stats;
+    nonogram_service_get_stats(daemon->service, &loop_stats);
+    nonogram_service_destroy(daemon->service);
+    stats->requests += loop_stats.requests;
+    stats->solves += loop_stats.solves;
+    stats->coalesced += loop_stats.coalesced;
+    stats->cached += loop_stats.cached;
+    stats->tabled += loop_stats.tabled;
+    stats->rejected += loop_stats.rejected;
+    stats->expired += loop_stats.expired;
+  }
+  while (daemon->connections) {
+    Connection *connection = daemon->connections;
+    connection->eof = true;
+    _flush(daemon, connection);
+    if (daemon->connections == connection) {
+      _close(daemon, connection);
+    }
+  }
+  _release_closed(daemon);
+  if (daemon->listener >= 0) {
+    close(daemon->listener);
+    unlink(daemon->path);
+  }
+  free(daemon->path);
+  if (daemon->tcp >= 0) {
+    close(daemon->tcp);
+  }
+  if (daemon->metrics >= 0) {
+    close(daemon->metrics);
+  }
+  if (daemon->wake >= 0) {
+    close(daemon->wake);
+  }
+  if (daemon->latency) {
+    nonogram_histogram_destroy(daemon->latency);
+  }
+  if (daemon->epoll >= 0) {
+    close(daemon->epoll);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  const char *path = NULL;
+  const char *metrics = NULL;
+  const char *capture = NULL;
+  const char *table = NULL;
+  int port = -1;
+  int loops = 1;
+  size_t cache = CACHE_CAPACITY;
+  int threads = 1;
+  size_t capacity = QUEUE_CAPACITY;
+  NonoGramEngine engine = NONOGRAM_ENGINE_AUTO;
+  double time_limit = 0.0;
+  long node_limit = 0;
+  int budget = 0;
+  double threshold = LARGE_THRESHOLD;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+      path = argv[++i];
+    } else if (strcmp(argv[i], "--tcp") == 0 && i + 1 < argc) {
+      port = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--loops") == 0 && i + 1 < argc) {
+      loops = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+      cache = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+      metrics = argv[++i];
+    } else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+      capture = argv[++i];
+    } else if (strcmp(argv[i], "--table") == 0 && i + 1 < argc) {
+      table = argv[++i];
+    } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--queue") == 0 && i + 1 < argc) {
+      capacity = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+      if (!nonogram_engine_from_string(argv[++i], &engine)) {
+        fprintf(stderr, "Error: Unknown engine %s\n", argv[i]);
+        return EXIT_FAILURE;
+      }
+    } else if (strcmp(argv[i], "--time-limit") == 0 && i + 1 < argc) {
+      time_limit = strtod(argv[++i], NULL);
+    } else if (strcmp(argv[i], "--node-limit") == 0 && i + 1 < argc) {
+      node_limit = strtol(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc) {
+      budget = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--large") == 0 && i + 1 < argc) {
+      threshold = strtod(argv[++i], NULL);
+    }
+  }
+  if (!path && port < 0) {
+    fprintf(stderr,
+            "Usage: %s --socket path|--tcp port [--loops n] [--threads n] "
+            "[--queue n] [--cache n] "
+            "[--engine auto|line|dfs|probe|local] [--time-limit seconds] "
+            "[--node-limit n] [--budget n] [--large cells] "
+            "[--metrics path] [--capture file] [--table file]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (loops < 1) {
+    // One event loop per core
+    loops = sysconf(_SC_NPROCESSORS_ONLN);
+    loops = loops > 0 ? loops : 1;
+  }
+
+  // The signals are received by the main thread only, with sigwait
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  Server server = {
+    .loops = calloc(loops, sizeof(Daemon)),
+    .loops_count = loops,
+    .cache = cache ? nonogram_cache_create(cache) : NULL,
+    .table = table ? nonogram_table_open(table) : NULL,
+    .capture = capture ? fopen(capture, "w") : NULL,
+    .start = _now(),
+  };
+  int status = EXIT_SUCCESS;
+  if (!server.loops || (cache && !server.cache) || (table && !server.table)) {
+    fprintf(stderr, "Error: Memory allocation failed\n");
+    free(server.loops);
+    server.loops = NULL;
+    server.loops_count = 0;
+    status = EXIT_FAILURE;
+  } else if (capture && !server.capture) {
+    fprintf(stderr, "Error: Unable to open file %s\n", capture);
+    status = EXIT_FAILURE;
+  }
+  for (int index = 0; index < server.loops_count; index++) {
+    Daemon *daemon = &server.loops[index];
+    daemon->server = &server;
+    daemon->epoll = -1;
+    daemon->listener = -1;
+    daemon->tcp = -1;
+    daemon->metrics = -1;
+    daemon->wake = -1;
+    if (status == EXIT_SUCCESS
+        && !_open(daemon, index, path, &port, metrics, threads, capacity)) {
+      status = EXIT_FAILURE;
+    }
+  }
+  if (status == EXIT_SUCCESS && port >= 0) {
+    fprintf(stderr, "Listening on 127.0.0.1:%d\n", port);
+  }
+  for (int index = 0; status == EXIT_SUCCESS && index < loops; index++) {
+    Daemon *daemon = &server.loops[index];
+    nonogram_service_set_engine(daemon->service, engine);
+    nonogram_service_set_limits(daemon->service, time_limit, node_limit);
+    nonogram_service_set_parallel(
+      daemon->service, budget > 0 ? budget : threads, threshold);
+    nonogram_service_set_cache(daemon->service, server.cache);
+    nonogram_service_set_table(daemon->service, server.table);
+    daemon->started = nonogram_service_start(daemon->service)
+      && !pthread_create(&daemon->thread, NULL, _loop, daemon);
+    if (!daemon->started) {
+      fprintf(stderr, "Error: Unable to start a thread\n");
+      status = EXIT_FAILURE;
+    }
+  }
+  if (status == EXIT_SUCCESS) {
+    int received;
+    sigwait(&signals, &received);
+  }
+  atomic_store(&_terminated, true);
+  for (int index = 0; index < server.loops_count; index++) {
+    Daemon *daemon = &server.loops[index];
+    uint64_t one = 1;
+    if (daemon->started && write(daemon->wake, &one, sizeof one) < 0) {
+      fprintf(stderr, "Error: Unable to wake the daemon\n");
+    }
+  }
+
+  NonoGramServiceStats stats = {0};
+  bool scraped = server.loops_count && server.loops[0].metrics >= 0;
+  for (int index = 0; index < server.loops_count; index++) {
+    Daemon *daemon = &server.loops[index];
+    if (daemon->started) {
+      pthread_join(daemon->thread, NULL);
+    }
+    _shut(daemon, &stats);
+  }
+  if (server.loops) {
+    fprintf(stderr,
+            "requests %ld  solves %ld  coalesced %ld  cached %ld  "
+            "tabled %ld  rejected %ld  expired %ld\n", stats.requests,
+            stats.solves, stats.coalesced, stats.cached, stats.tabled,
+            stats.rejected, stats.expired);
+  }
+  if (scraped) {
+    unlink(metrics);
+  }
+  free(server.loops);
+  if (server.capture && fclose(server.capture)) {
+    fprintf(stderr, "Error: Unable to write the capture\n");
+    status = EXIT_FAILURE;
+  }
+  if (server.cache) {
+    nonogram_cache_destroy(server.cache);
+  }
+  if (server.table) {
+    nonogram_table_close(server.table);
+  }
+  return status;
+}
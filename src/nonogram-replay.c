@@ -0,0 +1,506 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+/**
+ * @file nonogram-replay.c
+ * @brief Replay captured requests against a daemon and measure it.
+ *
+ * The capture written by nonogram-daemon --capture holds a request per
+ * line, after the time at which it has been read and a tab. Requests are
+ * sent again at their original pace, at a multiple of it with --speed, or
+ * as fast as the daemon answers with --max, spread over several
+ * connections. The id of every request is replaced by its index in the
+ * capture, so that answers are matched to requests and timed.
+ *
+ * A daemon with several event loops is reached on its TCP port, or on the
+ * Unix sockets of its loops with --loops, connections going round-robin.
+ */
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "./cJSON.h"
+#include "./histogram.h"
+
+/**
+ * @brief Default number of connections
+ */
+#define CONNECTIONS_COUNT 4
+
+/**
+ * @brief Default number of requests not answered yet per connection with
+ *        --max
+ */
+#define WINDOW 64
+
+/**
+ * @brief Size of the reads from a connection
+ */
+#define READ_SIZE 65536
+
+/**
+ * Entry is a captured request.
+ */
+typedef struct {
+  double time;     // Time at which the request has been read
+  cJSON *request;  // Request, without its id
+  double sent;     // Time at which the request has been sent again
+  bool answered;   // Whether the answer has been received
+} Entry;
+
+/**
+ * Client is a connection to the daemon.
+ */
+typedef struct {
+  int fd;                  // Socket
+  char *output;            // Requests not sent yet
+  size_t output_length;    // Number of bytes to send
+  size_t output_capacity;  // Size of the output buffer
+  char *input;             // Bytes received, not a full line yet
+  size_t input_length;     // Number of bytes received
+  size_t input_capacity;   // Size of the input buffer
+  long outstanding;        // Number of requests not answered yet
+} Client;
+
+/**
+ * Replay holds the state of the replay.
+ */
+typedef struct {
+  Entry *entries;              // Captured requests
+  long count;                  // Number of captured requests
+  long answered;               // Number of answers received
+  NonoGramHistogram *latency;  // Time from a request to its answer
+  cJSON *statuses;             // Number of answers by status
+} Replay;
+
+/**
+ * @brief Get the time of the monotonic clock
+ * @return The time in seconds
+ */
+static double _now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Append bytes to a buffer
+ * @param buffer The buffer, grown as needed
+ * @param length The number of bytes in the buffer, updated
+ * @param capacity The size of the buffer, updated
+ * @param data The bytes
+ * @param size The number of bytes
+ * @return false if memory allocation fails
+ */
+static bool _append(
+  char **buffer,
+  size_t *length,
+  size_t *capacity,
+  const char *data,
+  size_t size
+) {
+  if (*length + size > *capacity) {
+    size_t new_capacity = *capacity ? *capacity : 256;
+    while (new_capacity < *length + size) {
+      new_capacity *= 2;
+    }
+    char *new_buffer = realloc(*buffer, new_capacity);
+    if (!new_buffer) {
+      return false;
+    }
+    *buffer = new_buffer;
+    *capacity = new_capacity;
+  }
+  memcpy(*buffer + *length, data, size);
+  *length += size;
+  return true;
+}
+
+/**
+ * @brief Load a capture
+ * @param filename The name of the capture
+ * @param replay The replay receiving the requests
+ * @return false if the file cannot be read
+ * @note Invalid lines are ignored, times are made relative to the first
+ *       request
+ */
+static bool _load(const char *filename, Replay *replay) {
+  int fd = open(filename, O_RDONLY);
+  struct stat status;
+  if (fd < 0 || fstat(fd, &status) < 0) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    return false;
+  }
+  size_t size = status.st_size;
+  const char *data = size
+    ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0)
+    : NULL;
+  close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  long capacity = 0;
+  const char *end = data + size;
+  for (const char *line = data; line && line < end;) {
+    const char *newline = memchr(line, '\n', end - line);
+    const char *line_end = newline ? newline : end;
+    const char *tab = memchr(line, '\t', line_end - line);
+    cJSON *request = tab
+      ? cJSON_ParseWithLength(tab + 1, line_end - tab - 1)
+      : NULL;
+    if (cJSON_IsObject(request)) {
+      if (replay->count == capacity) {
+        capacity = capacity ? 2 * capacity : 1024;
+        Entry *entries =
+          realloc(replay->entries, capacity * sizeof(Entry));
+        if (!entries) {
+          cJSON_Delete(request);
+          break;
+        }
+        replay->entries = entries;
+      }
+      cJSON_DeleteItemFromObject(request, "id");
+      replay->entries[replay->count++] = (Entry) {
+        .time = strtod(line, NULL),
+        .request = request,
+      };
+    } else {
+      cJSON_Delete(request);
+    }
+    line = line_end + 1;
+  }
+  if (data) {
+    munmap((void *) data, size);
+  }
+  for (long index = replay->count - 1; index >= 0; index--) {
+    replay->entries[index].time -= replay->entries[0].time;
+  }
+  return true;
+}
+
+/**
+ * @brief Connect to the daemon
+ * @param path The path of the socket of the daemon, or NULL for TCP
+ * @param port The localhost TCP port of the daemon
+ * @return The socket, or -1 on error
+ */
+static int _connect(const char *path, int port) {
+  struct sockaddr_un unix_address = {.sun_family = AF_UNIX};
+  struct sockaddr_in tcp_address = {
+    .sin_family = AF_INET,
+    .sin_port = htons(port),
+    .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+  };
+  struct sockaddr *address = (struct sockaddr *) &tcp_address;
+  socklen_t length = sizeof tcp_address;
+  if (path) {
+    if (strlen(path) >= sizeof unix_address.sun_path) {
+      return -1;
+    }
+    strcpy(unix_address.sun_path, path);
+    address = (struct sockaddr *) &unix_address;
+    length = sizeof unix_address;
+  }
+  int fd = socket(address->sa_family, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  if (connect(fd, address, length) < 0) {
+    close(fd);
+    return -1;
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  return fd;
+}
+
+/**
+ * @brief Queue a request on a connection
+ * @param replay The replay
+ * @param client The connection
+ * @param index The index of the request
+ * @return false if memory allocation fails
+ */
+static bool _send(Replay *replay, Client *client, long index) {
+  Entry *entry = &replay->entries[index];
+  cJSON_AddNumberToObject(entry->request, "id", index);
+  char *text = cJSON_PrintUnformatted(entry->request);
+  cJSON_DeleteItemFromObject(entry->request, "id");
+  bool succeeded = text
+    && _append(&client->output, &client->output_length,
+               &client->output_capacity, text, strlen(text))
+    && _append(&client->output, &client->output_length,
+               &client->output_capacity, "\n", 1);
+  free(text);
+  entry->sent = _now();
+  client->outstanding++;
+  return succeeded;
+}
+
+/**
+ * @brief Send the queued requests of a connection
+ * @param client The connection
+ * @return false if the connection failed
+ */
+static bool _flush(Client *client) {
+  size_t sent = 0;
+  while (sent < client->output_length) {
+    ssize_t count = send(client->fd, client->output + sent,
+                         client->output_length - sent, MSG_NOSIGNAL);
+    if (count < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        return false;
+      }
+      break;
+    }
+    sent += count;
+  }
+  memmove(client->output, client->output + sent,
+          client->output_length - sent);
+  client->output_length -= sent;
+  return true;
+}
+
+/**
+ * @brief Read the answers of a connection
+ * @param replay The replay
+ * @param client The connection
+ * @return false if the connection has been closed
+ */
+static bool _receive(Replay *replay, Client *client) {
+  char buffer[READ_SIZE];
+  ssize_t count = recv(client->fd, buffer, sizeof buffer, 0);
+  if (count == 0) {
+    return false;
+  }
+  if (count < 0) {
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+  }
+  if (!_append(&client->input, &client->input_length,
+               &client->input_capacity, buffer, count)) {
+    return false;
+  }
+  double now = _now();
+  size_t start = 0;
+  char *newline;
+  while ((newline = memchr(client->input + start, '\n',
+                           client->input_length - start))) {
+    size_t length = newline - (client->input + start);
+    cJSON *answer = cJSON_ParseWithLength(client->input + start, length);
+    cJSON *id = cJSON_GetObjectItem(answer, "id");
+    cJSON *status = cJSON_GetObjectItem(answer, "status");
+    long index = cJSON_IsNumber(id) ? (long) id->valuedouble : -1;
+    if (index >= 0 && index < replay->count
+        && !replay->entries[index].answered) {
+      Entry *entry = &replay->entries[index];
+      entry->answered = true;
+      nonogram_histogram_record(replay->latency, now - entry->sent);
+      replay->answered++;
+      client->outstanding--;
+      const char *name = cJSON_IsString(status)
+        ? status->valuestring
+        : "unknown";
+      cJSON *counter = cJSON_GetObjectItem(replay->statuses, name);
+      if (counter) {
+        cJSON_SetNumberValue(counter, counter->valuedouble + 1);
+      } else {
+        cJSON_AddNumberToObject(replay->statuses, name, 1);
+      }
+    }
+    cJSON_Delete(answer);
+    start += length + 1;
+  }
+  memmove(client->input, client->input + start,
+          client->input_length - start);
+  client->input_length -= start;
+  return true;
+}
+
+/**
+ * @brief Print the measures of a replay
+ * @param replay The replay
+ * @param elapsed The duration of the replay in seconds
+ */
+static void _print(Replay *replay, double elapsed) {
+  printf("requests %ld  answered %ld  seconds %.3f  throughput %.1f/s\n",
+         replay->count, replay->answered, elapsed,
+         elapsed > 0 ? replay->answered / elapsed : 0.0);
+  double quantiles[] = {0.5, 0.9, 0.99, 0.999, 1.0};
+  const char *names[] = {"p50", "p90", "p99", "p99.9", "max"};
+  printf("latency");
+  for (int index = 0; index < 5; index++) {
+    printf("  %s %.3f ms", names[index],
+           nonogram_histogram_get_quantile(
+             replay->latency, quantiles[index]) * 1e3);
+  }
+  printf("\nstatus");
+  cJSON *counter;
+  cJSON_ArrayForEach(counter, replay->statuses) {
+    printf("  %s %.0f", counter->string, counter->valuedouble);
+  }
+  printf("\n");
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr,
+            "Usage: %s capture --socket path|--tcp port [--loops n] "
+            "[--connections n] [--speed factor] [--max] [--window n]\n",
+            argv[0]);
+    return EXIT_FAILURE;
+  }
+  const char *path = NULL;
+  int port = -1;
+  int loops = 1;
+  int connections = CONNECTIONS_COUNT;
+  double speed = 1.0;
+  bool max = false;
+  long window = WINDOW;
+  for (int i = 2; i < argc; i++) {
+    if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+      path = argv[++i];
+    } else if (strcmp(argv[i], "--tcp") == 0 && i + 1 < argc) {
+      port = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--loops") == 0 && i + 1 < argc) {
+      loops = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--connections") == 0 && i + 1 < argc) {
+      connections = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+      speed = strtod(argv[++i], NULL);
+    } else if (strcmp(argv[i], "--max") == 0) {
+      max = true;
+    } else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+      window = strtol(argv[++i], NULL, 10);
+    }
+  }
+  if (!path && port < 0) {
+    fprintf(stderr, "Error: Missing --socket or --tcp\n");
+    return EXIT_FAILURE;
+  }
+  if (loops < 1) {
+    loops = 1;
+  }
+  if (connections < 1) {
+    connections = 1;
+  }
+  if (speed <= 0) {
+    speed = 1.0;
+  }
+  if (window < 1) {
+    window = 1;
+  }
+
+  Replay replay = {
+    .latency = nonogram_histogram_create(),
+    .statuses = cJSON_CreateObject(),
+  };
+  if (!replay.latency || !replay.statuses || !_load(argv[1], &replay)) {
+    fprintf(stderr, "Error: Unable to read file %s\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+  Client *clients = calloc(connections, sizeof(Client));
+  int epoll = epoll_create1(0);
+  int status = EXIT_SUCCESS;
+  for (int index = 0; clients && index < connections; index++) {
+    // The event loops of the daemon after the first one add their index
+    char loop_path[path ? strlen(path) + 16 : 1];
+    if (path && index % loops) {
+      sprintf(loop_path, "%s.%d", path, index % loops);
+    } else if (path) {
+      strcpy(loop_path, path);
+    }
+    clients[index].fd = _connect(path ? loop_path : NULL, port);
+    struct epoll_event event = {
+      .events = EPOLLIN, .data.ptr = &clients[index]
+    };
+    if (clients[index].fd < 0
+        || epoll_ctl(epoll, EPOLL_CTL_ADD, clients[index].fd, &event) < 0) {
+      if (path) {
+        fprintf(stderr, "Error: Unable to connect to %s\n", loop_path);
+      } else {
+        fprintf(stderr, "Error: Unable to connect to port %d\n", port);
+      }
+      status = EXIT_FAILURE;
+      break;
+    }
+  }
+  if (!clients || epoll < 0) {
+    fprintf(stderr, "Error: Memory allocation failed\n");
+    status = EXIT_FAILURE;
+  }
+
+  double start = _now();
+  long next = 0;
+  while (status == EXIT_SUCCESS && replay.answered < replay.count) {
+    // Send the requests that are due
+    double now = _now() - start;
+    int timeout = -1;
+    while (next < replay.count) {
+      Client *client = &clients[next % connections];
+      if (max ? client->outstanding >= window
+              : replay.entries[next].time / speed > now) {
+        if (!max) {
+          timeout = (replay.entries[next].time / speed - now) * 1e3 + 1;
+        }
+        break;
+      }
+      if (!_send(&replay, client, next++)) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        status = EXIT_FAILURE;
+      }
+    }
+    for (int index = 0; index < connections; index++) {
+      Client *client = &clients[index];
+      if (!_flush(client)) {
+        status = EXIT_FAILURE;
+      }
+      struct epoll_event event = {
+        .events = EPOLLIN | (client->output_length ? EPOLLOUT : 0),
+        .data.ptr = client,
+      };
+      epoll_ctl(epoll, EPOLL_CTL_MOD, client->fd, &event);
+    }
+    struct epoll_event events[16];
+    int count = epoll_wait(epoll, events, 16, timeout);
+    for (int index = 0; index < count; index++) {
+      if ((events[index].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+          && !_receive(&replay, events[index].data.ptr)) {
+        fprintf(stderr, "Error: Connection closed by the daemon\n");
+        status = EXIT_FAILURE;
+      }
+    }
+  }
+  _print(&replay, _now() - start);
+
+  for (int index = 0; clients && index < connections; index++) {
+    if (clients[index].fd > 0) {
+      close(clients[index].fd);
+    }
+    free(clients[index].output);
+    free(clients[index].input);
+  }
+  free(clients);
+  if (epoll >= 0) {
+    close(epoll);
+  }
+  for (long index = 0; index < replay.count; index++) {
+    cJSON_Delete(replay.entries[index].request);
+  }
+  free(replay.entries);
+  cJSON_Delete(replay.statuses);
+  nonogram_histogram_destroy(replay.latency);
+  return status;
+}
@@ -0,0 +1,616 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+/**
+ * @file nonogram-shard.c
+ * @brief Solve every puzzle of a corpus in several worker processes.
+ *
+ * The coordinator opens the corpus, maps a shared memory region and forks
+ * the workers, which inherit both. The region holds the queue of puzzles,
+ * a slot per worker and a table with an entry per puzzle. A worker takes a
+ * range of puzzles from the queue under a process-shared robust lock,
+ * solves them one after the other and stores each result in the table:
+ * its status, its time and its board, copied to a shared arena.
+ *
+ * The slot of a worker tells which puzzle it is solving. When a worker
+ * dies, the coordinator records that puzzle as "crashed" and forks another
+ * worker that resumes the range after it, so that a puzzle crashing the
+ * solver costs only itself. With --timeout, a worker stuck on a puzzle is
+ * killed and the puzzle recorded as "timeout".
+ *
+ * The coordinator outputs the results as a JSON line per puzzle, in input
+ * order, as soon as the puzzles before them are done, then the number of
+ * puzzles by status on the standard error.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "./corpus.h"
+#include "./nonogram.h"
+#include "./solver.h"
+
+/**
+ * @brief Default number of puzzles taken at once by a worker
+ */
+#define RANGE_SIZE 64
+
+/**
+ * @brief Default size of the arena of the boards, in MiB
+ * @note The arena is reserved, memory is only used by the boards stored
+ */
+#define ARENA_SIZE 4096
+
+/**
+ * @brief Interval between two checks of the workers, in nanoseconds
+ */
+#define TICK 10000000L
+
+/**
+ * ShardStatus enumerates the results of a puzzle.
+ */
+typedef enum {
+  SHARD_PENDING,  // Not solved yet
+  SHARD_SOLVED,   // A solution has been found
+  SHARD_FAILED,   // The engine could not find a solution
+  SHARD_STOPPED,  // A limit stopped the solve
+  SHARD_INVALID,  // The record is not a puzzle
+  SHARD_ERROR,    // Memory or the arena is exhausted
+  SHARD_CRASHED,  // The worker died while solving the puzzle
+  SHARD_TIMEOUT,  // The worker has been killed while solving the puzzle
+} ShardStatus;
+
+/**
+ * @brief Number of statuses
+ */
+#define STATUSES_COUNT 8
+
+/**
+ * Names of the statuses, indexed by ShardStatus.
+ */
+static const char *const _status_names[] = {
+  "pending", "solved", "failed", "stopped", "invalid", "error", "crashed",
+  "timeout"
+};
+
+/**
+ * ShardHeader is the queue of puzzles, in shared memory.
+ */
+typedef struct {
+  pthread_mutex_t lock;  // Process-shared robust lock of the queue
+  long queue;            // First puzzle not handed out
+  atomic_size_t used;    // Number of bytes of the arena given out
+} ShardHeader;
+
+/**
+ * ShardSlot is the progress of a worker, in shared memory.
+ * @note Only the worker writes its slot while it is alive, and only the
+ *       coordinator once it has died.
+ */
+typedef struct {
+  atomic_long next;          // Next puzzle of the range
+  atomic_long end;           // End of the range
+  atomic_long current;       // Puzzle being solved, -1 for none
+  atomic_llong started;      // Start of the current puzzle, in nanoseconds
+  char padding[64 - 4 * 8];  // Slots on their own cache line
+} ShardSlot;
+
+/**
+ * ShardEntry is the result of a puzzle, in shared memory.
+ */
+typedef struct {
+  atomic_int status;  // ShardStatus, published last
+  int rows_count;     // Number of rows of the board
+  int cols_count;     // Number of columns of the board
+  float seconds;      // Time spent by the solve
+  size_t board;       // Offset of the board in the arena
+} ShardEntry;
+
+/**
+ * Record is the unparsed line of a puzzle.
+ */
+typedef struct {
+  const char *data;  // Line, or NULL for an archive
+  size_t length;     // Length of the line
+} Record;
+
+/**
+ * Worker is a worker process, as seen by the coordinator.
+ */
+typedef struct {
+  pid_t pid;    // Process, 0 once it has exited
+  long killed;  // Puzzle on which it has been killed, -1 for none
+} Worker;
+
+/**
+ * Shard holds the options, the shared memory and the coordinator state.
+ */
+typedef struct {
+  NonoGramCorpus *corpus;        // Corpus being solved
+  Record *records;               // Records of the puzzles
+  long count;                    // Number of puzzles
+  NonoGramEngine engine;         // Engine of the solver
+  unsigned long seed;            // Seed of the randomized engines
+  double time_limit;             // Time limit of the local search
+  long node_limit;               // Maximal number of decisions
+  long range;                    // Number of puzzles taken at once
+  double timeout;                // Time before killing a worker, or 0
+  void *region;                  // Shared memory
+  size_t region_size;            // Size of the shared memory
+  ShardHeader *header;           // Queue of puzzles
+  ShardSlot *slots;              // Progress of the workers
+  ShardEntry *entries;           // Results of the puzzles
+  char *arena;                   // Boards of the solved puzzles
+  size_t arena_size;             // Size of the arena
+  Worker *workers;               // Worker processes
+  int processes;                 // Number of workers
+  long restarts;                 // Number of workers forked again
+  long emitted;                  // Number of results output
+  long counts[STATUSES_COUNT];   // Number of results by status
+  double seconds;                // Time spent by the solves
+} Shard;
+
+/**
+ * @brief Get the monotonic time
+ * @return The time in nanoseconds
+ */
+static long long _now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/**
+ * @brief Keep the record of a puzzle
+ * @param id The index of the puzzle in the corpus
+ * @param data The line of the puzzle
+ * @param length The length of the line
+ * @param user_data The shard
+ * @return false if memory allocation fails
+ */
+static bool _keep(long id, const char *data, size_t length, void *user_data) {
+  Shard *shard = user_data;
+  // Ids are consecutive, the array doubles at powers of two
+  if (!(id & (id - 1))) {
+    Record *records =
+      realloc(shard->records, (id ? 2 * id : 1) * sizeof(Record));
+    if (!records) {
+      return false;
+    }
+    shard->records = records;
+  }
+  shard->records[id] = (Record) {data, length};
+  shard->count = id + 1;
+  return true;
+}
+
+/**
+ * @brief Map the shared memory
+ * @param shard The shard
+ * @return false if the mapping fails
+ */
+static bool _map(Shard *shard) {
+  size_t slots = (sizeof(ShardHeader) + 63) & ~(size_t) 63;
+  size_t entries = slots + shard->processes * sizeof(ShardSlot);
+  size_t arena = (entries + shard->count * sizeof(ShardEntry) + 63)
+    & ~(size_t) 63;
+  shard->region_size = arena + shard->arena_size;
+  shard->region = mmap(NULL, shard->region_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (shard->region == MAP_FAILED) {
+    shard->region = NULL;
+    return false;
+  }
+  char *region = shard->region;
+  shard->header = (ShardHeader *) region;
+  shard->slots = (ShardSlot *) (region + slots);
+  shard->entries = (ShardEntry *) (region + entries);
+  shard->arena = region + arena;
+  for (int index = 0; index < shard->processes; index++) {
+    atomic_init(&shard->slots[index].current, -1);
+  }
+
+  // A worker dying with the lock leaves it to the next owner to repair
+  pthread_mutexattr_t attributes;
+  pthread_mutexattr_init(&attributes);
+  pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+  pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+  bool initialized =
+    !pthread_mutex_init(&shard->header->lock, &attributes);
+  pthread_mutexattr_destroy(&attributes);
+  return initialized;
+}
+
+/**
+ * @brief Lock the queue, repairing it if the owner has died
+ * @param shard The shard
+ * @return false if the lock fails
+ * @note A claim records the range in the slot before moving the queue, so
+ *       a range recorded beyond the queue has been claimed by a worker
+ *       that died before moving it
+ */
+static bool _lock(Shard *shard) {
+  int error = pthread_mutex_lock(&shard->header->lock);
+  if (error == EOWNERDEAD) {
+    for (int index = 0; index < shard->processes; index++) {
+      long end = atomic_load(&shard->slots[index].end);
+      if (end > shard->header->queue) {
+        shard->header->queue = end;
+      }
+    }
+    pthread_mutex_consistent(&shard->header->lock);
+    error = 0;
+  }
+  return !error;
+}
+
+/**
+ * @brief Take a range of puzzles from the queue
+ * @param shard The shard
+ * @param slot The slot of the worker
+ * @return false if the queue is empty
+ */
+static bool _claim(Shard *shard, ShardSlot *slot) {
+  if (!_lock(shard)) {
+    return false;
+  }
+  long start = shard->header->queue;
+  bool claimed = start < shard->count;
+  if (claimed) {
+    long end = start + shard->range < shard->count
+      ? start + shard->range
+      : shard->count;
+    // Until the end is set, the range of the slot is empty
+    atomic_store(&slot->next, start);
+    atomic_store(&slot->end, end);
+    shard->header->queue = end;
+  }
+  pthread_mutex_unlock(&shard->header->lock);
+  return claimed;
+}
+
+/**
+ * @brief Solve a puzzle and store its result
+ * @param shard The shard
+ * @param id The index of the puzzle in the corpus
+ */
+static void _solve(Shard *shard, long id) {
+  ShardEntry *entry = &shard->entries[id];
+  long long started = _now();
+  ShardStatus status = SHARD_INVALID;
+  NonoGramHints *hints = nonogram_corpus_parse(
+    shard->corpus, id, shard->records[id].data, shard->records[id].length);
+  NonoGramSolver *solver = hints ? nonogram_solver_create(hints) : NULL;
+  if (hints && !solver) {
+    status = SHARD_ERROR;
+  }
+  if (solver) {
+    nonogram_solver_set_seed(solver, shard->seed);
+    nonogram_solver_set_time_limit(solver, shard->time_limit);
+    nonogram_solver_set_node_limit(solver, shard->node_limit);
+    NonoGramEngine engine = shard->engine;
+    NonoGramFeatures features;
+    if (engine == NONOGRAM_ENGINE_AUTO
+        && nonogram_solver_features(solver, &features)) {
+      engine = nonogram_solver_select_engine(&features);
+    }
+    switch (nonogram_solver_solve(solver, engine)) {
+      case NONOGRAM_SOLVER_SOLVED:
+        status = SHARD_SOLVED;
+        break;
+      case NONOGRAM_SOLVER_FAILED:
+        status = SHARD_FAILED;
+        break;
+      default:
+        status = SHARD_STOPPED;
+        break;
+    }
+  }
+  if (status == SHARD_SOLVED) {
+    int rows_count = nonogram_hints_get_rows_count(hints);
+    int cols_count = nonogram_hints_get_cols_count(hints);
+    size_t size = (size_t) rows_count * cols_count;
+    size_t board = atomic_fetch_add(&shard->header->used, size);
+    if (board + size > shard->arena_size) {
+      status = SHARD_ERROR;
+    } else {
+      char *cell = shard->arena + board;
+      for (int row = 0; row < rows_count; row++) {
+        for (int col = 0; col < cols_count; col++) {
+          *cell++ = '0' + nonogram_solver_get_cell(solver, row, col);
+        }
+      }
+      entry->rows_count = rows_count;
+      entry->cols_count = cols_count;
+      entry->board = board;
+    }
+  }
+  if (solver) {
+    nonogram_solver_destroy(solver);
+  }
+  if (hints) {
+    nonogram_hints_destroy(hints);
+  }
+  entry->seconds = (_now() - started) / 1e9;
+  atomic_store_explicit(&entry->status, status, memory_order_release);
+}
+
+/**
+ * @brief Run a worker process until the queue is empty
+ * @param shard The shard
+ * @param slot The slot of the worker, maybe with a range left by a
+ *        previous worker
+ */
+static void _work(Shard *shard, ShardSlot *slot) {
+  for (;;) {
+    long id = atomic_load(&slot->next);
+    if (id >= atomic_load(&slot->end)) {
+      if (!_claim(shard, slot)) {
+        return;
+      }
+      continue;
+    }
+    atomic_store(&slot->started, _now());
+    atomic_store(&slot->current, id);
+    _solve(shard, id);
+    atomic_store(&slot->next, id + 1);
+    atomic_store(&slot->current, -1);
+  }
+}
+
+/**
+ * @brief Fork a worker process
+ * @param shard The shard
+ * @param index The index of the worker
+ * @return false if the fork fails
+ */
+static bool _spawn(Shard *shard, int index) {
+  pid_t pid = fork();
+  if (pid < 0) {
+    return false;
+  }
+  if (!pid) {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigprocmask(SIG_SETMASK, &signals, NULL);
+    _work(shard, &shard->slots[index]);
+    // The buffers of the coordinator must not be flushed twice
+    _exit(EXIT_SUCCESS);
+  }
+  shard->workers[index] = (Worker) {pid, -1};
+  return true;
+}
+
+/**
+ * @brief Handle the end of a worker process
+ * @param shard The shard
+ * @param pid The process
+ * @param status The status given by waitpid
+ * @note The puzzle being solved by a dead worker is recorded, unless its
+ *       result was stored before the death, and another worker resumes
+ *       the range after it. A worker killed by the timeout after it moved
+ *       to another puzzle resumes at that puzzle.
+ */
+static void _reap(Shard *shard, pid_t pid, int status) {
+  int index = 0;
+  while (index < shard->processes && shard->workers[index].pid != pid) {
+    index++;
+  }
+  if (index == shard->processes) {
+    return;
+  }
+  Worker *worker = &shard->workers[index];
+  ShardSlot *slot = &shard->slots[index];
+  worker->pid = 0;
+  long current = atomic_load(&slot->current);
+  if (WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS
+      && current < 0) {
+    return;
+  }
+  // The lock repairs the queue if the worker died while claiming a range
+  if (_lock(shard)) {
+    pthread_mutex_unlock(&shard->header->lock);
+  }
+  if (current >= 0 && (worker->killed < 0 || worker->killed == current)) {
+    ShardEntry *entry = &shard->entries[current];
+    if (atomic_load(&entry->status) == SHARD_PENDING) {
+      atomic_store(&entry->status,
+                   worker->killed < 0 ? SHARD_CRASHED : SHARD_TIMEOUT);
+    }
+    if (atomic_load(&slot->next) <= current) {
+      atomic_store(&slot->next, current + 1);
+    }
+  }
+  atomic_store(&slot->current, -1);
+  if (_spawn(shard, index)) {
+    shard->restarts++;
+  } else {
+    fprintf(stderr, "Error: Unable to fork a worker\n");
+  }
+}
+
+/**
+ * @brief Kill the workers stuck on a puzzle for longer than the timeout
+ * @param shard The shard
+ */
+static void _watch(Shard *shard) {
+  long long now = _now();
+  for (int index = 0; index < shard->processes; index++) {
+    Worker *worker = &shard->workers[index];
+    ShardSlot *slot = &shard->slots[index];
+    // The puzzle is read before its start, which is stored first
+    long current = atomic_load(&slot->current);
+    long long started = atomic_load(&slot->started);
+    if (worker->pid && worker->killed < 0 && current >= 0
+        && (now - started) / 1e9 > shard->timeout) {
+      worker->killed = current;
+      kill(worker->pid, SIGKILL);
+    }
+  }
+}
+
+/**
+ * @brief Output the results whose predecessors have been output
+ * @param shard The shard
+ * @param all Whether the puzzles not done are output as errors
+ */
+static void _flush(Shard *shard, bool all) {
+  long emitted = shard->emitted;
+  for (; shard->emitted < shard->count; shard->emitted++) {
+    long id = shard->emitted;
+    ShardEntry *entry = &shard->entries[id];
+    ShardStatus status =
+      atomic_load_explicit(&entry->status, memory_order_acquire);
+    if (status == SHARD_PENDING) {
+      if (!all) {
+        break;
+      }
+      status = SHARD_ERROR;
+    }
+    shard->counts[status]++;
+    shard->seconds += entry->seconds;
+    printf("{\"id\":%ld,\"status\":\"%s\"", id, _status_names[status]);
+    if (status == SHARD_SOLVED) {
+      const char *cell = shard->arena + entry->board;
+      fputs(",\"board\":[", stdout);
+      for (int row = 0; row < entry->rows_count; row++) {
+        printf(row ? ",\"%.*s\"" : "\"%.*s\"", entry->cols_count, cell);
+        cell += entry->cols_count;
+      }
+      putchar(']');
+    }
+    fputs("}\n", stdout);
+  }
+  if (shard->emitted > emitted) {
+    fflush(stdout);
+  }
+}
+
+/**
+ * @brief Run the workers and output their results
+ * @param shard The shard
+ * @return false if no worker can be forked
+ */
+static bool _coordinate(Shard *shard) {
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGCHLD);
+  sigprocmask(SIG_BLOCK, &signals, NULL);
+  int alive = 0;
+  for (int index = 0; index < shard->processes; index++) {
+    alive += _spawn(shard, index);
+  }
+  if (!alive) {
+    return false;
+  }
+  while (alive) {
+    struct timespec tick = {0, TICK};
+    sigtimedwait(&signals, NULL, &tick);
+    pid_t pid;
+    int status;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+      _reap(shard, pid, status);
+    }
+    if (shard->timeout > 0) {
+      _watch(shard);
+    }
+    _flush(shard, false);
+    alive = 0;
+    for (int index = 0; index < shard->processes; index++) {
+      alive += shard->workers[index].pid != 0;
+    }
+  }
+  // Puzzles left by a worker that could not be forked again are errors
+  _flush(shard, true);
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr,
+            "Usage: %s corpus.ndjson|corpus.nga|directory [--processes n] "
+            "[--range n] [--timeout seconds] [--arena MiB] "
+            "[--engine auto|line|dfs|probe|local] [--seed n] "
+            "[--time-limit seconds] [--node-limit n]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  Shard shard = {
+    .engine = NONOGRAM_ENGINE_AUTO,
+    .range = RANGE_SIZE,
+    .arena_size = (size_t) ARENA_SIZE << 20,
+  };
+  shard.processes = sysconf(_SC_NPROCESSORS_ONLN);
+  for (int i = 2; i < argc; i++) {
+    if (strcmp(argv[i], "--processes") == 0 && i + 1 < argc) {
+      shard.processes = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--range") == 0 && i + 1 < argc) {
+      shard.range = strtol(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) {
+      shard.timeout = strtod(argv[++i], NULL);
+    } else if (strcmp(argv[i], "--arena") == 0 && i + 1 < argc) {
+      shard.arena_size = strtoul(argv[++i], NULL, 10) << 20;
+    } else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+      if (!nonogram_engine_from_string(argv[++i], &shard.engine)) {
+        fprintf(stderr, "Error: Unknown engine %s\n", argv[i]);
+        return EXIT_FAILURE;
+      }
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      shard.seed = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--time-limit") == 0 && i + 1 < argc) {
+      shard.time_limit = strtod(argv[++i], NULL);
+    } else if (strcmp(argv[i], "--node-limit") == 0 && i + 1 < argc) {
+      shard.node_limit = strtol(argv[++i], NULL, 10);
+    }
+  }
+  if (shard.processes < 1) {
+    shard.processes = 1;
+  }
+  if (shard.range < 1) {
+    shard.range = 1;
+  }
+
+  shard.corpus = nonogram_corpus_open(argv[1]);
+  if (!shard.corpus) {
+    fprintf(stderr, "Error: Unable to open file %s\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+  int status = EXIT_SUCCESS;
+  shard.workers = calloc(shard.processes, sizeof(Worker));
+  if (!shard.workers
+      || nonogram_corpus_scan(shard.corpus, _keep, &shard) != shard.count) {
+    fprintf(stderr, "Error: Unable to read file %s\n", argv[1]);
+    status = EXIT_FAILURE;
+  } else if (!_map(&shard)) {
+    fprintf(stderr, "Error: Unable to map the shared memory\n");
+    status = EXIT_FAILURE;
+  } else if (!_coordinate(&shard)) {
+    fprintf(stderr, "Error: Unable to fork a worker\n");
+    status = EXIT_FAILURE;
+  } else {
+    fprintf(stderr, "puzzles %ld", shard.count);
+    for (int index = SHARD_SOLVED; index < STATUSES_COUNT; index++) {
+      fprintf(stderr, "  %s %ld", _status_names[index], shard.counts[index]);
+    }
+    fprintf(stderr, "  restarts %ld  solve %.3fs\n", shard.restarts,
+            shard.seconds);
+  }
+
+  if (shard.region) {
+    pthread_mutex_destroy(&shard.header->lock);
+    munmap(shard.region, shard.region_size);
+  }
+  free(shard.workers);
+  free(shard.records);
+  nonogram_corpus_close(shard.corpus);
+  return status;
+}
@@ -2,12 +2,21 @@
     // Created by engouan,wbernard,jb--guillon,kdamasceno,akerraf,qvievard on 30/03/2024.
     //
 
+    #include <signal.h>
+    #include <stdatomic.h>
+    #include <stdbool.h>
     #include <stdio.h>
     #include <stdlib.h>
+    #include <string.h>
+    #include <time.h>
+    #include <unistd.h>
     #include <fcntl.h>
     #include "./cJSON.h"
     #include "./nonogram.h"
     #include "./nonogram.inc"
+    #include "./repair.h"
+    #include "./solver.h"
+    #include "./table.h"
     #include "./pnmio.h" //PBM file, read and write
 
     /**
@@ -15,25 +24,258 @@
      */
     #define MAX_HINTS 32
 
+    /**
+     * @brief Default time limit of the repair in seconds
+     */
+    #define REPAIR_TIME_LIMIT 1.0
+
+    /**
+     * @brief Number of line solves between two progress reports
+     */
+    #define PROGRESS_INTERVAL 100000
+
+    /**
+     * @brief Default number of seconds between two checkpoints
+     */
+    #define CHECKPOINT_INTERVAL 60.0
+
+    /**
+     * @brief Line solves of a step between two checks of the checkpoint interval
+     */
+    #define CHECKPOINT_BUDGET 10000
+
+    /**
+     * @brief Raised by SIGINT or SIGTERM to cancel the solve
+     */
+    static atomic_bool interrupted;
+
+    /**
+     * @brief Cancel the solve on SIGINT or SIGTERM
+     * @param signum The signal number
+     */
+    static void on_interrupt(int signum) {
+        (void) signum;
+        atomic_store(&interrupted, true);
+    }
+
+    /**
+     * @brief Print the progress of the solve to stderr
+     * @param nodes The number of decisions taken so far
+     * @param settled The number of cells currently settled
+     * @param data The number of cells of the board
+     */
+    static void print_progress(long nodes, int settled, void *data) {
+        fprintf(stderr, "Progress: %ld nodes, %d/%d cells settled\n", nodes, settled, *(int *) data);
+    }
+
+    /**
+     * @brief Get the monotonic time
+     * @return The time in seconds
+     */
+    static double now(void) {
+        struct timespec time;
+        clock_gettime(CLOCK_MONOTONIC, &time);
+        return time.tv_sec + time.tv_nsec / 1e9;
+    }
+
+    /**
+     * @brief Solve step by step, saving the state of the solve to a checkpoint file
+     * @param solver The solver
+     * @param engine The engine used to solve the puzzle, ignored by a resumed solve
+     * @param resumed Whether the solver has been loaded from the checkpoint file
+     * @param checkpoint The checkpoint file, removed once the solve has ended
+     * @param interval The number of seconds between two checkpoints
+     * @return The status of the solve
+     * @note An interrupted solve is saved before returning, so that it can be resumed
+     * @note The local search ignores the time limit in steps
+     */
+    NonoGramStatus solve_with_checkpoints(NonoGramSolver *solver, NonoGramEngine engine, bool resumed,
+                                          const char *checkpoint, double interval) {
+        if (!resumed) {
+            nonogram_solver_set_engine(solver, engine);
+        }
+        double saved = now();
+        NonoGramStatus status;
+        while ((status = nonogram_solver_step(solver, CHECKPOINT_BUDGET)) == NONOGRAM_SOLVER_IN_PROGRESS) {
+            if (now() - saved >= interval) {
+                if (!nonogram_solver_save(solver, checkpoint)) {
+                    fprintf(stderr, "Error: Unable to write checkpoint %s\n", checkpoint);
+                }
+                saved = now();
+            }
+        }
+        if (status != NONOGRAM_SOLVER_STOPPED) {
+            unlink(checkpoint);
+        } else if (nonogram_solver_save(solver, checkpoint)) {
+            fprintf(stderr, "Checkpoint saved to %s\n", checkpoint);
+        } else {
+            fprintf(stderr, "Error: Unable to write checkpoint %s\n", checkpoint);
+        }
+        return status;
+    }
+
+    /**
+     * @brief Stream of the solutions of an enumeration
+     */
+    typedef struct {
+        FILE *file;      // Output file
+        int rows_count;  // Number of rows of the board
+        int cols_count;  // Number of columns of the board
+        bool ndjson;     // Whether solutions are JSON lines rather than PBM images
+        long count;      // Number of solutions written
+    } SolutionStream;
+
+    /**
+     * @brief Write a solution of an enumeration
+     * @param bits The bit-packed board, as in a raw PBM image
+     * @param data The solution stream
+     * @return false if the solution cannot be written
+     */
+    static bool write_solution(const unsigned char *bits, void *data) {
+        SolutionStream *stream = data;
+        size_t stride = (stream->cols_count + 7) / 8;
+        stream->count++;
+        if (!stream->ndjson) {
+            // Une image PBM brute par solution, concaténées
+            fprintf(stream->file, "P4\n%d %d\n", stream->cols_count, stream->rows_count);
+            fwrite(bits, stride, stream->rows_count, stream->file);
+            return !ferror(stream->file);
+        }
+        fprintf(stream->file, "{\"solution\":%ld,\"board\":[", stream->count);
+        for (int row = 0; row < stream->rows_count; row++) {
+            fputs(row ? ",\"" : "\"", stream->file);
+            for (int col = 0; col < stream->cols_count; col++) {
+                fputc(bits[row * stride + col / 8] & (0x80 >> (col % 8)) ? '1' : '0', stream->file);
+            }
+            fputc('"', stream->file);
+        }
+        fputs("]}\n", stream->file);
+        return !ferror(stream->file);
+    }
+
+    /**
+     * @brief Enumerate the solutions of a nonogram hints object
+     * @param hints The nonogram hints object
+     * @param limit The maximal number of solutions, 0 for all of them
+     * @param ndjson Whether to write JSON lines rather than a stream of PBM images
+     * @param output_file The output file, or NULL for the standard output
+     * @return EXIT_SUCCESS if at least one solution has been written
+     * @note The number of solutions is printed to stderr, as a lower bound when the
+     *       enumeration has not been completed
+     */
+    int enumerate_solutions(NonoGramHints *hints, long limit, bool ndjson, const char *output_file) {
+        SolutionStream stream = {
+            .file = output_file ? fopen(output_file, ndjson ? "w" : "wb") : stdout,
+            .rows_count = hints->rows_count,
+            .cols_count = hints->cols_count,
+            .ndjson = ndjson,
+        };
+        if (!stream.file) {
+            fprintf(stderr, "Error: Unable to open file %s\n", output_file);
+            return EXIT_FAILURE;
+        }
+        NonoGramSolver *solver = nonogram_solver_create(hints);
+        long count = -1;
+        bool complete = false;
+        if (solver) {
+            nonogram_solver_set_cancel(solver, &interrupted);
+            count = nonogram_solver_enumerate(solver, limit, write_solution, &stream, &complete);
+            nonogram_solver_destroy(solver);
+        }
+        if (output_file) {
+            fclose(stream.file);
+        } else {
+            fflush(stdout);
+        }
+        if (count < 0) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            return EXIT_FAILURE;
+        }
+        fprintf(stderr, "Solutions: %s%ld\n", complete ? "" : "at least ", count);
+        return count > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     /**
      * @brief Create a board from a nonogram hints object
      * @param hints The nonogram hints object
-     * @return A 2D array representing the game board
+     * @param engine The engine used to solve the puzzle
+     * @param seed The seed of the randomized engines
+     * @param time_limit The time limit of the local search in seconds, 0 for none
+     * @param checkpoint The checkpoint file resumed and saved by the solve, or NULL
+     * @param interval The number of seconds between two checkpoints
+     * @param verbose Whether to print the features and the engine to stderr
+     * @return A 2D array representing the solved game board, or NULL if the puzzle is unsolvable
      * @note This function creates a game board from a nonogram hints object
      */
-    int **nonogram_board_create_from_hints(NonoGramHints *hints) {
+    int **nonogram_board_create_from_hints(NonoGramHints *hints, NonoGramEngine engine,
+                                           unsigned long seed, double time_limit,
+                                           const char *checkpoint, double interval, bool verbose) {
         int rows_count = hints->rows_count;
         int cols_count = hints->cols_count;
 
-        // Créer un tableau de jeu initialisé à 0
+        NonoGramSolver *solver = nonogram_solver_create(hints);
+        if (!solver) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            return NULL;
+        }
+        nonogram_solver_set_seed(solver, seed);
+        nonogram_solver_set_time_limit(solver, time_limit);
+        nonogram_solver_set_cancel(solver, &interrupted);
+        int cells_count = rows_count * cols_count;
+        if (verbose) {
+            nonogram_solver_set_progress(solver, print_progress, &cells_count, PROGRESS_INTERVAL);
+        }
+
+        // Reprendre une résolution interrompue
+        bool resumed = checkpoint && nonogram_solver_load(solver, checkpoint);
+        if (resumed && verbose) {
+            fprintf(stderr, "Resumed from checkpoint %s\n", checkpoint);
+        }
+
+        // Choisir le moteur à partir des caractéristiques du puzzle
+        if (engine == NONOGRAM_ENGINE_AUTO && !resumed) {
+            NonoGramFeatures features;
+            bool consistent = nonogram_solver_features(solver, &features);
+            engine = nonogram_solver_select_engine(&features);
+            if (verbose) {
+                fprintf(stderr, "Features: %dx%d, density %.3f, slack %.3f, max blocks %d, settled %.3f\n",
+                        features.rows_count, features.cols_count, features.clue_density,
+                        features.average_slack, features.max_blocks, features.settled);
+            }
+            if (!consistent) {
+                nonogram_solver_destroy(solver);
+                return NULL;
+            }
+        }
+        if (verbose && !resumed) {
+            fprintf(stderr, "Engine: %s\n", nonogram_engine_to_string(engine));
+        }
+
+        NonoGramStatus status = checkpoint
+            ? solve_with_checkpoints(solver, engine, resumed, checkpoint, interval)
+            : nonogram_solver_solve(solver, engine);
+        if (verbose) {
+            const NonoGramSolverStats *stats = nonogram_solver_get_stats(solver);
+            fprintf(stderr, "Nodes: %ld, backtracks: %ld, propagations: %ld, probes: %ld\n",
+                    stats->nodes, stats->backtracks, stats->propagations, stats->probes);
+        }
+        if (status == NONOGRAM_SOLVER_STOPPED) {
+            fprintf(stderr, "Interrupted\n");
+        }
+        if (status != NONOGRAM_SOLVER_SOLVED) {
+            nonogram_solver_destroy(solver);
+            return NULL;
+        }
+
         int **board = (int **)malloc(rows_count * sizeof(int *));
         if (!board) {
             fprintf(stderr, "Error: Memory allocation failed\n");
+            nonogram_solver_destroy(solver);
             return NULL;
         }
 
         for (int row = 0; row < rows_count; row++) {
-            board[row] = (int *)calloc(cols_count, sizeof(int));
+            board[row] = (int *)malloc(cols_count * sizeof(int));
             if (!board[row]) {
                 fprintf(stderr, "Error: Memory allocation failed\n");
                 // Libérer la mémoire allouée précédemment
@@ -41,28 +283,15 @@
                     free(board[i]);
                 }
                 free(board);
+                nonogram_solver_destroy(solver);
                 return NULL;
             }
-        }
-
-        for (int row = 0; row < rows_count; row++) {
-            int col = 0;
-            for (int i = 0; i < MAX_HINTS && hints->rows[row][i] != 0; i++) {
-                int hint = hints->rows[row][i];
-                // Remplir les blocs
-                for (int j = 0; j < hint; j++) {
-                    if (col < cols_count) {
-                        board[row][col] = 1;
-                        col++;
-                    }
-                }
-                // Ajouter un espace entre les blocs si c'est permis
-                if (col < cols_count && i < MAX_HINTS - 1 && hints->rows[row][i + 1] != 0) {
-                    col++;
-                }
+            for (int col = 0; col < cols_count; col++) {
+                board[row][col] = nonogram_solver_get_cell(solver, row, col);
             }
         }
 
+        nonogram_solver_destroy(solver);
         return board;
     }
 
@@ -112,6 +341,235 @@
             printf("\n");
         }
     }
+    /**
+     * @brief Print a line clue
+     * @param file The stream to print to
+     * @param clue The clue, terminated by 0
+     * @param length The length of the line
+     */
+    void print_clue(FILE *file, const int *clue, int length) {
+        if (length == 0 || clue[0] <= 0) {
+            fprintf(file, "-");
+        }
+        for (int i = 0; i < length && clue[i] > 0; i++) {
+            fprintf(file, i > 0 ? " %d" : "%d", clue[i]);
+        }
+    }
+
+    /**
+     * @brief Create the board violating the fewest clues of a nonogram hints object
+     * @param hints The nonogram hints object, possibly inconsistent
+     * @param seed The seed of the local search
+     * @param time_limit The time limit of the local search in seconds
+     * @return A 2D array representing the repaired game board, or NULL on failure
+     * @note The clues violated by the board are printed to stderr as suspects
+     */
+    int **nonogram_board_repair_from_hints(NonoGramHints *hints, unsigned long seed, double time_limit) {
+        int rows_count = hints->rows_count;
+        int cols_count = hints->cols_count;
+
+        int **board = (int **)malloc(rows_count * sizeof(int *));
+        bool *suspects = (bool *)malloc((rows_count + cols_count) * sizeof(bool));
+        if (!board || !suspects) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            free(board);
+            free(suspects);
+            return NULL;
+        }
+        for (int row = 0; row < rows_count; row++) {
+            board[row] = (int *)malloc(cols_count * sizeof(int));
+            if (!board[row]) {
+                fprintf(stderr, "Error: Memory allocation failed\n");
+                free_nonogram_board(board, row);
+                free(suspects);
+                return NULL;
+            }
+        }
+
+        int violations = nonogram_repair(hints, seed, time_limit, board, suspects);
+        if (violations < 0) {
+            fprintf(stderr, "Error: No board found in the time limit\n");
+            free_nonogram_board(board, rows_count);
+            free(suspects);
+            return NULL;
+        }
+
+        // Signaler les indices probablement faux avec ceux de la grille
+        NonoGramHints *repaired = nonogram_hints_create(board, rows_count, cols_count);
+        fprintf(stderr, "Violated clues: %d\n", violations);
+        for (int line = 0; line < rows_count + cols_count && repaired; line++) {
+            if (!suspects[line]) {
+                continue;
+            }
+            bool is_row = line < rows_count;
+            int index = is_row ? line : line - rows_count;
+            int length = is_row ? cols_count : rows_count;
+            fprintf(stderr, "Suspect %s %d: clue ", is_row ? "row" : "col", index);
+            print_clue(stderr, is_row ? hints->rows[index] : hints->cols[index], length);
+            fprintf(stderr, ", board ");
+            print_clue(stderr, is_row ? repaired->rows[index] : repaired->cols[index], length);
+            fprintf(stderr, "\n");
+        }
+        if (repaired) {
+            nonogram_hints_destroy(repaired);
+        }
+        free(suspects);
+        return board;
+    }
+
+    /**
+     * @brief Write a board to a PBM file
+     * @param filename The PBM file to write
+     * @param board The board
+     * @param rows_count The number of rows in the board
+     * @param cols_count The number of columns in the board
+     * @return true if the file has been written, false otherwise
+     */
+    bool write_board(const char *filename, int **board, int rows_count, int cols_count) {
+        FILE *file = fopen(filename, "w");
+        if (!file) {
+            fprintf(stderr, "Error: Unable to open file %s\n", filename);
+            return false;
+        }
+        int *data = (int *)malloc(rows_count * cols_count * sizeof(int));
+        if (!data) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            fclose(file);
+            return false;
+        }
+        for (int i = 0; i < rows_count; i++) {
+            memcpy(data + i * cols_count, board[i], cols_count * sizeof(int));
+        }
+        write_pbm_file(file, data, cols_count, rows_count, 1, 1, cols_count, 1);
+        free(data);
+        fclose(file);
+        return true;
+    }
+
+    /**
+     * @brief Compute the ambiguity mask of a nonogram hints object
+     * @param hints The nonogram hints object
+     * @return A 2D array where 1 marks the cells differing between solutions, or NULL if
+     *         the puzzle is unsolvable or the computation has been interrupted
+     * @note The number of cells fixed across all solutions is printed to stderr
+     */
+    int **nonogram_mask_from_hints(NonoGramHints *hints) {
+        int rows_count = hints->rows_count;
+        int cols_count = hints->cols_count;
+
+        NonoGramSolver *solver = nonogram_solver_create(hints);
+        if (!solver) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            return NULL;
+        }
+        nonogram_solver_set_cancel(solver, &interrupted);
+        if (nonogram_solver_backbone(solver) != NONOGRAM_SOLVER_SOLVED) {
+            nonogram_solver_destroy(solver);
+            return NULL;
+        }
+
+        int **mask = (int **)malloc(rows_count * sizeof(int *));
+        if (!mask) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+        }
+        int fixed = 0;
+        for (int row = 0; mask && row < rows_count; row++) {
+            mask[row] = (int *)malloc(cols_count * sizeof(int));
+            if (!mask[row]) {
+                fprintf(stderr, "Error: Memory allocation failed\n");
+                free_nonogram_board(mask, row);
+                mask = NULL;
+                break;
+            }
+            for (int col = 0; col < cols_count; col++) {
+                // Les cellules restées inconnues diffèrent entre les solutions
+                mask[row][col] = nonogram_solver_get_cell(solver, row, col) == -1;
+                fixed += !mask[row][col];
+            }
+        }
+        if (mask) {
+            fprintf(stderr, "Fixed cells: %d/%d\n", fixed, rows_count * cols_count);
+        }
+        nonogram_solver_destroy(solver);
+        return mask;
+    }
+
+    /**
+     * @brief Look a nonogram hints object up in a table of tiny puzzles
+     * @param hints The nonogram hints object
+     * @param filename The table file
+     * @param psolutions A pointer to the number of solutions, 2 for two or more, -1 if the
+     *        puzzle is not in the table
+     * @return A 2D array representing a solution, or NULL if there is none
+     * @note The number of solutions is printed to stderr
+     */
+    int **nonogram_board_from_table(NonoGramHints *hints, const char *filename, int *psolutions) {
+        int rows_count = hints->rows_count;
+        int cols_count = hints->cols_count;
+
+        *psolutions = -1;
+        NonoGramTable *table = nonogram_table_open(filename);
+        signed char *cells = malloc((size_t) rows_count * cols_count + 1);
+        if (table && cells) {
+            *psolutions = nonogram_table_lookup(table, hints, cells);
+        }
+        int **board = NULL;
+        if (*psolutions > 0) {
+            fprintf(stderr, "Solutions: %s%d\n", *psolutions > 1 ? "at least " : "", *psolutions);
+            board = (int **)malloc(rows_count * sizeof(int *));
+            for (int row = 0; board && row < rows_count; row++) {
+                board[row] = (int *)malloc(cols_count * sizeof(int));
+                if (!board[row]) {
+                    free_nonogram_board(board, row);
+                    board = NULL;
+                    break;
+                }
+                for (int col = 0; col < cols_count; col++) {
+                    board[row][col] = cells[row * cols_count + col];
+                }
+            }
+            if (!board) {
+                // La table ne sert plus, le solveur prend le relais
+                fprintf(stderr, "Error: Memory allocation failed\n");
+                *psolutions = -1;
+            }
+        }
+        free(cells);
+        if (table) {
+            nonogram_table_close(table);
+        }
+        return board;
+    }
+
+    /**
+     * @brief Parse the given cells of a JSON file
+     * @param hints The nonogram hints object, its given cells set
+     * @param given The JSON array of the given cells, a string of '0', '1'
+     *        or '.' per row
+     * @return false if the array is invalid or if memory allocation fails
+     */
+    static bool parse_given(NonoGramHints *hints, const cJSON *given) {
+        if (!cJSON_IsArray(given) || cJSON_GetArraySize(given) != hints->rows_count) {
+            return false;
+        }
+        signed char *cells = (signed char *)malloc((size_t)hints->rows_count * hints->cols_count);
+        if (!cells) {
+            return false;
+        }
+        bool valid = true;
+        for (int row = 0; valid && row < hints->rows_count; row++) {
+            const char *line = cJSON_GetStringValue(cJSON_GetArrayItem(given, row));
+            valid = line && strlen(line) == (size_t)hints->cols_count;
+            for (int col = 0; valid && col < hints->cols_count; col++) {
+                valid = line[col] == '0' || line[col] == '1' || line[col] == '.';
+                cells[row * hints->cols_count + col] = line[col] == '.' ? -1 : line[col] - '0';
+            }
+        }
+        valid = valid && nonogram_hints_set_given(hints, cells);
+        free(cells);
+        return valid;
+    }
+
     /**
      * @brief Parse a JSON file containing nonogram hints
      * @param filename The JSON file to parse
@@ -171,6 +629,7 @@
 
         hints->rows_count = cJSON_GetArraySize(rows);
         hints->cols_count = cJSON_GetArraySize(cols);
+        hints->given = NULL;
 
         // Allocate memory for row hints
         hints->rows = (int **)malloc(hints->rows_count * sizeof(int *));
@@ -242,6 +701,16 @@
             hints->cols[i][count] = 0; // Terminate with 0
         }
 
+        // Fill the given cells, which the parts written by nonogram-split rely on
+        cJSON *given = cJSON_GetObjectItem(root, "given");
+        if (given && !parse_given(hints, given)) {
+            fprintf(stderr, "Error: Invalid given cells\n");
+            cJSON_Delete(root);
+            free(json_content);
+            nonogram_hints_destroy(hints);
+            return NULL;
+        }
+
         // Free used memory
         cJSON_Delete(root);
         free(json_content);
@@ -257,30 +726,114 @@
      */
     int main(int argc, char *argv[]) {
         if (argc < 2) {
-            fprintf(stderr, "Usage: %s hints.json [--output solved.pbm]\n", argv[0]);
+            fprintf(stderr, "Usage: %s hints.json [--output solved.pbm] [--engine auto|line|dfs|probe|local] [--seed n] [--time-limit seconds] [--checkpoint file] [--checkpoint-interval seconds] [--repair] [--backbone] [--table file] [--verbose]\n"
+                            "       %s hints.json --all [--max n] [--format pbm|ndjson] [--output solutions]\n", argv[0], argv[0]);
             return EXIT_FAILURE;
         }
 
         const char *hints_file = argv[1];
         const char *output_file = NULL;
+        NonoGramEngine engine = NONOGRAM_ENGINE_AUTO;
+        unsigned long seed = 0;
+        double time_limit = 0.0;
+        const char *checkpoint = NULL;
+        double interval = CHECKPOINT_INTERVAL;
+        bool repair = false;
+        bool verbose = false;
+        bool backbone = false;
+        bool all = false;
+        long max = 0;
+        bool ndjson = false;
+        const char *table_file = NULL;
 
         // Parse command line arguments
         for (int i = 2; i < argc; i++) {
             if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
                 output_file = argv[i + 1];
                 i++;
+            } else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+                if (!nonogram_engine_from_string(argv[i + 1], &engine)) {
+                    fprintf(stderr, "Error: Unknown engine %s\n", argv[i + 1]);
+                    return EXIT_FAILURE;
+                }
+                i++;
+            } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+                seed = strtoul(argv[i + 1], NULL, 10);
+                i++;
+            } else if (strcmp(argv[i], "--time-limit") == 0 && i + 1 < argc) {
+                time_limit = strtod(argv[i + 1], NULL);
+                i++;
+            } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+                checkpoint = argv[i + 1];
+                i++;
+            } else if (strcmp(argv[i], "--checkpoint-interval") == 0 && i + 1 < argc) {
+                interval = strtod(argv[i + 1], NULL);
+                i++;
+            } else if (strcmp(argv[i], "--repair") == 0) {
+                repair = true;
+            } else if (strcmp(argv[i], "--verbose") == 0) {
+                verbose = true;
+            } else if (strcmp(argv[i], "--backbone") == 0) {
+                backbone = true;
+            } else if (strcmp(argv[i], "--table") == 0 && i + 1 < argc) {
+                table_file = argv[i + 1];
+                i++;
+            } else if (strcmp(argv[i], "--all") == 0) {
+                all = true;
+            } else if (strcmp(argv[i], "--max") == 0 && i + 1 < argc) {
+                max = strtol(argv[i + 1], NULL, 10);
+                all = true;
+                i++;
+            } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+                if (strcmp(argv[i + 1], "ndjson") != 0 && strcmp(argv[i + 1], "pbm") != 0) {
+                    fprintf(stderr, "Error: Unknown format %s\n", argv[i + 1]);
+                    return EXIT_FAILURE;
+                }
+                ndjson = strcmp(argv[i + 1], "ndjson") == 0;
+                i++;
             }
         }
+        // Ctrl-C ou un arrêt du service annule la résolution en cours
+        signal(SIGINT, on_interrupt);
+        signal(SIGTERM, on_interrupt);
+
         // Load hints from the JSON file
         NonoGramHints *hints = parse_json(hints_file);
         if (!hints) {
             return EXIT_FAILURE;
         }
 
-        int **board = nonogram_board_create_from_hints(hints);
-        if (board) {
-            print_board(board, hints->rows_count, hints->cols_count);
-            free_nonogram_board(board, hints->rows_count);
+        int status = EXIT_SUCCESS;
+        if (all) {
+            status = enumerate_solutions(hints, max > 0 ? max : 0, ndjson, output_file);
+        } else {
+            // Les petits puzzles sont d'abord cherchés dans la table
+            int solutions = -1;
+            int **board = table_file && !backbone && !repair
+                ? nonogram_board_from_table(hints, table_file, &solutions)
+                : NULL;
+            if (solutions < 0) {
+                board = backbone
+                    ? nonogram_mask_from_hints(hints)
+                    : repair
+                    ? nonogram_board_repair_from_hints(hints, seed, time_limit > 0 ? time_limit : REPAIR_TIME_LIMIT)
+                    : nonogram_board_create_from_hints(hints, engine, seed, time_limit, checkpoint, interval, verbose);
+            }
+            if (board) {
+                if (output_file) {
+                    if (!write_board(output_file, board, hints->rows_count, hints->cols_count)) {
+                        status = EXIT_FAILURE;
+                    }
+                } else {
+                    print_board(board, hints->rows_count, hints->cols_count);
+                }
+                free_nonogram_board(board, hints->rows_count);
+            } else if (atomic_load(&interrupted)) {
+                status = EXIT_FAILURE;
+            } else {
+                fprintf(stderr, repair ? "Unrepairable puzzle\n" : "Unsolvable puzzle (try --repair)\n");
+                status = EXIT_FAILURE;
+            }
         }
 
         // Libérer la mémoire allouée pour les hints
@@ -295,5 +848,5 @@
         free(hints->cols);
 
         free(hints);
-        return 0;
+        return status;
     }
\ No newline at end of file
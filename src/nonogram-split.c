@@ -0,0 +1,329 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+/**
+ * @file nonogram-split.c
+ * @brief Split the search of a puzzle into sub-puzzles and merge results.
+ *
+ * split cuts the depth-first search of a puzzle at a given number of
+ * decisions, cube-and-conquer style: every leaf not refuted by propagation
+ * becomes a sub-puzzle file, the hints of the puzzle with the cells settled
+ * in the leaf as given cells. Each solution of the puzzle solves exactly one
+ * sub-puzzle. The files are written with batched I/O in a directory, or
+ * spread over several part directories so that hosts sharing a filesystem
+ * can each solve a part, for instance with nonogram-shard.
+ *
+ * merge reads the JSON lines of the results of the sub-puzzles and outputs
+ * the result of the puzzle: the board of a solved sub-puzzle, failed if
+ * every sub-puzzle has failed, stopped otherwise. More than one solved
+ * sub-puzzle means that the puzzle has several solutions.
+ */
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "./cJSON.h"
+#include "./loader.h"
+#include "./nonogram.h"
+#include "./solver.h"
+
+/**
+ * @brief Default number of decisions fixing a sub-puzzle
+ */
+#define SPLIT_DEPTH 8
+
+/**
+ * @brief Number of files written at once
+ */
+#define WRITE_DEPTH 64
+
+/**
+ * Split holds the sub-puzzles being created.
+ */
+typedef struct {
+  NonoGramHints *hints;  // Hints of the puzzle
+  const char *output;    // Output directory
+  int parts;             // Number of part directories, 0 for none
+  char **names;          // Names of the files
+  char **contents;       // Contents of the files
+  size_t *lengths;       // Lengths of the contents
+  long count;            // Number of sub-puzzles
+  long capacity;         // Size of the arrays
+  bool failed;           // Whether memory allocation has failed
+} Split;
+
+/**
+ * @brief Read a whole file
+ * @param filename The name of the file
+ * @param plength A pointer to the length of the content
+ * @return The content of the file, or NULL if it cannot be read
+ */
+static char *_read_file(const char *filename, size_t *plength) {
+  FILE *file = fopen(filename, "rb");
+  if (!file) {
+    return NULL;
+  }
+  char *content = NULL;
+  if (fseek(file, 0, SEEK_END) == 0) {
+    long length = ftell(file);
+    content = length >= 0 ? malloc(length + 1) : NULL;
+    if (content) {
+      rewind(file);
+      *plength = fread(content, 1, length, file);
+      content[*plength] = '\0';
+    }
+  }
+  fclose(file);
+  return content;
+}
+
+/**
+ * @brief Create the file of a sub-puzzle
+ * @param cells The cells settled in the sub-puzzle
+ * @param data The split
+ * @return false if memory allocation fails
+ */
+static bool _add(const signed char *cells, void *data) {
+  Split *split = data;
+  if (split->count == split->capacity) {
+    long capacity = split->capacity ? 2 * split->capacity : 64;
+    char **names = realloc(split->names, capacity * sizeof(char *));
+    if (names) {
+      split->names = names;
+    }
+    char **contents = realloc(split->contents, capacity * sizeof(char *));
+    if (contents) {
+      split->contents = contents;
+    }
+    size_t *lengths = realloc(split->lengths, capacity * sizeof(size_t));
+    if (lengths) {
+      split->lengths = lengths;
+    }
+    if (!names || !contents || !lengths) {
+      split->failed = true;
+      return false;
+    }
+    split->capacity = capacity;
+  }
+  const char *string = nonogram_hints_set_given(split->hints, cells)
+    ? nonogram_hints_to_string(split->hints)
+    : NULL;
+  size_t length = string ? strlen(string) : 0;
+  char *name = malloc(strlen(split->output) + 64);
+  char *content = string ? malloc(length + 2) : NULL;
+  if (!name || !content) {
+    free(name);
+    free(content);
+    split->failed = true;
+    return false;
+  }
+  long id = split->count;
+  if (split->parts) {
+    sprintf(name, "%s/part-%03ld/%08ld.json", split->output,
+            id % split->parts, id);
+  } else {
+    sprintf(name, "%s/%08ld.json", split->output, id);
+  }
+  memcpy(content, string, length);
+  content[length] = '\n';
+  content[length + 1] = '\0';
+  split->names[id] = name;
+  split->contents[id] = content;
+  split->lengths[id] = length + 1;
+  split->count++;
+  return true;
+}
+
+/**
+ * @brief Create a directory
+ * @param path The path of the directory
+ * @return false if it cannot be created and does not exist
+ */
+static bool _make_directory(const char *path) {
+  return !mkdir(path, 0777) || errno == EEXIST;
+}
+
+/**
+ * @brief Split a puzzle into sub-puzzle files
+ * @param filename The hints object or the PBM image of the puzzle
+ * @param output The output directory
+ * @param depth The number of decisions fixing a sub-puzzle
+ * @param parts The number of part directories, 0 for none
+ * @return EXIT_SUCCESS if the files have been written
+ */
+static int _split(
+  const char *filename,
+  const char *output,
+  int depth,
+  int parts
+) {
+  size_t length = 0;
+  char *content = _read_file(filename, &length);
+  if (!content) {
+    fprintf(stderr, "Error: Unable to open file %s\n", filename);
+    return EXIT_FAILURE;
+  }
+  NonoGramHints *hints = length && content[0] == 'P'
+    ? nonogram_hints_parse_pbm(content, length)
+    : nonogram_hints_parse(content, length);
+  free(content);
+  if (!hints) {
+    fprintf(stderr, "Error: Invalid puzzle %s\n", filename);
+    return EXIT_FAILURE;
+  }
+  NonoGramSolver *solver = nonogram_solver_create(hints);
+  Split split = {.hints = hints, .output = output, .parts = parts};
+  long count = solver
+    ? nonogram_solver_split(solver, depth, _add, &split)
+    : -1;
+  int status = EXIT_SUCCESS;
+  if (count < 0 || split.failed) {
+    fprintf(stderr, "Error: Memory allocation failed\n");
+    status = EXIT_FAILURE;
+  }
+  bool created = status == EXIT_SUCCESS && _make_directory(output);
+  char path[4096];
+  for (int part = 0; created && part < parts; part++) {
+    snprintf(path, sizeof path, "%s/part-%03d", output, part);
+    created = _make_directory(path);
+  }
+  if (status == EXIT_SUCCESS && !created) {
+    fprintf(stderr, "Error: Unable to create directory %s\n", output);
+    status = EXIT_FAILURE;
+  }
+  if (status == EXIT_SUCCESS) {
+    NonoGramLoader *loader = nonogram_loader_create(WRITE_DEPTH, true);
+    if (!loader
+        || nonogram_loader_write(
+             loader, (const char *const *) split.names,
+             (const char *const *) split.contents, split.lengths,
+             split.count) != split.count) {
+      fprintf(stderr, "Error: Unable to write the sub-puzzles\n");
+      status = EXIT_FAILURE;
+    } else {
+      // The solver is left with the cells settled before splitting
+      int rows_count = nonogram_hints_get_rows_count(hints);
+      int cols_count = nonogram_hints_get_cols_count(hints);
+      int settled = 0;
+      for (int cell = 0; cell < rows_count * cols_count; cell++) {
+        settled += nonogram_solver_get_cell(
+          solver, cell / cols_count, cell % cols_count) >= 0;
+      }
+      fprintf(stderr, "sub-puzzles %ld  settled %d/%d\n", split.count,
+              settled, rows_count * cols_count);
+    }
+    if (loader) {
+      nonogram_loader_destroy(loader);
+    }
+  }
+
+  for (long id = 0; id < split.count; id++) {
+    free(split.names[id]);
+    free(split.contents[id]);
+  }
+  free(split.names);
+  free(split.contents);
+  free(split.lengths);
+  nonogram_hints_to_string(NULL);
+  if (solver) {
+    nonogram_solver_destroy(solver);
+  }
+  nonogram_hints_destroy(hints);
+  return status;
+}
+
+/**
+ * @brief Merge the results of sub-puzzles
+ * @param filenames The JSON lines files of the results
+ * @param count The number of files
+ * @return EXIT_SUCCESS if a sub-puzzle has been solved
+ */
+static int _merge(char *const *filenames, int count) {
+  long results = 0;
+  long solved = 0;
+  long failed = 0;
+  cJSON *board = NULL;
+  char *line = NULL;
+  size_t capacity = 0;
+  for (int index = 0; index < count; index++) {
+    FILE *file = fopen(filenames[index], "r");
+    if (!file) {
+      fprintf(stderr, "Error: Unable to open file %s\n", filenames[index]);
+      free(line);
+      cJSON_Delete(board);
+      return EXIT_FAILURE;
+    }
+    while (getline(&line, &capacity, file) > 0) {
+      cJSON *result = cJSON_Parse(line);
+      cJSON *status = cJSON_GetObjectItem(result, "status");
+      if (!cJSON_IsString(status)) {
+        cJSON_Delete(result);
+        continue;
+      }
+      results++;
+      if (strcmp(status->valuestring, "solved") == 0) {
+        if (!solved++) {
+          board = cJSON_DetachItemFromObject(result, "board");
+        }
+      } else if (strcmp(status->valuestring, "failed") == 0) {
+        failed++;
+      }
+      cJSON_Delete(result);
+    }
+    fclose(file);
+  }
+  free(line);
+
+  const char *status = solved ? "solved"
+    : results && failed == results ? "failed"
+    : "stopped";
+  printf("{\"status\":\"%s\",\"sub-puzzles\":%ld,\"solved\":%ld",
+         status, results, solved);
+  if (board) {
+    char *rows = cJSON_PrintUnformatted(board);
+    if (rows) {
+      printf(",\"board\":%s", rows);
+      free(rows);
+    }
+    cJSON_Delete(board);
+  }
+  printf("}\n");
+  return solved ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    fprintf(stderr,
+            "Usage: %s split hints.json|image.pbm directory [--depth n] "
+            "[--parts n]\n"
+            "       %s merge results.ndjson...\n",
+            argv[0], argv[0]);
+    return EXIT_FAILURE;
+  }
+  const char *command = argv[1];
+  if (strcmp(command, "merge") == 0) {
+    return _merge(argv + 2, argc - 2);
+  }
+  if (strcmp(command, "split") != 0) {
+    fprintf(stderr, "Error: Unknown command %s\n", command);
+    return EXIT_FAILURE;
+  }
+  if (argc < 4) {
+    fprintf(stderr, "Error: Missing directory\n");
+    return EXIT_FAILURE;
+  }
+  int depth = SPLIT_DEPTH;
+  int parts = 0;
+  for (int i = 4; i < argc; i++) {
+    if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc) {
+      depth = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--parts") == 0 && i + 1 < argc) {
+      parts = atoi(argv[++i]);
+    }
+  }
+  return _split(argv[2], argv[3], depth > 0 ? depth : 0,
+                parts > 1 ? parts : 0);
+}
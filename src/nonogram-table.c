@@ -0,0 +1,112 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+/**
+ * @file nonogram-table.c
+ * @brief Build and query the table of the solutions of tiny puzzles.
+ *
+ * build enumerates every board up to a size and writes the table file; the
+ * table target runs it with the NONOGRAM_TABLE_SIZE option. lookup reads hints
+ * objects, one per line, and outputs for each one whether it is unique,
+ * ambiguous, failed or absent from the table, with the time per lookup on
+ * stderr.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "./nonogram.h"
+#include "./table.h"
+
+/**
+ * @brief Get the time of a monotonic clock
+ * @return The time in seconds
+ */
+static double _now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Look puzzles up in a table
+ * @param filename The table file
+ * @param file The hints objects, one per line
+ * @return EXIT_SUCCESS if the table can be read
+ */
+static int _lookup(const char *filename, FILE *file) {
+  NonoGramTable *table = nonogram_table_open(filename);
+  if (!table || !nonogram_table_get_size(table)) {
+    fprintf(stderr, "Error: Invalid table %s\n", filename);
+    if (table) {
+      nonogram_table_close(table);
+    }
+    return EXIT_FAILURE;
+  }
+  static const char *const names[] = {
+    "absent", "failed", "unique", "ambiguous"
+  };
+  signed char cells[NONOGRAM_TABLE_SIZE_MAX * NONOGRAM_TABLE_SIZE_MAX];
+  long counts[4] = {0};
+  double elapsed = 0.0;
+  char *line = NULL;
+  size_t capacity = 0;
+  ssize_t length;
+  while ((length = getline(&line, &capacity, file)) > 0) {
+    NonoGramHints *hints = nonogram_hints_parse(line, length);
+    if (!hints) {
+      continue;
+    }
+    double start = _now();
+    int solutions = nonogram_table_lookup(table, hints, cells);
+    elapsed += _now() - start;
+    counts[solutions + 1]++;
+    printf("%s\n", names[solutions + 1]);
+    nonogram_hints_destroy(hints);
+  }
+  free(line);
+  long total = counts[0] + counts[1] + counts[2] + counts[3];
+  fprintf(stderr,
+          "puzzles %ld  unique %ld  ambiguous %ld  failed %ld  absent %ld  "
+          "ns/lookup %.0f\n",
+          total, counts[2], counts[3], counts[1], counts[0],
+          total ? elapsed * 1e9 / total : 0.0);
+  nonogram_table_close(table);
+  return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 4 || (strcmp(argv[1], "build") && strcmp(argv[1], "lookup"))) {
+    fprintf(stderr,
+            "Usage: %s build size table\n"
+            "       %s lookup table hints.ndjson|-\n",
+            argv[0], argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (strcmp(argv[1], "lookup") == 0) {
+    FILE *file = strcmp(argv[3], "-") ? fopen(argv[3], "r") : stdin;
+    if (!file) {
+      fprintf(stderr, "Error: Unable to open file %s\n", argv[3]);
+      return EXIT_FAILURE;
+    }
+    int status = _lookup(argv[2], file);
+    if (file != stdin) {
+      fclose(file);
+    }
+    return status;
+  }
+  int size = atoi(argv[2]);
+  if (size < 1 || size > NONOGRAM_TABLE_SIZE_MAX) {
+    fprintf(stderr, "Error: The size must be between 1 and %d\n",
+            NONOGRAM_TABLE_SIZE_MAX);
+    return EXIT_FAILURE;
+  }
+  double start = _now();
+  if (!nonogram_table_write(argv[3], size)) {
+    fprintf(stderr, "Error: Unable to write the table %s\n", argv[3]);
+    return EXIT_FAILURE;
+  }
+  fprintf(stderr, "table %dx%d  time %.3fs\n", size, size, _now() - start);
+  return EXIT_SUCCESS;
+}
@@ -38,6 +38,7 @@ static NonoGramHints *_nonogram_hints_new(int rows_count, int cols_count) {
   if (!hints) {
     return NULL;
   }
+  hints->given = NULL;
   hints->rows = malloc(rows_count * sizeof(int *));
   if (!hints->rows) {
     free(hints);
@@ -172,9 +173,438 @@ void nonogram_hints_destroy(NonoGramHints *hints) {
   }
   free(hints->rows);
   free(hints->cols);
+  free(hints->given);
   free(hints);
 }
 
+/**
+ * @brief Create a nonogram hints object with empty clues
+ *
+ * @param rows_count Number of rows in the board
+ * @param cols_count Number of columns in the board
+ * @return A pointer to the created nonogram hints object, or NULL if
+ *         memory allocation fails.
+ */
+NonoGramHints *nonogram_hints_create_empty(int rows_count, int cols_count) {
+  NonoGramHints *hints = _nonogram_hints_new(rows_count, cols_count);
+  if (hints) {
+    hints->rows_count = rows_count;
+    hints->cols_count = cols_count;
+  }
+  return hints;
+}
+
+/**
+ * @brief Set the given cells of a nonogram hints object
+ *
+ * @param hints The nonogram hints object
+ * @param cells The cells, or NULL to remove the given cells
+ * @return false if memory allocation fails
+ */
+bool nonogram_hints_set_given(NonoGramHints *hints, const signed char *cells) {
+  if (!cells) {
+    free(hints->given);
+    hints->given = NULL;
+    return true;
+  }
+  size_t size = (size_t) hints->rows_count * hints->cols_count;
+  if (!hints->given) {
+    hints->given = malloc(size);
+    if (!hints->given) {
+      return false;
+    }
+  }
+  memcpy(hints->given, cells, size);
+  return true;
+}
+
+/**
+ * @brief Get a given cell of a nonogram hints object
+ *
+ * @param hints The nonogram hints object
+ * @param row The row index
+ * @param col The col index
+ * @return The value of the cell, -1 if it is not given
+ */
+int nonogram_hints_get_given(NonoGramHints *hints, int row, int col) {
+  assert(row < hints->rows_count);
+  assert(col < hints->cols_count);
+  return hints->given ? hints->given[row * hints->cols_count + col] : -1;
+}
+
+/**
+ * @brief Skip the white spaces of a JSON string
+ *
+ * @param pstring A pointer to the current position
+ * @param end The end of the string
+ */
+static void _skip_spaces(const char **pstring, const char *end) {
+  while (*pstring < end
+         && (**pstring == ' ' || **pstring == '\t' || **pstring == '\n'
+             || **pstring == '\r')) {
+    (*pstring)++;
+  }
+}
+
+/**
+ * @brief Consume a character of a JSON string
+ *
+ * @param pstring A pointer to the current position
+ * @param end The end of the string
+ * @param expected The expected character
+ * @return true if the next non white space character is the expected one
+ */
+static bool _expect(const char **pstring, const char *end, char expected) {
+  _skip_spaces(pstring, end);
+  if (*pstring < end && **pstring == expected) {
+    (*pstring)++;
+    return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Skip a JSON string
+ *
+ * @param pstring A pointer to the opening quote
+ * @param end The end of the string
+ * @return true if the string is terminated
+ */
+static bool _skip_string(const char **pstring, const char *end) {
+  const char *string = *pstring + 1;
+  while (string < end && *string != '"') {
+    string += *string == '\\' ? 2 : 1;
+  }
+  if (string >= end) {
+    return false;
+  }
+  *pstring = string + 1;
+  return true;
+}
+
+/**
+ * @brief Skip a JSON value
+ *
+ * @param pstring A pointer to the current position
+ * @param end The end of the string
+ * @return true if a complete value has been skipped
+ */
+static bool _skip_value(const char **pstring, const char *end) {
+  int depth = 0;
+  _skip_spaces(pstring, end);
+  while (*pstring < end) {
+    char c = **pstring;
+    if (c == '"') {
+      if (!_skip_string(pstring, end)) {
+        return false;
+      }
+      continue;
+    }
+    if (!depth && (c == ',' || c == '}' || c == ']')) {
+      return true;
+    }
+    if (c == '[' || c == '{') {
+      depth++;
+    } else if (c == ']' || c == '}') {
+      depth--;
+    }
+    (*pstring)++;
+  }
+  return false;
+}
+
+/**
+ * @brief Parse a JSON array of clues
+ *
+ * This function counts the clues of the array and, if lines is not NULL,
+ * fills them, checking that every clue fits in its line.
+ *
+ * @param pstring A pointer to the current position
+ * @param end The end of the string
+ * @param lines The clues to fill, or NULL
+ * @param length The length of the lines
+ * @param pcount A pointer to the number of lines
+ * @return true if the array is valid
+ */
+static bool _parse_clues(
+  const char **pstring,
+  const char *end,
+  int **lines,
+  int length,
+  int *pcount
+) {
+  int count = 0;
+  if (!_expect(pstring, end, '[')) {
+    return false;
+  }
+  if (_expect(pstring, end, ']')) {
+    *pcount = 0;
+    return true;
+  }
+  do {
+    if (!_expect(pstring, end, '[')) {
+      return false;
+    }
+    int index = 0;
+    int used = 0;
+    if (!_expect(pstring, end, ']')) {
+      do {
+        _skip_spaces(pstring, end);
+        int value = 0;
+        const char *start = *pstring;
+        while (*pstring < end && **pstring >= '0' && **pstring <= '9'
+               && value <= 1000000) {
+          value = value * 10 + (**pstring - '0');
+          (*pstring)++;
+        }
+        if (*pstring == start) {
+          return false;
+        }
+        if (value && lines) {
+          used += index ? value + 1 : value;
+          if (used > length) {
+            return false;
+          }
+          lines[count][index++] = value;
+        }
+      } while (_expect(pstring, end, ','));
+      if (!_expect(pstring, end, ']')) {
+        return false;
+      }
+    }
+    count++;
+  } while (_expect(pstring, end, ','));
+  *pcount = count;
+  return _expect(pstring, end, ']');
+}
+
+/**
+ * @brief Parse a JSON array of given cells
+ *
+ * @param pstring A pointer to the current position
+ * @param end The end of the string
+ * @param cells The cells to fill, rows first
+ * @param rows_count The number of rows
+ * @param cols_count The number of columns
+ * @return true if the array has a string of cols_count cells per row
+ */
+static bool _parse_given(
+  const char **pstring,
+  const char *end,
+  signed char *cells,
+  int rows_count,
+  int cols_count
+) {
+  if (!_expect(pstring, end, '[')) {
+    return false;
+  }
+  for (int row = 0; row < rows_count; row++) {
+    if ((row && !_expect(pstring, end, ','))
+        || !_expect(pstring, end, '"')
+        || end - *pstring <= cols_count) {
+      return false;
+    }
+    for (int col = 0; col < cols_count; col++) {
+      char c = *(*pstring)++;
+      if (c != '0' && c != '1' && c != '.') {
+        return false;
+      }
+      *cells++ = c == '.' ? -1 : c - '0';
+    }
+    if (*(*pstring)++ != '"') {
+      return false;
+    }
+  }
+  return _expect(pstring, end, ']');
+}
+
+/**
+ * @brief Parse a nonogram hints object from its JSON representation
+ *
+ * The string is scanned once to find and count the clues of the rows and
+ * of the columns, then the clues and the given cells are parsed into the
+ * new object.
+ *
+ * @param string The JSON object
+ * @param length The length of the string
+ * @return A pointer to the created nonogram hints object, or NULL if the
+ *         string is invalid or if memory allocation fails.
+ */
+NonoGramHints *nonogram_hints_parse(const char *string, size_t length) {
+  const char *end = string + length;
+  const char *rows = NULL;
+  const char *cols = NULL;
+  const char *given = NULL;
+  int rows_count = 0;
+  int cols_count = 0;
+  if (!_expect(&string, end, '{')) {
+    return NULL;
+  }
+  if (!_expect(&string, end, '}')) {
+    do {
+      _skip_spaces(&string, end);
+      const char *key = string;
+      if (string >= end || *string != '"' || !_skip_string(&string, end)) {
+        return NULL;
+      }
+      size_t key_length = string - key;
+      if (!_expect(&string, end, ':')) {
+        return NULL;
+      }
+      _skip_spaces(&string, end);
+      if (key_length == 6 && strncmp(key, "\"rows\"", 6) == 0) {
+        rows = string;
+        if (!_parse_clues(&string, end, NULL, 0, &rows_count)) {
+          return NULL;
+        }
+      } else if (key_length == 6 && strncmp(key, "\"cols\"", 6) == 0) {
+        cols = string;
+        if (!_parse_clues(&string, end, NULL, 0, &cols_count)) {
+          return NULL;
+        }
+      } else if (key_length == 7 && strncmp(key, "\"given\"", 7) == 0) {
+        given = string;
+        if (!_skip_value(&string, end)) {
+          return NULL;
+        }
+      } else if (!_skip_value(&string, end)) {
+        return NULL;
+      }
+    } while (_expect(&string, end, ','));
+    if (!_expect(&string, end, '}')) {
+      return NULL;
+    }
+  }
+  if (!rows || !cols) {
+    return NULL;
+  }
+  NonoGramHints *hints = nonogram_hints_create_empty(rows_count, cols_count);
+  if (!hints) {
+    return NULL;
+  }
+  if (!_parse_clues(&rows, end, hints->rows, cols_count, &rows_count)
+      || !_parse_clues(&cols, end, hints->cols, rows_count, &cols_count)) {
+    nonogram_hints_destroy(hints);
+    return NULL;
+  }
+  if (given) {
+    hints->given = malloc((size_t) rows_count * cols_count);
+    if (!hints->given
+        || !_parse_given(
+          &given, end, hints->given, rows_count, cols_count)) {
+      nonogram_hints_destroy(hints);
+      return NULL;
+    }
+  }
+  return hints;
+}
+
+/**
+ * @brief Largest dimension of a PBM image
+ */
+#define PBM_MAX_DIMENSION 4096
+
+/**
+ * @brief Skip the white spaces and comments of a PBM header
+ *
+ * @param pstring A pointer to the current position
+ * @param end The end of the string
+ */
+static void _pbm_skip(const char **pstring, const char *end) {
+  for (;;) {
+    _skip_spaces(pstring, end);
+    if (*pstring >= end || **pstring != '#') {
+      return;
+    }
+    while (*pstring < end && **pstring != '\n') {
+      (*pstring)++;
+    }
+  }
+}
+
+/**
+ * @brief Parse a dimension of a PBM header
+ *
+ * @param pstring A pointer to the current position
+ * @param end The end of the string
+ * @param value The dimension
+ * @return true if a positive dimension has been parsed
+ */
+static bool _pbm_dimension(const char **pstring, const char *end, int *value) {
+  _pbm_skip(pstring, end);
+  *value = 0;
+  const char *start = *pstring;
+  while (*pstring < end && **pstring >= '0' && **pstring <= '9'
+         && *value <= PBM_MAX_DIMENSION) {
+    *value = *value * 10 + (**pstring - '0');
+    (*pstring)++;
+  }
+  return *pstring > start && *value > 0 && *value <= PBM_MAX_DIMENSION;
+}
+
+/**
+ * @brief Create a nonogram hints object from the board of a PBM image
+ *
+ * The header is parsed, then the pixels of the plain format, one character
+ * each, or of the raw format, eight per byte with padded rows.
+ *
+ * @param string The image
+ * @param length The length of the image
+ * @return A pointer to the created nonogram hints object, or NULL if the
+ *         image is invalid or if memory allocation fails.
+ */
+NonoGramHints *nonogram_hints_parse_pbm(const char *string, size_t length) {
+  const char *end = string + length;
+  _pbm_skip(&string, end);
+  if (end - string < 2 || string[0] != 'P'
+      || (string[1] != '1' && string[1] != '4')) {
+    return NULL;
+  }
+  bool raw = string[1] == '4';
+  string += 2;
+  int cols_count;
+  int rows_count;
+  if (!_pbm_dimension(&string, end, &cols_count)
+      || !_pbm_dimension(&string, end, &rows_count)) {
+    return NULL;
+  }
+  int *cells = malloc((size_t) rows_count * cols_count * sizeof(int));
+  int **board = malloc(rows_count * sizeof(int *));
+  bool valid = cells && board;
+  if (raw) {
+    // A single white space separates the header from the pixels
+    size_t row_size = (cols_count + 7) / 8;
+    string++;
+    valid = valid && string <= end
+      && (size_t) (end - string) >= row_size * rows_count;
+    for (int row = 0; valid && row < rows_count; row++) {
+      const unsigned char *bytes =
+        (const unsigned char *) string + row * row_size;
+      for (int col = 0; col < cols_count; col++) {
+        cells[row * cols_count + col] = (bytes[col / 8] >> (7 - col % 8)) & 1;
+      }
+    }
+  } else {
+    for (int cell = 0; valid && cell < rows_count * cols_count; cell++) {
+      _pbm_skip(&string, end);
+      valid = string < end && (*string == '0' || *string == '1');
+      if (valid) {
+        cells[cell] = *string++ - '0';
+      }
+    }
+  }
+  NonoGramHints *hints = NULL;
+  if (valid) {
+    for (int row = 0; row < rows_count; row++) {
+      board[row] = cells + row * cols_count;
+    }
+    hints = nonogram_hints_create(board, rows_count, cols_count);
+  }
+  free(board);
+  free(cells);
+  return hints;
+}
+
 /**
  * @brief Get the number of rows in a nonogram hints object
  * 
@@ -327,7 +757,141 @@ const char *nonogram_hints_to_string(NonoGramHints *hints) {
   }
   _ADD_STRING(&string, &length, "]");
 
+  if (hints->given) {
+    _ADD_STRING(&string, &length, ",\"given\":[");
+    const signed char *cell = hints->given;
+    for (int row = 0; row < hints->rows_count; row++) {
+      char line[hints->cols_count + 4];
+      char *character = line;
+      if (row > 0) {
+        *character++ = ',';
+      }
+      *character++ = '"';
+      for (int col = 0; col < hints->cols_count; col++, cell++) {
+        *character++ = *cell < 0 ? '.' : '0' + *cell;
+      }
+      *character++ = '"';
+      *character = '\0';
+      _ADD_STRING(&string, &length, line);
+    }
+    _ADD_STRING(&string, &length, "]");
+  }
+
   _ADD_STRING(&string, &length, "}");
 
   return string;
 }
+
+/**
+ * @brief FNV-1a offset basis
+ */
+#define FNV_OFFSET 14695981039346656037ULL
+
+/**
+ * @brief FNV-1a prime
+ */
+#define FNV_PRIME 1099511628211ULL
+
+/**
+ * @brief Add an integer to a FNV-1a hash
+ *
+ * The integer is hashed as 4 little-endian bytes, whatever the platform.
+ *
+ * @param hash The current hash
+ * @param value The integer
+ * @return The new hash
+ */
+static uint64_t _hash_int(uint64_t hash, int value) {
+  for (int shift = 0; shift < 32; shift += 8) {
+    hash ^= (uint64_t) (((unsigned int) value >> shift) & 0xff);
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+/**
+ * @brief Add the clues of lines to a FNV-1a hash
+ *
+ * @param hash The current hash
+ * @param lines The clues of the lines
+ * @param count The number of lines
+ * @param length The length of the lines
+ * @return The new hash
+ */
+static uint64_t _hash_lines(uint64_t hash, int **lines, int count, int length) {
+  for (int line = 0; line < count; line++) {
+    for (int index = 0; index < length && lines[line][index]; index++) {
+      hash = _hash_int(hash, lines[line][index]);
+    }
+    hash = _hash_int(hash, 0);
+  }
+  return hash;
+}
+
+/**
+ * @brief Hash the clues of a nonogram hints object
+ *
+ * Hints without given cells keep the hash of their clues alone.
+ *
+ * @param hints The nonogram hints object
+ * @return A 64-bit FNV-1a hash of the size, of the clues and of the given
+ *         cells
+ */
+uint64_t nonogram_hints_hash(NonoGramHints *hints) {
+  uint64_t hash = FNV_OFFSET;
+  hash = _hash_int(hash, hints->rows_count);
+  hash = _hash_int(hash, hints->cols_count);
+  hash = _hash_lines(hash, hints->rows, hints->rows_count, hints->cols_count);
+  hash = _hash_lines(hash, hints->cols, hints->cols_count, hints->rows_count);
+  if (hints->given) {
+    size_t size = (size_t) hints->rows_count * hints->cols_count;
+    for (size_t cell = 0; cell < size; cell++) {
+      hash = _hash_int(hash, hints->given[cell]);
+    }
+  }
+  return hash;
+}
+
+/**
+ * @brief Compare the clues of lines
+ *
+ * @param lines The clues of the first lines
+ * @param others The clues of the second lines
+ * @param count The number of lines
+ * @param length The length of the lines
+ * @return true if the clues are equal
+ */
+static bool _lines_equal(int **lines, int **others, int count, int length) {
+  for (int line = 0; line < count; line++) {
+    for (int index = 0; index < length; index++) {
+      if (lines[line][index] != others[line][index]) {
+        return false;
+      }
+      if (!lines[line][index]) {
+        break;
+      }
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Compare the clues of two nonogram hints objects
+ *
+ * @param hints The first nonogram hints object
+ * @param other The second nonogram hints object
+ * @return true if both objects have the same size, the same clues and the
+ *         same given cells
+ */
+bool nonogram_hints_equal(NonoGramHints *hints, NonoGramHints *other) {
+  return hints->rows_count == other->rows_count
+    && hints->cols_count == other->cols_count
+    && _lines_equal(
+      hints->rows, other->rows, hints->rows_count, hints->cols_count)
+    && _lines_equal(
+      hints->cols, other->cols, hints->cols_count, hints->rows_count)
+    && !hints->given == !other->given
+    && (!hints->given
+        || !memcmp(hints->given, other->given,
+                   (size_t) hints->rows_count * hints->cols_count));
+}
@@ -4,6 +4,8 @@
 // Licensed under the BSD-3 License. See the LICENSE file for details.
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "./pnmio.h"
 
 /**
@@ -30,6 +32,63 @@ extern NonoGramHints *nonogram_hints_create(
  * @note This function frees the memory allocated for the nonogram hints object
  */
 extern void nonogram_hints_destroy(NonoGramHints *hints);
+/**
+ * @brief Create a nonogram hints object with empty clues
+ * @param rows_count Number of rows in the board
+ * @param cols_count Number of columns in the board
+ * @return A new nonogram hints object, or NULL if memory allocation fails
+ * @note The clues are zero-terminated arrays filled through nonogram.inc
+ */
+extern NonoGramHints *nonogram_hints_create_empty(
+  int rows_count,
+  int cols_count
+);
+/**
+ * @brief Parse a nonogram hints object from its JSON representation
+ * @param string The JSON object, with "rows" and "cols" arrays of clues
+ *        and an optional "given" array of rows, strings of '1' for filled,
+ *        '0' for empty and '.' for unknown cells
+ * @param length The length of the string
+ * @return A new nonogram hints object, or NULL if the string is invalid, if
+ *         a clue does not fit in its line or if memory allocation fails
+ * @note The string does not need to be null-terminated, other keys are
+ *       ignored
+ */
+extern NonoGramHints *nonogram_hints_parse(const char *string, size_t length);
+/**
+ * @brief Create a nonogram hints object from the board of a PBM image
+ * @param string The image, plain (P1) or raw (P4), black cells being filled
+ * @param length The length of the image
+ * @return A new nonogram hints object, or NULL if the image is invalid or if
+ *         memory allocation fails
+ */
+extern NonoGramHints *nonogram_hints_parse_pbm(
+  const char *string,
+  size_t length
+);
+
+/**
+ * @brief Set the given cells of a nonogram hints object
+ * @param hints The nonogram hints object
+ * @param cells The cells, rows first: 1 filled, 0 empty, -1 unknown; or
+ *        NULL to remove the given cells
+ * @return false if memory allocation fails
+ * @note Given cells are settled before a solve starts, so that a part of
+ *       the search of a puzzle can be solved as a puzzle of its own
+ */
+extern bool nonogram_hints_set_given(
+  NonoGramHints *hints,
+  const signed char *cells
+);
+/**
+ * @brief Get a given cell of a nonogram hints object
+ * @param hints The nonogram hints object
+ * @param row The row index
+ * @param col The col index
+ * @return 1 if the cell is given filled, 0 if it is given empty, -1 if it is
+ *         not given
+ */
+extern int nonogram_hints_get_given(NonoGramHints *hints, int row, int col);
 
 /**
  * @brief Get the number of rows in the nonogram hints object
@@ -83,5 +142,22 @@ extern int nonogram_hints_get_col_value(
  */
 extern const char *nonogram_hints_to_string(NonoGramHints *hints);
 
+/**
+ * @brief Hash the clues of a nonogram hints object
+ * @param hints The nonogram hints object
+ * @return A 64-bit FNV-1a hash of the size, of the clues and of the given
+ *         cells
+ * @note Equal hints have equal hashes on every platform
+ */
+extern uint64_t nonogram_hints_hash(NonoGramHints *hints);
+/**
+ * @brief Compare the clues of two nonogram hints objects
+ * @param hints The first nonogram hints object
+ * @param other The second nonogram hints object
+ * @return true if both objects have the same size, the same clues and the
+ *         same given cells
+ */
+extern bool nonogram_hints_equal(NonoGramHints *hints, NonoGramHints *other);
+
 
 #endif  // NONOGRAM_H_
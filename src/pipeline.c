@@ -0,0 +1,315 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+/**
+ * @file pipeline.c
+ * @brief Implementation of the staged pipeline.
+ *
+ * Stages are connected by bounded lock-free queues: a stage that cannot
+ * keep up fills its input queue and the stage before it waits in emit, so
+ * the memory held by the pipeline is bounded by the queue capacities.
+ */
+#include "./pipeline.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "./queue.h"
+
+#include "./pipeline.inc"
+
+/**
+ * @brief Get the time elapsed since a start time
+ * @param start The start time
+ * @return The elapsed time in nanoseconds
+ */
+static long _elapsed(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) * 1000000000L
+    + now.tv_nsec - start->tv_nsec;
+}
+
+/**
+ * @brief Create a new pipeline
+ * @return A new pipeline without stages, or NULL if memory allocation fails
+ */
+NonoGramPipeline *nonogram_pipeline_create(void) {
+  NonoGramPipeline *pipeline = calloc(1, sizeof(NonoGramPipeline));
+  if (!pipeline) {
+    return NULL;
+  }
+  atomic_init(&pipeline->stopped, false);
+  pthread_mutex_init(&pipeline->lock, NULL);
+  pthread_cond_init(&pipeline->end, NULL);
+  return pipeline;
+}
+
+/**
+ * @brief Destroy a pipeline
+ * @param pipeline The pipeline, not running
+ */
+void nonogram_pipeline_destroy(NonoGramPipeline *pipeline) {
+  for (int stage = 0; stage < pipeline->stages_count; stage++) {
+    if (pipeline->stages[stage].input) {
+      nonogram_queue_destroy(pipeline->stages[stage].input);
+    }
+  }
+  pthread_cond_destroy(&pipeline->end);
+  pthread_mutex_destroy(&pipeline->lock);
+  free(pipeline->threads);
+  free(pipeline);
+}
+
+/**
+ * @brief Add a stage at the end of a pipeline
+ * @param pipeline The pipeline, not started
+ * @param name The name of the stage
+ * @param threads The number of threads of the stage
+ * @param capacity The capacity of the input queue
+ * @param function The function processing the items
+ * @param data The data given to the function
+ * @return The index of the stage, or -1 on failure
+ */
+int nonogram_pipeline_add_stage(
+  NonoGramPipeline *pipeline,
+  const char *name,
+  int threads,
+  size_t capacity,
+  NonoGramStage function,
+  void *data
+) {
+  if (pipeline->stages_count == PIPELINE_MAX_STAGES || threads < 1) {
+    return -1;
+  }
+  int index = pipeline->stages_count;
+  NonoGramPipelineStage *stage = &pipeline->stages[index];
+  if (index) {
+    stage->input = nonogram_queue_create(capacity);
+    if (!stage->input) {
+      return -1;
+    }
+  }
+  stage->name = name;
+  stage->threads = threads;
+  stage->function = function;
+  stage->data = data;
+  atomic_init(&stage->running, 0);
+  atomic_init(&stage->processed, 0);
+  atomic_init(&stage->emitted, 0);
+  atomic_init(&stage->busy, 0);
+  atomic_init(&stage->blocked, 0);
+  pipeline->stages_count++;
+  return index;
+}
+
+/**
+ * @brief Account for a thread of a stage that has ended
+ * @param pipeline The pipeline
+ * @param stage The index of the stage
+ */
+static void _leave(NonoGramPipeline *pipeline, int stage) {
+  if (atomic_fetch_sub(&pipeline->stages[stage].running, 1) > 1) {
+    return;
+  }
+  if (stage + 1 < pipeline->stages_count) {
+    nonogram_queue_close(pipeline->stages[stage + 1].input);
+  } else {
+    pthread_mutex_lock(&pipeline->lock);
+    pipeline->finished = true;
+    pthread_cond_broadcast(&pipeline->end);
+    pthread_mutex_unlock(&pipeline->lock);
+  }
+}
+
+/**
+ * @brief Run a thread of a stage
+ * @param data The thread
+ * @return NULL
+ */
+static void *_run(void *data) {
+  NonoGramPipelineThread *thread = data;
+  NonoGramPipeline *pipeline = thread->pipeline;
+  NonoGramPipelineStage *stage = &pipeline->stages[thread->stage];
+  struct timespec start;
+  if (!stage->input) {
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    stage->function(pipeline, thread->stage, NULL, stage->data);
+    atomic_fetch_add(&stage->busy, _elapsed(&start));
+  } else {
+    void *item;
+    while ((item = nonogram_queue_pop(stage->input))) {
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      stage->function(pipeline, thread->stage, item, stage->data);
+      atomic_fetch_add_explicit(
+        &stage->busy, _elapsed(&start), memory_order_relaxed);
+      atomic_fetch_add_explicit(&stage->processed, 1, memory_order_relaxed);
+    }
+  }
+  _leave(pipeline, thread->stage);
+  return NULL;
+}
+
+/**
+ * @brief Start the threads of a pipeline
+ * @param pipeline The pipeline
+ * @return false if a stage has no thread, the pipeline is then stopped
+ */
+bool nonogram_pipeline_start(NonoGramPipeline *pipeline) {
+  assert(pipeline->stages_count > 0);
+  int count = 0;
+  for (int stage = 0; stage < pipeline->stages_count; stage++) {
+    count += pipeline->stages[stage].threads;
+    atomic_store(
+      &pipeline->stages[stage].running, pipeline->stages[stage].threads);
+  }
+  pipeline->threads = calloc(count, sizeof(NonoGramPipelineThread));
+  clock_gettime(CLOCK_MONOTONIC, &pipeline->start);
+  bool succeeded = pipeline->threads != NULL;
+  int index = 0;
+  for (int stage = 0; stage < pipeline->stages_count; stage++) {
+    int started = 0;
+    for (int rank = 0; rank < pipeline->stages[stage].threads; rank++) {
+      NonoGramPipelineThread *thread =
+        pipeline->threads ? &pipeline->threads[index++] : NULL;
+      if (thread) {
+        thread->pipeline = pipeline;
+        thread->stage = stage;
+        thread->started = !pthread_create(&thread->id, NULL, _run, thread);
+      }
+      if (thread && thread->started) {
+        started++;
+      } else {
+        _leave(pipeline, stage);
+      }
+    }
+    if (!started) {
+      succeeded = false;
+    }
+  }
+  pipeline->threads_count = index;
+  if (!succeeded) {
+    nonogram_pipeline_stop(pipeline);
+  }
+  return succeeded;
+}
+
+/**
+ * @brief Wait for the end of a pipeline
+ * @param pipeline The pipeline
+ * @param timeout The maximal wait in seconds, 0 to wait for the end
+ * @return true if every stage has ended and its threads have been joined
+ */
+bool nonogram_pipeline_wait(NonoGramPipeline *pipeline, double timeout) {
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  long nanoseconds =
+    deadline.tv_nsec + (long) ((timeout - (long) timeout) * 1e9);
+  deadline.tv_sec += (long) timeout + nanoseconds / 1000000000L;
+  deadline.tv_nsec = nanoseconds % 1000000000L;
+  pthread_mutex_lock(&pipeline->lock);
+  while (!pipeline->finished) {
+    if (timeout <= 0) {
+      pthread_cond_wait(&pipeline->end, &pipeline->lock);
+    } else if (pthread_cond_timedwait(
+                 &pipeline->end, &pipeline->lock, &deadline)) {
+      break;
+    }
+  }
+  bool finished = pipeline->finished;
+  pthread_mutex_unlock(&pipeline->lock);
+  if (finished && !pipeline->joined) {
+    for (int index = 0; index < pipeline->threads_count; index++) {
+      if (pipeline->threads[index].started) {
+        pthread_join(pipeline->threads[index].id, NULL);
+      }
+    }
+    pipeline->joined = true;
+  }
+  return finished;
+}
+
+/**
+ * @brief Give an item to the next stage, waiting while its queue is full
+ * @param pipeline The pipeline
+ * @param stage The index of the stage emitting the item
+ * @param item The item, not NULL
+ * @return false if the pipeline has been stopped
+ */
+bool nonogram_pipeline_emit(
+  NonoGramPipeline *pipeline,
+  int stage,
+  void *item
+) {
+  assert(stage + 1 < pipeline->stages_count);
+  if (atomic_load_explicit(&pipeline->stopped, memory_order_relaxed)) {
+    return false;
+  }
+  NonoGramQueue *queue = pipeline->stages[stage + 1].input;
+  if (!nonogram_queue_try_push(queue, item)) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    bool pushed = nonogram_queue_push(queue, item);
+    atomic_fetch_add_explicit(&pipeline->stages[stage].blocked,
+                              _elapsed(&start), memory_order_relaxed);
+    if (!pushed) {
+      return false;
+    }
+  }
+  atomic_fetch_add_explicit(
+    &pipeline->stages[stage].emitted, 1, memory_order_relaxed);
+  return true;
+}
+
+/**
+ * @brief Stop a pipeline
+ * @param pipeline The pipeline
+ */
+void nonogram_pipeline_stop(NonoGramPipeline *pipeline) {
+  atomic_store(&pipeline->stopped, true);
+  for (int stage = 1; stage < pipeline->stages_count; stage++) {
+    nonogram_queue_close(pipeline->stages[stage].input);
+  }
+}
+
+/**
+ * @brief Get the number of stages of a pipeline
+ * @param pipeline The pipeline
+ * @return The number of stages
+ */
+int nonogram_pipeline_get_stages_count(NonoGramPipeline *pipeline) {
+  return pipeline->stages_count;
+}
+
+/**
+ * @brief Get the metrics of a pipeline stage
+ * @param pipeline The pipeline
+ * @param stage The index of the stage
+ * @param stats The metrics to fill
+ */
+void nonogram_pipeline_get_stats(
+  NonoGramPipeline *pipeline,
+  int stage,
+  NonoGramStageStats *stats
+) {
+  NonoGramPipelineStage *current = &pipeline->stages[stage];
+  stats->name = current->name;
+  stats->threads = current->threads;
+  stats->emitted = atomic_load(&current->emitted);
+  stats->processed =
+    current->input ? atomic_load(&current->processed) : stats->emitted;
+  stats->depth = current->input ? nonogram_queue_get_depth(current->input) : 0;
+  stats->capacity =
+    current->input ? nonogram_queue_get_capacity(current->input) : 0;
+  stats->blocked = atomic_load(&current->blocked) / 1e9;
+  stats->elapsed = pipeline->threads ? _elapsed(&pipeline->start) / 1e9 : 0.0;
+  stats->busy = atomic_load(&current->busy) / 1e9;
+  if (!current->input) {
+    // Source threads run from the start and account for their time at the end
+    stats->busy += atomic_load(&current->running) * stats->elapsed;
+  }
+}
@@ -0,0 +1,133 @@
+#ifndef PIPELINE_H_
+#define PIPELINE_H_
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * NonoGramPipeline is a opaque structure that represents a chain of stages,
+ * each one run by its own threads and fed by a bounded queue.
+ */
+typedef struct _NonoGramPipeline NonoGramPipeline;
+
+/**
+ * NonoGramStage processes an item of a pipeline stage.
+ * @param pipeline The pipeline
+ * @param stage The index of the stage
+ * @param item The item, or NULL for the first stage
+ * @param data The data given with the stage
+ * @note The first stage is the source: its function is called once per
+ *       thread and emits the items. The other stages are called once per
+ *       item and emit it, or another item, to the next stage
+ */
+typedef void (*NonoGramStage)(
+  NonoGramPipeline *pipeline,
+  int stage,
+  void *item,
+  void *data
+);
+
+/**
+ * NonoGramStageStats holds the metrics of a pipeline stage.
+ */
+typedef struct {
+  const char *name;  // Name of the stage
+  int threads;       // Number of threads of the stage
+  long processed;    // Number of items processed, emitted by the source
+  long emitted;      // Number of items given to the next stage
+  size_t depth;      // Number of items waiting in the input queue
+  size_t capacity;   // Capacity of the input queue, 0 for the source
+  double busy;       // Seconds spent by the threads in the stage function
+  double blocked;    // Seconds of busy spent waiting for the next stage
+  double elapsed;    // Seconds since the pipeline has been started
+} NonoGramStageStats;
+
+/**
+ * @brief Create a new pipeline
+ * @return A new pipeline without stages, or NULL if memory allocation fails
+ */
+extern NonoGramPipeline *nonogram_pipeline_create(void);
+/**
+ * @brief Destroy a pipeline
+ * @param pipeline The pipeline, not running
+ */
+extern void nonogram_pipeline_destroy(NonoGramPipeline *pipeline);
+
+/**
+ * @brief Add a stage at the end of a pipeline
+ * @param pipeline The pipeline, not started
+ * @param name The name of the stage, used by the metrics
+ * @param threads The number of threads of the stage
+ * @param capacity The capacity of the input queue, ignored for the source
+ * @param function The function processing the items
+ * @param data The data given to the function
+ * @return The index of the stage, or -1 on failure
+ */
+extern int nonogram_pipeline_add_stage(
+  NonoGramPipeline *pipeline,
+  const char *name,
+  int threads,
+  size_t capacity,
+  NonoGramStage function,
+  void *data
+);
+
+/**
+ * @brief Start the threads of a pipeline
+ * @param pipeline The pipeline
+ * @return false if a stage has no thread, the pipeline is then stopped
+ * @note nonogram_pipeline_wait must be called in both cases
+ */
+extern bool nonogram_pipeline_start(NonoGramPipeline *pipeline);
+/**
+ * @brief Wait for the end of a pipeline
+ * @param pipeline The pipeline
+ * @param timeout The maximal wait in seconds, 0 to wait for the end
+ * @return true if every stage has ended and its threads have been joined
+ */
+extern bool nonogram_pipeline_wait(NonoGramPipeline *pipeline, double timeout);
+
+/**
+ * @brief Give an item to the next stage, waiting while its queue is full
+ * @param pipeline The pipeline
+ * @param stage The index of the stage emitting the item
+ * @param item The item, not NULL
+ * @return false if the pipeline has been stopped, the item is then still
+ *         owned by the caller
+ * @note Waiting for room is how a slow stage throttles the stages before it
+ */
+extern bool nonogram_pipeline_emit(
+  NonoGramPipeline *pipeline,
+  int stage,
+  void *item
+);
+/**
+ * @brief Stop a pipeline
+ * @param pipeline The pipeline
+ * @note Emits fail from now on; the items already queued are still
+ *       processed so that the stages can release them
+ */
+extern void nonogram_pipeline_stop(NonoGramPipeline *pipeline);
+
+/**
+ * @brief Get the number of stages of a pipeline
+ * @param pipeline The pipeline
+ * @return The number of stages
+ */
+extern int nonogram_pipeline_get_stages_count(NonoGramPipeline *pipeline);
+/**
+ * @brief Get the metrics of a pipeline stage
+ * @param pipeline The pipeline
+ * @param stage The index of the stage
+ * @param stats The metrics to fill
+ * @note This can be called while the pipeline is running
+ */
+extern void nonogram_pipeline_get_stats(
+  NonoGramPipeline *pipeline,
+  int stage,
+  NonoGramStageStats *stats
+);
+
+#endif  // PIPELINE_H_
@@ -0,0 +1,214 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+/**
+ * @file queue.c
+ * @brief Implementation of the bounded lock-free queue.
+ *
+ * Every slot holds a sequence number: a producer claims the tail position
+ * when the slot sequence equals it, a consumer claims the head position
+ * when the slot sequence is one past it. Claims are single compare and swap
+ * operations, so that no thread ever holds a lock. Waiting for room or for
+ * an item backs off from yielding to short sleeps.
+ */
+#include "./queue.h"
+
+#include <assert.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "./queue.inc"
+
+/**
+ * @brief Number of yields before a waiting thread starts sleeping
+ */
+#define QUEUE_YIELDS 64
+
+/**
+ * @brief Sleep of a waiting thread in nanoseconds
+ */
+#define QUEUE_SLEEP 50000
+
+/**
+ * @brief Wait before retrying a full or empty queue
+ * @param attempt The number of attempts so far, incremented
+ */
+static void _backoff(int *attempt) {
+  if ((*attempt)++ < QUEUE_YIELDS) {
+    sched_yield();
+  } else {
+    struct timespec delay = {0, QUEUE_SLEEP};
+    nanosleep(&delay, NULL);
+  }
+}
+
+/**
+ * @brief Create a new queue
+ * @param capacity The minimal number of items the queue can hold
+ * @return A new queue, or NULL if memory allocation fails
+ */
+NonoGramQueue *nonogram_queue_create(size_t capacity) {
+  size_t size = 2;
+  while (size < capacity) {
+    size *= 2;
+  }
+  NonoGramQueue *queue = aligned_alloc(QUEUE_CACHE_LINE, sizeof(NonoGramQueue));
+  if (!queue) {
+    return NULL;
+  }
+  queue->cells = malloc(size * sizeof(NonoGramQueueCell));
+  if (!queue->cells) {
+    free(queue);
+    return NULL;
+  }
+  for (size_t index = 0; index < size; index++) {
+    atomic_init(&queue->cells[index].sequence, index);
+  }
+  queue->mask = size - 1;
+  atomic_init(&queue->closed, false);
+  atomic_init(&queue->tail, 0);
+  atomic_init(&queue->head, 0);
+  return queue;
+}
+
+/**
+ * @brief Destroy a queue
+ * @param queue The queue
+ */
+void nonogram_queue_destroy(NonoGramQueue *queue) {
+  free(queue->cells);
+  free(queue);
+}
+
+/**
+ * @brief Add an item to a queue if it is not full
+ * @param queue The queue
+ * @param item The item, not NULL
+ * @return false if the queue is full
+ */
+bool nonogram_queue_try_push(NonoGramQueue *queue, void *item) {
+  assert(item);
+  size_t position = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+  NonoGramQueueCell *cell;
+  for (;;) {
+    cell = &queue->cells[position & queue->mask];
+    size_t sequence =
+      atomic_load_explicit(&cell->sequence, memory_order_acquire);
+    intptr_t difference = (intptr_t) sequence - (intptr_t) position;
+    if (difference == 0) {
+      if (atomic_compare_exchange_weak_explicit(
+            &queue->tail, &position, position + 1,
+            memory_order_relaxed, memory_order_relaxed)) {
+        break;
+      }
+    } else if (difference < 0) {
+      return false;
+    } else {
+      position = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    }
+  }
+  cell->item = item;
+  atomic_store_explicit(&cell->sequence, position + 1, memory_order_release);
+  return true;
+}
+
+/**
+ * @brief Add an item to a queue, waiting while the queue is full
+ * @param queue The queue
+ * @param item The item, not NULL
+ * @return false if the queue has been closed
+ */
+bool nonogram_queue_push(NonoGramQueue *queue, void *item) {
+  int attempt = 0;
+  while (!atomic_load_explicit(&queue->closed, memory_order_acquire)) {
+    if (nonogram_queue_try_push(queue, item)) {
+      return true;
+    }
+    _backoff(&attempt);
+  }
+  return false;
+}
+
+/**
+ * @brief Remove the oldest item of a queue if it is not empty
+ * @param queue The queue
+ * @return The item, or NULL if the queue is empty
+ */
+void *nonogram_queue_try_pop(NonoGramQueue *queue) {
+  size_t position = atomic_load_explicit(&queue->head, memory_order_relaxed);
+  NonoGramQueueCell *cell;
+  for (;;) {
+    cell = &queue->cells[position & queue->mask];
+    size_t sequence =
+      atomic_load_explicit(&cell->sequence, memory_order_acquire);
+    intptr_t difference = (intptr_t) sequence - (intptr_t) (position + 1);
+    if (difference == 0) {
+      if (atomic_compare_exchange_weak_explicit(
+            &queue->head, &position, position + 1,
+            memory_order_relaxed, memory_order_relaxed)) {
+        break;
+      }
+    } else if (difference < 0) {
+      return NULL;
+    } else {
+      position = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    }
+  }
+  void *item = cell->item;
+  atomic_store_explicit(
+    &cell->sequence, position + queue->mask + 1, memory_order_release);
+  return item;
+}
+
+/**
+ * @brief Remove the oldest item of a queue, waiting while the queue is empty
+ * @param queue The queue
+ * @return The item, or NULL if the queue has been closed and is empty
+ */
+void *nonogram_queue_pop(NonoGramQueue *queue) {
+  int attempt = 0;
+  for (;;) {
+    void *item = nonogram_queue_try_pop(queue);
+    if (item) {
+      return item;
+    }
+    if (atomic_load_explicit(&queue->closed, memory_order_acquire)) {
+      // Items pushed before the queue was closed are visible now
+      return nonogram_queue_try_pop(queue);
+    }
+    _backoff(&attempt);
+  }
+}
+
+/**
+ * @brief Close a queue
+ * @param queue The queue
+ */
+void nonogram_queue_close(NonoGramQueue *queue) {
+  atomic_store_explicit(&queue->closed, true, memory_order_release);
+}
+
+/**
+ * @brief Get the number of items in a queue
+ * @param queue The queue
+ * @return The number of items
+ */
+size_t nonogram_queue_get_depth(NonoGramQueue *queue) {
+  size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+  size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+  return tail > head ? tail - head : 0;
+}
+
+/**
+ * @brief Get the capacity of a queue
+ * @param queue The queue
+ * @return The number of items the queue can hold
+ */
+size_t nonogram_queue_get_capacity(NonoGramQueue *queue) {
+  return queue->mask + 1;
+}
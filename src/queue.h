@@ -0,0 +1,75 @@
+#ifndef QUEUE_H_
+#define QUEUE_H_
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * NonoGramQueue is a opaque structure that represents a bounded lock-free
+ * queue of pointers shared by several producers and consumers.
+ */
+typedef struct _NonoGramQueue NonoGramQueue;
+
+/**
+ * @brief Create a new queue
+ * @param capacity The minimal number of items the queue can hold
+ * @return A new queue, or NULL if memory allocation fails
+ * @note The capacity is rounded up to a power of two
+ */
+extern NonoGramQueue *nonogram_queue_create(size_t capacity);
+/**
+ * @brief Destroy a queue
+ * @param queue The queue
+ * @note The items still in the queue are not freed
+ */
+extern void nonogram_queue_destroy(NonoGramQueue *queue);
+
+/**
+ * @brief Add an item to a queue, waiting while the queue is full
+ * @param queue The queue
+ * @param item The item, not NULL
+ * @return false if the queue has been closed
+ */
+extern bool nonogram_queue_push(NonoGramQueue *queue, void *item);
+/**
+ * @brief Add an item to a queue if it is not full
+ * @param queue The queue
+ * @param item The item, not NULL
+ * @return false if the queue is full
+ */
+extern bool nonogram_queue_try_push(NonoGramQueue *queue, void *item);
+/**
+ * @brief Remove the oldest item of a queue, waiting while the queue is empty
+ * @param queue The queue
+ * @return The item, or NULL if the queue has been closed and is empty
+ */
+extern void *nonogram_queue_pop(NonoGramQueue *queue);
+/**
+ * @brief Remove the oldest item of a queue if it is not empty
+ * @param queue The queue
+ * @return The item, or NULL if the queue is empty
+ */
+extern void *nonogram_queue_try_pop(NonoGramQueue *queue);
+
+/**
+ * @brief Close a queue
+ * @param queue The queue
+ * @note Consumers drain the remaining items, then pop returns NULL
+ */
+extern void nonogram_queue_close(NonoGramQueue *queue);
+/**
+ * @brief Get the number of items in a queue
+ * @param queue The queue
+ * @return The number of items, exact when the queue is not being used
+ */
+extern size_t nonogram_queue_get_depth(NonoGramQueue *queue);
+/**
+ * @brief Get the capacity of a queue
+ * @param queue The queue
+ * @return The number of items the queue can hold
+ */
+extern size_t nonogram_queue_get_capacity(NonoGramQueue *queue);
+
+#endif  // QUEUE_H_
@@ -0,0 +1,346 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+/**
+ * @file repair.c
+ * @brief Implementation of the repair of inconsistent hints.
+ *
+ * The clues of one line, then of two lines, are ignored in turn until the
+ * exact solver finds a board; the ignored lines are then the only ones the
+ * board can violate. Each solve has a budget of REPAIR_NODE_LIMIT
+ * decisions, past which the set of lines is skipped. When no set gives a
+ * board before the time runs out, a local search keeping either the row
+ * clues or the col clues gives the board.
+ */
+#include "./repair.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "./localsearch.h"
+#include "./nonogram.h"
+#include "./solver.h"
+
+#include "./nonogram.inc"
+
+/**
+ * @brief Largest number of lines whose clues are ignored together
+ */
+#define REPAIR_MAX_RELAXED 2
+/**
+ * @brief Maximal number of decisions of a solve with ignored lines
+ */
+#define REPAIR_NODE_LIMIT 100
+/**
+ * @brief Number of line solver calls between two checks of the deadline
+ */
+#define REPAIR_PROGRESS_INTERVAL 64
+
+/**
+ * Deadline stops the solves of the exact repair once its time has passed.
+ */
+typedef struct {
+  double time;         // Time at which to give up
+  atomic_bool passed;  // Raised once the time has passed
+} Deadline;
+
+/**
+ * @brief Get the current time
+ * @return The time in seconds of a monotonic clock
+ */
+static double _now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Raise the flag of a deadline once its time has passed
+ * @param nodes The number of decisions taken so far
+ * @param settled The number of cells currently settled
+ * @param data The deadline
+ */
+static void _check_deadline(long nodes, int settled, void *data) {
+  (void) nodes;
+  (void) settled;
+  Deadline *deadline = data;
+  if (_now() >= deadline->time) {
+    atomic_store(&deadline->passed, true);
+  }
+}
+
+/**
+ * @brief Compute the distance between a line of a board and its clue
+ *
+ * The distance is the sum of the differences between the blocks of the line
+ * and its clue, a missing block counting as a block of length 0.
+ *
+ * @param clue The clue of the line, terminated by 0
+ * @param board The board
+ * @param line The index of the row or col
+ * @param length The length of the line
+ * @param is_row Whether the line is a row
+ * @return The distance, 0 if the line satisfies its clue
+ */
+static int _line_distance(
+  const int *clue,
+  int **board,
+  int line,
+  int length,
+  bool is_row
+) {
+  int distance = 0;
+  int index = 0;
+  int run = 0;
+  bool ended = false;
+  for (int position = 0; position <= length; position++) {
+    if (position < length
+        && (is_row ? board[line][position] : board[position][line])) {
+      run++;
+      continue;
+    }
+    if (run) {
+      ended = ended || index >= length || clue[index] <= 0;
+      distance += abs(run - (ended ? 0 : clue[index]));
+      index++;
+      run = 0;
+    }
+  }
+  for (; !ended && index < length && clue[index] > 0; index++) {
+    distance += clue[index];
+  }
+  return distance;
+}
+
+/**
+ * @brief Compute the distance between a line of a board and its clue
+ * @param hints The nonogram hints object
+ * @param board The board
+ * @param line The line index, rows first, then columns
+ * @return The distance, 0 if the line satisfies its clue
+ */
+static int _distance(NonoGramHints *hints, int **board, int line) {
+  if (line < hints->rows_count) {
+    return _line_distance(hints->rows[line], board, line, hints->cols_count,
+                          true);
+  }
+  line -= hints->rows_count;
+  return _line_distance(hints->cols[line], board, line, hints->rows_count,
+                        false);
+}
+
+/**
+ * @brief Solve a puzzle ignoring the clues of some lines
+ * @param hints The nonogram hints object
+ * @param relaxed The lines whose clues are ignored
+ * @param count The number of ignored lines
+ * @param deadline The deadline cancelling the solve
+ * @param board The board to fill
+ * @return true if a board satisfying the other clues has been found, false
+ *         as well if the budget of decisions or the time has run out
+ */
+static bool _solve_relaxed(
+  NonoGramHints *hints,
+  const int *relaxed,
+  int count,
+  Deadline *deadline,
+  int **board
+) {
+  NonoGramSolver *solver = nonogram_solver_create(hints);
+  if (!solver) {
+    return false;
+  }
+  for (int index = 0; index < count; index++) {
+    nonogram_solver_relax_line(solver, relaxed[index]);
+  }
+  nonogram_solver_set_node_limit(solver, REPAIR_NODE_LIMIT);
+  nonogram_solver_set_cancel(solver, &deadline->passed);
+  nonogram_solver_set_progress(solver, _check_deadline, deadline,
+                               REPAIR_PROGRESS_INTERVAL);
+  NonoGramStatus status = nonogram_solver_solve(solver, NONOGRAM_ENGINE_DFS);
+  bool solved = status == NONOGRAM_SOLVER_SOLVED;
+  for (int row = 0; solved && row < hints->rows_count; row++) {
+    for (int col = 0; col < hints->cols_count; col++) {
+      board[row][col] = nonogram_solver_get_cell(solver, row, col);
+    }
+  }
+  nonogram_solver_destroy(solver);
+  return solved;
+}
+
+/**
+ * @brief Ignore the clues of growing sets of lines until a board is found
+ *
+ * Among the sets of the smallest size giving a board, the board closest to
+ * the ignored clues is kept.
+ *
+ * @param hints The nonogram hints object
+ * @param deadline The deadline at which to give up
+ * @param board The board to fill
+ * @param candidate A board used as workspace
+ * @return true if a board has been found
+ */
+static bool _repair_exact(
+  NonoGramHints *hints,
+  Deadline *deadline,
+  int **board,
+  int **candidate
+) {
+  int lines_count = hints->rows_count + hints->cols_count;
+  int relaxed[REPAIR_MAX_RELAXED];
+  int best = -1;
+  for (int count = 0; count <= REPAIR_MAX_RELAXED && best < 0; count++) {
+    // Enumerate the sets of count lines in lexicographic order
+    for (int index = 0; index < count; index++) {
+      relaxed[index] = index;
+    }
+    while (!atomic_load(&deadline->passed) && _now() < deadline->time) {
+      if (_solve_relaxed(hints, relaxed, count, deadline, candidate)) {
+        int distance = 0;
+        for (int index = 0; index < count; index++) {
+          distance += _distance(hints, candidate, relaxed[index]);
+        }
+        if (best < 0 || distance < best) {
+          best = distance;
+          for (int row = 0; row < hints->rows_count; row++) {
+            memcpy(board[row], candidate[row],
+                   hints->cols_count * sizeof(int));
+          }
+        }
+      }
+      int index = count - 1;
+      while (index >= 0 && relaxed[index] == lines_count - count + index) {
+        index--;
+      }
+      if (index < 0) {
+        break;
+      }
+      relaxed[index]++;
+      for (int next = index + 1; next < count; next++) {
+        relaxed[next] = relaxed[next - 1] + 1;
+      }
+    }
+  }
+  return best >= 0;
+}
+
+/**
+ * @brief Find a board with a local search
+ *
+ * A search keeping the row clues only violates column clues and a search
+ * keeping the col clues only violates row clues: the best of both boards is
+ * kept. Without time left, the initial boards of the searches are compared.
+ * Like the local search of the solver, it ignores the given cells.
+ *
+ * @param hints The nonogram hints object
+ * @param seed The seed of the local search
+ * @param seconds The time limit in seconds, 0 or less for none left
+ * @param board The board to fill
+ * @return true if a board has been found
+ */
+static bool _repair_local(
+  NonoGramHints *hints,
+  unsigned long seed,
+  double seconds,
+  int **board
+) {
+  // The transposed puzzle shares the clues of the puzzle, the local search
+  // ignores the given cells
+  NonoGramHints transposed = {
+    .rows_count = hints->cols_count,
+    .cols_count = hints->rows_count,
+    .rows = hints->cols,
+    .cols = hints->rows,
+    .given = NULL,
+  };
+  NonoGramLocalSearch *by_rows = nonogram_local_search_create(hints, seed);
+  NonoGramLocalSearch *by_cols =
+    nonogram_local_search_create(&transposed, seed);
+  int count = (by_rows != NULL) + (by_cols != NULL);
+  if (!count) {
+    return false;
+  }
+  bool solved = false;
+  if (by_rows && seconds > 0) {
+    solved = nonogram_local_search_run(by_rows, seconds / count, 0);
+  }
+  if (by_cols && seconds > 0 && !solved) {
+    nonogram_local_search_run(by_cols, seconds / count, 0);
+  }
+  bool use_rows = by_rows
+                  && (solved || !by_cols
+                      || nonogram_local_search_get_violations(by_rows)
+                         <= nonogram_local_search_get_violations(by_cols));
+  for (int row = 0; row < hints->rows_count; row++) {
+    for (int col = 0; col < hints->cols_count; col++) {
+      board[row][col] = use_rows
+                        ? nonogram_local_search_get_cell(by_rows, row, col)
+                        : nonogram_local_search_get_cell(by_cols, col, row);
+    }
+  }
+  if (by_rows) {
+    nonogram_local_search_destroy(by_rows);
+  }
+  if (by_cols) {
+    nonogram_local_search_destroy(by_cols);
+  }
+  return true;
+}
+
+/**
+ * @brief Find a board violating as few clues as possible
+ *
+ * Half of the time is given to the exact repair, the rest to the local
+ * search when the exact repair fails.
+ *
+ * @param hints The nonogram hints object, possibly inconsistent
+ * @param seed The seed of the local search
+ * @param seconds The time limit in seconds
+ * @param board The board to fill, an array of rows of ints
+ * @param suspects The lines to fill, true if the board violates their clue
+ * @return The number of violated lines, or -1 if no board has been found
+ */
+int nonogram_repair(
+  NonoGramHints *hints,
+  unsigned long seed,
+  double seconds,
+  int **board,
+  bool *suspects
+) {
+  double start = _now();
+  Deadline deadline = {.time = start + seconds / 2};
+  atomic_init(&deadline.passed, false);
+  int **candidate = malloc(hints->rows_count * sizeof(int *));
+  if (!candidate) {
+    return -1;
+  }
+  for (int row = 0; row < hints->rows_count; row++) {
+    candidate[row] = malloc(hints->cols_count * sizeof(int));
+    if (!candidate[row]) {
+      for (int index = 0; index < row; index++) {
+        free(candidate[index]);
+      }
+      free(candidate);
+      return -1;
+    }
+  }
+  bool found = _repair_exact(hints, &deadline, board, candidate)
+               || _repair_local(hints, seed, seconds - (_now() - start), board);
+  for (int row = 0; row < hints->rows_count; row++) {
+    free(candidate[row]);
+  }
+  free(candidate);
+  if (!found) {
+    return -1;
+  }
+
+  int violations = 0;
+  for (int line = 0; line < hints->rows_count + hints->cols_count; line++) {
+    suspects[line] = _distance(hints, board, line) > 0;
+    violations += suspects[line];
+  }
+  return violations;
+}
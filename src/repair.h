@@ -0,0 +1,33 @@
+#ifndef REPAIR_H_
+#define REPAIR_H_
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+#include <stdbool.h>
+
+#include "./nonogram.h"
+
+/**
+ * @brief Find a board violating as few clues as possible
+ * @param hints The nonogram hints object, possibly inconsistent
+ * @param seed The seed of the local search
+ * @param seconds The time limit in seconds
+ * @param board The board to fill, an array of rows of ints
+ * @param suspects The lines to fill, rows first, then columns: true if the
+ *                 board violates their clue
+ * @return The number of violated lines, or -1 if no board has been found
+ * @note Repair is best effort: the clues of one line, then of two lines,
+ *       are ignored in turn, each solve within a budget of decisions, and a
+ *       solve stopped by its budget counts as no board. A puzzle with at
+ *       most two wrong clues can thus be missed; like puzzles with more
+ *       wrong clues, it then gets the best board of a local search
+ */
+extern int nonogram_repair(
+  NonoGramHints *hints,
+  unsigned long seed,
+  double seconds,
+  int **board,
+  bool *suspects
+);
+
+#endif  // REPAIR_H_
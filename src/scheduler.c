@@ -0,0 +1,185 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+/**
+ * @file scheduler.c
+ * @brief Implementation of the size-aware thread scheduler.
+ *
+ * Small puzzles are cheap and numerous: one thread each gives the best
+ * throughput. Large puzzles dominate the wall time of a batch when they are
+ * solved on a single thread, so they are given several threads for the
+ * parallel engine. Both draw from the same pool of thread tokens.
+ */
+#include "./scheduler.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "./solver.h"
+
+#include "./scheduler.inc"
+
+/**
+ * @brief Milliseconds a large puzzle waits for released threads
+ */
+#define SCHEDULER_GATHER 5
+
+/**
+ * @brief Create a new scheduler
+ * @param threads The number of solver threads to share
+ * @param budget The maximal number of threads of a large puzzle
+ * @param threshold The estimated cost from which a puzzle is large
+ * @return A new scheduler, or NULL if memory allocation fails
+ */
+NonoGramScheduler *nonogram_scheduler_create(
+  int threads,
+  int budget,
+  double threshold
+) {
+  NonoGramScheduler *scheduler = calloc(1, sizeof(NonoGramScheduler));
+  if (!scheduler) {
+    return NULL;
+  }
+  scheduler->threads = threads > 1 ? threads : 1;
+  // Large puzzles leave a thread to the small ones
+  if (budget > scheduler->threads - 1) {
+    budget = scheduler->threads - 1;
+  }
+  scheduler->budget = budget > 1 ? budget : 1;
+  scheduler->threshold = threshold;
+  scheduler->available = scheduler->threads;
+  pthread_mutex_init(&scheduler->lock, NULL);
+  pthread_cond_init(&scheduler->changed, NULL);
+  return scheduler;
+}
+
+/**
+ * @brief Destroy a scheduler
+ * @param scheduler The scheduler
+ */
+void nonogram_scheduler_destroy(NonoGramScheduler *scheduler) {
+  pthread_cond_destroy(&scheduler->changed);
+  pthread_mutex_destroy(&scheduler->lock);
+  free(scheduler);
+}
+
+/**
+ * @brief Estimate the cost of a puzzle
+ * @param features The features of the puzzle, after presolve
+ * @return The number of cells left unknown by presolve
+ */
+double nonogram_scheduler_estimate(const NonoGramFeatures *features) {
+  return (double) features->rows_count * features->cols_count
+    * (1.0 - features->settled);
+}
+
+/**
+ * @brief Check whether a puzzle is solved in parallel
+ * @param scheduler The scheduler
+ * @param cost The estimated cost of the puzzle
+ * @return true if the puzzle is large
+ */
+static bool _large(NonoGramScheduler *scheduler, double cost) {
+  return scheduler->budget > 1 && cost >= scheduler->threshold;
+}
+
+/**
+ * @brief Get the number of tokens a large puzzle can take now
+ * @param scheduler The scheduler, locked
+ * @param wanted The number of tokens still wanted
+ * @return The number of tokens
+ */
+static int _takable(NonoGramScheduler *scheduler, int wanted) {
+  int count = scheduler->available;
+  int limit = scheduler->threads - 1 - scheduler->large_held;
+  if (count > limit) {
+    count = limit;
+  }
+  return count < wanted ? count : wanted;
+}
+
+/**
+ * @brief Wait for threads to solve a puzzle
+ * @param scheduler The scheduler
+ * @param cost The estimated cost of the puzzle
+ * @return The number of threads granted
+ */
+int nonogram_scheduler_acquire(NonoGramScheduler *scheduler, double cost) {
+  pthread_mutex_lock(&scheduler->lock);
+  if (!_large(scheduler, cost)) {
+    while (!scheduler->available || scheduler->gathering) {
+      pthread_cond_wait(&scheduler->changed, &scheduler->lock);
+    }
+    scheduler->available--;
+    scheduler->stats.small++;
+    pthread_mutex_unlock(&scheduler->lock);
+    return 1;
+  }
+  while (!_takable(scheduler, 1) || scheduler->gathering) {
+    pthread_cond_wait(&scheduler->changed, &scheduler->lock);
+  }
+  int granted = _takable(scheduler, scheduler->budget);
+  scheduler->available -= granted;
+  scheduler->large_held += granted;
+  if (granted < scheduler->budget) {
+    // Threads released soon go to this puzzle rather than to small ones
+    scheduler->gathering = true;
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += SCHEDULER_GATHER * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+    }
+    while (granted < scheduler->budget
+           && !pthread_cond_timedwait(
+                &scheduler->changed, &scheduler->lock, &deadline)) {
+      int count = _takable(scheduler, scheduler->budget - granted);
+      scheduler->available -= count;
+      scheduler->large_held += count;
+      granted += count;
+    }
+    scheduler->gathering = false;
+    pthread_cond_broadcast(&scheduler->changed);
+  }
+  scheduler->stats.large++;
+  scheduler->stats.granted += granted;
+  pthread_mutex_unlock(&scheduler->lock);
+  return granted;
+}
+
+/**
+ * @brief Give threads back to a scheduler
+ * @param scheduler The scheduler
+ * @param threads The number of threads granted by the acquisition
+ * @param cost The estimated cost given to the acquisition
+ */
+void nonogram_scheduler_release(
+  NonoGramScheduler *scheduler,
+  int threads,
+  double cost
+) {
+  pthread_mutex_lock(&scheduler->lock);
+  scheduler->available += threads;
+  if (_large(scheduler, cost)) {
+    scheduler->large_held -= threads;
+  }
+  pthread_cond_broadcast(&scheduler->changed);
+  pthread_mutex_unlock(&scheduler->lock);
+}
+
+/**
+ * @brief Get the counters of a scheduler
+ * @param scheduler The scheduler
+ * @param stats The counters to fill
+ */
+void nonogram_scheduler_get_stats(
+  NonoGramScheduler *scheduler,
+  NonoGramSchedulerStats *stats
+) {
+  pthread_mutex_lock(&scheduler->lock);
+  *stats = scheduler->stats;
+  pthread_mutex_unlock(&scheduler->lock);
+}
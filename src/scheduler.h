@@ -0,0 +1,85 @@
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+#include "./solver.h"
+
+/**
+ * NonoGramScheduler is a opaque structure that shares a number of solver
+ * threads between small puzzles, solved one per thread, and large puzzles,
+ * solved in parallel on several threads.
+ */
+typedef struct _NonoGramScheduler NonoGramScheduler;
+
+/**
+ * NonoGramSchedulerStats holds the counters of a scheduler.
+ */
+typedef struct {
+  long small;    // Number of small puzzles scheduled
+  long large;    // Number of large puzzles scheduled
+  long granted;  // Number of threads granted to the large puzzles
+} NonoGramSchedulerStats;
+
+/**
+ * @brief Create a new scheduler
+ * @param threads The number of solver threads to share
+ * @param budget The maximal number of threads of a large puzzle
+ * @param threshold The estimated cost from which a puzzle is large
+ * @return A new scheduler, or NULL if memory allocation fails
+ */
+extern NonoGramScheduler *nonogram_scheduler_create(
+  int threads,
+  int budget,
+  double threshold
+);
+/**
+ * @brief Destroy a scheduler
+ * @param scheduler The scheduler
+ */
+extern void nonogram_scheduler_destroy(NonoGramScheduler *scheduler);
+
+/**
+ * @brief Estimate the cost of a puzzle
+ * @param features The features of the puzzle, after presolve
+ * @return The number of cells left unknown by presolve
+ */
+extern double nonogram_scheduler_estimate(const NonoGramFeatures *features);
+
+/**
+ * @brief Wait for threads to solve a puzzle
+ * @param scheduler The scheduler
+ * @param cost The estimated cost of the puzzle
+ * @return The number of threads granted: 1 for a small puzzle, between 1
+ *         and the budget for a large one
+ * @note A large puzzle gathers threads as they are released for a short
+ *       while before settling for what it has, and large puzzles never hold
+ *       every thread, so that neither class waits for the other for long
+ */
+extern int nonogram_scheduler_acquire(
+  NonoGramScheduler *scheduler,
+  double cost
+);
+/**
+ * @brief Give threads back to a scheduler
+ * @param scheduler The scheduler
+ * @param threads The number of threads granted by the acquisition
+ * @param cost The estimated cost given to the acquisition
+ */
+extern void nonogram_scheduler_release(
+  NonoGramScheduler *scheduler,
+  int threads,
+  double cost
+);
+
+/**
+ * @brief Get the counters of a scheduler
+ * @param scheduler The scheduler
+ * @param stats The counters to fill
+ */
+extern void nonogram_scheduler_get_stats(
+  NonoGramScheduler *scheduler,
+  NonoGramSchedulerStats *stats
+);
+
+#endif  // SCHEDULER_H_
@@ -0,0 +1,757 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+/**
+ * @file service.c
+ * @brief Implementation of the solve service of the daemon.
+ *
+ * Every solve requested and not answered yet is a flight, kept in a table
+ * keyed by the canonical hash of its hints. A request for a puzzle already
+ * in flight becomes one more waiter of that flight, so that a burst of
+ * identical requests costs a single solve.
+ *
+ * Waiting flights are kept in a binary heap per priority class, ordered by
+ * earliest deadline. Admission compares the deadline of a request with the
+ * moving mean of the solve time times the number of flights that would be
+ * solved before it, and a running solve is cancelled from its progress
+ * callback once its latest deadline has passed.
+ */
+#include "./service.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "./cache.h"
+#include "./histogram.h"
+#include "./nonogram.h"
+#include "./scheduler.h"
+#include "./solver.h"
+#include "./table.h"
+
+#include "./service.inc"
+
+/**
+ * @brief Default estimated cost from which a puzzle is large
+ */
+#define SERVICE_LARGE_THRESHOLD 1000.0
+
+/**
+ * @brief Weight of the last solve in the moving mean of the solve time
+ */
+#define SERVICE_MEAN_WEIGHT 0.125
+
+/**
+ * @brief Number of line solver calls between two deadline checks
+ */
+#define SERVICE_CHECK_INTERVAL 64
+
+/**
+ * @brief Get the time of the monotonic clock
+ * @return The time in seconds
+ */
+static double _now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Compare the order of two waiting flights
+ * @param flight The first flight
+ * @param other The second flight
+ * @return true if the first flight is taken before the second one
+ */
+static bool _before(
+  const NonoGramServiceFlight *flight,
+  const NonoGramServiceFlight *other
+) {
+  if (flight->deadline != other->deadline) {
+    return flight->deadline < other->deadline;
+  }
+  return flight->sequence < other->sequence;
+}
+
+/**
+ * @brief Move a flight towards the top of its heap
+ * @param heap The heap
+ * @param position The index of the flight
+ */
+static void _sift_up(NonoGramServiceFlight **heap, size_t position) {
+  NonoGramServiceFlight *flight = heap[position];
+  while (position > 0) {
+    size_t parent = (position - 1) / 2;
+    if (!_before(flight, heap[parent])) {
+      break;
+    }
+    heap[position] = heap[parent];
+    heap[position]->position = position;
+    position = parent;
+  }
+  heap[position] = flight;
+  flight->position = position;
+}
+
+/**
+ * @brief Move a flight towards the bottom of its heap
+ * @param heap The heap
+ * @param count The number of flights in the heap
+ * @param position The index of the flight
+ */
+static void _sift_down(
+  NonoGramServiceFlight **heap,
+  size_t count,
+  size_t position
+) {
+  NonoGramServiceFlight *flight = heap[position];
+  for (;;) {
+    size_t child = 2 * position + 1;
+    if (child >= count) {
+      break;
+    }
+    if (child + 1 < count && _before(heap[child + 1], heap[child])) {
+      child++;
+    }
+    if (!_before(heap[child], flight)) {
+      break;
+    }
+    heap[position] = heap[child];
+    heap[position]->position = position;
+    position = child;
+  }
+  heap[position] = flight;
+  flight->position = position;
+}
+
+/**
+ * @brief Add a flight to the heap of its class
+ * @param service The service
+ * @param flight The flight
+ */
+static void _enqueue(NonoGramService *service, NonoGramServiceFlight *flight) {
+  size_t count = service->counts[flight->priority]++;
+  service->heaps[flight->priority][count] = flight;
+  _sift_up(service->heaps[flight->priority], count);
+  service->queued++;
+}
+
+/**
+ * @brief Remove a flight from the heap of its class
+ * @param service The service
+ * @param flight The flight
+ */
+static void _dequeue(NonoGramService *service, NonoGramServiceFlight *flight) {
+  NonoGramServiceFlight **heap = service->heaps[flight->priority];
+  size_t count = --service->counts[flight->priority];
+  size_t position = flight->position;
+  flight->position = -1;
+  service->queued--;
+  if (position == count) {
+    return;
+  }
+  NonoGramServiceFlight *last = heap[count];
+  heap[position] = last;
+  _sift_up(heap, position);
+  _sift_down(heap, count, last->position);
+}
+
+/**
+ * @brief Take the next waiting flight
+ * @param service The service
+ * @return The flight of the highest class with the earliest deadline, or
+ *         NULL if no flight is waiting
+ */
+static NonoGramServiceFlight *_take(NonoGramService *service) {
+  for (int priority = 0; priority < SERVICE_PRIORITIES; priority++) {
+    if (service->counts[priority]) {
+      NonoGramServiceFlight *flight = service->heaps[priority][0];
+      _dequeue(service, flight);
+      return flight;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Check whether a request can meet its deadline
+ * @param service The service
+ * @param priority The priority class of the request
+ * @param deadline The deadline of the request
+ * @param now The current time
+ * @return false if the solves taken before the request leave it no time
+ */
+static bool _admissible(
+  NonoGramService *service,
+  NonoGramPriority priority,
+  double deadline,
+  double now
+) {
+  if (isinf(deadline) || service->mean <= 0.0) {
+    return true;
+  }
+  size_t ahead = service->running;
+  for (int higher = 0; higher < (int) priority; higher++) {
+    ahead += service->counts[higher];
+  }
+  NonoGramServiceFlight **heap = service->heaps[priority];
+  for (size_t index = 0; index < service->counts[priority]; index++) {
+    ahead += heap[index]->deadline <= deadline;
+  }
+  // Every thread takes a flight at a time
+  double wait = service->mean * ahead / service->threads;
+  return now + wait + service->mean <= deadline;
+}
+
+/**
+ * @brief Create a new service
+ * @param threads The number of solver threads
+ * @param capacity The number of solves that can wait for a thread
+ * @return A new service, not started, or NULL if memory allocation fails
+ */
+NonoGramService *nonogram_service_create(int threads, size_t capacity) {
+  NonoGramService *service = calloc(1, sizeof(NonoGramService));
+  if (!service) {
+    return NULL;
+  }
+  service->threads = threads > 1 ? threads : 1;
+  service->capacity = capacity > 1 ? capacity : 1;
+  service->engine = NONOGRAM_ENGINE_AUTO;
+  service->budget = 1;
+  service->threshold = SERVICE_LARGE_THRESHOLD;
+  // Flights are either waiting or solved by a thread
+  size_t buckets = 2;
+  while (buckets < 2 * (service->capacity + service->threads)) {
+    buckets *= 2;
+  }
+  service->mask = buckets - 1;
+  service->buckets = calloc(buckets, sizeof(NonoGramServiceFlight *));
+  service->ids = calloc(service->threads, sizeof(pthread_t));
+  service->wait = nonogram_histogram_create();
+  service->solve = nonogram_histogram_create();
+  bool allocated = service->buckets && service->ids && service->wait
+    && service->solve;
+  for (int priority = 0; priority < SERVICE_PRIORITIES; priority++) {
+    service->heaps[priority] =
+      malloc(service->capacity * sizeof(NonoGramServiceFlight *));
+    allocated = allocated && service->heaps[priority];
+  }
+  if (!allocated) {
+    for (int priority = 0; priority < SERVICE_PRIORITIES; priority++) {
+      free(service->heaps[priority]);
+    }
+    if (service->wait) {
+      nonogram_histogram_destroy(service->wait);
+    }
+    if (service->solve) {
+      nonogram_histogram_destroy(service->solve);
+    }
+    free(service->buckets);
+    free(service->ids);
+    free(service);
+    return NULL;
+  }
+  pthread_mutex_init(&service->lock, NULL);
+  pthread_cond_init(&service->work, NULL);
+  return service;
+}
+
+/**
+ * @brief Answer the waiters of a flight and release it
+ * @param service The service
+ * @param flight The flight, taken from the heaps
+ * @param result The result of the solve
+ */
+static void _complete(
+  NonoGramService *service,
+  NonoGramServiceFlight *flight,
+  const NonoGramServiceResult *result
+) {
+  pthread_mutex_lock(&service->lock);
+  NonoGramServiceFlight **link =
+    &service->buckets[flight->hash & service->mask];
+  while (*link != flight) {
+    link = &(*link)->next;
+  }
+  *link = flight->next;
+  pthread_mutex_unlock(&service->lock);
+  // No request can be attached to the flight anymore
+  NonoGramServiceWaiter *waiter = flight->waiters;
+  while (waiter) {
+    NonoGramServiceWaiter *next = waiter->next;
+    waiter->callback(result, waiter->data);
+    free(waiter);
+    waiter = next;
+  }
+  if (service->cache && result->status == NONOGRAM_SOLVER_SOLVED) {
+    nonogram_cache_put(service->cache, flight->hints, result->cells);
+  } else {
+    nonogram_hints_destroy(flight->hints);
+  }
+  free(flight);
+}
+
+/**
+ * @brief Stop a solve once its deadline has passed
+ * @param nodes The number of decisions taken so far
+ * @param settled The number of cells currently settled
+ * @param data The budget of the solve
+ */
+static void _check_deadline(long nodes, int settled, void *data) {
+  (void) nodes;
+  (void) settled;
+  NonoGramServiceBudget *budget = data;
+  if (_now() >= budget->deadline) {
+    atomic_store(&budget->cancel, true);
+  }
+}
+
+/**
+ * @brief Solve a flight
+ * @param service The service
+ * @param flight The flight, taken from the heaps
+ * @return true if the deadline stopped the solve
+ */
+static bool _solve(NonoGramService *service, NonoGramServiceFlight *flight) {
+  int rows_count = nonogram_hints_get_rows_count(flight->hints);
+  int cols_count = nonogram_hints_get_cols_count(flight->hints);
+  signed char *cells = malloc((size_t) rows_count * cols_count);
+  NonoGramSolver *solver =
+    cells ? nonogram_solver_create(flight->hints) : NULL;
+  NonoGramServiceResult result = {
+    .status = NONOGRAM_SOLVER_STOPPED,
+    .rows_count = rows_count,
+    .cols_count = cols_count,
+    .cells = cells,
+  };
+  NonoGramServiceBudget budget = {.deadline = flight->budget};
+  atomic_init(&budget.cancel, false);
+  if (solver) {
+    double time_limit = service->time_limit;
+    if (!isinf(budget.deadline)) {
+      double left = budget.deadline - _now();
+      if (time_limit <= 0.0 || left < time_limit) {
+        time_limit = left > 0.0 ? left : 1e-3;
+      }
+      nonogram_solver_set_cancel(solver, &budget.cancel);
+      nonogram_solver_set_progress(
+        solver, _check_deadline, &budget, SERVICE_CHECK_INTERVAL);
+    }
+    nonogram_solver_set_time_limit(solver, time_limit);
+    nonogram_solver_set_node_limit(solver, service->node_limit);
+    NonoGramEngine engine = service->engine;
+    NonoGramFeatures features;
+    double cost = 0.0;
+    if (nonogram_solver_features(solver, &features)) {
+      cost = nonogram_scheduler_estimate(&features);
+      if (engine == NONOGRAM_ENGINE_AUTO) {
+        engine = nonogram_solver_select_engine(&features);
+      }
+    }
+    int threads = nonogram_scheduler_acquire(service->scheduler, cost);
+    result.status = nonogram_solver_solve_parallel(solver, engine, threads);
+    nonogram_scheduler_release(service->scheduler, threads, cost);
+    for (int row = 0; row < rows_count; row++) {
+      for (int col = 0; col < cols_count; col++) {
+        cells[row * cols_count + col] =
+          nonogram_solver_get_cell(solver, row, col);
+      }
+    }
+    nonogram_solver_destroy(solver);
+  }
+  if (!cells) {
+    result.rows_count = 0;
+    result.cols_count = 0;
+  }
+  _complete(service, flight, &result);
+  free(cells);
+  return result.status == NONOGRAM_SOLVER_STOPPED
+    && atomic_load(&budget.cancel);
+}
+
+/**
+ * @brief Run a solver thread
+ * @param data The service
+ * @return NULL
+ */
+static void *_run(void *data) {
+  NonoGramService *service = data;
+  pthread_mutex_lock(&service->lock);
+  for (;;) {
+    NonoGramServiceFlight *flight = _take(service);
+    if (!flight) {
+      if (service->stopping) {
+        break;
+      }
+      pthread_cond_wait(&service->work, &service->lock);
+      continue;
+    }
+    double start = _now();
+    nonogram_histogram_record(service->wait, start - flight->submitted);
+    if (start > flight->budget) {
+      // Every request of the flight has given up
+      service->stats.rejected++;
+      pthread_mutex_unlock(&service->lock);
+      NonoGramServiceResult result = {
+        .status = NONOGRAM_SOLVER_STOPPED,
+        .rejected = true,
+      };
+      _complete(service, flight, &result);
+      pthread_mutex_lock(&service->lock);
+      continue;
+    }
+    service->running++;
+    pthread_mutex_unlock(&service->lock);
+    bool expired = _solve(service, flight);
+    double elapsed = _now() - start;
+    nonogram_histogram_record(service->solve, elapsed);
+    pthread_mutex_lock(&service->lock);
+    service->running--;
+    service->stats.solves++;
+    service->stats.expired += expired;
+    service->mean = service->mean > 0.0
+      ? service->mean + SERVICE_MEAN_WEIGHT * (elapsed - service->mean)
+      : elapsed;
+  }
+  pthread_mutex_unlock(&service->lock);
+  return NULL;
+}
+
+/**
+ * @brief Start the solver threads of a service
+ * @param service The service
+ * @return false if no thread could be started
+ */
+bool nonogram_service_start(NonoGramService *service) {
+  service->scheduler = nonogram_scheduler_create(
+    service->threads, service->budget, service->threshold);
+  if (!service->scheduler) {
+    return false;
+  }
+  while (service->started < service->threads
+         && !pthread_create(
+              &service->ids[service->started], NULL, _run, service)) {
+    service->started++;
+  }
+  return service->started > 0;
+}
+
+/**
+ * @brief Stop and destroy a service
+ * @param service The service
+ */
+void nonogram_service_destroy(NonoGramService *service) {
+  pthread_mutex_lock(&service->lock);
+  service->stopping = true;
+  pthread_cond_broadcast(&service->work);
+  pthread_mutex_unlock(&service->lock);
+  for (int thread = 0; thread < service->started; thread++) {
+    pthread_join(service->ids[thread], NULL);
+  }
+  // Threads empty the heaps before leaving, unless none was started
+  NonoGramServiceFlight *flight;
+  NonoGramServiceResult result = {.status = NONOGRAM_SOLVER_STOPPED};
+  while ((flight = _take(service))) {
+    _complete(service, flight, &result);
+  }
+  if (service->scheduler) {
+    nonogram_scheduler_destroy(service->scheduler);
+  }
+  pthread_cond_destroy(&service->work);
+  pthread_mutex_destroy(&service->lock);
+  for (int priority = 0; priority < SERVICE_PRIORITIES; priority++) {
+    free(service->heaps[priority]);
+  }
+  nonogram_histogram_destroy(service->wait);
+  nonogram_histogram_destroy(service->solve);
+  free(service->buckets);
+  free(service->ids);
+  free(service);
+}
+
+/**
+ * @brief Attach a request to a flight
+ * @param service The service
+ * @param flight The flight
+ * @param priority The priority class of the request
+ * @param deadline The deadline of the request, or INFINITY
+ */
+static void _attach(
+  NonoGramService *service,
+  NonoGramServiceFlight *flight,
+  NonoGramPriority priority,
+  double deadline
+) {
+  if (flight->position < 0) {
+    // A running solve keeps the budget it started with
+    return;
+  }
+  if (deadline > flight->budget || isinf(deadline)) {
+    flight->budget = deadline;
+  }
+  // A waiting flight is promoted to its most urgent request
+  if (priority < flight->priority || deadline < flight->deadline) {
+    _dequeue(service, flight);
+    if (priority < flight->priority) {
+      flight->priority = priority;
+    }
+    if (deadline < flight->deadline) {
+      flight->deadline = deadline;
+    }
+    _enqueue(service, flight);
+  }
+}
+
+/**
+ * @brief Answer a request from the table or the cache
+ * @param service The service
+ * @param hints The hints of the request, destroyed if they are found
+ * @param callback The callback receiving the answer
+ * @param data The data given to the callback
+ * @return true if the request has been answered
+ */
+static bool _answer_cached(
+  NonoGramService *service,
+  NonoGramHints *hints,
+  NonoGramServiceCallback callback,
+  void *data
+) {
+  int rows_count = nonogram_hints_get_rows_count(hints);
+  int cols_count = nonogram_hints_get_cols_count(hints);
+  signed char *cells = malloc((size_t) rows_count * cols_count + 1);
+  int solutions = cells && service->table
+    ? nonogram_table_lookup(service->table, hints, cells)
+    : -1;
+  if (!cells
+      || (solutions < 0
+          && (!service->cache
+              || !nonogram_cache_get(service->cache, hints, cells)))) {
+    free(cells);
+    return false;
+  }
+  if (!solutions) {
+    memset(cells, -1, (size_t) rows_count * cols_count);
+  }
+  pthread_mutex_lock(&service->lock);
+  bool stopping = service->stopping;
+  if (!stopping) {
+    service->stats.requests++;
+    if (solutions < 0) {
+      service->stats.cached++;
+    } else {
+      service->stats.tabled++;
+    }
+  }
+  pthread_mutex_unlock(&service->lock);
+  if (!stopping) {
+    NonoGramServiceResult result = {
+      .status = solutions ? NONOGRAM_SOLVER_SOLVED : NONOGRAM_SOLVER_FAILED,
+      .rows_count = rows_count,
+      .cols_count = cols_count,
+      .cells = cells,
+    };
+    callback(&result, data);
+    nonogram_hints_destroy(hints);
+  }
+  free(cells);
+  return !stopping;
+}
+
+/**
+ * @brief Submit a solve request
+ * @param service The service
+ * @param hints The hints of the puzzle, owned by the service from now on
+ * @param priority The priority class of the request
+ * @param deadline The time left to answer in seconds, 0 for none
+ * @param callback The callback receiving the answer
+ * @param data The data given to the callback
+ * @return false if the service is stopping
+ */
+bool nonogram_service_submit(
+  NonoGramService *service,
+  NonoGramHints *hints,
+  NonoGramPriority priority,
+  double deadline,
+  NonoGramServiceCallback callback,
+  void *data
+) {
+  NonoGramServiceWaiter *waiter = malloc(sizeof(NonoGramServiceWaiter));
+  if (!waiter) {
+    nonogram_hints_destroy(hints);
+    return false;
+  }
+  waiter->callback = callback;
+  waiter->data = data;
+  if ((int) priority < 0 || (int) priority >= SERVICE_PRIORITIES) {
+    priority = NONOGRAM_PRIORITY_NORMAL;
+  }
+  double now = _now();
+  deadline = deadline > 0.0 ? now + deadline : INFINITY;
+  if ((service->table || service->cache)
+      && _answer_cached(service, hints, callback, data)) {
+    free(waiter);
+    return true;
+  }
+  uint64_t hash = nonogram_hints_hash(hints);
+  pthread_mutex_lock(&service->lock);
+  if (service->stopping) {
+    pthread_mutex_unlock(&service->lock);
+    nonogram_hints_destroy(hints);
+    free(waiter);
+    return false;
+  }
+  service->stats.requests++;
+  NonoGramServiceFlight **bucket = &service->buckets[hash & service->mask];
+  for (NonoGramServiceFlight *flight = *bucket; flight; flight = flight->next) {
+    if (flight->hash == hash && nonogram_hints_equal(flight->hints, hints)) {
+      waiter->next = flight->waiters;
+      flight->waiters = waiter;
+      _attach(service, flight, priority, deadline);
+      service->stats.coalesced++;
+      pthread_mutex_unlock(&service->lock);
+      nonogram_hints_destroy(hints);
+      return true;
+    }
+  }
+  NonoGramServiceFlight *flight = NULL;
+  if (service->queued < service->capacity
+      && _admissible(service, priority, deadline, now)) {
+    flight = malloc(sizeof(NonoGramServiceFlight));
+  }
+  if (!flight) {
+    service->stats.rejected++;
+    pthread_mutex_unlock(&service->lock);
+    nonogram_hints_destroy(hints);
+    free(waiter);
+    NonoGramServiceResult result = {
+      .status = NONOGRAM_SOLVER_STOPPED,
+      .rejected = true,
+    };
+    callback(&result, data);
+    return true;
+  }
+  waiter->next = NULL;
+  flight->hash = hash;
+  flight->hints = hints;
+  flight->waiters = waiter;
+  flight->next = *bucket;
+  flight->priority = priority;
+  flight->deadline = deadline;
+  flight->budget = deadline;
+  flight->sequence = service->sequence++;
+  flight->submitted = now;
+  *bucket = flight;
+  _enqueue(service, flight);
+  pthread_cond_signal(&service->work);
+  pthread_mutex_unlock(&service->lock);
+  return true;
+}
+
+/**
+ * @brief Set the engine of the solves of a service
+ * @param service The service, not started
+ * @param engine The engine
+ */
+void nonogram_service_set_engine(
+  NonoGramService *service,
+  NonoGramEngine engine
+) {
+  service->engine = engine;
+}
+
+/**
+ * @brief Set the limits of the solves of a service
+ * @param service The service, not started
+ * @param time_limit The time limit of the local search, 0 for none
+ * @param node_limit The maximal number of decisions, 0 for none
+ */
+void nonogram_service_set_limits(
+  NonoGramService *service,
+  double time_limit,
+  long node_limit
+) {
+  service->time_limit = time_limit;
+  service->node_limit = node_limit;
+}
+
+/**
+ * @brief Solve the large puzzles of a service on several threads
+ * @param service The service, not started
+ * @param budget The maximal number of threads of a large puzzle
+ * @param threshold The number of cells left unknown by presolve from which
+ *        a puzzle is large
+ */
+void nonogram_service_set_parallel(
+  NonoGramService *service,
+  int budget,
+  double threshold
+) {
+  service->budget = budget;
+  service->threshold = threshold;
+}
+
+/**
+ * @brief Share a cache of solved puzzles with a service
+ * @param service The service, not started
+ * @param cache The cache, owned by the caller, or NULL for none
+ */
+void nonogram_service_set_cache(
+  NonoGramService *service,
+  NonoGramCache *cache
+) {
+  service->cache = cache;
+}
+
+/**
+ * @brief Share a table of tiny puzzles with a service
+ * @param service The service, not started
+ * @param table The table, owned by the caller, or NULL for none
+ */
+void nonogram_service_set_table(
+  NonoGramService *service,
+  NonoGramTable *table
+) {
+  service->table = table;
+}
+
+/**
+ * @brief Get the counters of a service
+ * @param service The service
+ * @param stats The counters to fill
+ */
+void nonogram_service_get_stats(
+  NonoGramService *service,
+  NonoGramServiceStats *stats
+) {
+  pthread_mutex_lock(&service->lock);
+  *stats = service->stats;
+  stats->queued = service->queued;
+  stats->running = service->running;
+  pthread_mutex_unlock(&service->lock);
+}
+
+/**
+ * @brief Get the histogram of the time spent by solves waiting for a thread
+ * @param service The service
+ * @return The histogram, owned by the service
+ */
+NonoGramHistogram *nonogram_service_get_wait_histogram(
+  NonoGramService *service
+) {
+  return service->wait;
+}
+
+/**
+ * @brief Get the histogram of the time spent by solves on a thread
+ * @param service The service
+ * @return The histogram, owned by the service
+ */
+NonoGramHistogram *nonogram_service_get_solve_histogram(
+  NonoGramService *service
+) {
+  return service->solve;
+}
@@ -0,0 +1,204 @@
+#ifndef SERVICE_H_
+#define SERVICE_H_
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "./cache.h"
+#include "./histogram.h"
+#include "./nonogram.h"
+#include "./solver.h"
+#include "./table.h"
+
+/**
+ * NonoGramService is a opaque structure that represents a pool of solver
+ * threads answering solve requests, as run by the daemon.
+ */
+typedef struct _NonoGramService NonoGramService;
+
+/**
+ * NonoGramPriority enumerates the priority classes of the requests.
+ */
+typedef enum {
+  NONOGRAM_PRIORITY_INTERACTIVE,  // Requests of a waiting user
+  NONOGRAM_PRIORITY_NORMAL,       // Default class
+  NONOGRAM_PRIORITY_BULK,         // Requests that can wait
+} NonoGramPriority;
+
+/**
+ * NonoGramServiceResult is the answer to a solve request.
+ */
+typedef struct {
+  NonoGramStatus status;     // Status of the solve
+  bool rejected;             // Whether the deadline could not be met
+  int rows_count;            // Number of rows
+  int cols_count;            // Number of columns
+  const signed char *cells;  // Cells of the board, row by row
+} NonoGramServiceResult;
+
+/**
+ * NonoGramServiceCallback receives the answer to a request.
+ * @param result The result, valid during the call only
+ * @param data The data given with the request
+ * @note The callback is called by a solver thread
+ */
+typedef void (*NonoGramServiceCallback)(
+  const NonoGramServiceResult *result,
+  void *data
+);
+
+/**
+ * NonoGramServiceStats holds the counters of a service.
+ */
+typedef struct {
+  long requests;   // Number of requests accepted
+  long solves;     // Number of solves run
+  long coalesced;  // Number of requests attached to a running solve
+  long rejected;   // Number of requests answered without a solve
+  long expired;    // Number of solves stopped by their deadline
+  long queued;     // Number of solves waiting for a thread
+  long running;    // Number of solves running
+  long cached;     // Number of requests answered by the cache
+  long tabled;     // Number of requests answered by the table
+} NonoGramServiceStats;
+
+/**
+ * @brief Create a new service
+ * @param threads The number of solver threads
+ * @param capacity The number of solves that can wait for a thread
+ * @return A new service, not started, or NULL if memory allocation fails
+ */
+extern NonoGramService *nonogram_service_create(int threads, size_t capacity);
+/**
+ * @brief Stop and destroy a service
+ * @param service The service
+ * @note Waiting requests are solved and answered first
+ */
+extern void nonogram_service_destroy(NonoGramService *service);
+
+/**
+ * @brief Start the solver threads of a service
+ * @param service The service
+ * @return false if no thread could be started
+ */
+extern bool nonogram_service_start(NonoGramService *service);
+
+/**
+ * @brief Submit a solve request
+ * @param service The service
+ * @param hints The hints of the puzzle, owned by the service from now on
+ * @param priority The priority class of the request
+ * @param deadline The time left to answer in seconds, 0 for none
+ * @param callback The callback receiving the answer
+ * @param data The data given to the callback
+ * @return false if the service is stopping, the hints are then destroyed
+ * @note Waiting solves are taken by priority class, then by earliest
+ *       deadline, then in submission order
+ * @note A request for hints equal to those of a solve not finished yet is
+ *       attached to that solve instead of being solved again, and every
+ *       attached request receives its result. A waiting solve takes the
+ *       highest priority and the earliest deadline of its requests
+ * @note A request is rejected, and answered at once by the calling thread,
+ *       when the queue of solves is full or when the mean solve time and the
+ *       solves taken before it show that its deadline cannot be met. Solves
+ *       whose deadlines have all passed are rejected when they reach a
+ *       thread, others are stopped at their latest deadline
+ * @note A request for a puzzle found in the table or in the cache of the
+ *       service is answered at once by the calling thread
+ */
+extern bool nonogram_service_submit(
+  NonoGramService *service,
+  NonoGramHints *hints,
+  NonoGramPriority priority,
+  double deadline,
+  NonoGramServiceCallback callback,
+  void *data
+);
+
+/**
+ * @brief Set the engine of the solves of a service
+ * @param service The service, not started
+ * @param engine The engine, NONOGRAM_ENGINE_AUTO by default
+ */
+extern void nonogram_service_set_engine(
+  NonoGramService *service,
+  NonoGramEngine engine
+);
+/**
+ * @brief Set the limits of the solves of a service
+ * @param service The service, not started
+ * @param time_limit The time limit of the local search, 0 for none
+ * @param node_limit The maximal number of decisions, 0 for none
+ */
+extern void nonogram_service_set_limits(
+  NonoGramService *service,
+  double time_limit,
+  long node_limit
+);
+/**
+ * @brief Solve the large puzzles of a service on several threads
+ * @param service The service, not started
+ * @param budget The maximal number of threads of a large puzzle
+ * @param threshold The number of cells left unknown by presolve from which
+ *        a puzzle is large
+ * @note Puzzles are solved one per thread by default
+ */
+extern void nonogram_service_set_parallel(
+  NonoGramService *service,
+  int budget,
+  double threshold
+);
+/**
+ * @brief Share a cache of solved puzzles with a service
+ * @param service The service, not started
+ * @param cache The cache, owned by the caller, or NULL for none
+ * @note Requests are looked up in the cache before being queued, and the
+ *       puzzles solved by the service are added to it. Several services can
+ *       share a cache
+ */
+extern void nonogram_service_set_cache(
+  NonoGramService *service,
+  NonoGramCache *cache
+);
+/**
+ * @brief Share a table of tiny puzzles with a service
+ * @param service The service, not started
+ * @param table The table, owned by the caller, or NULL for none
+ * @note Requests are looked up in the table before the cache, a puzzle of
+ *       the table having no solution is answered failed
+ */
+extern void nonogram_service_set_table(
+  NonoGramService *service,
+  NonoGramTable *table
+);
+
+/**
+ * @brief Get the counters of a service
+ * @param service The service
+ * @param stats The counters to fill
+ */
+extern void nonogram_service_get_stats(
+  NonoGramService *service,
+  NonoGramServiceStats *stats
+);
+
+/**
+ * @brief Get the histogram of the time spent by solves waiting for a thread
+ * @param service The service
+ * @return The histogram, owned by the service
+ */
+extern NonoGramHistogram *nonogram_service_get_wait_histogram(
+  NonoGramService *service
+);
+/**
+ * @brief Get the histogram of the time spent by solves on a thread
+ * @param service The service
+ * @return The histogram, owned by the service
+ */
+extern NonoGramHistogram *nonogram_service_get_solve_histogram(
+  NonoGramService *service
+);
+
+#endif  // SERVICE_H_
@@ -0,0 +1,2004 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+/**
+ * @file solver.c
+ * @brief Implementation of the nonogram solver.
+ *
+ * Each line is solved exactly by a dynamic programming line solver, lines are
+ * propagated to a fixpoint, and the remaining cells are settled by a
+ * depth-first search keeping an explicit decision stack. Since the whole
+ * search state lives in the solver, a paused solve can be saved to a
+ * checkpoint file and resumed by another process.
+ */
+#include "./solver.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "./localsearch.h"
+#include "./nonogram.h"
+
+#include "./nonogram.inc"
+#include "./solver.inc"
+#include "./solver-rules.inc"
+
+/**
+ * @brief Moves per cell of the local search when no time limit is set
+ */
+#define LOCAL_SEARCH_MOVES 200
+
+/**
+ * @brief Milliseconds between two checks of the cancellation flag while
+ *        waiting for the members of a parallel solve
+ */
+#define PORTFOLIO_POLL 10
+
+/**
+ * @brief Line solves and local search moves of a member per round of a
+ *        deterministic parallel solve
+ */
+#define PORTFOLIO_ROUND 1024
+
+/**
+ * @brief Magic bytes of a checkpoint file
+ */
+#define CHECKPOINT_MAGIC "NONOSAVE"
+
+/**
+ * @brief Version of the checkpoint format
+ */
+#define CHECKPOINT_VERSION 1
+
+/**
+ * @brief Byte order mark of a checkpoint file
+ */
+#define CHECKPOINT_BYTE_ORDER 0x01020304u
+
+/**
+ * @brief Engines given in turn to the members of a parallel solve
+ */
+static const NonoGramEngine _portfolio_engines[] = {
+  NONOGRAM_ENGINE_PROBE, NONOGRAM_ENGINE_LOCAL, NONOGRAM_ENGINE_DFS
+};
+
+/**
+ * @brief Get the length of a line
+ * @param solver The solver
+ * @param line The line index
+ * @return The number of cells in the line
+ */
+static inline int _line_length(const NonoGramSolver *solver, int line) {
+  return line < solver->rows_count ? solver->cols_count : solver->rows_count;
+}
+
+/**
+ * @brief Get the index of a cell of a line
+ * @param solver The solver
+ * @param line The line index
+ * @param position The position of the cell in the line
+ * @return The index of the cell in the board
+ */
+static inline int _line_cell(
+  const NonoGramSolver *solver,
+  int line,
+  int position
+) {
+  if (line < solver->rows_count) {
+    return line * solver->cols_count + position;
+  }
+  return position * solver->cols_count + line - solver->rows_count;
+}
+
+/**
+ * @brief Add a line to the propagation queue
+ * @param solver The solver
+ * @param line The line index
+ */
+static void _enqueue(NonoGramSolver *solver, int line) {
+  if (!solver->queued[line]) {
+    solver->queued[line] = true;
+    solver->queue[(solver->queue_head + solver->queue_count)
+                  % solver->lines_count] = line;
+    solver->queue_count++;
+  }
+}
+
+/**
+ * @brief Empty the propagation queue
+ * @param solver The solver
+ */
+static void _clear_queue(NonoGramSolver *solver) {
+  while (solver->queue_count) {
+    solver->queued[solver->queue[solver->queue_head]] = false;
+    solver->queue_head = (solver->queue_head + 1) % solver->lines_count;
+    solver->queue_count--;
+  }
+}
+
+/**
+ * @brief Assign a cell and record it on the trail
+ * @param solver The solver
+ * @param cell The cell index
+ * @param value The value of the cell
+ */
+static void _assign(NonoGramSolver *solver, int cell, signed char value) {
+  assert(solver->cells[cell] == -1);
+  solver->cells[cell] = value;
+  solver->trail[solver->trail_count++] = cell;
+}
+
+/**
+ * @brief Assign a cell and queue its row and column
+ * @param solver The solver
+ * @param cell The cell index
+ * @param value The value of the cell
+ */
+static void _decide(NonoGramSolver *solver, int cell, signed char value) {
+  _assign(solver, cell, value);
+  _enqueue(solver, cell / solver->cols_count);
+  _enqueue(solver, solver->rows_count + cell % solver->cols_count);
+}
+
+/**
+ * @brief Unassign the cells recorded after a given trail length
+ * @param solver The solver
+ * @param trail_count The trail length to restore
+ */
+static void _undo(NonoGramSolver *solver, int trail_count) {
+  while (solver->trail_count > trail_count) {
+    solver->cells[solver->trail[--solver->trail_count]] = -1;
+  }
+}
+
+/**
+ * @brief Solve a line
+ *
+ * This function computes, for each unknown cell of the line, whether it is
+ * empty or filled in every placement of the blocks compatible with the known
+ * cells, assigns the cells settled this way and queues the crossing lines.
+ *
+ * @param solver The solver
+ * @param line The line index
+ * @return false if no placement of the blocks is compatible with the line
+ */
+static bool _line_solve(NonoGramSolver *solver, int line) {
+  int length = _line_length(solver, line);
+  int count = solver->blocks_count[line];
+  const int *blocks = solver->blocks[line];
+  signed char *values = solver->line;
+  int *zeros = solver->zeros;
+  bool *forward = solver->forward;
+  bool *backward = solver->backward;
+  int *cover = solver->cover;
+  int width = length + 1;
+
+  if (count < 0) {
+    return true;
+  }
+  solver->stats.propagations++;
+
+  zeros[0] = 0;
+  for (int position = 0; position < length; position++) {
+    values[position] = solver->cells[_line_cell(solver, line, position)];
+    zeros[position + 1] = zeros[position] + (values[position] == 0);
+  }
+
+  // forward[block * width + end]: blocks before block fit in [0, end)
+  forward[0] = true;
+  for (int end = 1; end <= length; end++) {
+    forward[end] = forward[end - 1] && values[end - 1] != 1;
+  }
+  for (int block = 1; block <= count; block++) {
+    int size = blocks[block - 1];
+    bool *current = forward + block * width;
+    const bool *previous = current - width;
+    current[0] = false;
+    for (int end = 1; end <= length; end++) {
+      bool fit = current[end - 1] && values[end - 1] != 1;
+      int start = end - size;
+      if (!fit && start >= 0 && zeros[end] == zeros[start]) {
+        if (start == 0) {
+          fit = block == 1;
+        } else {
+          fit = values[start - 1] != 1 && previous[start - 1];
+        }
+      }
+      current[end] = fit;
+    }
+  }
+  if (!forward[count * width + length]) {
+    return false;
+  }
+
+  // backward[block * width + start]: blocks from block fit in [start, length)
+  bool *last = backward + count * width;
+  last[length] = true;
+  for (int start = length - 1; start >= 0; start--) {
+    last[start] = last[start + 1] && values[start] != 1;
+  }
+  for (int block = count - 1; block >= 0; block--) {
+    int size = blocks[block];
+    bool *current = backward + block * width;
+    const bool *next = current + width;
+    current[length] = false;
+    for (int start = length - 1; start >= 0; start--) {
+      bool fit = current[start + 1] && values[start] != 1;
+      int end = start + size;
+      if (!fit && end <= length && zeros[end] == zeros[start]) {
+        if (end == length) {
+          fit = block == count - 1;
+        } else {
+          fit = values[end] != 1 && next[end + 1];
+        }
+      }
+      current[start] = fit;
+    }
+  }
+
+  // Cells covered by at least one valid placement of a block can be filled
+  memset(cover, 0, (length + 1) * sizeof(int));
+  for (int block = 0; block < count; block++) {
+    int size = blocks[block];
+    const bool *before = forward + block * width;
+    const bool *after = backward + (block + 1) * width;
+    for (int start = 0; start + size <= length; start++) {
+      int end = start + size;
+      if (zeros[end] != zeros[start]) {
+        continue;
+      }
+      if (start == 0 ? block != 0
+                     : values[start - 1] == 1 || !before[start - 1]) {
+        continue;
+      }
+      if (end == length ? block != count - 1
+                        : values[end] == 1 || !after[end + 1]) {
+        continue;
+      }
+      cover[start]++;
+      cover[end]--;
+    }
+  }
+
+  int covered = 0;
+  for (int position = 0; position < length; position++) {
+    covered += cover[position];
+    if (values[position] != -1) {
+      continue;
+    }
+    bool can_fill = covered > 0;
+    bool can_empty = false;
+    for (int block = 0; block <= count && !can_empty; block++) {
+      can_empty = forward[block * width + position]
+                  && backward[block * width + position + 1];
+    }
+    if (can_fill == can_empty) {
+      continue;
+    }
+    int cell = _line_cell(solver, line, position);
+    _assign(solver, cell, can_fill ? 1 : 0);
+    if (line < solver->rows_count) {
+      _enqueue(solver, solver->rows_count + position);
+    } else {
+      _enqueue(solver, position);
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Report the progress of a solve and check whether it must pause
+ * @param solver The solver
+ * @return true if the solve has been cancelled or its step budget is spent
+ * @note This is called before every line solve, so that a cancellation is
+ *       observed after a bounded amount of work wherever the search is
+ */
+static bool _interrupted(NonoGramSolver *solver) {
+  if (solver->budget == 0) {
+    solver->exhausted = true;
+    solver->interrupted = true;
+  } else if (solver->budget > 0) {
+    solver->budget--;
+  }
+  if (solver->progress && ++solver->ticks >= solver->progress_interval) {
+    solver->ticks = 0;
+    solver->progress(
+      solver->stats.nodes, solver->trail_count, solver->progress_data);
+  }
+  if (solver->cancel
+      && atomic_load_explicit(solver->cancel, memory_order_relaxed)) {
+    solver->interrupted = true;
+  }
+  return solver->interrupted;
+}
+
+/**
+ * @brief Propagate the queued lines to a fixpoint
+ * @param solver The solver
+ * @return false if a contradiction has been found or if the solve has been
+ *         cancelled, the queue is then kept so that propagation can resume
+ */
+static bool _propagate(NonoGramSolver *solver) {
+  if (!solver->started) {
+    solver->started = true;
+    for (int line = 0; line < solver->lines_count; line++) {
+      _enqueue(solver, line);
+    }
+  }
+  while (solver->queue_count) {
+    if (_interrupted(solver)) {
+      return false;
+    }
+    int line = solver->queue[solver->queue_head];
+    solver->queue_head = (solver->queue_head + 1) % solver->lines_count;
+    solver->queue_count--;
+    solver->queued[line] = false;
+    if (!_line_solve(solver, line)) {
+      _clear_queue(solver);
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Settle cells whose values lead to a contradiction
+ *
+ * Each unknown cell is tentatively given both values; a value whose
+ * propagation fails proves the other one. Cells are probed cyclically until
+ * a whole cycle settles nothing. An interrupted probe is kept on the trail
+ * and its propagation resumes with the next call.
+ *
+ * @param solver The solver
+ * @return false if a contradiction has been found or if the solve has been
+ *         interrupted
+ */
+static bool _probe(NonoGramSolver *solver) {
+  while (solver->probe_quiet < solver->cells_count) {
+    int cell = solver->probe_cell;
+    if (!solver->probing) {
+      if (solver->cells[cell] != -1) {
+        solver->probe_cell = (cell + 1) % solver->cells_count;
+        solver->probe_quiet++;
+        continue;
+      }
+      solver->stats.probes++;
+      solver->probing = true;
+      solver->probe_value = 1;
+      solver->probe_trail = solver->trail_count;
+      _decide(solver, cell, 1);
+    }
+    bool consistent = _propagate(solver);
+    if (solver->interrupted) {
+      return false;
+    }
+    _undo(solver, solver->probe_trail);
+    if (consistent && solver->probe_value == 1) {
+      solver->probe_value = 0;
+      _decide(solver, cell, 0);
+      continue;
+    }
+    solver->probing = false;
+    solver->probe_cell = (cell + 1) % solver->cells_count;
+    solver->probe_quiet++;
+    if (!consistent) {
+      solver->probe_quiet = 0;
+      _decide(solver, cell, 1 - solver->probe_value);
+      if (!_propagate(solver)) {
+        if (!solver->interrupted) {
+          solver->probe_cell = 0;
+        }
+        return false;
+      }
+    }
+  }
+  solver->probe_cell = 0;
+  solver->probe_quiet = 0;
+  return true;
+}
+
+/**
+ * @brief Undo a probe interrupted by a solve that does not resume it
+ * @param solver The solver
+ */
+static void _abandon_probe(NonoGramSolver *solver) {
+  if (solver->probing) {
+    solver->probing = false;
+    _clear_queue(solver);
+    _undo(solver, solver->probe_trail);
+  }
+  solver->probe_cell = 0;
+  solver->probe_quiet = 0;
+}
+
+/**
+ * @brief Choose the next cell to decide
+ *
+ * The first unknown cell of the line with the fewest unknown cells is chosen.
+ *
+ * @param solver The solver
+ * @return The index of the cell, or -1 if every cell is assigned
+ */
+static int _choose(NonoGramSolver *solver) {
+  int best_cell = -1;
+  int best_unknowns = 0;
+  for (int line = 0; line < solver->lines_count; line++) {
+    int length = _line_length(solver, line);
+    int unknowns = 0;
+    int first = -1;
+    for (int position = 0; position < length; position++) {
+      int cell = _line_cell(solver, line, position);
+      if (solver->cells[cell] == -1) {
+        if (first == -1) {
+          first = cell;
+        }
+        unknowns++;
+      }
+    }
+    if (unknowns && (best_cell == -1 || unknowns < best_unknowns)) {
+      best_cell = first;
+      best_unknowns = unknowns;
+    }
+  }
+  return best_cell;
+}
+
+/**
+ * @brief Refute the last decision that still has an untried value
+ * @param solver The solver
+ * @return false if every decision has been refuted
+ */
+static bool _backtrack(NonoGramSolver *solver) {
+  while (solver->decisions_count) {
+    NonoGramDecision *decision =
+      &solver->decisions[solver->decisions_count - 1];
+    _undo(solver, decision->trail_count);
+    if (!decision->flipped) {
+      solver->stats.backtracks++;
+      decision->flipped = true;
+      decision->value = 1 - decision->value;
+      _decide(solver, decision->cell, decision->value);
+      return true;
+    }
+    solver->decisions_count--;
+  }
+  return false;
+}
+
+/**
+ * @brief Run an engine from the current state of a solver
+ * @param solver The solver
+ * @param engine The engine, NONOGRAM_ENGINE_AUTO is not allowed
+ * @return The status of the solve
+ */
+static NonoGramStatus _search(NonoGramSolver *solver, NonoGramEngine engine) {
+  if (engine != NONOGRAM_ENGINE_PROBE) {
+    _abandon_probe(solver);
+  }
+  for (;;) {
+    // An interrupted probe resumes its own propagation
+    bool consistent = solver->probing || _propagate(solver);
+    if (consistent && engine == NONOGRAM_ENGINE_PROBE) {
+      consistent = _probe(solver);
+    }
+    if (solver->interrupted) {
+      return NONOGRAM_SOLVER_STOPPED;
+    }
+    if (!consistent) {
+      if (engine == NONOGRAM_ENGINE_LINE || !_backtrack(solver)) {
+        solver->conflict = true;
+        return NONOGRAM_SOLVER_FAILED;
+      }
+      continue;
+    }
+    if (solver->trail_count == solver->cells_count) {
+      return NONOGRAM_SOLVER_SOLVED;
+    }
+    if (engine == NONOGRAM_ENGINE_LINE) {
+      return NONOGRAM_SOLVER_FAILED;
+    }
+    if (solver->node_limit && solver->stats.nodes >= solver->node_limit) {
+      return NONOGRAM_SOLVER_STOPPED;
+    }
+    int cell = _choose(solver);
+    NonoGramDecision *decision = &solver->decisions[solver->decisions_count++];
+    decision->trail_count = solver->trail_count;
+    decision->cell = cell;
+    decision->value = solver->phase[cell] == -1 ? 1 : solver->phase[cell];
+    decision->flipped = false;
+    solver->stats.nodes++;
+    _decide(solver, cell, decision->value);
+  }
+}
+
+/**
+ * @brief Run the local search engine
+ *
+ * A board satisfying every clue found by the local search is installed as
+ * the solution; otherwise the best board warm-starts a probing search.
+ * Within a step, the local search runs at most one move per unit of budget
+ * and is kept in the solver until its default move budget is spent.
+ *
+ * @param solver The solver
+ * @return The status of the solve
+ */
+static NonoGramStatus _local_search(NonoGramSolver *solver) {
+  if (solver->warmed) {
+    return _search(solver, NONOGRAM_ENGINE_PROBE);
+  }
+  if (!solver->search) {
+    solver->search = nonogram_local_search_create(solver->hints, solver->seed);
+    if (!solver->search) {
+      solver->warmed = true;
+      return _search(solver, NONOGRAM_ENGINE_PROBE);
+    }
+    nonogram_local_search_set_cancel(solver->search, solver->cancel);
+  }
+  NonoGramLocalSearch *search = solver->search;
+  long total = LOCAL_SEARCH_MOVES * solver->cells_count;
+  bool solved;
+  if (solver->budget < 0) {
+    solved = nonogram_local_search_run(
+      search, solver->time_limit, solver->time_limit > 0 ? 0 : total);
+  } else {
+    long first = nonogram_local_search_get_moves(search);
+    long moves = total - first;
+    if (moves > solver->budget) {
+      moves = solver->budget;
+    }
+    solved = moves > 0 && nonogram_local_search_run(search, 0, moves);
+    solver->budget -= nonogram_local_search_get_moves(search) - first;
+    if (!solved && nonogram_local_search_get_moves(search) < total) {
+      solver->exhausted = solver->budget == 0;
+      solver->interrupted = true;
+      return NONOGRAM_SOLVER_STOPPED;
+    }
+  }
+  // The local search ignores the given cells, its board must agree with them
+  for (int cell = 0; solved && cell < solver->cells_count; cell++) {
+    solved = solver->cells[cell] == -1
+      || solver->cells[cell] == nonogram_local_search_get_cell(
+        search, cell / solver->cols_count, cell % solver->cols_count);
+  }
+  for (int cell = 0; cell < solver->cells_count; cell++) {
+    int value = nonogram_local_search_get_cell(
+      search, cell / solver->cols_count, cell % solver->cols_count);
+    if (!solved) {
+      solver->phase[cell] = value;
+    } else if (solver->cells[cell] == -1) {
+      _assign(solver, cell, value);
+    }
+  }
+  nonogram_local_search_destroy(search);
+  solver->search = NULL;
+  solver->warmed = true;
+  if (solved) {
+    return NONOGRAM_SOLVER_SOLVED;
+  }
+  if (_interrupted(solver)) {
+    return NONOGRAM_SOLVER_STOPPED;
+  }
+  return _search(solver, NONOGRAM_ENGINE_PROBE);
+}
+
+/**
+ * @brief Count the blocks of a hints line
+ * @param values The hints of the line, terminated by 0
+ * @param length The length of the line
+ * @return The number of blocks of the line
+ */
+static int _count_blocks(const int *values, int length) {
+  int count = 0;
+  while (count < length && values[count] > 0) {
+    count++;
+  }
+  return count;
+}
+
+/**
+ * @brief Create a new solver for a nonogram hints object
+ *
+ * This function allocates the board, the search stacks and the line solver
+ * workspace, sized for the largest line of the puzzle, and settles the given
+ * cells of the hints.
+ *
+ * @param hints The nonogram hints object
+ * @return A new solver, or NULL if memory allocation fails
+ */
+NonoGramSolver *nonogram_solver_create(NonoGramHints *hints) {
+  if (!hints || hints->rows_count <= 0 || hints->cols_count <= 0) {
+    return NULL;
+  }
+  NonoGramSolver *solver = calloc(1, sizeof(NonoGramSolver));
+  if (!solver) {
+    return NULL;
+  }
+  solver->hints = hints;
+  solver->rows_count = hints->rows_count;
+  solver->cols_count = hints->cols_count;
+  solver->lines_count = hints->rows_count + hints->cols_count;
+  solver->cells_count = hints->rows_count * hints->cols_count;
+
+  int length = solver->rows_count > solver->cols_count ? solver->rows_count
+                                                       : solver->cols_count;
+  int width = (length + 1) * (length + 2);
+  solver->blocks = malloc(solver->lines_count * sizeof(int *));
+  solver->blocks_count = malloc(solver->lines_count * sizeof(int));
+  solver->cells = malloc(solver->cells_count * sizeof(signed char));
+  solver->phase = malloc(solver->cells_count * sizeof(signed char));
+  solver->trail = malloc(solver->cells_count * sizeof(int));
+  solver->decisions =
+    malloc(solver->cells_count * sizeof(NonoGramDecision));
+  solver->queue = malloc(solver->lines_count * sizeof(int));
+  solver->queued = calloc(solver->lines_count, sizeof(bool));
+  solver->line = malloc(length * sizeof(signed char));
+  solver->zeros = malloc((length + 1) * sizeof(int));
+  solver->forward = malloc(width * sizeof(bool));
+  solver->backward = malloc(width * sizeof(bool));
+  solver->cover = malloc((length + 1) * sizeof(int));
+  if (!solver->blocks || !solver->blocks_count || !solver->cells
+      || !solver->phase || !solver->trail || !solver->decisions
+      || !solver->queue || !solver->queued || !solver->line || !solver->zeros
+      || !solver->forward || !solver->backward || !solver->cover) {
+    nonogram_solver_destroy(solver);
+    return NULL;
+  }
+  for (int row = 0; row < solver->rows_count; row++) {
+    solver->blocks[row] = hints->rows[row];
+    solver->blocks_count[row] =
+      _count_blocks(hints->rows[row], solver->cols_count);
+  }
+  for (int col = 0; col < solver->cols_count; col++) {
+    solver->blocks[solver->rows_count + col] = hints->cols[col];
+    solver->blocks_count[solver->rows_count + col] =
+      _count_blocks(hints->cols[col], solver->rows_count);
+  }
+  memset(solver->cells, -1, solver->cells_count * sizeof(signed char));
+  memset(solver->phase, -1, solver->cells_count * sizeof(signed char));
+  // Given cells are settled first, below any decision
+  for (int cell = 0; hints->given && cell < solver->cells_count; cell++) {
+    if (hints->given[cell] >= 0) {
+      _assign(solver, cell, hints->given[cell]);
+    }
+  }
+  solver->budget = -1;
+  return solver;
+}
+
+/**
+ * @brief Destroy a solver
+ * @param solver The solver
+ */
+void nonogram_solver_destroy(NonoGramSolver *solver) {
+  if (solver->search) {
+    nonogram_local_search_destroy(solver->search);
+  }
+  free(solver->blocks);
+  free(solver->blocks_count);
+  free(solver->cells);
+  free(solver->phase);
+  free(solver->trail);
+  free(solver->decisions);
+  free(solver->queue);
+  free(solver->queued);
+  free(solver->line);
+  free(solver->zeros);
+  free(solver->forward);
+  free(solver->backward);
+  free(solver->cover);
+  free(solver);
+}
+
+/**
+ * @brief Compute the features of the puzzle of a solver
+ *
+ * The static features come from the hints; the settled fraction comes from a
+ * propagation of the lines before any decision.
+ *
+ * @param solver The solver
+ * @param features The features to fill
+ * @return false if presolve proved the puzzle unsolvable, true otherwise
+ */
+bool nonogram_solver_features(
+  NonoGramSolver *solver,
+  NonoGramFeatures *features
+) {
+  long filled = 0;
+  double slack = 0.0;
+  features->rows_count = solver->rows_count;
+  features->cols_count = solver->cols_count;
+  features->max_blocks = 0;
+  for (int line = 0; line < solver->lines_count; line++) {
+    int length = _line_length(solver, line);
+    int count = solver->blocks_count[line];
+    if (count < 0) {
+      slack += 1.0;
+      continue;
+    }
+    int minimum = count ? count - 1 : 0;
+    for (int block = 0; block < count; block++) {
+      minimum += solver->blocks[line][block];
+      if (line < solver->rows_count) {
+        filled += solver->blocks[line][block];
+      }
+    }
+    slack += (double) (length - minimum) / length;
+    if (count > features->max_blocks) {
+      features->max_blocks = count;
+    }
+  }
+  features->clue_density = (double) filled / solver->cells_count;
+  features->average_slack = slack / solver->lines_count;
+
+  solver->interrupted = false;
+  _abandon_probe(solver);
+  bool consistent = _propagate(solver);
+  if (!consistent && !solver->interrupted) {
+    solver->conflict = true;
+  }
+  features->settled = (double) solver->trail_count / solver->cells_count;
+  return !solver->conflict;
+}
+
+/**
+ * @brief Get the value of a feature
+ * @param features The features of the puzzle
+ * @param feature The feature
+ * @return The value of the feature
+ */
+static double _feature_value(
+  const NonoGramFeatures *features,
+  NonoGramFeature feature
+) {
+  switch (feature) {
+    case NONOGRAM_FEATURE_CELLS:
+      return (double) features->rows_count * features->cols_count;
+    case NONOGRAM_FEATURE_CLUE_DENSITY:
+      return features->clue_density;
+    case NONOGRAM_FEATURE_AVERAGE_SLACK:
+      return features->average_slack;
+    case NONOGRAM_FEATURE_MAX_BLOCKS:
+      return features->max_blocks;
+    case NONOGRAM_FEATURE_SETTLED:
+      return features->settled;
+    default:
+      return 0.0;
+  }
+}
+
+/**
+ * @brief Choose the engine expected to be the fastest for a puzzle
+ * @param features The features of the puzzle
+ * @return The engine given by the first matching rule of the rule table
+ */
+NonoGramEngine nonogram_solver_select_engine(
+  const NonoGramFeatures *features
+) {
+  int count = sizeof _nonogram_rules / sizeof _nonogram_rules[0];
+  for (int index = 0; index < count; index++) {
+    const NonoGramRule *rule = &_nonogram_rules[index];
+    if (rule->feature == NONOGRAM_FEATURE_ALWAYS) {
+      return rule->engine;
+    }
+    double value = _feature_value(features, rule->feature);
+    if (value >= rule->minimum && value <= rule->maximum) {
+      return rule->engine;
+    }
+  }
+  return NONOGRAM_ENGINE_DFS;
+}
+
+/**
+ * @brief Run an engine until it ends or is interrupted
+ * @param solver The solver
+ * @param engine The engine to use, replaced by the selected engine if it is
+ *        NONOGRAM_ENGINE_AUTO and presolve has completed
+ * @return The status of the solve
+ */
+static NonoGramStatus _solve(NonoGramSolver *solver, NonoGramEngine *engine) {
+  if (solver->conflict) {
+    return NONOGRAM_SOLVER_FAILED;
+  }
+  solver->interrupted = false;
+  if (*engine == NONOGRAM_ENGINE_AUTO) {
+    NonoGramFeatures features;
+    if (!nonogram_solver_features(solver, &features)) {
+      return NONOGRAM_SOLVER_FAILED;
+    }
+    if (solver->interrupted) {
+      return NONOGRAM_SOLVER_STOPPED;
+    }
+    *engine = nonogram_solver_select_engine(&features);
+  }
+  if (*engine == NONOGRAM_ENGINE_LOCAL) {
+    if (!_propagate(solver)) {
+      if (solver->interrupted) {
+        return NONOGRAM_SOLVER_STOPPED;
+      }
+      solver->conflict = true;
+      return NONOGRAM_SOLVER_FAILED;
+    }
+    return _local_search(solver);
+  }
+  return _search(solver, *engine);
+}
+
+/**
+ * @brief Solve the puzzle of a solver
+ * @param solver The solver
+ * @param engine The engine to use
+ * @return The status of the solve
+ */
+NonoGramStatus nonogram_solver_solve(
+  NonoGramSolver *solver,
+  NonoGramEngine engine
+) {
+  solver->budget = -1;
+  return _solve(solver, &engine);
+}
+
+/**
+ * @brief Do a bounded amount of work on the puzzle of a solver
+ * @param solver The solver
+ * @param budget The maximal number of line solves and local search moves
+ * @return NONOGRAM_SOLVER_IN_PROGRESS if the budget has been spent, the
+ *         status of the solve otherwise
+ */
+NonoGramStatus nonogram_solver_step(NonoGramSolver *solver, long budget) {
+  assert(budget > 0);
+  solver->budget = budget;
+  solver->exhausted = false;
+  NonoGramStatus status = _solve(solver, &solver->engine);
+  solver->budget = -1;
+  if (status == NONOGRAM_SOLVER_STOPPED && solver->exhausted) {
+    return NONOGRAM_SOLVER_IN_PROGRESS;
+  }
+  return status;
+}
+
+/**
+ * @brief Settle the cells of the puzzle of a solver proven by probing
+ * @param solver The solver
+ * @return false if the puzzle has no solution or if the solve has been
+ *         stopped
+ */
+bool nonogram_solver_probe(NonoGramSolver *solver) {
+  assert(!solver->decisions_count);
+  if (solver->conflict) {
+    return false;
+  }
+  solver->budget = -1;
+  solver->interrupted = false;
+  // An interrupted probe resumes its own propagation
+  bool consistent = (solver->probing || _propagate(solver)) && _probe(solver);
+  if (!consistent && !solver->interrupted) {
+    solver->conflict = true;
+  }
+  return consistent;
+}
+
+/**
+ * @brief Rate the difficulty of the puzzle of a solver
+ *
+ * The puzzle is solved by engines of increasing strength: the rating is
+ * given by the first one needing no search, or by the number of decisions
+ * of the probing search.
+ *
+ * @param solver The solver
+ * @return The rating, 0 if the puzzle has no solution or if the solve has
+ *         been stopped
+ */
+int nonogram_solver_rate(NonoGramSolver *solver) {
+  long nodes = solver->stats.nodes;
+  NonoGramStatus status = nonogram_solver_solve(solver, NONOGRAM_ENGINE_LINE);
+  if (status == NONOGRAM_SOLVER_SOLVED) {
+    return 1;
+  }
+  if (status != NONOGRAM_SOLVER_FAILED || solver->conflict
+      || nonogram_solver_solve(solver, NONOGRAM_ENGINE_PROBE)
+           != NONOGRAM_SOLVER_SOLVED) {
+    return 0;
+  }
+  int rating = 2;
+  for (nodes = solver->stats.nodes - nodes; nodes; nodes >>= 1) {
+    rating++;
+  }
+  return rating;
+}
+
+/**
+ * @brief Get the size of a checkpoint file
+ * @param cells_count The number of cells
+ * @param lines_count The number of lines
+ * @param header The header of the checkpoint
+ * @return The size of the file
+ */
+static size_t _checkpoint_size(
+  int cells_count,
+  int lines_count,
+  const NonoGramCheckpoint *header
+) {
+  return sizeof(NonoGramCheckpoint) + 2 * (size_t) cells_count + lines_count
+    + header->trail_count * sizeof(int32_t)
+    + header->decisions_count * sizeof(NonoGramCheckpointDecision)
+    + header->queue_count * sizeof(int32_t);
+}
+
+/**
+ * @brief Save the state of a solve to a checkpoint file
+ *
+ * The checkpoint is written to a temporary file which then replaces the
+ * previous one, so that a process killed while saving keeps the previous
+ * checkpoint.
+ *
+ * @param solver The solver
+ * @param filename The checkpoint file
+ * @return false if the file cannot be written
+ */
+bool nonogram_solver_save(NonoGramSolver *solver, const char *filename) {
+  NonoGramCheckpoint header;
+  memset(&header, 0, sizeof header);
+  memcpy(header.magic, CHECKPOINT_MAGIC, sizeof header.magic);
+  header.version = CHECKPOINT_VERSION;
+  header.byte_order = CHECKPOINT_BYTE_ORDER;
+  header.hash = nonogram_hints_hash(solver->hints);
+  header.rows_count = solver->rows_count;
+  header.cols_count = solver->cols_count;
+  header.engine = solver->engine;
+  header.trail_count = solver->trail_count;
+  header.decisions_count = solver->decisions_count;
+  header.queue_count = solver->queue_count;
+  header.probe_cell = solver->probe_cell;
+  header.probe_quiet = solver->probe_quiet;
+  header.probe_trail = solver->probe_trail;
+  header.probe_value = solver->probe_value;
+  header.started = solver->started;
+  header.conflict = solver->conflict;
+  header.warmed = solver->warmed;
+  header.probing = solver->probing;
+  header.nodes = solver->stats.nodes;
+  header.backtracks = solver->stats.backtracks;
+  header.propagations = solver->stats.propagations;
+  header.probes = solver->stats.probes;
+
+  size_t size =
+    _checkpoint_size(solver->cells_count, solver->lines_count, &header);
+  char *buffer = calloc(1, size);
+  if (!buffer) {
+    return false;
+  }
+  char *cursor = buffer;
+  memcpy(cursor, &header, sizeof header);
+  cursor += sizeof header;
+  memcpy(cursor, solver->cells, solver->cells_count);
+  cursor += solver->cells_count;
+  memcpy(cursor, solver->phase, solver->cells_count);
+  cursor += solver->cells_count;
+  for (int line = 0; line < solver->lines_count; line++) {
+    *cursor++ = solver->blocks_count[line] < 0;
+  }
+  for (int index = 0; index < solver->trail_count; index++) {
+    int32_t cell = solver->trail[index];
+    memcpy(cursor, &cell, sizeof cell);
+    cursor += sizeof cell;
+  }
+  for (int index = 0; index < solver->decisions_count; index++) {
+    NonoGramCheckpointDecision decision = {
+      .trail_count = solver->decisions[index].trail_count,
+      .cell = solver->decisions[index].cell,
+      .value = solver->decisions[index].value,
+      .flipped = solver->decisions[index].flipped,
+    };
+    memcpy(cursor, &decision, sizeof decision);
+    cursor += sizeof decision;
+  }
+  for (int index = 0; index < solver->queue_count; index++) {
+    int32_t line =
+      solver->queue[(solver->queue_head + index) % solver->lines_count];
+    memcpy(cursor, &line, sizeof line);
+    cursor += sizeof line;
+  }
+
+  size_t length = strlen(filename);
+  char *temporary = malloc(length + 5);
+  FILE *file = NULL;
+  if (temporary) {
+    memcpy(temporary, filename, length);
+    memcpy(temporary + length, ".tmp", 5);
+    file = fopen(temporary, "wb");
+  }
+  bool written = file && fwrite(buffer, 1, size, file) == size
+    && !fflush(file) && !fsync(fileno(file));
+  if (file && fclose(file)) {
+    written = false;
+  }
+  written = written && !rename(temporary, filename);
+  if (file && !written) {
+    unlink(temporary);
+  }
+  free(temporary);
+  free(buffer);
+  return written;
+}
+
+/**
+ * @brief Check the state of a checkpoint against a solver
+ * @param solver The solver
+ * @param header The header of the checkpoint
+ * @param body The cells, the phases, the relaxed flags, the trail, the
+ *        decisions and the queue of the checkpoint
+ * @return true if the state is a state of a solve of the solver
+ */
+static bool _checkpoint_valid(
+  NonoGramSolver *solver,
+  const NonoGramCheckpoint *header,
+  const char *body
+) {
+  if (header->trail_count < 0 || header->trail_count > solver->cells_count
+      || header->decisions_count < 0
+      || header->decisions_count > header->trail_count
+      || header->queue_count < 0 || header->queue_count > solver->lines_count
+      || header->probe_cell < 0 || header->probe_cell >= solver->cells_count
+      || header->probe_trail < 0 || header->probe_trail > header->trail_count
+      || header->engine < NONOGRAM_ENGINE_AUTO
+      || header->engine > NONOGRAM_ENGINE_LOCAL) {
+    return false;
+  }
+  const signed char *cells = (const signed char *) body;
+  const signed char *phase = cells + solver->cells_count;
+  const char *relaxed = (const char *) phase + solver->cells_count;
+  int assigned = 0;
+  for (int cell = 0; cell < solver->cells_count; cell++) {
+    if (cells[cell] < -1 || cells[cell] > 1 || phase[cell] < -1
+        || phase[cell] > 1) {
+      return false;
+    }
+    assigned += cells[cell] != -1;
+  }
+  for (int line = 0; line < solver->lines_count; line++) {
+    if (relaxed[line] != (solver->blocks_count[line] < 0)) {
+      return false;
+    }
+  }
+  if (assigned != header->trail_count) {
+    return false;
+  }
+  // The trail holds each assigned cell once
+  const char *cursor = relaxed + solver->lines_count;
+  bool *seen = calloc(
+    solver->cells_count > solver->lines_count
+      ? solver->cells_count
+      : solver->lines_count,
+    sizeof(bool));
+  if (!seen) {
+    return false;
+  }
+  bool valid = true;
+  for (int index = 0; valid && index < header->trail_count; index++) {
+    int32_t cell;
+    memcpy(&cell, cursor, sizeof cell);
+    cursor += sizeof cell;
+    valid = cell >= 0 && cell < solver->cells_count && cells[cell] != -1
+      && !seen[cell];
+    if (valid) {
+      seen[cell] = true;
+    }
+  }
+  int32_t previous = 0;
+  for (int index = 0; valid && index < header->decisions_count; index++) {
+    NonoGramCheckpointDecision decision;
+    memcpy(&decision, cursor, sizeof decision);
+    cursor += sizeof decision;
+    valid = decision.trail_count >= previous
+      && decision.trail_count < header->trail_count
+      && decision.cell >= 0 && decision.cell < solver->cells_count
+      && (decision.value == 0 || decision.value == 1);
+    previous = decision.trail_count;
+  }
+  memset(seen, 0, solver->lines_count * sizeof(bool));
+  for (int index = 0; valid && index < header->queue_count; index++) {
+    int32_t line;
+    memcpy(&line, cursor, sizeof line);
+    cursor += sizeof line;
+    valid = line >= 0 && line < solver->lines_count && !seen[line];
+    if (valid) {
+      seen[line] = true;
+    }
+  }
+  free(seen);
+  return valid;
+}
+
+/**
+ * @brief Resume a solve from a checkpoint file
+ *
+ * The whole file is read and checked before the solver is changed.
+ *
+ * @param solver The solver
+ * @param filename The checkpoint file
+ * @return false if the file cannot be read, is corrupted or belongs to
+ *         other hints
+ */
+bool nonogram_solver_load(NonoGramSolver *solver, const char *filename) {
+  FILE *file = fopen(filename, "rb");
+  if (!file) {
+    return false;
+  }
+  NonoGramCheckpoint header;
+  char *buffer = NULL;
+  size_t size = 0;
+  bool valid = fread(&header, sizeof header, 1, file) == 1
+    && !memcmp(header.magic, CHECKPOINT_MAGIC, sizeof header.magic)
+    && header.version == CHECKPOINT_VERSION
+    && header.byte_order == CHECKPOINT_BYTE_ORDER
+    && header.hash == nonogram_hints_hash(solver->hints)
+    && header.rows_count == solver->rows_count
+    && header.cols_count == solver->cols_count
+    && header.trail_count >= 0 && header.trail_count <= solver->cells_count
+    && header.decisions_count >= 0
+    && header.decisions_count <= solver->cells_count
+    && header.queue_count >= 0 && header.queue_count <= solver->lines_count;
+  if (valid) {
+    size = _checkpoint_size(solver->cells_count, solver->lines_count, &header)
+      - sizeof header;
+    // One more byte shows a file longer than its header tells
+    buffer = malloc(size + 1);
+    valid = buffer && fread(buffer, 1, size + 1, file) == size
+      && _checkpoint_valid(solver, &header, buffer);
+  }
+  fclose(file);
+  if (!valid) {
+    free(buffer);
+    return false;
+  }
+
+  const char *cursor = buffer;
+  memcpy(solver->cells, cursor, solver->cells_count);
+  cursor += solver->cells_count;
+  memcpy(solver->phase, cursor, solver->cells_count);
+  cursor += solver->cells_count + solver->lines_count;
+  for (int index = 0; index < header.trail_count; index++) {
+    int32_t cell;
+    memcpy(&cell, cursor, sizeof cell);
+    cursor += sizeof cell;
+    solver->trail[index] = cell;
+  }
+  solver->trail_count = header.trail_count;
+  for (int index = 0; index < header.decisions_count; index++) {
+    NonoGramCheckpointDecision decision;
+    memcpy(&decision, cursor, sizeof decision);
+    cursor += sizeof decision;
+    solver->decisions[index] = (NonoGramDecision) {
+      decision.trail_count, decision.cell, decision.value, decision.flipped
+    };
+  }
+  solver->decisions_count = header.decisions_count;
+  _clear_queue(solver);
+  solver->queue_head = 0;
+  for (int index = 0; index < header.queue_count; index++) {
+    int32_t line;
+    memcpy(&line, cursor, sizeof line);
+    cursor += sizeof line;
+    _enqueue(solver, line);
+  }
+  if (solver->search) {
+    nonogram_local_search_destroy(solver->search);
+    solver->search = NULL;
+  }
+  solver->engine = header.engine;
+  solver->started = header.started;
+  solver->conflict = header.conflict;
+  solver->warmed = header.warmed;
+  solver->probing = header.probing;
+  solver->probe_cell = header.probe_cell;
+  solver->probe_quiet = header.probe_quiet;
+  solver->probe_trail = header.probe_trail;
+  solver->probe_value = header.probe_value;
+  solver->interrupted = false;
+  solver->stats.nodes = header.nodes;
+  solver->stats.backtracks = header.backtracks;
+  solver->stats.propagations = header.propagations;
+  solver->stats.probes = header.probes;
+  free(buffer);
+  return true;
+}
+
+/**
+ * @brief Enumerate the solutions of the puzzle of a solver
+ *
+ * Each solution found by the depth-first search is packed and given to the
+ * callback, then its last decision is refuted and the search goes on.
+ *
+ * @param solver The solver
+ * @param limit The maximal number of solutions, 0 for all of them
+ * @param callback The callback receiving the solutions
+ * @param data The data given to the callback
+ * @param pcomplete A pointer set to whether every solution has been given
+ * @return The number of solutions, or -1 if memory allocation fails
+ */
+long nonogram_solver_enumerate(
+  NonoGramSolver *solver,
+  long limit,
+  NonoGramSolutionCallback callback,
+  void *data,
+  bool *pcomplete
+) {
+  size_t stride = (solver->cols_count + 7) / 8;
+  unsigned char *bits = malloc(solver->rows_count * stride);
+  bool complete = false;
+  long count = bits ? 0 : -1;
+  solver->budget = -1;
+  solver->interrupted = false;
+  while (bits) {
+    if (solver->enumerated) {
+      if (!_backtrack(solver)) {
+        complete = true;
+        break;
+      }
+      solver->enumerated = false;
+    }
+    if (limit && count >= limit) {
+      break;
+    }
+    NonoGramStatus status = solver->conflict
+      ? NONOGRAM_SOLVER_FAILED
+      : _search(solver, NONOGRAM_ENGINE_DFS);
+    if (status == NONOGRAM_SOLVER_FAILED) {
+      complete = true;
+      break;
+    }
+    if (status != NONOGRAM_SOLVER_SOLVED) {
+      break;
+    }
+    solver->enumerated = true;
+    count++;
+    memset(bits, 0, solver->rows_count * stride);
+    for (int cell = 0; cell < solver->cells_count; cell++) {
+      int row = cell / solver->cols_count;
+      int col = cell % solver->cols_count;
+      if (solver->cells[cell]) {
+        bits[row * stride + col / 8] |= 0x80 >> (col % 8);
+      }
+    }
+    if (!callback(bits, data)) {
+      break;
+    }
+  }
+  free(bits);
+  if (pcomplete) {
+    *pcomplete = complete;
+  }
+  return count;
+}
+
+/**
+ * @brief Undo the decisions of a solver
+ *
+ * The cells settled before the first decision are a propagated state.
+ *
+ * @param solver The solver
+ */
+static void _undo_decisions(NonoGramSolver *solver) {
+  if (solver->decisions_count) {
+    _undo(solver, solver->decisions[0].trail_count);
+    solver->decisions_count = 0;
+    _clear_queue(solver);
+  }
+}
+
+/**
+ * @brief Compute the cells having the same value in every solution
+ *
+ * The first solution found gives the candidate value of every cell. Each
+ * candidate cell is then assumed to have the other value: a solution
+ * found this way rules out every cell where it differs from the first one,
+ * while a refuted assumption settles the cell before the first decision,
+ * strengthening the propagation of the next searches. The phases favour
+ * the values not seen yet so that solutions differ as much as possible.
+ *
+ * @param solver The solver
+ * @return The status of the computation
+ */
+NonoGramStatus nonogram_solver_backbone(NonoGramSolver *solver) {
+  assert(!solver->decisions_count);
+  if (solver->conflict) {
+    return NONOGRAM_SOLVER_FAILED;
+  }
+  signed char *values = malloc(2 * solver->cells_count);
+  if (!values) {
+    return NONOGRAM_SOLVER_STOPPED;
+  }
+  signed char *phase = values + solver->cells_count;
+  memcpy(phase, solver->phase, solver->cells_count);
+  solver->budget = -1;
+  solver->interrupted = false;
+  NonoGramStatus status = _search(solver, NONOGRAM_ENGINE_DFS);
+  if (status == NONOGRAM_SOLVER_SOLVED) {
+    memcpy(values, solver->cells, solver->cells_count);
+    for (int cell = 0; cell < solver->cells_count; cell++) {
+      solver->phase[cell] = 1 - values[cell];
+    }
+  }
+  _undo_decisions(solver);
+  for (int cell = 0; cell < solver->cells_count; cell++) {
+    if (status != NONOGRAM_SOLVER_SOLVED) {
+      break;
+    }
+    if (values[cell] == -1 || solver->cells[cell] != -1) {
+      continue;
+    }
+    // Refuting the decision ends the search with the decisions undone
+    NonoGramDecision *decision = &solver->decisions[solver->decisions_count++];
+    decision->trail_count = solver->trail_count;
+    decision->cell = cell;
+    decision->value = 1 - values[cell];
+    decision->flipped = true;
+    solver->stats.nodes++;
+    _decide(solver, cell, decision->value);
+    NonoGramStatus found = _search(solver, NONOGRAM_ENGINE_DFS);
+    if (found == NONOGRAM_SOLVER_SOLVED) {
+      for (int other = cell; other < solver->cells_count; other++) {
+        if (values[other] != -1 && solver->cells[other] != values[other]) {
+          values[other] = -1;
+          solver->phase[other] = phase[other];
+        }
+      }
+      _undo_decisions(solver);
+    } else if (found == NONOGRAM_SOLVER_FAILED) {
+      solver->conflict = false;
+      _clear_queue(solver);
+      _decide(solver, cell, values[cell]);
+      if (!_propagate(solver) && !solver->interrupted) {
+        solver->conflict = true;
+        status = NONOGRAM_SOLVER_FAILED;
+      }
+    }
+    if (found == NONOGRAM_SOLVER_STOPPED || solver->interrupted) {
+      _undo_decisions(solver);
+      status = NONOGRAM_SOLVER_STOPPED;
+    }
+  }
+  memcpy(solver->phase, phase, solver->cells_count);
+  free(values);
+  return status;
+}
+
+/**
+ * @brief Split the search of a puzzle into independent parts
+ *
+ * The depth-first search runs with the decision stack bounded by depth:
+ * a consistent state at that depth, or with every cell settled, is a part,
+ * after which the search backtracks as after a contradiction.
+ *
+ * @param solver The solver
+ * @param depth The number of decisions fixing a part
+ * @param callback The callback receiving the parts
+ * @param data The data given to the callback
+ * @return The number of parts, or -1 if the split has been cancelled
+ */
+long nonogram_solver_split(
+  NonoGramSolver *solver,
+  int depth,
+  NonoGramPartCallback callback,
+  void *data
+) {
+  assert(!solver->decisions_count);
+  if (solver->conflict) {
+    return 0;
+  }
+  solver->budget = -1;
+  solver->interrupted = false;
+  _abandon_probe(solver);
+  long count = 0;
+  for (;;) {
+    bool consistent = _propagate(solver);
+    if (solver->interrupted) {
+      count = -1;
+      break;
+    }
+    if (consistent && solver->decisions_count < depth
+        && solver->trail_count < solver->cells_count) {
+      int cell = _choose(solver);
+      NonoGramDecision *decision =
+        &solver->decisions[solver->decisions_count++];
+      decision->trail_count = solver->trail_count;
+      decision->cell = cell;
+      decision->value = solver->phase[cell] == -1 ? 1 : solver->phase[cell];
+      decision->flipped = false;
+      solver->stats.nodes++;
+      _decide(solver, cell, decision->value);
+      continue;
+    }
+    if (consistent) {
+      count++;
+      if (!callback(solver->cells, data)) {
+        break;
+      }
+    } else if (!solver->decisions_count) {
+      solver->conflict = true;
+    }
+    if (!_backtrack(solver)) {
+      break;
+    }
+  }
+  _undo_decisions(solver);
+  return count;
+}
+
+/**
+ * @brief Create the solver of a member of a parallel solve
+ * @param solver The solver being solved in parallel
+ * @param index The index of the member
+ * @param stop The flag stopping the members
+ * @return A solver starting from the settled cells of solver, or NULL if
+ *         memory allocation fails
+ * @note Members other than the first one try a random value first at every
+ *       decision, so that their searches differ
+ */
+static NonoGramSolver *_create_member(
+  NonoGramSolver *solver,
+  int index,
+  atomic_bool *stop
+) {
+  NonoGramSolver *member = nonogram_solver_create(solver->hints);
+  if (!member) {
+    return NULL;
+  }
+  member->seed = solver->seed + index;
+  member->time_limit = solver->time_limit;
+  member->node_limit = solver->node_limit;
+  member->cancel = stop;
+  if (!index) {
+    member->progress = solver->progress;
+    member->progress_data = solver->progress_data;
+    member->progress_interval = solver->progress_interval;
+  }
+  for (int line = 0; line < solver->lines_count; line++) {
+    if (solver->blocks_count[line] < 0) {
+      member->blocks_count[line] = -1;
+    }
+  }
+  // Cells settled before any decision or probe follow from the clues
+  int settled = solver->decisions_count
+    ? solver->decisions[0].trail_count
+    : solver->trail_count;
+  if (solver->probing && solver->probe_trail < settled) {
+    settled = solver->probe_trail;
+  }
+  // Given cells come first on both trails
+  for (int position = member->trail_count; position < settled; position++) {
+    int cell = solver->trail[position];
+    _assign(member, cell, solver->cells[cell]);
+  }
+  unsigned long long random =
+    (solver->seed + index) * 0x9E3779B97F4A7C15ULL | 1;
+  for (int cell = 0; cell < solver->cells_count; cell++) {
+    if (index) {
+      random ^= random >> 12;
+      random ^= random << 25;
+      random ^= random >> 27;
+      member->phase[cell] = (random * 2685821657736338717ULL) >> 63;
+    } else {
+      member->phase[cell] = solver->phase[cell];
+    }
+  }
+  return member;
+}
+
+/**
+ * @brief Run a member of a parallel solve
+ * @param data The member
+ * @return NULL
+ */
+static void *_run_member(void *data) {
+  NonoGramMember *member = data;
+  NonoGramPortfolio *portfolio = member->portfolio;
+  member->status = nonogram_solver_solve(member->solver, member->engine);
+  pthread_mutex_lock(&portfolio->lock);
+  portfolio->finished++;
+  if (member->status != NONOGRAM_SOLVER_STOPPED && portfolio->winner < 0) {
+    portfolio->winner = member->index;
+    atomic_store(&portfolio->stop, true);
+  }
+  pthread_cond_signal(&portfolio->done);
+  pthread_mutex_unlock(&portfolio->lock);
+  return NULL;
+}
+
+/**
+ * @brief Wait for the members of a parallel solve
+ * @param solver The solver being solved in parallel
+ * @param portfolio The parallel solve
+ * @param started The number of members started
+ */
+static void _wait_members(
+  NonoGramSolver *solver,
+  NonoGramPortfolio *portfolio,
+  int started
+) {
+  pthread_mutex_lock(&portfolio->lock);
+  while (portfolio->finished < started) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += PORTFOLIO_POLL * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&portfolio->done, &portfolio->lock, &deadline);
+    if (solver->cancel && atomic_load(solver->cancel)) {
+      atomic_store(&portfolio->stop, true);
+    }
+  }
+  pthread_mutex_unlock(&portfolio->lock);
+}
+
+/**
+ * @brief Create the members of a parallel solve
+ * @param solver The solver being solved in parallel
+ * @param engine The engine of the first member
+ * @param members The members to initialize
+ * @param count The number of members
+ * @param stop The flag stopping the members, or NULL
+ */
+static void _create_members(
+  NonoGramSolver *solver,
+  NonoGramEngine engine,
+  NonoGramMember *members,
+  int count,
+  atomic_bool *stop
+) {
+  int engines_count = sizeof _portfolio_engines / sizeof _portfolio_engines[0];
+  for (int index = 0; index < count; index++) {
+    NonoGramMember *member = &members[index];
+    member->index = index;
+    member->engine =
+      index ? _portfolio_engines[(index - 1) % engines_count] : engine;
+    member->solver = _create_member(solver, index, stop);
+    member->status = member->solver
+      ? NONOGRAM_SOLVER_IN_PROGRESS
+      : NONOGRAM_SOLVER_STOPPED;
+    member->started = false;
+    if (member->solver) {
+      member->solver->engine = member->engine;
+    }
+  }
+}
+
+/**
+ * @brief Install the result of a parallel solve and destroy its members
+ * @param solver The solver being solved in parallel
+ * @param members The members
+ * @param count The number of members
+ * @param winner The index of the member that ended the solve, or -1
+ * @return The status of the solve
+ */
+static NonoGramStatus _merge_members(
+  NonoGramSolver *solver,
+  NonoGramMember *members,
+  int count,
+  int winner
+) {
+  NonoGramStatus status = NONOGRAM_SOLVER_STOPPED;
+  if (winner >= 0) {
+    status = members[winner].status;
+    if (status == NONOGRAM_SOLVER_SOLVED) {
+      _abandon_probe(solver);
+      if (solver->decisions_count) {
+        _clear_queue(solver);
+        _undo(solver, solver->decisions[0].trail_count);
+        solver->decisions_count = 0;
+      }
+      for (int cell = 0; cell < solver->cells_count; cell++) {
+        if (solver->cells[cell] == -1) {
+          _assign(solver, cell, members[winner].solver->cells[cell]);
+        }
+      }
+    } else {
+      solver->conflict = true;
+    }
+  }
+  solver->interrupted = status == NONOGRAM_SOLVER_STOPPED;
+  for (int index = 0; index < count; index++) {
+    NonoGramSolver *member = members[index].solver;
+    if (member) {
+      solver->stats.nodes += member->stats.nodes;
+      solver->stats.backtracks += member->stats.backtracks;
+      solver->stats.propagations += member->stats.propagations;
+      solver->stats.probes += member->stats.probes;
+      nonogram_solver_destroy(member);
+    }
+  }
+  return status;
+}
+
+/**
+ * @brief Step the members of a deterministic solve given to a rank
+ * @param rounds The rounds
+ * @param rank The rank
+ */
+static void _step_members(NonoGramRounds *rounds, int rank) {
+  for (int index = rank; index < rounds->count; index += rounds->threads) {
+    NonoGramMember *member = &rounds->members[index];
+    if (member->status == NONOGRAM_SOLVER_IN_PROGRESS) {
+      member->status = nonogram_solver_step(member->solver, PORTFOLIO_ROUND);
+    }
+  }
+}
+
+/**
+ * @brief Run the rounds of a rank of a deterministic solve
+ * @param data The worker
+ * @return NULL
+ */
+static void *_run_rounds(void *data) {
+  NonoGramRoundsWorker *worker = data;
+  NonoGramRounds *rounds = worker->rounds;
+  long seen = 0;
+  for (;;) {
+    pthread_mutex_lock(&rounds->lock);
+    while (rounds->round == seen && !rounds->done) {
+      pthread_cond_wait(&rounds->start, &rounds->lock);
+    }
+    seen = rounds->round;
+    bool done = rounds->done;
+    pthread_mutex_unlock(&rounds->lock);
+    if (done) {
+      return NULL;
+    }
+    _step_members(rounds, worker->rank);
+    pthread_mutex_lock(&rounds->lock);
+    if (!--rounds->pending) {
+      pthread_cond_signal(&rounds->end);
+    }
+    pthread_mutex_unlock(&rounds->lock);
+  }
+}
+
+/**
+ * @brief Solve the puzzle of a solver on several threads, deterministically
+ *
+ * Every member does the same amount of work per round whatever the thread
+ * running it, and the rounds are separated by barriers. After each round,
+ * the member of smallest index that has ended gives the result, so that
+ * the board and the counters only depend on the puzzle and the seed.
+ *
+ * @param solver The solver
+ * @param engine The engine of the first member
+ * @param threads The number of threads
+ * @return The status of the solve
+ */
+static NonoGramStatus _solve_rounds(
+  NonoGramSolver *solver,
+  NonoGramEngine engine,
+  int threads
+) {
+  int count = solver->deterministic;
+  if (threads > count) {
+    threads = count;
+  }
+  NonoGramMember members[count];
+  _create_members(solver, engine, members, count, NULL);
+  NonoGramRounds rounds = {
+    .members = members,
+    .count = count,
+    .threads = threads,
+  };
+  pthread_mutex_init(&rounds.lock, NULL);
+  pthread_cond_init(&rounds.start, NULL);
+  pthread_cond_init(&rounds.end, NULL);
+  NonoGramRoundsWorker workers[threads];
+  int started = 0;
+  for (int rank = 1; rank < threads; rank++) {
+    workers[rank].rounds = &rounds;
+    workers[rank].rank = rank;
+    workers[rank].started =
+      !pthread_create(&workers[rank].id, NULL, _run_rounds, &workers[rank]);
+    started += workers[rank].started;
+  }
+
+  int winner = -1;
+  for (;;) {
+    bool running = false;
+    for (int index = 0; index < count && winner < 0; index++) {
+      NonoGramStatus status = members[index].status;
+      if (status == NONOGRAM_SOLVER_SOLVED
+          || status == NONOGRAM_SOLVER_FAILED) {
+        winner = index;
+      }
+      running = running || status == NONOGRAM_SOLVER_IN_PROGRESS;
+    }
+    if (winner >= 0 || !running
+        || (solver->cancel && atomic_load(solver->cancel))) {
+      break;
+    }
+    pthread_mutex_lock(&rounds.lock);
+    rounds.round++;
+    rounds.pending = started;
+    pthread_cond_broadcast(&rounds.start);
+    pthread_mutex_unlock(&rounds.lock);
+    // The calling thread takes the ranks whose thread has not started
+    _step_members(&rounds, 0);
+    for (int rank = 1; rank < threads; rank++) {
+      if (!workers[rank].started) {
+        _step_members(&rounds, rank);
+      }
+    }
+    pthread_mutex_lock(&rounds.lock);
+    while (rounds.pending) {
+      pthread_cond_wait(&rounds.end, &rounds.lock);
+    }
+    pthread_mutex_unlock(&rounds.lock);
+  }
+  pthread_mutex_lock(&rounds.lock);
+  rounds.done = true;
+  pthread_cond_broadcast(&rounds.start);
+  pthread_mutex_unlock(&rounds.lock);
+  for (int rank = 1; rank < threads; rank++) {
+    if (workers[rank].started) {
+      pthread_join(workers[rank].id, NULL);
+    }
+  }
+  pthread_cond_destroy(&rounds.end);
+  pthread_cond_destroy(&rounds.start);
+  pthread_mutex_destroy(&rounds.lock);
+  return _merge_members(solver, members, count, winner);
+}
+
+/**
+ * @brief Solve the puzzle of a solver on several threads
+ * @param solver The solver
+ * @param engine The engine of the first member
+ * @param threads The number of threads
+ * @return The status of the solve
+ */
+NonoGramStatus nonogram_solver_solve_parallel(
+  NonoGramSolver *solver,
+  NonoGramEngine engine,
+  int threads
+) {
+  if (engine == NONOGRAM_ENGINE_LINE || solver->conflict
+      || (threads <= 1 && !solver->deterministic)) {
+    return nonogram_solver_solve(solver, engine);
+  }
+  if (solver->cancel && atomic_load(solver->cancel)) {
+    solver->interrupted = true;
+    return NONOGRAM_SOLVER_STOPPED;
+  }
+  if (solver->deterministic) {
+    return _solve_rounds(solver, engine, threads > 1 ? threads : 1);
+  }
+  NonoGramPortfolio portfolio = {.finished = 0, .winner = -1};
+  atomic_init(&portfolio.stop, false);
+  pthread_mutex_init(&portfolio.lock, NULL);
+  pthread_cond_init(&portfolio.done, NULL);
+  NonoGramMember members[threads];
+  _create_members(solver, engine, members, threads, &portfolio.stop);
+  int started = 0;
+  for (int index = 0; index < threads; index++) {
+    NonoGramMember *member = &members[index];
+    member->portfolio = &portfolio;
+    member->started = member->solver
+      && !pthread_create(&member->id, NULL, _run_member, member);
+    started += member->started;
+  }
+  _wait_members(solver, &portfolio, started);
+  for (int index = 0; index < threads; index++) {
+    if (members[index].started) {
+      pthread_join(members[index].id, NULL);
+    }
+  }
+  pthread_cond_destroy(&portfolio.done);
+  pthread_mutex_destroy(&portfolio.lock);
+  NonoGramStatus status =
+    _merge_members(solver, members, threads, portfolio.winner);
+  if (!started) {
+    status = nonogram_solver_solve(solver, engine);
+  }
+  return status;
+}
+
+/**
+ * @brief Make the parallel solves of a solver deterministic
+ * @param solver The solver
+ * @param members The number of members of the parallel solves, 0 to let
+ *        the first member to end give the result
+ */
+void nonogram_solver_set_deterministic(NonoGramSolver *solver, int members) {
+  solver->deterministic = members > 0 ? members : 0;
+}
+
+/**
+ * @brief Set the seed of the randomized engines of a solver
+ * @param solver The solver
+ * @param seed The seed
+ */
+void nonogram_solver_set_seed(NonoGramSolver *solver, unsigned long seed) {
+  solver->seed = seed;
+}
+
+/**
+ * @brief Set the time limit of the local search of a solver
+ * @param solver The solver
+ * @param seconds The time limit in seconds, 0 for the default move budget
+ */
+void nonogram_solver_set_time_limit(NonoGramSolver *solver, double seconds) {
+  solver->time_limit = seconds;
+}
+
+/**
+ * @brief Set the engine used by the steps of a solver
+ * @param solver The solver
+ * @param engine The engine
+ */
+void nonogram_solver_set_engine(NonoGramSolver *solver, NonoGramEngine engine) {
+  solver->engine = engine;
+}
+
+/**
+ * @brief Set the maximal number of decisions of a solver
+ * @param solver The solver
+ * @param nodes The maximal number of decisions, 0 for none
+ */
+void nonogram_solver_set_node_limit(NonoGramSolver *solver, long nodes) {
+  solver->node_limit = nodes;
+}
+
+/**
+ * @brief Set the cancellation flag of a solver
+ * @param solver The solver
+ * @param cancel The flag, NULL for none
+ */
+void nonogram_solver_set_cancel(NonoGramSolver *solver, atomic_bool *cancel) {
+  solver->cancel = cancel;
+}
+
+/**
+ * @brief Set the progress callback of a solver
+ * @param solver The solver
+ * @param progress The callback, NULL for none
+ * @param data The data given to the callback
+ * @param interval The number of line solver calls between two calls
+ */
+void nonogram_solver_set_progress(
+  NonoGramSolver *solver,
+  NonoGramProgress progress,
+  void *data,
+  long interval
+) {
+  assert(!progress || interval > 0);
+  solver->progress = progress;
+  solver->progress_data = data;
+  solver->progress_interval = interval;
+  solver->ticks = 0;
+}
+
+/**
+ * @brief Restart the solve of a solver
+ *
+ * Every cell is unassigned but the given cells, and the clues of the hints
+ * are counted again, so that hints edited in place can be solved without
+ * allocating a new solver.
+ *
+ * @param solver The solver
+ */
+void nonogram_solver_reset(NonoGramSolver *solver) {
+  NonoGramHints *hints = solver->hints;
+  _abandon_probe(solver);
+  _clear_queue(solver);
+  _undo(solver, 0);
+  solver->decisions_count = 0;
+  solver->started = false;
+  solver->conflict = false;
+  solver->interrupted = false;
+  solver->exhausted = false;
+  solver->enumerated = false;
+  if (solver->search) {
+    nonogram_local_search_destroy(solver->search);
+    solver->search = NULL;
+  }
+  solver->warmed = false;
+  for (int line = 0; line < solver->lines_count; line++) {
+    if (solver->blocks_count[line] != -1) {
+      solver->blocks_count[line] = line < solver->rows_count
+        ? _count_blocks(solver->blocks[line], solver->cols_count)
+        : _count_blocks(solver->blocks[line], solver->rows_count);
+    }
+  }
+  for (int cell = 0; hints->given && cell < solver->cells_count; cell++) {
+    if (hints->given[cell] >= 0) {
+      _assign(solver, cell, hints->given[cell]);
+    }
+  }
+}
+
+/**
+ * @brief Ignore the clue of a line
+ * @param solver The solver
+ * @param line The line index, rows first, then columns
+ */
+void nonogram_solver_relax_line(NonoGramSolver *solver, int line) {
+  assert(line < solver->lines_count);
+  solver->blocks_count[line] = -1;
+}
+
+/**
+ * @brief Set the value tried first when the search decides a cell
+ * @param solver The solver
+ * @param row The row index
+ * @param col The col index
+ * @param value 1 or 0, -1 to restore the default
+ */
+void nonogram_solver_set_phase(
+  NonoGramSolver *solver,
+  int row,
+  int col,
+  int value
+) {
+  assert(row < solver->rows_count);
+  assert(col < solver->cols_count);
+  solver->phase[row * solver->cols_count + col] = value;
+}
+
+/**
+ * @brief Get a cell of the board of a solver
+ * @param solver The solver
+ * @param row The row index
+ * @param col The col index
+ * @return 1 if the cell is filled, 0 if it is empty, -1 if it is unknown
+ */
+int nonogram_solver_get_cell(NonoGramSolver *solver, int row, int col) {
+  assert(row < solver->rows_count);
+  assert(col < solver->cols_count);
+  return solver->cells[row * solver->cols_count + col];
+}
+
+/**
+ * @brief Get the counters of a solver
+ * @param solver The solver
+ * @return The counters of the solver
+ */
+const NonoGramSolverStats *nonogram_solver_get_stats(NonoGramSolver *solver) {
+  return &solver->stats;
+}
+
+/**
+ * Names of the engines, indexed by NonoGramEngine.
+ */
+static const char *const _engine_names[] = {
+  "auto", "line", "dfs", "probe", "local"
+};
+
+/**
+ * @brief Get the name of an engine
+ * @param engine The engine
+ * @return The name of the engine
+ */
+const char *nonogram_engine_to_string(NonoGramEngine engine) {
+  return _engine_names[engine];
+}
+
+/**
+ * @brief Get an engine from its name
+ * @param name The name of the engine
+ * @param engine The engine to fill
+ * @return true if the name is known, false otherwise
+ */
+bool nonogram_engine_from_string(const char *name, NonoGramEngine *engine) {
+  int count = sizeof _engine_names / sizeof _engine_names[0];
+  for (int index = 0; index < count; index++) {
+    if (strcmp(name, _engine_names[index]) == 0) {
+      *engine = (NonoGramEngine) index;
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,426 @@
+#ifndef SOLVER_H_
+#define SOLVER_H_
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "./nonogram.h"
+
+/**
+ * NonoGramSolver is a opaque structure that represents the state of a solve.
+ */
+typedef struct _NonoGramSolver NonoGramSolver;
+
+/**
+ * NonoGramEngine enumerates the search strategies of the solver.
+ */
+typedef enum {
+  NONOGRAM_ENGINE_AUTO,   // Choose the engine from the puzzle features
+  NONOGRAM_ENGINE_LINE,   // Line propagation only
+  NONOGRAM_ENGINE_DFS,    // Line propagation and depth-first search
+  NONOGRAM_ENGINE_PROBE,  // Depth-first search with failed cell probing
+  NONOGRAM_ENGINE_LOCAL,  // Local search warm-starting a probing search
+} NonoGramEngine;
+
+/**
+ * NonoGramStatus enumerates the outcomes of a solve.
+ */
+typedef enum {
+  NONOGRAM_SOLVER_SOLVED,  // A solution has been found
+  NONOGRAM_SOLVER_FAILED,  // The engine could not find a solution
+  NONOGRAM_SOLVER_STOPPED,  // A limit or a cancellation stopped the solve
+  NONOGRAM_SOLVER_IN_PROGRESS,  // A step has spent its budget
+} NonoGramStatus;
+
+/**
+ * NonoGramFeatures holds the cheap puzzle features used to choose an engine.
+ */
+typedef struct {
+  int rows_count;        // Number of rows in the board
+  int cols_count;        // Number of columns in the board
+  double clue_density;   // Filled cells required by the row clues per cell
+  double average_slack;  // Mean free space of a line relative to its length
+  int max_blocks;        // Largest number of blocks in a line
+  double settled;        // Fraction of the cells settled by presolve
+} NonoGramFeatures;
+
+/**
+ * NonoGramSolverStats holds the counters of a solve.
+ */
+typedef struct {
+  long nodes;         // Number of decisions taken
+  long backtracks;    // Number of refuted decisions
+  long propagations;  // Number of line solver calls
+  long probes;        // Number of probed cells
+} NonoGramSolverStats;
+
+/**
+ * NonoGramProgress is called by a solve to report its progress.
+ * @param nodes The number of decisions taken so far
+ * @param settled The number of cells currently settled
+ * @param data The data given with the callback
+ */
+typedef void (*NonoGramProgress)(long nodes, int settled, void *data);
+
+/**
+ * NonoGramPartCallback receives a part of the search of a puzzle.
+ * @param cells The cells settled in the part, rows first: 1 filled, 0 empty,
+ *        -1 unknown
+ * @param data The data given with the callback
+ * @return false to stop splitting
+ */
+typedef bool (*NonoGramPartCallback)(const signed char *cells, void *data);
+
+/**
+ * NonoGramSolutionCallback receives a solution of an enumeration.
+ * @param bits The board, rows first, each row padded to a whole number of
+ *        bytes, most significant bit first and set for filled cells, as in
+ *        a raw PBM image; valid during the call only
+ * @param data The data given with the callback
+ * @return false to stop the enumeration
+ */
+typedef bool (*NonoGramSolutionCallback)(
+  const unsigned char *bits,
+  void *data
+);
+
+/**
+ * @brief Create a new solver for a nonogram hints object
+ * @param hints The nonogram hints object
+ * @return A new solver, or NULL if memory allocation fails
+ * @note The hints object must outlive the solver
+ */
+extern NonoGramSolver *nonogram_solver_create(NonoGramHints *hints);
+/**
+ * @brief Destroy a solver
+ * @param solver The solver
+ */
+extern void nonogram_solver_destroy(NonoGramSolver *solver);
+
+/**
+ * @brief Compute the features of the puzzle of a solver
+ * @param solver The solver
+ * @param features The features to fill
+ * @return false if presolve proved the puzzle unsolvable, true otherwise
+ * @note Presolve settles cells in the solver, a later solve starts from them
+ */
+extern bool nonogram_solver_features(
+  NonoGramSolver *solver,
+  NonoGramFeatures *features
+);
+/**
+ * @brief Choose the engine expected to be the fastest for a puzzle
+ * @param features The features of the puzzle
+ * @return The engine given by the first matching rule of the rule table
+ */
+extern NonoGramEngine nonogram_solver_select_engine(
+  const NonoGramFeatures *features
+);
+
+/**
+ * @brief Solve the puzzle of a solver
+ * @param solver The solver
+ * @param engine The engine to use
+ * @return The status of the solve
+ * @note NONOGRAM_ENGINE_AUTO computes the features and selects the engine
+ */
+extern NonoGramStatus nonogram_solver_solve(
+  NonoGramSolver *solver,
+  NonoGramEngine engine
+);
+
+/**
+ * @brief Settle the cells of the puzzle of a solver proven by probing
+ * @param solver The solver, without decisions
+ * @return false if the puzzle has no solution or if the solve has been
+ *         stopped
+ * @note The lines are propagated, then every unknown cell is given both
+ *       values in turn until no value leads to a contradiction: the cells
+ *       settled are fixed in every solution, without any search
+ */
+extern bool nonogram_solver_probe(NonoGramSolver *solver);
+
+/**
+ * @brief Rate the difficulty of the puzzle of a solver
+ * @param solver The solver, not solved yet
+ * @return 1 if propagating the lines solves the puzzle, 2 if probing the
+ *         cells does, 3 + k for a probing search of 2^k to 2^(k+1) - 1
+ *         decisions, 0 if the puzzle has no solution or if the solve has
+ *         been stopped
+ * @note The solver is left solved. The rating of a puzzle having several
+ *       solutions is the rating of finding one of them.
+ */
+extern int nonogram_solver_rate(NonoGramSolver *solver);
+
+/**
+ * @brief Do a bounded amount of work on the puzzle of a solver
+ * @param solver The solver
+ * @param budget The maximal number of line solves and local search moves,
+ *        at least 1
+ * @return NONOGRAM_SOLVER_IN_PROGRESS if the budget has been spent, the
+ *         status of the solve otherwise
+ * @note The whole state of the solve is kept in the solver: stepping again
+ *       resumes it, so that solves can be interleaved on a single thread
+ * @note Steps use the engine given by nonogram_solver_set_engine, the local
+ *       search ignores the time limit and runs its default move budget
+ */
+extern NonoGramStatus nonogram_solver_step(NonoGramSolver *solver, long budget);
+
+/**
+ * @brief Save the state of a solve to a checkpoint file
+ * @param solver The solver, between two steps or after a stopped solve
+ * @param filename The checkpoint file, replaced once completely written
+ * @return false if the file cannot be written
+ * @note The board, the trail, the decision stack, the propagation queue,
+ *       the interrupted probe, the phases, the engine of the steps and the
+ *       counters are saved. A local search in progress is not: it starts
+ *       again when the solve is resumed
+ */
+extern bool nonogram_solver_save(
+  NonoGramSolver *solver,
+  const char *filename
+);
+/**
+ * @brief Resume a solve from a checkpoint file
+ * @param solver A solver of the hints of the checkpoint, with the same
+ *        relaxed lines, not solved yet
+ * @param filename The checkpoint file
+ * @return false if the file cannot be read, is corrupted or belongs to
+ *         other hints, the solver is then left unchanged
+ * @note Stepping the solver continues the saved solve with its engine, as
+ *       if it had never been stopped
+ */
+extern bool nonogram_solver_load(
+  NonoGramSolver *solver,
+  const char *filename
+);
+
+/**
+ * @brief Enumerate the solutions of the puzzle of a solver
+ * @param solver The solver, not solved yet or only enumerated
+ * @param limit The maximal number of solutions, 0 for all of them
+ * @param callback The callback receiving the solutions
+ * @param data The data given to the callback
+ * @param pcomplete A pointer set to whether every solution has been given,
+ *        or NULL
+ * @return The number of solutions given to the callback, or -1 if memory
+ *         allocation fails
+ * @note The depth-first search goes on from each solution, without storing
+ *       it, as after a contradiction: the propagated state of the search is
+ *       kept from a solution to the next one
+ * @note The enumeration stops at the limit, when the callback returns
+ *       false, at the node limit or on cancellation; enumerating again then
+ *       resumes it after the last solution given
+ */
+extern long nonogram_solver_enumerate(
+  NonoGramSolver *solver,
+  long limit,
+  NonoGramSolutionCallback callback,
+  void *data,
+  bool *pcomplete
+);
+
+/**
+ * @brief Compute the cells having the same value in every solution
+ * @param solver The solver, without decisions
+ * @return NONOGRAM_SOLVER_SOLVED if the puzzle has a solution,
+ *         NONOGRAM_SOLVER_FAILED if it has none, NONOGRAM_SOLVER_STOPPED on
+ *         the node limit, on cancellation or if memory allocation fails
+ * @note Once solved, the solver is left with exactly the cells fixed across
+ *       all solutions settled, the backbone of the puzzle: cells still
+ *       unknown differ between solutions, and none are for a unique puzzle
+ * @note Each cell is checked by a search from the settled cells, which the
+ *       cells found fixed strengthen as the computation goes on
+ */
+extern NonoGramStatus nonogram_solver_backbone(NonoGramSolver *solver);
+
+/**
+ * @brief Split the search of a puzzle into independent parts
+ * @param solver The solver, not solved yet
+ * @param depth The number of decisions fixing a part
+ * @param callback The callback receiving the parts
+ * @param data The data given to the callback
+ * @return The number of parts given to the callback, or -1 if the split has
+ *         been cancelled
+ * @note A part is a leaf of the depth-first search cut at depth decisions,
+ *       with the cells settled by their propagation; leaves refuted by
+ *       propagation are left out. Each solution of the puzzle is a solution
+ *       of exactly one part, so that the parts, given to
+ *       nonogram_hints_set_given, can be solved as puzzles of their own on
+ *       other processes or hosts
+ * @note The solver is left with the cells settled before any decision
+ */
+extern long nonogram_solver_split(
+  NonoGramSolver *solver,
+  int depth,
+  NonoGramPartCallback callback,
+  void *data
+);
+
+/**
+ * @brief Solve the puzzle of a solver on several threads
+ * @param solver The solver
+ * @param engine The engine of the first thread
+ * @param threads The number of threads, the calling thread only waits
+ * @return The status of the solve
+ * @note Each thread runs its own copy of the solver, started from the cells
+ *       settled before any decision. The others use the probing, local and
+ *       depth-first engines in turn with randomized decisions, the first
+ *       thread to prove a solution or a contradiction stops the others
+ * @note With a single thread or the line engine, this is
+ *       nonogram_solver_solve
+ */
+extern NonoGramStatus nonogram_solver_solve_parallel(
+  NonoGramSolver *solver,
+  NonoGramEngine engine,
+  int threads
+);
+
+/**
+ * @brief Make the parallel solves of a solver deterministic
+ * @param solver The solver
+ * @param members The number of members of the parallel solves, 0 to let
+ *        the first member to end give the result
+ * @note Members then run in rounds of equal work separated by barriers and
+ *       the first member in index order to end gives the result: the board
+ *       and the counters only depend on the puzzle, the seed and the number
+ *       of members, whatever the number of threads, at the cost of waiting
+ *       for the slowest member of every round
+ * @note The local search of the members ignores the time limit
+ */
+extern void nonogram_solver_set_deterministic(
+  NonoGramSolver *solver,
+  int members
+);
+
+/**
+ * @brief Set the seed of the randomized engines of a solver
+ * @param solver The solver
+ * @param seed The seed
+ */
+extern void nonogram_solver_set_seed(
+  NonoGramSolver *solver,
+  unsigned long seed
+);
+/**
+ * @brief Set the time limit of the local search of a solver
+ * @param solver The solver
+ * @param seconds The time limit in seconds, 0 for the default move budget
+ */
+extern void nonogram_solver_set_time_limit(
+  NonoGramSolver *solver,
+  double seconds
+);
+/**
+ * @brief Set the engine used by the steps of a solver
+ * @param solver The solver
+ * @param engine The engine, NONOGRAM_ENGINE_AUTO by default
+ * @note This must be called before the first step
+ */
+extern void nonogram_solver_set_engine(
+  NonoGramSolver *solver,
+  NonoGramEngine engine
+);
+/**
+ * @brief Set the maximal number of decisions of a solver
+ * @param solver The solver
+ * @param nodes The maximal number of decisions, 0 for none
+ * @note A solve reaching the limit returns NONOGRAM_SOLVER_STOPPED and can be
+ *       resumed by solving again with a higher limit
+ */
+extern void nonogram_solver_set_node_limit(NonoGramSolver *solver, long nodes);
+/**
+ * @brief Set the cancellation flag of a solver
+ * @param solver The solver
+ * @param cancel The flag, NULL for none
+ * @note The flag can be raised from another thread or a signal handler, the
+ *       solve returns NONOGRAM_SOLVER_STOPPED after at most one line solve
+ * @note A cancelled solve can be resumed by lowering the flag and solving
+ *       again
+ */
+extern void nonogram_solver_set_cancel(
+  NonoGramSolver *solver,
+  atomic_bool *cancel
+);
+/**
+ * @brief Set the progress callback of a solver
+ * @param solver The solver
+ * @param progress The callback, NULL for none
+ * @param data The data given to the callback
+ * @param interval The number of line solver calls between two calls
+ */
+extern void nonogram_solver_set_progress(
+  NonoGramSolver *solver,
+  NonoGramProgress progress,
+  void *data,
+  long interval
+);
+/**
+ * @brief Restart the solve of a solver
+ * @param solver The solver
+ * @note The clues of the hints of the solver are read again: the solver
+ *       follows clues changed in place, with the same dimensions
+ * @note The settings, the relaxed lines, the phases and the counters are
+ *       kept
+ */
+extern void nonogram_solver_reset(NonoGramSolver *solver);
+
+/**
+ * @brief Ignore the clue of a line
+ * @param solver The solver
+ * @param line The line index, rows first, then columns
+ * @note This must be called before the first solve
+ */
+extern void nonogram_solver_relax_line(NonoGramSolver *solver, int line);
+/**
+ * @brief Set the value tried first when the search decides a cell
+ * @param solver The solver
+ * @param row The row index
+ * @param col The col index
+ * @param value 1 or 0, -1 to restore the default
+ * @note This is how a board close to a solution warm-starts the search
+ */
+extern void nonogram_solver_set_phase(
+  NonoGramSolver *solver,
+  int row,
+  int col,
+  int value
+);
+
+/**
+ * @brief Get a cell of the board of a solver
+ * @param solver The solver
+ * @param row The row index
+ * @param col The col index
+ * @return 1 if the cell is filled, 0 if it is empty, -1 if it is unknown
+ */
+extern int nonogram_solver_get_cell(NonoGramSolver *solver, int row, int col);
+/**
+ * @brief Get the counters of a solver
+ * @param solver The solver
+ * @return The counters of the solver
+ */
+extern const NonoGramSolverStats *nonogram_solver_get_stats(
+  NonoGramSolver *solver
+);
+
+/**
+ * @brief Get the name of an engine
+ * @param engine The engine
+ * @return The name of the engine
+ */
+extern const char *nonogram_engine_to_string(NonoGramEngine engine);
+/**
+ * @brief Get an engine from its name
+ * @param name The name of the engine
+ * @param engine The engine to fill
+ * @return true if the name is known, false otherwise
+ */
+extern bool nonogram_engine_from_string(
+  const char *name,
+  NonoGramEngine *engine
+);
+
+#endif  // SOLVER_H_
@@ -0,0 +1,561 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+/**
+ * @file table.c
+ * @brief Implementation of the tables of tiny puzzles.
+ *
+ * A line has few clues: 13 for 5 cells. The clue of a line is coded by its
+ * rank among the clues of its length, and the clues of the rows, or of the
+ * columns, by the digits of a number in that base. Given the clues of the
+ * rows, a board is the choice of a line among the lines of each clue: 6 at
+ * most for 5 cells, so that the index of the choice takes 13 bits and the
+ * code of the columns the 19 other bits of an entry. The writer enumerates
+ * every board of every size, groups the entries by the code of the rows,
+ * sorts each group and keeps the first two entries of a puzzle. A lookup
+ * codes the clues, reads the bounds of the group and finds the entries of
+ * the puzzle by a binary search, then decodes the board.
+ */
+#include "./table.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "./nonogram.h"
+
+#include "./nonogram.inc"
+#include "./table.inc"
+
+/**
+ * @brief Magic bytes of a table
+ */
+#define TABLE_MAGIC "NONOTABL"
+
+/**
+ * @brief Version of the table format
+ */
+#define TABLE_VERSION 1
+
+/**
+ * @brief Byte order mark of a table
+ */
+#define TABLE_BYTE_ORDER 0x01020304u
+
+/**
+ * @brief Number of bits of the index of a board in an entry
+ */
+#define TABLE_INDEX_BITS 13
+
+/**
+ * @brief State of a table whose file is mapped
+ */
+#define TABLE_MAPPED 1
+
+/**
+ * @brief State of a table whose file cannot be mapped
+ */
+#define TABLE_INVALID -1
+
+/**
+ * @brief Codes of the clues of the lines by their cells, for each length
+ */
+static uint8_t _codes[NONOGRAM_TABLE_SIZE_MAX + 1]
+                     [1 << NONOGRAM_TABLE_SIZE_MAX];
+
+/**
+ * @brief Number of clues of the lines, for each length
+ */
+static uint32_t _clues_counts[NONOGRAM_TABLE_SIZE_MAX + 1];
+
+/**
+ * @brief Lines sorted by the code of their clue, for each length
+ */
+static uint8_t _lines[NONOGRAM_TABLE_SIZE_MAX + 1]
+                     [1 << NONOGRAM_TABLE_SIZE_MAX];
+
+/**
+ * @brief Index of the first line of each clue in the sorted lines, then
+ *        the number of lines, for each length
+ */
+static uint8_t _firsts[NONOGRAM_TABLE_SIZE_MAX + 1]
+                      [(1 << NONOGRAM_TABLE_SIZE_MAX) + 1];
+
+/**
+ * @brief Rank of each line among the lines of its clue, for each length
+ */
+static uint8_t _ranks[NONOGRAM_TABLE_SIZE_MAX + 1]
+                     [1 << NONOGRAM_TABLE_SIZE_MAX];
+
+/**
+ * @brief Initialization of the codes
+ */
+static pthread_once_t _codes_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Get the leftmost line having the clue of a line
+ * @param cells The cells of the line, from the low bit
+ * @param length The length of the line
+ * @return The cells of the leftmost line
+ */
+static unsigned _leftmost(unsigned cells, int length) {
+  unsigned leftmost = 0;
+  int position = 0;
+  int count = 0;
+  for (int index = 0; index <= length; index++) {
+    if (index < length && (cells >> index & 1)) {
+      count++;
+    } else if (count) {
+      leftmost |= ((1u << count) - 1) << position;
+      position += count + 1;
+      count = 0;
+    }
+  }
+  return leftmost;
+}
+
+/**
+ * @brief Compute the codes of the clues
+ */
+static void _init_codes(void) {
+  for (int length = 0; length <= NONOGRAM_TABLE_SIZE_MAX; length++) {
+    uint32_t count = 0;
+    for (unsigned cells = 0; cells < 1u << length; cells++) {
+      if (_leftmost(cells, length) == cells) {
+        _codes[length][cells] = count++;
+      }
+    }
+    for (unsigned cells = 0; cells < 1u << length; cells++) {
+      _codes[length][cells] = _codes[length][_leftmost(cells, length)];
+      _firsts[length][_codes[length][cells] + 1]++;
+    }
+    for (uint32_t code = 0; code < count; code++) {
+      _firsts[length][code + 1] += _firsts[length][code];
+    }
+    uint8_t next[1 << NONOGRAM_TABLE_SIZE_MAX];
+    memcpy(next, _firsts[length], count);
+    for (unsigned cells = 0; cells < 1u << length; cells++) {
+      int code = _codes[length][cells];
+      _ranks[length][cells] = next[code] - _firsts[length][code];
+      _lines[length][next[code]++] = cells;
+    }
+    _clues_counts[length] = count;
+  }
+}
+
+/**
+ * @brief Get the code of the clue of a line of hints
+ * @param line The blocks of the line, ended by 0 if they are fewer than
+ *        its cells
+ * @param length The length of the line
+ * @return The code, or -1 if the blocks do not fit in the line
+ */
+static int _code(const int *line, int length) {
+  unsigned leftmost = 0;
+  int position = 0;
+  for (int index = 0; index < length && line[index]; index++) {
+    int count = line[index];
+    if (count < 0 || count > length - position) {
+      return -1;
+    }
+    leftmost |= ((1u << count) - 1) << position;
+    position += count + 1;
+  }
+  return _codes[length][leftmost];
+}
+
+/**
+ * @brief Get the code of the rows of a board
+ * @param board The cells, bit-packed row after row from the low bit
+ * @param rows_count The number of rows
+ * @param cols_count The number of columns
+ * @param pindex A pointer to the index of the board among the boards of
+ *        its rows
+ * @return The code of the clues of the rows
+ */
+static uint64_t _rows_code(
+  uint32_t board,
+  int rows_count,
+  int cols_count,
+  uint32_t *pindex
+) {
+  uint64_t code = 0;
+  uint32_t index = 0;
+  for (int row = rows_count - 1; row >= 0; row--) {
+    unsigned cells = board >> (row * cols_count) & ((1u << cols_count) - 1);
+    const uint8_t *firsts = &_firsts[cols_count][_codes[cols_count][cells]];
+    code = code * _clues_counts[cols_count] + _codes[cols_count][cells];
+    index = index * (firsts[1] - firsts[0]) + _ranks[cols_count][cells];
+  }
+  *pindex = index;
+  return code;
+}
+
+/**
+ * @brief Get the code of the columns of a board
+ * @param board The cells, bit-packed row after row from the low bit
+ * @param rows_count The number of rows
+ * @param cols_count The number of columns
+ * @return The code of the clues of the columns
+ */
+static uint64_t _cols_code(uint32_t board, int rows_count, int cols_count) {
+  uint64_t code = 0;
+  for (int col = cols_count - 1; col >= 0; col--) {
+    unsigned cells = 0;
+    for (int row = 0; row < rows_count; row++) {
+      cells |= (board >> (row * cols_count + col) & 1) << row;
+    }
+    code = code * _clues_counts[rows_count] + _codes[rows_count][cells];
+  }
+  return code;
+}
+
+/**
+ * @brief Get the number of codes of the rows of a size
+ * @param rows_count The number of rows
+ * @param cols_count The number of columns
+ * @return The number of groups of the section of the size
+ */
+static uint64_t _groups_count(int rows_count, int cols_count) {
+  uint64_t count = 1;
+  for (int row = 0; row < rows_count; row++) {
+    count *= _clues_counts[cols_count];
+  }
+  return count;
+}
+
+/**
+ * @brief Open a table
+ * @param filename The name of the table file
+ * @return A new table, or NULL if memory allocation fails
+ */
+NonoGramTable *nonogram_table_open(const char *filename) {
+  NonoGramTable *table = calloc(1, sizeof(NonoGramTable));
+  if (!table) {
+    return NULL;
+  }
+  table->filename = strdup(filename);
+  if (!table->filename) {
+    free(table);
+    return NULL;
+  }
+  pthread_mutex_init(&table->lock, NULL);
+  atomic_init(&table->state, 0);
+  return table;
+}
+
+/**
+ * @brief Close a table
+ * @param table The table
+ */
+void nonogram_table_close(NonoGramTable *table) {
+  if (table->data) {
+    munmap((void *) table->data, table->size);
+  }
+  pthread_mutex_destroy(&table->lock);
+  free(table->filename);
+  free(table);
+}
+
+/**
+ * @brief Map the file of a table and check its header
+ * @param table The table
+ * @return false if the file cannot be mapped or is not a valid table
+ */
+static bool _load(NonoGramTable *table) {
+  pthread_once(&_codes_once, _init_codes);
+  int fd = open(table->filename, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat status;
+  if (fstat(fd, &status) < 0
+      || (size_t) status.st_size < sizeof(NonoGramTableHeader)) {
+    close(fd);
+    return false;
+  }
+  void *data = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  const NonoGramTableHeader *header = data;
+  uint64_t size = status.st_size;
+  bool valid = !memcmp(header->magic, TABLE_MAGIC, sizeof header->magic)
+    && header->version == TABLE_VERSION
+    && header->byte_order == TABLE_BYTE_ORDER
+    && header->size >= 1
+    && header->size <= NONOGRAM_TABLE_SIZE_MAX;
+  for (int rows_count = 1;
+       valid && rows_count <= (int) header->size;
+       rows_count++) {
+    for (int cols_count = 1;
+         valid && cols_count <= (int) header->size;
+         cols_count++) {
+      const NonoGramTableSection *section =
+        &header->sections[(rows_count - 1) * header->size + cols_count - 1];
+      valid = section->groups_count == _groups_count(rows_count, cols_count)
+        && section->offsets_offset % sizeof(uint32_t) == 0
+        && section->offsets_offset <= size
+        && section->groups_count + 1
+           <= (size - section->offsets_offset) / sizeof(uint32_t)
+        && section->entries_offset % sizeof(uint32_t) == 0
+        && section->entries_offset <= size
+        && section->entries_count
+           <= (size - section->entries_offset) / sizeof(uint32_t);
+    }
+  }
+  if (!valid) {
+    munmap(data, status.st_size);
+    return false;
+  }
+  table->data = data;
+  table->size = status.st_size;
+  table->header = header;
+  return true;
+}
+
+/**
+ * @brief Map the file of a table once
+ * @param table The table
+ * @return false if the file cannot be mapped or is not a valid table
+ */
+static bool _map(NonoGramTable *table) {
+  int state = atomic_load_explicit(&table->state, memory_order_acquire);
+  if (state) {
+    return state == TABLE_MAPPED;
+  }
+  pthread_mutex_lock(&table->lock);
+  state = atomic_load_explicit(&table->state, memory_order_relaxed);
+  if (!state) {
+    state = _load(table) ? TABLE_MAPPED : TABLE_INVALID;
+    atomic_store_explicit(&table->state, state, memory_order_release);
+  }
+  pthread_mutex_unlock(&table->lock);
+  return state == TABLE_MAPPED;
+}
+
+/**
+ * @brief Get the size of the puzzles of a table
+ * @param table The table
+ * @return The largest number of rows and of columns of the puzzles, 0 if
+ *         the file cannot be mapped or is not a valid table
+ */
+int nonogram_table_get_size(NonoGramTable *table) {
+  return _map(table) ? (int) table->header->size : 0;
+}
+
+/**
+ * @brief Look the solutions of a puzzle up
+ * @param table The table
+ * @param hints The hints of the puzzle
+ * @param cells The buffer receiving a solution, row by row
+ * @return The number of solutions, 2 for two or more, -1 if the puzzle is
+ *         not in the table
+ */
+int nonogram_table_lookup(
+  NonoGramTable *table,
+  NonoGramHints *hints,
+  signed char *cells
+) {
+  int rows_count = hints->rows_count;
+  int cols_count = hints->cols_count;
+  if (hints->given || rows_count < 1 || cols_count < 1 || !_map(table)
+      || rows_count > (int) table->header->size
+      || cols_count > (int) table->header->size) {
+    return -1;
+  }
+  int codes[NONOGRAM_TABLE_SIZE_MAX];
+  uint64_t rows_code = 0;
+  for (int row = rows_count - 1; row >= 0; row--) {
+    codes[row] = _code(hints->rows[row], cols_count);
+    if (codes[row] < 0) {
+      return 0;
+    }
+    rows_code = rows_code * _clues_counts[cols_count] + codes[row];
+  }
+  uint64_t cols_code = 0;
+  for (int col = cols_count - 1; col >= 0; col--) {
+    int code = _code(hints->cols[col], rows_count);
+    if (code < 0) {
+      return 0;
+    }
+    cols_code = cols_code * _clues_counts[rows_count] + code;
+  }
+
+  const NonoGramTableSection *section = &table->header->sections[
+    (rows_count - 1) * table->header->size + cols_count - 1];
+  const uint32_t *offsets =
+    (const uint32_t *) (table->data + section->offsets_offset);
+  const uint32_t *entries =
+    (const uint32_t *) (table->data + section->entries_offset);
+  uint32_t low = offsets[rows_code];
+  uint32_t end = offsets[rows_code + 1];
+  if (low > end || end > section->entries_count) {
+    return -1;
+  }
+  uint32_t key = cols_code << TABLE_INDEX_BITS;
+  uint32_t high = end;
+  while (low < high) {
+    uint32_t middle = low + (high - low) / 2;
+    if (entries[middle] < key) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  if (low == end || entries[low] >> TABLE_INDEX_BITS != cols_code) {
+    return 0;
+  }
+  uint32_t index = entries[low] & ((1u << TABLE_INDEX_BITS) - 1);
+  for (int row = 0; row < rows_count; row++) {
+    const uint8_t *firsts = &_firsts[cols_count][codes[row]];
+    uint32_t count = firsts[1] - firsts[0];
+    unsigned line = _lines[cols_count][firsts[0] + index % count];
+    index /= count;
+    for (int col = 0; col < cols_count; col++) {
+      cells[row * cols_count + col] = line >> col & 1;
+    }
+  }
+  return low + 1 < end && entries[low + 1] >> TABLE_INDEX_BITS == cols_code
+    ? 2
+    : 1;
+}
+
+/**
+ * @brief Compare two entries
+ * @param first The first entry
+ * @param second The second entry
+ * @return The order of the entries
+ */
+static int _compare(const void *first, const void *second) {
+  uint32_t a = *(const uint32_t *) first;
+  uint32_t b = *(const uint32_t *) second;
+  return (a > b) - (a < b);
+}
+
+/**
+ * @brief Write the section of the puzzles of a size
+ * @param file The table file, at the offset of the section
+ * @param rows_count The number of rows
+ * @param cols_count The number of columns
+ * @param section The location of the section, filled
+ * @param poffset A pointer to the offset in the file, moved past the
+ *        section
+ * @return false if the file cannot be written or memory allocation fails
+ */
+static bool _write_section(
+  FILE *file,
+  int rows_count,
+  int cols_count,
+  NonoGramTableSection *section,
+  uint64_t *poffset
+) {
+  uint32_t boards_count = 1u << (rows_count * cols_count);
+  uint64_t groups_count = _groups_count(rows_count, cols_count);
+  uint32_t *offsets = calloc(groups_count + 1, sizeof(uint32_t));
+  uint32_t *entries = malloc(boards_count * sizeof(uint32_t));
+  if (!offsets || !entries) {
+    free(offsets);
+    free(entries);
+    return false;
+  }
+
+  // Entries are grouped by the code of the rows with a counting sort
+  uint32_t index;
+  for (uint32_t board = 0; board < boards_count; board++) {
+    offsets[_rows_code(board, rows_count, cols_count, &index) + 1]++;
+  }
+  for (uint64_t group = 0; group < groups_count; group++) {
+    offsets[group + 1] += offsets[group];
+  }
+  for (uint32_t board = 0; board < boards_count; board++) {
+    uint64_t group = _rows_code(board, rows_count, cols_count, &index);
+    entries[offsets[group]++] =
+      _cols_code(board, rows_count, cols_count) << TABLE_INDEX_BITS | index;
+  }
+  memmove(offsets + 1, offsets, groups_count * sizeof(uint32_t));
+  offsets[0] = 0;
+
+  // Each group is sorted, the first two entries of a puzzle are kept in
+  // place: the entries already kept tell whether two of them are there
+  uint32_t count = 0;
+  uint32_t start = 0;
+  for (uint64_t group = 0; group < groups_count; group++) {
+    uint32_t end = offsets[group + 1];
+    offsets[group] = count;
+    qsort(entries + start, end - start, sizeof(uint32_t), _compare);
+    for (uint32_t entry = start; entry < end; entry++) {
+      uint32_t code = entries[entry] >> TABLE_INDEX_BITS;
+      if (count - offsets[group] < 2
+          || entries[count - 2] >> TABLE_INDEX_BITS != code) {
+        entries[count++] = entries[entry];
+      }
+    }
+    start = end;
+  }
+  offsets[groups_count] = count;
+
+  section->offsets_offset = *poffset;
+  section->groups_count = groups_count;
+  section->entries_offset =
+    section->offsets_offset + (groups_count + 1) * sizeof(uint32_t);
+  section->entries_count = count;
+  *poffset = section->entries_offset + count * sizeof(uint32_t);
+  bool written =
+    fwrite(offsets, sizeof(uint32_t), groups_count + 1, file)
+      == groups_count + 1
+    && fwrite(entries, sizeof(uint32_t), count, file) == count;
+  free(offsets);
+  free(entries);
+  return written;
+}
+
+/**
+ * @brief Write the table of every puzzle up to a size
+ * @param filename The name of the table file
+ * @param size The largest number of rows and of columns
+ * @return false if the file cannot be written or memory allocation fails
+ */
+bool nonogram_table_write(const char *filename, int size) {
+  if (size < 1 || size > NONOGRAM_TABLE_SIZE_MAX) {
+    return false;
+  }
+  pthread_once(&_codes_once, _init_codes);
+  FILE *file = fopen(filename, "wb");
+  if (!file) {
+    return false;
+  }
+  NonoGramTableHeader header = {
+    .version = TABLE_VERSION,
+    .byte_order = TABLE_BYTE_ORDER,
+    .size = size,
+  };
+  memcpy(header.magic, TABLE_MAGIC, sizeof header.magic);
+
+  // The header is written again once the sections are known
+  bool written = fwrite(&header, sizeof header, 1, file) == 1;
+  uint64_t offset = sizeof header;
+  for (int rows_count = 1; written && rows_count <= size; rows_count++) {
+    for (int cols_count = 1; written && cols_count <= size; cols_count++) {
+      written = _write_section(
+        file, rows_count, cols_count,
+        &header.sections[(rows_count - 1) * size + cols_count - 1], &offset);
+    }
+  }
+  written = written && fseek(file, 0, SEEK_SET) == 0
+    && fwrite(&header, sizeof header, 1, file) == 1;
+  written = !fclose(file) && written;
+  if (!written) {
+    remove(filename);
+  }
+  return written;
+}
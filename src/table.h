@@ -0,0 +1,70 @@
+#ifndef TABLE_H_
+#define TABLE_H_
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+#include <stdbool.h>
+
+#include "./nonogram.h"
+
+/**
+ * @brief Largest number of rows and of columns of a table
+ */
+#define NONOGRAM_TABLE_SIZE_MAX 5
+
+/**
+ * NonoGramTable is a opaque structure that represents the precomputed
+ * solutions of every puzzle up to a small size, read from a table file.
+ */
+typedef struct _NonoGramTable NonoGramTable;
+
+/**
+ * @brief Open a table
+ * @param filename The name of the table file
+ * @return A new table, or NULL if memory allocation fails
+ * @note The file is mapped by the first lookup, not by the opening
+ */
+extern NonoGramTable *nonogram_table_open(const char *filename);
+/**
+ * @brief Close a table
+ * @param table The table
+ */
+extern void nonogram_table_close(NonoGramTable *table);
+
+/**
+ * @brief Get the size of the puzzles of a table
+ * @param table The table
+ * @return The largest number of rows and of columns of the puzzles, 0 if
+ *         the file cannot be mapped or is not a valid table
+ */
+extern int nonogram_table_get_size(NonoGramTable *table);
+
+/**
+ * @brief Look the solutions of a puzzle up
+ * @param table The table
+ * @param hints The hints of the puzzle
+ * @param cells The buffer receiving a solution, row by row
+ * @return The number of solutions, 2 for two or more, -1 if the puzzle is
+ *         not in the table
+ * @note Puzzles larger than the table, or having given cells, are not in
+ *       the table
+ * @note A lookup maps the file at first, then only reads it, so that
+ *       threads can share a table
+ */
+extern int nonogram_table_lookup(
+  NonoGramTable *table,
+  NonoGramHints *hints,
+  signed char *cells
+);
+
+/**
+ * @brief Write the table of every puzzle up to a size
+ * @param filename The name of the table file
+ * @param size The largest number of rows and of columns, at most
+ *        NONOGRAM_TABLE_SIZE_MAX
+ * @return false if the file cannot be written or memory allocation fails
+ * @note Every board of every size is enumerated: 2^25 boards for 5x5
+ */
+extern bool nonogram_table_write(const char *filename, int size);
+
+#endif  // TABLE_H_
@@ -0,0 +1,150 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <assert.h>
+
+#include "./archive.h"
+#include "./nonogram.h"
+#include "./nonogram.inc"
+#include "./archive.inc"
+
+/**
+ * Parse a null-terminated string.
+ */
+static NonoGramHints *parse(const char *string) {
+  return nonogram_hints_parse(string, strlen(string));
+}
+
+int main(void) {
+  char filename[] = "test-archive-XXXXXX";
+  int fd = mkstemp(filename);
+  assert(fd >= 0);
+  close(fd);
+
+  /**
+   * Board and hints of the first puzzle:
+   *      2 1 1
+   *     +-----
+   * 2 1 |■ ■   ■
+   * 1 1 |■   ■
+   */
+  int first_rows[2][3] = {{1, 1, 0}, {1, 0, 1}};
+  int *board[2] = {first_rows[0], first_rows[1]};
+  NonoGramHints *first = nonogram_hints_create(board, 2, 3);
+  NonoGramHints *second = parse("{\"rows\":[[1],[1]],\"cols\":[[1],[1]]}");
+  NonoGramHints *third = parse("{\"rows\":[[3]],\"cols\":[[1],[1],[1]]}");
+
+  NonoGramArchiveWriter *writer = nonogram_archive_writer_open(filename, false);
+  assert(writer);
+  assert(nonogram_archive_writer_add(writer, first, board, "first") == 0);
+  assert(nonogram_archive_writer_add(writer, second, NULL, NULL) == 1);
+  assert(nonogram_archive_writer_add(writer, first, NULL, "again") == 2);
+  assert(nonogram_archive_writer_close(writer));
+
+  NonoGramArchive *archive = nonogram_archive_open(filename);
+  assert(archive);
+  assert(nonogram_archive_get_count(archive) == 3);
+  NonoGramHints *hints = nonogram_archive_get_hints(archive, 0);
+  assert(nonogram_hints_equal(hints, first));
+  nonogram_hints_destroy(hints);
+  hints = nonogram_archive_get_hints(archive, 1);
+  assert(nonogram_hints_equal(hints, second));
+  nonogram_hints_destroy(hints);
+  assert(nonogram_archive_get_hash(archive, 1) == nonogram_hints_hash(second));
+  for (int row = 0; row < 2; row++) {
+    for (int col = 0; col < 3; col++) {
+      assert(nonogram_archive_get_cell(archive, 0, row, col)
+             == first_rows[row][col]);
+    }
+  }
+  assert(nonogram_archive_get_cell(archive, 1, 0, 0) == -1);
+  assert(strcmp(nonogram_archive_get_metadata(archive, 0), "first") == 0);
+  assert(!nonogram_archive_get_metadata(archive, 1));
+  assert(nonogram_archive_find(archive, first) == 0);
+  assert(nonogram_archive_find(archive, second) == 1);
+  assert(nonogram_archive_find(archive, third) == -1);
+  assert(!nonogram_archive_get_hints(archive, 3));
+  nonogram_archive_close(archive);
+
+  // Appending keeps the puzzles and their ids
+  writer = nonogram_archive_writer_open(filename, true);
+  assert(writer);
+  assert(nonogram_archive_writer_add(writer, third, NULL, "third") == 3);
+  assert(nonogram_archive_writer_close(writer));
+  archive = nonogram_archive_open(filename);
+  assert(archive);
+  assert(nonogram_archive_get_count(archive) == 4);
+  assert(nonogram_archive_find(archive, first) == 0);
+  assert(nonogram_archive_find(archive, third) == 3);
+  assert(strcmp(nonogram_archive_get_metadata(archive, 2), "again") == 0);
+  assert(nonogram_archive_get_cell(archive, 0, 1, 2) == 1);
+  assert(nonogram_archive_get_hash(archive, 4) == 0);
+  assert(nonogram_archive_get_hash(archive, -1) == 0);
+  nonogram_archive_close(archive);
+
+  // A hash table without empty slots is refused, or probed once at most
+  FILE *file = fopen(filename, "r+b");
+  assert(file);
+  NonoGramArchiveHeader header;
+  assert(fread(&header, sizeof header, 1, file) == 1);
+  assert(header.count == 4 && header.table_size == 8);
+  uint32_t slots[8] = {4, 4, 4, 4, 4, 4, 4, 4};
+  assert(fseek(file, header.table_offset, SEEK_SET) == 0);
+  assert(fwrite(slots, sizeof slots, 1, file) == 1);
+  assert(fflush(file) == 0);
+  archive = nonogram_archive_open(filename);
+  assert(archive);
+  assert(nonogram_archive_find(archive, second) == -1);
+  assert(nonogram_archive_find(archive, third) == 3);
+  nonogram_archive_close(archive);
+  header.table_size = 4;
+  rewind(file);
+  assert(fwrite(&header, sizeof header, 1, file) == 1);
+  fclose(file);
+  assert(!nonogram_archive_open(filename));
+
+  // An unfinished archive is not an archive
+  writer = nonogram_archive_writer_open(filename, false);
+  assert(writer);
+  assert(!nonogram_archive_open(filename));
+  assert(nonogram_archive_writer_close(writer));
+  archive = nonogram_archive_open(filename);
+  assert(archive);
+  assert(nonogram_archive_get_count(archive) == 0);
+  assert(nonogram_archive_find(archive, first) == -1);
+  nonogram_archive_close(archive);
+
+  // The given cells are kept along with the solution
+  const signed char cells[6] = {1, -1, -1, -1, 0, -1};
+  assert(nonogram_hints_set_given(first, cells));
+  writer = nonogram_archive_writer_open(filename, false);
+  assert(writer);
+  assert(nonogram_archive_writer_add(writer, first, board, "given") == 0);
+  assert(nonogram_archive_writer_close(writer));
+  archive = nonogram_archive_open(filename);
+  assert(archive);
+  hints = nonogram_archive_get_hints(archive, 0);
+  assert(nonogram_hints_equal(hints, first));
+  assert(nonogram_hints_get_given(hints, 1, 1) == 0);
+  assert(nonogram_hints_hash(hints) == nonogram_archive_get_hash(archive, 0));
+  nonogram_hints_destroy(hints);
+  assert(nonogram_archive_find(archive, first) == 0);
+  assert(nonogram_archive_get_cell(archive, 0, 1, 2) == 1);
+  assert(nonogram_archive_get_cell(archive, 0, 0, 2) == 0);
+  assert(strcmp(nonogram_archive_get_metadata(archive, 0), "given") == 0);
+  nonogram_archive_close(archive);
+
+  unlink(filename);
+  nonogram_hints_destroy(first);
+  nonogram_hints_destroy(second);
+  nonogram_hints_destroy(third);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,122 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <assert.h>
+
+#include "./nonogram.h"
+#include "./solver.h"
+
+/**
+ * Size of the random puzzles of the test.
+ */
+#define SIZE 6
+
+/**
+ * Number of random puzzles of the test.
+ */
+#define PUZZLES 300
+
+/**
+ * Cells of the solutions of a puzzle: the value shared by every solution,
+ * or -1 when solutions differ.
+ */
+typedef struct {
+  signed char cells[SIZE * SIZE];  // Value of each cell, -1 if it varies
+  long count;                      // Number of solutions
+} Solutions;
+
+/**
+ * Merge a solution into the cells of the solutions.
+ */
+static bool merge(const unsigned char *bits, void *data) {
+  Solutions *solutions = data;
+  for (int cell = 0; cell < SIZE * SIZE; cell++) {
+    signed char value = (bits[cell / SIZE] >> (7 - cell % SIZE)) & 1;
+    if (!solutions->count) {
+      solutions->cells[cell] = value;
+    } else if (solutions->cells[cell] != value) {
+      solutions->cells[cell] = -1;
+    }
+  }
+  solutions->count++;
+  return true;
+}
+
+/**
+ * Check the backbone of a puzzle against the enumeration of its solutions,
+ * return the number of cells that vary.
+ */
+static int check(NonoGramHints *hints) {
+  NonoGramSolver *solver = nonogram_solver_create(hints);
+  Solutions solutions = {.count = 0};
+  assert(nonogram_solver_enumerate(solver, 0, merge, &solutions, NULL) > 0);
+  nonogram_solver_destroy(solver);
+
+  solver = nonogram_solver_create(hints);
+  assert(nonogram_solver_backbone(solver) == NONOGRAM_SOLVER_SOLVED);
+  int varying = 0;
+  for (int cell = 0; cell < SIZE * SIZE; cell++) {
+    assert(nonogram_solver_get_cell(solver, cell / SIZE, cell % SIZE)
+           == solutions.cells[cell]);
+    varying += solutions.cells[cell] == -1;
+  }
+  assert((solutions.count == 1) == (varying == 0));
+
+  // The solver goes on from the backbone
+  assert(nonogram_solver_solve(solver, NONOGRAM_ENGINE_DFS)
+         == NONOGRAM_SOLVER_SOLVED);
+  nonogram_solver_destroy(solver);
+  return varying;
+}
+
+int main(void) {
+  int **board = malloc(SIZE * sizeof(int *));
+  for (int row = 0; row < SIZE; row++) {
+    board[row] = calloc(SIZE, sizeof(int));
+  }
+
+  // Random puzzles, unique or not, have the backbone of their solutions
+  int ambiguous = 0;
+  srand(1);
+  for (int puzzle = 0; puzzle < PUZZLES; puzzle++) {
+    for (int cell = 0; cell < SIZE * SIZE; cell++) {
+      board[cell / SIZE][cell % SIZE] = rand() % 2;
+    }
+    NonoGramHints *hints = nonogram_hints_create(board, SIZE, SIZE);
+    ambiguous += check(hints) > 0;
+    nonogram_hints_destroy(hints);
+  }
+  assert(ambiguous > 0 && ambiguous < PUZZLES);
+
+  // No cell of a permutation puzzle is fixed, the node limit stops it
+  for (int cell = 0; cell < SIZE * SIZE; cell++) {
+    board[cell / SIZE][cell % SIZE] = cell / SIZE == cell % SIZE;
+  }
+  NonoGramHints *hints = nonogram_hints_create(board, SIZE, SIZE);
+  assert(check(hints) == SIZE * SIZE);
+  NonoGramSolver *solver = nonogram_solver_create(hints);
+  nonogram_solver_set_node_limit(solver, 2);
+  assert(nonogram_solver_backbone(solver) == NONOGRAM_SOLVER_STOPPED);
+  nonogram_solver_destroy(solver);
+  nonogram_hints_destroy(hints);
+
+  // Clues that do not agree have no backbone
+  const char *string = "{\"rows\":[[2],[1]],\"cols\":[[2],[2]]}";
+  hints = nonogram_hints_parse(string, strlen(string));
+  solver = nonogram_solver_create(hints);
+  assert(nonogram_solver_backbone(solver) == NONOGRAM_SOLVER_FAILED);
+  nonogram_solver_destroy(solver);
+  nonogram_hints_destroy(hints);
+
+  for (int row = 0; row < SIZE; row++) {
+    free(board[row]);
+  }
+  free(board);
+  return EXIT_SUCCESS;
+}
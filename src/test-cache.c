@@ -0,0 +1,123 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <assert.h>
+
+#include "./cache.h"
+#include "./nonogram.h"
+
+/**
+ * Number of readers, and number of lookups of each reader.
+ */
+#define THREADS 4
+#define LOOKUPS 20000
+
+/**
+ * Number of puzzles of the test.
+ */
+#define PUZZLES 64
+
+/**
+ * Cache shared by the threads.
+ */
+static NonoGramCache *cache;
+
+/**
+ * Create the hints of a 3x3 board and fill its cells.
+ */
+static NonoGramHints *board_hints(int bits, signed char *cells) {
+  int *rows[3];
+  int values[3][3];
+  for (int row = 0; row < 3; row++) {
+    rows[row] = values[row];
+    for (int col = 0; col < 3; col++) {
+      values[row][col] = (bits >> (row * 3 + col)) & 1;
+      cells[row * 3 + col] = values[row][col];
+    }
+  }
+  return nonogram_hints_create(rows, 3, 3);
+}
+
+/**
+ * Check that a board satisfies hints, other boards can share them.
+ */
+static bool satisfies(NonoGramHints *hints, const signed char *cells) {
+  int bits = 0;
+  for (int cell = 0; cell < 9; cell++) {
+    bits |= cells[cell] << cell;
+  }
+  signed char copy[9];
+  NonoGramHints *other = board_hints(bits, copy);
+  bool equal = nonogram_hints_equal(hints, other);
+  nonogram_hints_destroy(other);
+  return equal;
+}
+
+/**
+ * Look the puzzles up, any board found must satisfy its hints.
+ */
+static void *lookup(void *data) {
+  (void) data;
+  for (int index = 0; index < LOOKUPS; index++) {
+    signed char expected[9];
+    signed char cells[9];
+    NonoGramHints *hints = board_hints(index % PUZZLES * 7 + 1, expected);
+    if (nonogram_cache_get(cache, hints, cells)) {
+      assert(satisfies(hints, cells));
+    }
+    nonogram_hints_destroy(hints);
+  }
+  return NULL;
+}
+
+int main(void) {
+  signed char cells[9];
+  signed char found[9];
+
+  // A bucket keeps its latest puzzles
+  cache = nonogram_cache_create(4);
+  for (int bits = 1; bits <= 5; bits++) {
+    nonogram_cache_put(cache, board_hints(bits, cells), cells);
+  }
+  assert(nonogram_cache_get_count(cache) == 4);
+  NonoGramHints *hints = board_hints(1, cells);
+  assert(!nonogram_cache_get(cache, hints, found));
+  nonogram_hints_destroy(hints);
+  hints = board_hints(5, cells);
+  memset(found, -1, sizeof found);
+  assert(nonogram_cache_get(cache, hints, found));
+  assert(memcmp(found, cells, sizeof cells) == 0);
+  nonogram_hints_destroy(hints);
+  // A puzzle already there is not added twice
+  nonogram_cache_put(cache, board_hints(5, cells), cells);
+  hints = board_hints(2, cells);
+  assert(nonogram_cache_get(cache, hints, found));
+  nonogram_hints_destroy(hints);
+  nonogram_cache_destroy(cache);
+
+  // Lookups run concurrently with puzzles being added
+  cache = nonogram_cache_create(PUZZLES / 2);
+  pthread_t threads[THREADS];
+  for (int thread = 0; thread < THREADS; thread++) {
+    assert(!pthread_create(&threads[thread], NULL, lookup, NULL));
+  }
+  for (int index = 0; index < PUZZLES * 4; index++) {
+    nonogram_cache_put(
+      cache, board_hints(index % PUZZLES * 7 + 1, cells), cells);
+  }
+  for (int thread = 0; thread < THREADS; thread++) {
+    pthread_join(threads[thread], NULL);
+  }
+  // The capacity bounds the puzzles kept
+  assert(nonogram_cache_get_count(cache) > 0);
+  assert(nonogram_cache_get_count(cache) <= PUZZLES / 2);
+  nonogram_cache_destroy(cache);
+  return EXIT_SUCCESS;
+}
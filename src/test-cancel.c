@@ -0,0 +1,98 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <assert.h>
+
+#include "./nonogram.h"
+#include "./solver.h"
+#include "./nonogram.inc"
+
+/**
+ * State shared with the progress callback.
+ */
+typedef struct {
+  atomic_bool cancel;  // Flag raised by the callback
+  int calls;           // Number of calls of the callback
+  int cancel_at;       // Call raising the flag
+} Progress;
+
+/**
+ * Count the calls and raise the flag on a given call.
+ */
+static void on_progress(long nodes, int settled, void *data) {
+  Progress *progress = data;
+  assert(nodes >= 0);
+  assert(settled >= 0 && settled <= 25);
+  if (++progress->calls == progress->cancel_at) {
+    atomic_store(&progress->cancel, true);
+  }
+}
+
+int main(void) {
+  int rows_count = 5;
+  int cols_count = 5;
+  int **board = malloc(rows_count * sizeof(int *));
+  for (int row = 0; row < rows_count; row++) {
+    board[row] = calloc(cols_count, sizeof(int));
+    board[row][row] = 1;
+  }
+  NonoGramHints *hints = nonogram_hints_create(board, rows_count, cols_count);
+
+  // Cancel from the progress callback deep in the search, then resume
+  NonoGramEngine engines[] = {
+    NONOGRAM_ENGINE_DFS, NONOGRAM_ENGINE_PROBE, NONOGRAM_ENGINE_AUTO,
+    NONOGRAM_ENGINE_LOCAL
+  };
+  for (int index = 0; index < 4; index++) {
+    // Propagating the initial lines takes 10 line solves
+    int cancel_at = engines[index] == NONOGRAM_ENGINE_LOCAL ? 5 : 12;
+    Progress progress = {.calls = 0, .cancel_at = cancel_at};
+    atomic_init(&progress.cancel, false);
+    NonoGramSolver *solver = nonogram_solver_create(hints);
+    assert(solver);
+    nonogram_solver_set_cancel(solver, &progress.cancel);
+    nonogram_solver_set_progress(solver, on_progress, &progress, 1);
+    assert(nonogram_solver_solve(solver, engines[index])
+           == NONOGRAM_SOLVER_STOPPED);
+    assert(progress.calls == cancel_at);
+    atomic_store(&progress.cancel, false);
+    assert(nonogram_solver_solve(solver, engines[index])
+           == NONOGRAM_SOLVER_SOLVED);
+    assert(progress.calls > cancel_at);
+    for (int row = 0; row < rows_count; row++) {
+      int filled = 0;
+      for (int col = 0; col < cols_count; col++) {
+        int cell = nonogram_solver_get_cell(solver, row, col);
+        assert(cell == 0 || cell == 1);
+        filled += cell;
+      }
+      assert(filled == 1);
+    }
+    nonogram_solver_destroy(solver);
+  }
+
+  // A raised flag stops the solve before any line solve
+  atomic_bool cancel;
+  atomic_init(&cancel, true);
+  NonoGramSolver *solver = nonogram_solver_create(hints);
+  nonogram_solver_set_cancel(solver, &cancel);
+  assert(nonogram_solver_solve(solver, NONOGRAM_ENGINE_DFS)
+         == NONOGRAM_SOLVER_STOPPED);
+  assert(nonogram_solver_get_stats(solver)->propagations == 0);
+  nonogram_solver_set_cancel(solver, NULL);
+  assert(nonogram_solver_solve(solver, NONOGRAM_ENGINE_DFS)
+         == NONOGRAM_SOLVER_SOLVED);
+  nonogram_solver_destroy(solver);
+
+  nonogram_hints_destroy(hints);
+  for (int row = 0; row < rows_count; row++) {
+    free(board[row]);
+  }
+  free(board);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,134 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <assert.h>
+
+#include "./nonogram.h"
+#include "./solver.h"
+
+/**
+ * Size of the puzzle of the test, whose solution is not unique.
+ */
+#define SIZE 7
+
+/**
+ * Checkpoint file of the test.
+ */
+#define CHECKPOINT "test-checkpoint.save"
+
+/**
+ * Check that two solvers have the same board and counters.
+ */
+static void check_equal(NonoGramSolver *first, NonoGramSolver *second) {
+  for (int row = 0; row < SIZE; row++) {
+    for (int col = 0; col < SIZE; col++) {
+      assert(nonogram_solver_get_cell(first, row, col)
+             == nonogram_solver_get_cell(second, row, col));
+    }
+  }
+  const NonoGramSolverStats *stats = nonogram_solver_get_stats(first);
+  const NonoGramSolverStats *other = nonogram_solver_get_stats(second);
+  assert(stats->nodes == other->nodes);
+  assert(stats->backtracks == other->backtracks);
+  assert(stats->propagations == other->propagations);
+  assert(stats->probes == other->probes);
+}
+
+int main(void) {
+  int **board = malloc(SIZE * sizeof(int *));
+  for (int row = 0; row < SIZE; row++) {
+    board[row] = calloc(SIZE, sizeof(int));
+    board[row][row] = 1;
+    board[row][SIZE - 1 - row] = 1;
+  }
+  NonoGramHints *hints = nonogram_hints_create(board, SIZE, SIZE);
+
+  // A solve saved and resumed by a new solver after every step ends as the
+  // same solve run at once
+  NonoGramEngine engines[] = {
+    NONOGRAM_ENGINE_AUTO, NONOGRAM_ENGINE_DFS, NONOGRAM_ENGINE_PROBE
+  };
+  for (int index = 0; index < 3; index++) {
+    NonoGramSolver *reference = nonogram_solver_create(hints);
+    nonogram_solver_set_engine(reference, engines[index]);
+    int steps = 0;
+    while (nonogram_solver_step(reference, 1) == NONOGRAM_SOLVER_IN_PROGRESS) {
+      steps++;
+    }
+    assert(steps > 10);
+    assert(nonogram_solver_get_stats(reference)->nodes > 0);
+
+    NonoGramSolver *solver = nonogram_solver_create(hints);
+    nonogram_solver_set_engine(solver, engines[index]);
+    NonoGramStatus status;
+    while ((status = nonogram_solver_step(solver, 1))
+           == NONOGRAM_SOLVER_IN_PROGRESS) {
+      assert(nonogram_solver_save(solver, CHECKPOINT));
+      nonogram_solver_destroy(solver);
+      solver = nonogram_solver_create(hints);
+      assert(nonogram_solver_load(solver, CHECKPOINT));
+    }
+    assert(status == NONOGRAM_SOLVER_SOLVED);
+    check_equal(reference, solver);
+    nonogram_solver_destroy(solver);
+    nonogram_solver_destroy(reference);
+  }
+
+  // A solve stopped by the node limit resumes from its checkpoint
+  NonoGramSolver *solver = nonogram_solver_create(hints);
+  nonogram_solver_set_node_limit(solver, 2);
+  assert(nonogram_solver_solve(solver, NONOGRAM_ENGINE_DFS)
+         == NONOGRAM_SOLVER_STOPPED);
+  assert(nonogram_solver_save(solver, CHECKPOINT));
+  NonoGramSolver *resumed = nonogram_solver_create(hints);
+  assert(nonogram_solver_load(resumed, CHECKPOINT));
+  nonogram_solver_set_node_limit(solver, 0);
+  assert(nonogram_solver_solve(solver, NONOGRAM_ENGINE_DFS)
+         == NONOGRAM_SOLVER_SOLVED);
+  assert(nonogram_solver_solve(resumed, NONOGRAM_ENGINE_DFS)
+         == NONOGRAM_SOLVER_SOLVED);
+  check_equal(solver, resumed);
+  nonogram_solver_destroy(resumed);
+
+  // Checkpoints of other hints or of other relaxed lines are refused
+  board[0][0] = 0;
+  NonoGramHints *other = nonogram_hints_create(board, SIZE, SIZE);
+  resumed = nonogram_solver_create(other);
+  assert(!nonogram_solver_load(resumed, CHECKPOINT));
+  nonogram_solver_destroy(resumed);
+  nonogram_hints_destroy(other);
+  resumed = nonogram_solver_create(hints);
+  nonogram_solver_relax_line(resumed, 0);
+  assert(!nonogram_solver_load(resumed, CHECKPOINT));
+  nonogram_solver_destroy(resumed);
+
+  // Truncated and missing checkpoints are refused, the solver is unchanged
+  FILE *file = fopen(CHECKPOINT, "r+b");
+  assert(file);
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fclose(file);
+  assert(truncate(CHECKPOINT, size - 1) == 0);
+  resumed = nonogram_solver_create(hints);
+  assert(!nonogram_solver_load(resumed, CHECKPOINT));
+  unlink(CHECKPOINT);
+  assert(!nonogram_solver_load(resumed, CHECKPOINT));
+  assert(nonogram_solver_get_stats(resumed)->nodes == 0);
+  assert(nonogram_solver_get_cell(resumed, 0, 0) == -1);
+  nonogram_solver_destroy(resumed);
+
+  nonogram_solver_destroy(solver);
+  nonogram_hints_destroy(hints);
+  for (int row = 0; row < SIZE; row++) {
+    free(board[row]);
+  }
+  free(board);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,210 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <assert.h>
+
+#include "./archive.h"
+#include "./corpus.h"
+#include "./nonogram.h"
+#include "./nonogram.inc"
+
+/**
+ * Number of puzzles of the corpus, enough for several chunks.
+ */
+#define PUZZLES 20000
+
+/**
+ * Number of files of the directory corpus.
+ */
+#define FILES 300
+
+/**
+ * Last puzzle of the file, without a newline.
+ */
+#define LAST "{\"rows\":[[1]],\"cols\":[[1]]}"
+
+/**
+ * Puzzles seen by the callback.
+ */
+typedef struct {
+  pthread_mutex_t lock;  // Lock of the counters
+  int *seen;             // Number of times each id has been seen
+  int invalid;           // Number of invalid puzzles
+  long stop_at;          // Id stopping the reading, -1 for none
+} Seen;
+
+/**
+ * Check a puzzle: puzzle id has a single row clue id % 7 + 1.
+ */
+static bool check(long id, NonoGramHints *hints, void *data) {
+  Seen *seen = data;
+  assert(id >= 0 && id < PUZZLES);
+  pthread_mutex_lock(&seen->lock);
+  seen->seen[id]++;
+  if (!hints) {
+    seen->invalid++;
+  }
+  pthread_mutex_unlock(&seen->lock);
+  if (hints) {
+    assert(nonogram_hints_get_rows_count(hints) == 1);
+    assert(nonogram_hints_get_row_value(hints, 0, 0) == id % 7 + 1);
+    nonogram_hints_destroy(hints);
+  }
+  return id != seen->stop_at;
+}
+
+/**
+ * Parse a scanned record and check it.
+ */
+static bool scan(long id, const char *data, size_t length, void *user_data) {
+  NonoGramCorpus *corpus = user_data;
+  NonoGramHints *hints = nonogram_corpus_parse(corpus, id, data, length);
+  if (id == 1234 && data) {
+    assert(!hints);
+  } else {
+    assert(hints);
+    assert(nonogram_hints_get_row_value(hints, 0, 0) == id % 7 + 1);
+    nonogram_hints_destroy(hints);
+  }
+  return true;
+}
+
+/**
+ * Read a corpus and check that every id has been seen once.
+ */
+static void read_corpus(const char *filename, int threads, int invalid) {
+  Seen seen = {.seen = calloc(PUZZLES, sizeof(int)), .stop_at = -1};
+  pthread_mutex_init(&seen.lock, NULL);
+  NonoGramCorpus *corpus = nonogram_corpus_open(filename);
+  assert(corpus);
+  assert(nonogram_corpus_read(corpus, threads, check, &seen) == PUZZLES);
+  assert(nonogram_corpus_scan(corpus, scan, corpus) == PUZZLES);
+  nonogram_corpus_close(corpus);
+  for (long id = 0; id < PUZZLES; id++) {
+    assert(seen.seen[id] == 1);
+  }
+  assert(seen.invalid == invalid);
+  pthread_mutex_destroy(&seen.lock);
+  free(seen.seen);
+}
+
+int main(void) {
+  char filename[] = "test-corpus-XXXXXX";
+  int fd = mkstemp(filename);
+  assert(fd >= 0);
+  FILE *file = fdopen(fd, "w");
+  for (long id = 0; id < PUZZLES; id++) {
+    // Puzzle id is a single row of 7 cells with a block of id % 7 + 1
+    int block = id % 7 + 1;
+    if (id == 1234) {
+      fprintf(file, "{\"rows\":[[%d]],\"cols\":[oops]}\n", block);
+    } else {
+      fprintf(file, "{\"rows\":[[%d]],\"cols\":[", block);
+      for (int col = 0; col < 7; col++) {
+        fprintf(file, col < block ? "%s[1]" : "%s[]", col ? "," : "");
+      }
+      fprintf(file, "]}\n");
+    }
+    if (id % 1000 == 0) {
+      fprintf(file, "\n  \r\n");
+    }
+  }
+  fprintf(file, "%s", LAST);
+  fclose(file);
+
+  // The last line has no newline
+  Seen seen = {.seen = calloc(PUZZLES + 1, sizeof(int)), .stop_at = -1};
+  pthread_mutex_init(&seen.lock, NULL);
+  NonoGramCorpus *corpus = nonogram_corpus_open(filename);
+  assert(corpus);
+  seen.stop_at = 100;
+  assert(nonogram_corpus_read(corpus, 2, check, &seen) == PUZZLES + 1);
+  assert(seen.seen[100] == 1);
+  nonogram_corpus_close(corpus);
+  pthread_mutex_destroy(&seen.lock);
+  free(seen.seen);
+
+  // Drop the last line, then read with several thread counts
+  struct stat status;
+  assert(stat(filename, &status) == 0);
+  assert(truncate(filename, status.st_size - strlen(LAST)) == 0);
+  read_corpus(filename, 1, 1);
+  read_corpus(filename, 3, 1);
+  read_corpus(filename, 8, 1);
+
+  // The same puzzles from an archive
+  char archive_filename[] = "test-corpus-archive-XXXXXX";
+  fd = mkstemp(archive_filename);
+  assert(fd >= 0);
+  close(fd);
+  NonoGramArchiveWriter *writer =
+    nonogram_archive_writer_open(archive_filename, false);
+  for (long id = 0; id < PUZZLES; id++) {
+    int row[7] = {0};
+    for (int col = 0; col < id % 7 + 1; col++) {
+      row[col] = 1;
+    }
+    int *board[1] = {row};
+    NonoGramHints *hints = nonogram_hints_create(board, 1, 7);
+    assert(nonogram_archive_writer_add(writer, hints, NULL, NULL) == id);
+    nonogram_hints_destroy(hints);
+  }
+  assert(nonogram_archive_writer_close(writer));
+  read_corpus(archive_filename, 3, 0);
+
+  // The same puzzles from files of a directory, hints objects, plain PBM
+  // and raw PBM images
+  char directory[] = "test-corpus-directory-XXXXXX";
+  assert(mkdtemp(directory));
+  char path[64];
+  for (long id = 0; id < FILES; id++) {
+    snprintf(path, sizeof path, "%s/%05ld", directory, id);
+    file = fopen(path, "w");
+    int block = id % 7 + 1;
+    if (id % 3 == 0) {
+      fprintf(file, "{\"rows\":[[%d]],\"cols\":[", block);
+      for (int col = 0; col < 7; col++) {
+        fprintf(file, col < block ? "%s[1]" : "%s[]", col ? "," : "");
+      }
+      fprintf(file, "]}\n");
+    } else if (id % 3 == 1) {
+      fprintf(file, "P1\n# puzzle %ld\n7 1\n", id);
+      for (int col = 0; col < 7; col++) {
+        fprintf(file, "%d ", col < block);
+      }
+    } else {
+      fprintf(file, "P4\n7 1\n%c", (0xff00 >> block) & 0xfe);
+    }
+    fclose(file);
+  }
+  seen = (Seen) {.seen = calloc(PUZZLES, sizeof(int)), .stop_at = -1};
+  pthread_mutex_init(&seen.lock, NULL);
+  corpus = nonogram_corpus_open(directory);
+  assert(corpus);
+  assert(nonogram_corpus_read(corpus, 3, check, &seen) == FILES);
+  for (long id = 0; id < FILES; id++) {
+    assert(seen.seen[id] == 1);
+  }
+  assert(seen.invalid == 0);
+  nonogram_corpus_close(corpus);
+  pthread_mutex_destroy(&seen.lock);
+  free(seen.seen);
+  for (long id = 0; id < FILES; id++) {
+    snprintf(path, sizeof path, "%s/%05ld", directory, id);
+    unlink(path);
+  }
+  rmdir(directory);
+
+  unlink(filename);
+  unlink(archive_filename);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,152 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <assert.h>
+
+#include "./nonogram.h"
+#include "./solver.h"
+
+/**
+ * Size of the permutation puzzle, each row and column has one filled cell.
+ */
+#define SIZE 5
+
+/**
+ * Number of solutions of the permutation puzzle.
+ */
+#define SOLUTIONS 120
+
+/**
+ * Solutions received from an enumeration.
+ */
+typedef struct {
+  int columns[SOLUTIONS][SIZE];  // Column filled in each row of a solution
+  long count;                    // Number of solutions
+  long stop_at;                  // Solution stopping the enumeration, or -1
+} Solutions;
+
+/**
+ * Check that a solution is a permutation and has not been given before.
+ */
+static bool receive(const unsigned char *bits, void *data) {
+  Solutions *solutions = data;
+  assert(solutions->count < SOLUTIONS);
+  int *columns = solutions->columns[solutions->count];
+  bool used[SIZE] = {false};
+  for (int row = 0; row < SIZE; row++) {
+    // A row of the puzzle fits in one byte, unused bits are clear
+    assert(bits[row] && !(bits[row] & (0xff >> SIZE)));
+    columns[row] = __builtin_clz(bits[row]) - 24;
+    assert(bits[row] == 0x80 >> columns[row]);
+    assert(!used[columns[row]]);
+    used[columns[row]] = true;
+  }
+  for (long index = 0; index < solutions->count; index++) {
+    assert(memcmp(solutions->columns[index], columns, sizeof(int) * SIZE));
+  }
+  return solutions->count++ != solutions->stop_at;
+}
+
+/**
+ * Count a solution.
+ */
+static bool tally(const unsigned char *bits, void *data) {
+  (void) bits;
+  ++*(long *) data;
+  return true;
+}
+
+/**
+ * Count the solutions of a puzzle given by a board.
+ */
+static long count(int **board, int rows_count, int cols_count) {
+  NonoGramHints *hints = nonogram_hints_create(board, rows_count, cols_count);
+  NonoGramSolver *solver = nonogram_solver_create(hints);
+  long solutions = 0;
+  bool complete = false;
+  long result = nonogram_solver_enumerate(solver, 0, tally, &solutions,
+                                          &complete);
+  assert(complete);
+  assert(result == solutions);
+  nonogram_solver_destroy(solver);
+  nonogram_hints_destroy(hints);
+  return result;
+}
+
+int main(void) {
+  int **board = malloc(SIZE * sizeof(int *));
+  for (int row = 0; row < SIZE; row++) {
+    board[row] = calloc(SIZE, sizeof(int));
+    board[row][row] = 1;
+  }
+  NonoGramHints *hints = nonogram_hints_create(board, SIZE, SIZE);
+
+  // Every permutation is given once
+  NonoGramSolver *solver = nonogram_solver_create(hints);
+  Solutions solutions = {.stop_at = -1};
+  bool complete = false;
+  assert(nonogram_solver_enumerate(solver, 0, receive, &solutions, &complete)
+         == SOLUTIONS);
+  assert(complete);
+  nonogram_solver_destroy(solver);
+
+  // A limited enumeration resumes after its last solution
+  solver = nonogram_solver_create(hints);
+  solutions.count = 0;
+  assert(nonogram_solver_enumerate(solver, 7, receive, &solutions, &complete)
+         == 7);
+  assert(!complete);
+  assert(nonogram_solver_enumerate(solver, 0, receive, &solutions, &complete)
+         == SOLUTIONS - 7);
+  assert(complete && solutions.count == SOLUTIONS);
+  assert(nonogram_solver_enumerate(solver, 0, receive, &solutions, &complete)
+         == 0);
+  assert(complete);
+  nonogram_solver_destroy(solver);
+
+  // The callback stops the enumeration, the node limit too
+  solver = nonogram_solver_create(hints);
+  solutions.count = 0;
+  solutions.stop_at = 2;
+  assert(nonogram_solver_enumerate(solver, 0, receive, &solutions, NULL)
+         == 3);
+  nonogram_solver_destroy(solver);
+  solver = nonogram_solver_create(hints);
+  nonogram_solver_set_node_limit(solver, 20);
+  solutions.count = 0;
+  solutions.stop_at = -1;
+  long found = nonogram_solver_enumerate(solver, 0, receive, &solutions,
+                                         &complete);
+  assert(found > 0 && found < SOLUTIONS && !complete);
+  nonogram_solver_destroy(solver);
+
+  // A full board has one solution, clues that do not agree none
+  for (int row = 0; row < SIZE; row++) {
+    for (int col = 0; col < SIZE; col++) {
+      board[row][col] = 1;
+    }
+  }
+  assert(count(board, SIZE, SIZE) == 1);
+  const char *string = "{\"rows\":[[2],[1]],\"cols\":[[2],[2]]}";
+  NonoGramHints *other = nonogram_hints_parse(string, strlen(string));
+  assert(other);
+  solver = nonogram_solver_create(other);
+  assert(nonogram_solver_enumerate(solver, 0, receive, &solutions, &complete)
+         == 0);
+  assert(complete);
+  nonogram_solver_destroy(solver);
+  nonogram_hints_destroy(other);
+
+  nonogram_hints_destroy(hints);
+  for (int row = 0; row < SIZE; row++) {
+    free(board[row]);
+  }
+  free(board);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,144 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+#include <stdbool.h>
+#include <stdlib.h>
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <assert.h>
+
+#include "./generator.h"
+#include "./nonogram.h"
+#include "./solver.h"
+
+/**
+ * Size of the puzzles of the test.
+ */
+#define SIZE 8
+
+/**
+ * Number of puzzles generated by each generator.
+ */
+#define PUZZLES 50
+
+/**
+ * Solution received from an enumeration.
+ */
+typedef struct {
+  unsigned char bits[SIZE];  // Rows of the solution
+  long count;                // Number of solutions
+} Solution;
+
+/**
+ * Keep a solution.
+ */
+static bool receive(const unsigned char *bits, void *data) {
+  Solution *solution = data;
+  for (int row = 0; row < SIZE; row++) {
+    solution->bits[row] = bits[row];
+  }
+  solution->count++;
+  return true;
+}
+
+/**
+ * Check that a puzzle has the solution of the generator only.
+ */
+static void check(NonoGramHints *hints, NonoGramGenerator *generator) {
+  NonoGramSolver *solver = nonogram_solver_create(hints);
+  Solution solution = {.count = 0};
+  bool complete = false;
+  assert(nonogram_solver_enumerate(solver, 2, receive, &solution, &complete)
+         == 1);
+  assert(complete);
+  for (int cell = 0; cell < SIZE * SIZE; cell++) {
+    int row = cell / SIZE;
+    int col = cell % SIZE;
+    assert(nonogram_generator_get_cell(generator, row, col)
+           == ((solution.bits[row] >> (7 - col)) & 1));
+  }
+  nonogram_solver_destroy(solver);
+}
+
+/**
+ * Generate unique puzzles, by mutations or not.
+ */
+static void run(long mutations) {
+  NonoGramGenerator *generator = nonogram_generator_create(SIZE, SIZE, 7);
+  NonoGramGenerator *same = nonogram_generator_create(SIZE, SIZE, 7);
+  assert(generator && same);
+  nonogram_generator_set_density(generator, 0.4);
+  nonogram_generator_set_density(same, 0.4);
+  if (mutations >= 0) {
+    nonogram_generator_set_mutations(generator, mutations);
+    nonogram_generator_set_mutations(same, mutations);
+  }
+  for (int puzzle = 0; puzzle < PUZZLES; puzzle++) {
+    NonoGramHints *hints = nonogram_generator_next(generator, 0);
+    assert(hints);
+    check(hints, generator);
+
+    // Generators with the same seed give the same puzzles
+    NonoGramHints *other = nonogram_generator_next(same, 0);
+    assert(other && nonogram_hints_equal(hints, other));
+    nonogram_hints_destroy(other);
+    nonogram_hints_destroy(hints);
+  }
+  const NonoGramGeneratorStats *stats = nonogram_generator_get_stats(generator);
+  assert(stats->puzzles == PUZZLES);
+  assert(stats->candidates >= PUZZLES);
+  assert(stats->checks == stats->candidates + stats->mutations);
+  if (!mutations) {
+    assert(!stats->mutations);
+  } else {
+    // Ambiguous boards are mutated rather than drawn again
+    assert(stats->mutations > 0 && stats->candidates < 2 * PUZZLES);
+  }
+  nonogram_generator_destroy(same);
+  nonogram_generator_destroy(generator);
+}
+
+/**
+ * Generate puzzles of a single rating and check their rating.
+ */
+static void run_rating(int rating) {
+  NonoGramGenerator *generator = nonogram_generator_create(SIZE, SIZE, 3);
+  assert(generator);
+  nonogram_generator_set_rating(generator, rating, rating);
+  for (int puzzle = 0; puzzle < PUZZLES; puzzle++) {
+    NonoGramHints *hints = nonogram_generator_next(generator, 0);
+    assert(hints);
+    check(hints, generator);
+    assert(nonogram_generator_get_rating(generator) == rating);
+    NonoGramSolver *solver = nonogram_solver_create(hints);
+    assert(nonogram_solver_rate(solver) == rating);
+    nonogram_solver_destroy(solver);
+    nonogram_hints_destroy(hints);
+  }
+  const NonoGramGeneratorStats *stats = nonogram_generator_get_stats(generator);
+  assert(stats->puzzles == PUZZLES);
+  if (rating > 1) {
+    // Boards solved by propagation are rejected before any search
+    assert(stats->easy > 0);
+  }
+  nonogram_generator_destroy(generator);
+}
+
+int main(void) {
+  run(-1);
+  run(0);
+  run_rating(1);
+  run_rating(2);
+
+  // A board drawn full is unique without mutations
+  NonoGramGenerator *generator = nonogram_generator_create(SIZE, SIZE, 1);
+  nonogram_generator_set_density(generator, 1.0);
+  NonoGramHints *hints = nonogram_generator_next(generator, 1);
+  assert(hints);
+  check(hints, generator);
+  nonogram_hints_destroy(hints);
+  assert(nonogram_generator_get_stats(generator)->mutations == 0);
+  nonogram_generator_destroy(generator);
+  return EXIT_SUCCESS;
+}
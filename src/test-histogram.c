@@ -0,0 +1,113 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <assert.h>
+
+#include "./histogram.h"
+
+/**
+ * Record the durations from 1 to 1000 microseconds.
+ */
+static void *record(void *data) {
+  NonoGramHistogram *histogram = data;
+  for (int value = 1; value <= 1000; value++) {
+    nonogram_histogram_record(histogram, value * 1e-6);
+  }
+  return NULL;
+}
+
+int main(void) {
+  NonoGramHistogram *histogram = nonogram_histogram_create();
+  assert(histogram);
+  assert(nonogram_histogram_get_count(histogram) == 0);
+  assert(nonogram_histogram_get_quantile(histogram, 0.5) == 0.0);
+
+  // Concurrent records are all counted
+  pthread_t threads[4];
+  for (int thread = 0; thread < 4; thread++) {
+    assert(!pthread_create(&threads[thread], NULL, record, histogram));
+  }
+  for (int thread = 0; thread < 4; thread++) {
+    pthread_join(threads[thread], NULL);
+  }
+  assert(nonogram_histogram_get_count(histogram) == 4000);
+  assert(fabs(nonogram_histogram_get_sum(histogram) - 4 * 0.5005) < 1e-6);
+
+  // Quantiles are bucket bounds within an eighth of the exact value
+  double quantiles[] = {0.01, 0.5, 0.9, 0.99, 1.0};
+  for (int index = 0; index < 5; index++) {
+    double exact = quantiles[index] * 1000e-6;
+    double value = nonogram_histogram_get_quantile(
+      histogram, quantiles[index]);
+    assert(value >= exact * (1 - 1e-9));
+    assert(value <= exact * (1 + 1.0 / 8) + 1e-9);
+  }
+
+  // Small durations have exact buckets, huge ones are clamped
+  NonoGramHistogram *other = nonogram_histogram_create();
+  nonogram_histogram_record(other, 3e-9);
+  assert(fabs(nonogram_histogram_get_quantile(other, 1.0) - 4e-9) < 1e-12);
+  nonogram_histogram_record(other, -1.0);
+  nonogram_histogram_record(other, 1e6);
+  assert(nonogram_histogram_get_count(other) == 3);
+  assert(nonogram_histogram_get_quantile(other, 0.0) == 1e-9);
+
+  // Adding a histogram adds its buckets, count and sum
+  NonoGramHistogram *total = nonogram_histogram_create();
+  nonogram_histogram_add(total, other);
+  nonogram_histogram_add(total, histogram);
+  assert(nonogram_histogram_get_count(total) == 4003);
+  assert(fabs(nonogram_histogram_get_sum(total)
+              - nonogram_histogram_get_sum(other)
+              - nonogram_histogram_get_sum(histogram)) < 1e-6);
+  assert(nonogram_histogram_get_quantile(total, 0.0) == 1e-9);
+  assert(nonogram_histogram_get_quantile(total, 1.0)
+         == nonogram_histogram_get_quantile(other, 1.0));
+  nonogram_histogram_destroy(total);
+  nonogram_histogram_destroy(other);
+
+  // The Prometheus text has cumulative buckets ending with the count
+  size_t length = nonogram_histogram_format(
+    histogram, "test_seconds", "Test durations", NULL, 0);
+  char *text = malloc(length + 1);
+  assert(nonogram_histogram_format(
+    histogram, "test_seconds", "Test durations", text, length + 1)
+    == length);
+  assert(strlen(text) == length);
+  assert(strstr(text, "# HELP test_seconds Test durations\n"));
+  assert(strstr(text, "# TYPE test_seconds histogram\n"));
+  assert(strstr(text, "test_seconds_bucket{le=\"+Inf\"} 4000\n"));
+  assert(strstr(text, "test_seconds_count 4000\n"));
+  assert(strstr(text, "test_seconds_sum 2.002"));
+  unsigned long previous = 0;
+  int buckets = 0;
+  for (char *line = strstr(text, "_bucket{"); line;
+       line = strstr(line + 1, "_bucket{")) {
+    unsigned long count = strtoul(strchr(line, '}') + 1, NULL, 10);
+    assert(count >= previous);
+    previous = count;
+    buckets++;
+  }
+  assert(buckets > 2 && previous == 4000);
+  // Only the durations of a microsecond are below 1024 ns
+  assert(strstr(text, "test_seconds_bucket{le=\"1.024e-06\"} 4\n"));
+
+  // A short buffer receives a truncated text
+  char short_buffer[16];
+  assert(nonogram_histogram_format(
+    histogram, "test_seconds", "Test durations", short_buffer,
+    sizeof short_buffer) == length);
+  assert(strlen(short_buffer) == sizeof short_buffer - 1);
+  free(text);
+
+  nonogram_histogram_destroy(histogram);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,125 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <assert.h>
+
+#include "./loader.h"
+
+/**
+ * Number of files of the test, the last one is missing.
+ */
+#define FILES 200
+
+/**
+ * Size of the largest file, larger than the first read.
+ */
+#define LARGE 100000
+
+/**
+ * Files written and read back.
+ */
+typedef struct {
+  char *names[FILES];     // Names of the files
+  char *contents[FILES];  // Contents of the files
+  size_t lengths[FILES];  // Lengths of the contents
+  int seen[FILES];        // Number of times each file has been read
+  int missing;            // Number of files that cannot be read
+  long stop_at;           // Index stopping the reading, -1 for none
+  bool stopped;           // Whether the reading has been stopped
+} Files;
+
+/**
+ * Check the content of a file against the content written.
+ */
+static bool check(long index, char *content, size_t length, void *data) {
+  Files *files = data;
+  assert(!files->stopped);
+  assert(index >= 0 && index < FILES);
+  files->seen[index]++;
+  if (!content) {
+    files->missing++;
+  } else {
+    assert(length == files->lengths[index]);
+    assert(memcmp(content, files->contents[index], length) == 0);
+    assert(content[length] == '\0');
+    free(content);
+  }
+  files->stopped = index == files->stop_at;
+  return !files->stopped;
+}
+
+/**
+ * Write the files, then read them back with a loader.
+ */
+static void run(Files *files, bool async) {
+  NonoGramLoader *loader = nonogram_loader_create(16, async);
+  assert(loader);
+  if (!async) {
+    assert(!nonogram_loader_is_async(loader));
+  }
+  assert(nonogram_loader_write(
+    loader, (const char *const *) files->names,
+    (const char *const *) files->contents, files->lengths, FILES - 1)
+    == FILES - 1);
+  memset(files->seen, 0, sizeof files->seen);
+  files->missing = 0;
+  files->stop_at = -1;
+  files->stopped = false;
+  assert(nonogram_loader_read(
+    loader, (const char *const *) files->names, FILES, check, files)
+    == FILES - 1);
+  for (int index = 0; index < FILES; index++) {
+    assert(files->seen[index] == 1);
+  }
+  assert(files->missing == 1);
+
+  // A callback stops the reading, files in flight are not given but closed
+  int lowest = open("/dev/null", O_RDONLY);
+  close(lowest);
+  memset(files->seen, 0, sizeof files->seen);
+  files->stop_at = 10;
+  long read = nonogram_loader_read(
+    loader, (const char *const *) files->names, FILES, check, files);
+  assert(read > 0 && read < FILES - 1);
+  assert(files->seen[10] == 1);
+  int fd = open("/dev/null", O_RDONLY);
+  assert(lowest >= 0 && fd == lowest);
+  close(fd);
+  nonogram_loader_destroy(loader);
+}
+
+int main(void) {
+  char directory[] = "test-loader-XXXXXX";
+  assert(mkdtemp(directory));
+  Files files;
+  for (int index = 0; index < FILES; index++) {
+    files.names[index] = malloc(strlen(directory) + 16);
+    sprintf(files.names[index], "%s/%03d", directory, index);
+    // Files are small, but for an empty one and a large one
+    files.lengths[index] = index == 1 ? 0 : index == 2 ? LARGE : index * 7;
+    files.contents[index] = malloc(files.lengths[index] + 1);
+    for (size_t byte = 0; byte < files.lengths[index]; byte++) {
+      files.contents[index][byte] = 'a' + (index + byte) % 26;
+    }
+  }
+
+  run(&files, false);
+  run(&files, true);
+
+  for (int index = 0; index < FILES; index++) {
+    unlink(files.names[index]);
+    free(files.names[index]);
+    free(files.contents[index]);
+  }
+  rmdir(directory);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,97 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+#include <stdlib.h>
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <assert.h>
+
+#include "./localsearch.h"
+#include "./nonogram.h"
+#include "./solver.h"
+#include "./nonogram.inc"
+
+int main(void) {
+  int rows_count = 12;
+  int cols_count = 10;
+  int **board = malloc(rows_count * sizeof(int *));
+  unsigned long long random = 42;
+  for (int row = 0; row < rows_count; row++) {
+    board[row] = malloc(cols_count * sizeof(int));
+    for (int col = 0; col < cols_count; col++) {
+      random = random * 6364136223846793005ULL + 1442695040888963407ULL;
+      board[row][col] = (random >> 33) % 3 != 0;
+    }
+  }
+  NonoGramHints *hints = nonogram_hints_create(board, rows_count, cols_count);
+
+  // The search is reproducible and finds a board satisfying every clue
+  NonoGramLocalSearch *first = nonogram_local_search_create(hints, 7);
+  NonoGramLocalSearch *second = nonogram_local_search_create(hints, 7);
+  assert(first && second);
+  assert(nonogram_local_search_run(first, 0, 1000000));
+  assert(nonogram_local_search_run(second, 0, 1000000));
+  assert(nonogram_local_search_get_violations(first) == 0);
+  assert(nonogram_local_search_get_moves(first)
+         == nonogram_local_search_get_moves(second));
+  for (int row = 0; row < rows_count; row++) {
+    for (int col = 0; col < cols_count; col++) {
+      assert(nonogram_local_search_get_cell(first, row, col)
+             == nonogram_local_search_get_cell(second, row, col));
+    }
+  }
+  nonogram_local_search_destroy(first);
+  nonogram_local_search_destroy(second);
+
+  // A search run in steps anneals as in a single run
+  first = nonogram_local_search_create(hints, 11);
+  second = nonogram_local_search_create(hints, 11);
+  assert(nonogram_local_search_run(first, 0, 1000000));
+  while (!nonogram_local_search_run(second, 0, 1000)) {
+    assert(nonogram_local_search_get_moves(second) < 1000000);
+  }
+  assert(nonogram_local_search_get_moves(first)
+         == nonogram_local_search_get_moves(second));
+  for (int row = 0; row < rows_count; row++) {
+    for (int col = 0; col < cols_count; col++) {
+      assert(nonogram_local_search_get_cell(first, row, col)
+             == nonogram_local_search_get_cell(second, row, col));
+    }
+  }
+  nonogram_local_search_destroy(first);
+  nonogram_local_search_destroy(second);
+
+  // A bounded run reports its best board
+  first = nonogram_local_search_create(hints, 1);
+  nonogram_local_search_run(first, 0, 1);
+  assert(nonogram_local_search_get_moves(first) == 1);
+  assert(nonogram_local_search_get_violations(first) <= cols_count);
+  nonogram_local_search_destroy(first);
+
+  // The local engine of the solver
+  NonoGramSolver *solver = nonogram_solver_create(hints);
+  nonogram_solver_set_seed(solver, 3);
+  assert(nonogram_solver_solve(solver, NONOGRAM_ENGINE_LOCAL)
+         == NONOGRAM_SOLVER_SOLVED);
+  for (int row = 0; row < rows_count; row++) {
+    for (int col = 0; col < cols_count; col++) {
+      assert(nonogram_solver_get_cell(solver, row, col) != -1);
+    }
+  }
+  nonogram_solver_destroy(solver);
+
+  nonogram_hints_destroy(hints);
+
+  // A row clue longer than its row
+  hints = nonogram_hints_create(board, 1, 2);
+  hints->rows[0][0] = 3;
+  assert(!nonogram_local_search_create(hints, 0));
+  nonogram_hints_destroy(hints);
+
+  for (int row = 0; row < rows_count; row++) {
+    free(board[row]);
+  }
+  free(board);
+  return EXIT_SUCCESS;
+}
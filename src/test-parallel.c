@@ -0,0 +1,196 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <assert.h>
+
+#include "./nonogram.h"
+#include "./scheduler.h"
+#include "./solver.h"
+#include "./nonogram.inc"
+
+/**
+ * Check that the board of a solver satisfies the hints.
+ */
+static void check_solution(NonoGramSolver *solver, NonoGramHints *hints) {
+  int rows_count = nonogram_hints_get_rows_count(hints);
+  int cols_count = nonogram_hints_get_cols_count(hints);
+  int **board = malloc(rows_count * sizeof(int *));
+  for (int row = 0; row < rows_count; row++) {
+    board[row] = malloc(cols_count * sizeof(int));
+    for (int col = 0; col < cols_count; col++) {
+      board[row][col] = nonogram_solver_get_cell(solver, row, col);
+      assert(board[row][col] == 0 || board[row][col] == 1);
+    }
+  }
+  NonoGramHints *solved = nonogram_hints_create(board, rows_count, cols_count);
+  assert(nonogram_hints_equal(hints, solved));
+  nonogram_hints_destroy(solved);
+  for (int row = 0; row < rows_count; row++) {
+    free(board[row]);
+  }
+  free(board);
+}
+
+int main(void) {
+  // A random puzzle, ambiguous enough to need a search
+  int size = 20;
+  int **board = malloc(size * sizeof(int *));
+  srand(7);
+  for (int row = 0; row < size; row++) {
+    board[row] = malloc(size * sizeof(int));
+    for (int col = 0; col < size; col++) {
+      board[row][col] = rand() % 2;
+    }
+  }
+  NonoGramHints *hints = nonogram_hints_create(board, size, size);
+
+  // Every member engine finds a valid board
+  NonoGramEngine engines[] = {
+    NONOGRAM_ENGINE_AUTO, NONOGRAM_ENGINE_DFS, NONOGRAM_ENGINE_PROBE,
+    NONOGRAM_ENGINE_LOCAL
+  };
+  for (int index = 0; index < 4; index++) {
+    for (int threads = 1; threads <= 4; threads++) {
+      NonoGramSolver *solver = nonogram_solver_create(hints);
+      nonogram_solver_set_seed(solver, index);
+      assert(nonogram_solver_solve_parallel(solver, engines[index], threads)
+             == NONOGRAM_SOLVER_SOLVED);
+      check_solution(solver, hints);
+      assert(nonogram_solver_get_stats(solver)->propagations > 0);
+      nonogram_solver_destroy(solver);
+    }
+  }
+
+  // From a presolved solver, then from a search stopped by the node limit
+  NonoGramSolver *solver = nonogram_solver_create(hints);
+  NonoGramFeatures features;
+  assert(nonogram_solver_features(solver, &features));
+  assert(nonogram_scheduler_estimate(&features)
+         == size * size * (1.0 - features.settled));
+  nonogram_solver_set_node_limit(solver, 1);
+  assert(nonogram_solver_solve(solver, NONOGRAM_ENGINE_DFS)
+         != NONOGRAM_SOLVER_FAILED);
+  nonogram_solver_set_node_limit(solver, 0);
+  assert(nonogram_solver_solve_parallel(solver, NONOGRAM_ENGINE_DFS, 3)
+         == NONOGRAM_SOLVER_SOLVED);
+  check_solution(solver, hints);
+  nonogram_solver_destroy(solver);
+
+  // Deterministic solves do not depend on the number of threads
+  NonoGramSolverStats reference;
+  int *cells = malloc(size * size * sizeof(int));
+  for (int threads = 1; threads <= 4; threads++) {
+    for (int repeat = 0; repeat < 3; repeat++) {
+      solver = nonogram_solver_create(hints);
+      nonogram_solver_set_seed(solver, 42);
+      nonogram_solver_set_deterministic(solver, 3);
+      assert(nonogram_solver_solve_parallel(solver, NONOGRAM_ENGINE_DFS,
+                                            threads)
+             == NONOGRAM_SOLVER_SOLVED);
+      check_solution(solver, hints);
+      const NonoGramSolverStats *stats = nonogram_solver_get_stats(solver);
+      if (threads == 1 && !repeat) {
+        reference = *stats;
+        for (int cell = 0; cell < size * size; cell++) {
+          cells[cell] = nonogram_solver_get_cell(solver, cell / size,
+                                                 cell % size);
+        }
+      }
+      assert(stats->nodes == reference.nodes);
+      assert(stats->backtracks == reference.backtracks);
+      assert(stats->propagations == reference.propagations);
+      assert(stats->probes == reference.probes);
+      for (int cell = 0; cell < size * size; cell++) {
+        assert(cells[cell]
+               == nonogram_solver_get_cell(solver, cell / size, cell % size));
+      }
+      nonogram_solver_destroy(solver);
+    }
+  }
+  free(cells);
+
+  // A raised flag stops the solve at once
+  atomic_bool cancel;
+  atomic_init(&cancel, true);
+  solver = nonogram_solver_create(hints);
+  nonogram_solver_set_cancel(solver, &cancel);
+  assert(nonogram_solver_solve_parallel(solver, NONOGRAM_ENGINE_DFS, 3)
+         == NONOGRAM_SOLVER_STOPPED);
+  atomic_store(&cancel, false);
+  assert(nonogram_solver_solve_parallel(solver, NONOGRAM_ENGINE_DFS, 3)
+         == NONOGRAM_SOLVER_SOLVED);
+  check_solution(solver, hints);
+  nonogram_solver_destroy(solver);
+  nonogram_hints_destroy(hints);
+
+  // A contradiction found by any member fails the solve
+  for (int row = 0; row < 5; row++) {
+    for (int col = 0; col < 5; col++) {
+      board[row][col] = row == col;
+    }
+  }
+  hints = nonogram_hints_create(board, 5, 5);
+  // Among the many solutions of the diagonal, the same one is chosen
+  int chosen[5];
+  for (int threads = 1; threads <= 3; threads++) {
+    solver = nonogram_solver_create(hints);
+    nonogram_solver_set_deterministic(solver, 4);
+    assert(nonogram_solver_solve_parallel(solver, NONOGRAM_ENGINE_PROBE,
+                                          threads)
+           == NONOGRAM_SOLVER_SOLVED);
+    check_solution(solver, hints);
+    for (int row = 0; row < 5; row++) {
+      int col = 0;
+      while (!nonogram_solver_get_cell(solver, row, col)) {
+        col++;
+      }
+      assert(threads == 1 || chosen[row] == col);
+      chosen[row] = col;
+    }
+    nonogram_solver_destroy(solver);
+  }
+  hints->cols[0][0] = 2;
+  solver = nonogram_solver_create(hints);
+  assert(nonogram_solver_solve_parallel(solver, NONOGRAM_ENGINE_PROBE, 3)
+         == NONOGRAM_SOLVER_FAILED);
+  nonogram_solver_destroy(solver);
+  solver = nonogram_solver_create(hints);
+  nonogram_solver_set_deterministic(solver, 3);
+  assert(nonogram_solver_solve_parallel(solver, NONOGRAM_ENGINE_PROBE, 2)
+         == NONOGRAM_SOLVER_FAILED);
+  assert(nonogram_solver_solve(solver, NONOGRAM_ENGINE_DFS)
+         == NONOGRAM_SOLVER_FAILED);
+  nonogram_solver_destroy(solver);
+  nonogram_hints_destroy(hints);
+  for (int row = 0; row < size; row++) {
+    free(board[row]);
+  }
+  free(board);
+
+  // Small puzzles take a thread, large ones gather up to the budget
+  NonoGramScheduler *scheduler = nonogram_scheduler_create(4, 8, 100.0);
+  assert(nonogram_scheduler_acquire(scheduler, 10.0) == 1);
+  assert(nonogram_scheduler_acquire(scheduler, 500.0) == 3);
+  nonogram_scheduler_release(scheduler, 3, 500.0);
+  assert(nonogram_scheduler_acquire(scheduler, 10.0) == 1);
+  // Two threads are busy with small puzzles, the large one gets the rest
+  assert(nonogram_scheduler_acquire(scheduler, 500.0) == 2);
+  NonoGramSchedulerStats stats;
+  nonogram_scheduler_get_stats(scheduler, &stats);
+  assert(stats.small == 2 && stats.large == 2 && stats.granted == 5);
+  nonogram_scheduler_release(scheduler, 2, 500.0);
+  nonogram_scheduler_release(scheduler, 1, 10.0);
+  nonogram_scheduler_release(scheduler, 1, 10.0);
+  nonogram_scheduler_destroy(scheduler);
+  // A single thread solves everything alone
+  scheduler = nonogram_scheduler_create(1, 4, 100.0);
+  assert(nonogram_scheduler_acquire(scheduler, 500.0) == 1);
+  nonogram_scheduler_release(scheduler, 1, 500.0);
+  nonogram_scheduler_destroy(scheduler);
+  return EXIT_SUCCESS;
+}
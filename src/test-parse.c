@@ -0,0 +1,98 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <assert.h>
+
+#include "./nonogram.h"
+#include "./nonogram.inc"
+
+/**
+ * Parse a null-terminated string.
+ */
+static NonoGramHints *parse(const char *string) {
+  return nonogram_hints_parse(string, strlen(string));
+}
+
+int main(void) {
+  const char *expected = "{\"rows\":[[2],[1,1],[]],\"cols\":[[2],[1],[1]]}";
+  NonoGramHints *hints = parse(expected);
+  assert(hints);
+  assert(nonogram_hints_get_rows_count(hints) == 3);
+  assert(nonogram_hints_get_cols_count(hints) == 3);
+  assert(strcmp(nonogram_hints_to_string(hints), expected) == 0);
+
+  // White spaces, key order, other keys and zero clues
+  NonoGramHints *other = parse(
+    " {\n  \"name\": \"a, \\\"b\\\" ]\",\n  \"cols\": [ [2], [1], [1] ],\n"
+    "  \"size\": {\"rows\": [3]},\n  \"rows\": [[2], [1, 1], [0]]\n}\n");
+  assert(other);
+  assert(nonogram_hints_equal(hints, other));
+  assert(nonogram_hints_hash(hints) == nonogram_hints_hash(other));
+  nonogram_hints_destroy(other);
+
+  // A different clue changes the hash
+  other = parse("{\"rows\":[[2],[1,1],[]],\"cols\":[[2],[1],[2]]}");
+  assert(other);
+  assert(!nonogram_hints_equal(hints, other));
+  assert(nonogram_hints_hash(hints) != nonogram_hints_hash(other));
+  nonogram_hints_destroy(other);
+
+  // The length bounds the string
+  assert(!nonogram_hints_parse(expected, strlen(expected) - 1));
+
+  // Invalid strings and clues that do not fit
+  assert(!parse(""));
+  assert(!parse("{\"rows\":[[1]]}"));
+  assert(!parse("{\"rows\":[[1]],\"cols\":[[1]],}"));
+  assert(!parse("{\"rows\":[[1],[1]],\"cols\":[[3]]}"));
+  assert(!parse("{\"rows\":[[1,1]],\"cols\":[[1],[1]]}"));
+  assert(!parse("{\"rows\":[[-1]],\"cols\":[[1]]}"));
+  assert(!parse("{\"rows\":[],\"cols\":[]}"));
+
+  // A PBM image gives the hints of its board
+  const char *plain = "P1\n# comment\n3 3\n110\n1 0 1\n000\n";
+  other = nonogram_hints_parse_pbm(plain, strlen(plain));
+  assert(other);
+  assert(nonogram_hints_equal(hints, other));
+  nonogram_hints_destroy(other);
+  // Rows of a raw image are padded to a byte
+  const char raw[] = "P4\n3 3\n\xc0\xa0\x00";
+  other = nonogram_hints_parse_pbm(raw, sizeof raw - 1);
+  assert(other);
+  assert(nonogram_hints_equal(hints, other));
+  nonogram_hints_destroy(other);
+  assert(!nonogram_hints_parse_pbm(raw, sizeof raw - 2));
+  assert(!nonogram_hints_parse_pbm("P1 2 2 1 0 1", 12));
+  assert(!nonogram_hints_parse_pbm("P2 1 1 1", 8));
+  assert(!nonogram_hints_parse_pbm("P1 0 1", 6));
+
+  // Given cells are parsed, written back and part of the identity
+  const char *given =
+    "{\"rows\":[[2],[1,1],[]],\"cols\":[[2],[1],[1]],"
+    "\"given\":[\"1..\",\"..1\",\"...\"]}";
+  other = parse(given);
+  assert(other);
+  assert(nonogram_hints_get_given(other, 0, 0) == 1);
+  assert(nonogram_hints_get_given(other, 0, 1) == -1);
+  assert(nonogram_hints_get_given(other, 1, 2) == 1);
+  assert(nonogram_hints_get_given(hints, 0, 0) == -1);
+  assert(strcmp(nonogram_hints_to_string(other), given) == 0);
+  assert(!nonogram_hints_equal(hints, other));
+  assert(nonogram_hints_hash(hints) != nonogram_hints_hash(other));
+  assert(nonogram_hints_set_given(other, NULL));
+  assert(nonogram_hints_equal(hints, other));
+  assert(nonogram_hints_hash(hints) == nonogram_hints_hash(other));
+  nonogram_hints_destroy(other);
+  assert(!parse("{\"rows\":[[1]],\"cols\":[[1]],\"given\":[\"..\"]}"));
+  assert(!parse("{\"rows\":[[1]],\"cols\":[[1]],\"given\":[\"2\"]}"));
+  assert(!parse("{\"rows\":[[1]],\"cols\":[[1]],\"given\":[]}"));
+
+  nonogram_hints_destroy(hints);
+  nonogram_hints_to_string(NULL);
+  return EXIT_SUCCESS;
+}
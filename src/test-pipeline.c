@@ -0,0 +1,114 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <assert.h>
+
+#include "./pipeline.h"
+
+/**
+ * Number of items emitted by the source.
+ */
+#define ITEMS 5000
+
+/**
+ * Sum of the items reaching the last stage.
+ */
+static atomic_long sum;
+
+/**
+ * Emit the items 1 to ITEMS.
+ */
+static void source(NonoGramPipeline *pipeline, int stage, void *item,
+                   void *data) {
+  (void) item;
+  (void) data;
+  for (intptr_t value = 1; value <= ITEMS; value++) {
+    if (!nonogram_pipeline_emit(pipeline, stage, (void *) value)) {
+      return;
+    }
+  }
+}
+
+/**
+ * Double an item.
+ */
+static void twice(NonoGramPipeline *pipeline, int stage, void *item,
+                  void *data) {
+  (void) data;
+  nonogram_pipeline_emit(pipeline, stage, (void *) (2 * (intptr_t) item));
+}
+
+/**
+ * Add an item to the sum, slowly.
+ */
+static void slow_sink(NonoGramPipeline *pipeline, int stage, void *item,
+                      void *data) {
+  (void) pipeline;
+  (void) stage;
+  (void) data;
+  struct timespec delay = {0, 20000};
+  nanosleep(&delay, NULL);
+  atomic_fetch_add(&sum, (intptr_t) item);
+}
+
+int main(void) {
+  atomic_init(&sum, 0);
+  NonoGramPipeline *pipeline = nonogram_pipeline_create();
+  assert(nonogram_pipeline_add_stage(pipeline, "source", 1, 0, source,
+                                     NULL) == 0);
+  assert(nonogram_pipeline_add_stage(pipeline, "twice", 3, 8, twice,
+                                     NULL) == 1);
+  assert(nonogram_pipeline_add_stage(pipeline, "sink", 2, 8, slow_sink,
+                                     NULL) == 2);
+  assert(nonogram_pipeline_add_stage(pipeline, "none", 0, 8, slow_sink,
+                                     NULL) == -1);
+  assert(nonogram_pipeline_get_stages_count(pipeline) == 3);
+  assert(nonogram_pipeline_start(pipeline));
+  // The slow sink throttles the stages before it
+  NonoGramStageStats stats;
+  for (int check = 0; check < 10; check++) {
+    for (int stage = 1; stage < 3; stage++) {
+      nonogram_pipeline_get_stats(pipeline, stage, &stats);
+      assert(stats.capacity == 8);
+      assert(stats.depth <= stats.capacity);
+    }
+    nonogram_pipeline_get_stats(pipeline, 0, &stats);
+    nonogram_pipeline_get_stats(pipeline, 2, &stats);
+    struct timespec delay = {0, 1000000};
+    nanosleep(&delay, NULL);
+  }
+  while (!nonogram_pipeline_wait(pipeline, 0.01)) {
+    continue;
+  }
+  assert(atomic_load(&sum) == (long) ITEMS * (ITEMS + 1));
+  for (int stage = 0; stage < 3; stage++) {
+    nonogram_pipeline_get_stats(pipeline, stage, &stats);
+    assert(stats.processed == ITEMS);
+    assert(stats.emitted == (stage < 2 ? ITEMS : 0));
+    assert(stats.depth == 0);
+    assert(stats.busy >= stats.blocked);
+  }
+  nonogram_pipeline_get_stats(pipeline, 0, &stats);
+  assert(stats.blocked > 0);
+  nonogram_pipeline_destroy(pipeline);
+
+  // A stopped pipeline drains and ends
+  atomic_store(&sum, 0);
+  pipeline = nonogram_pipeline_create();
+  nonogram_pipeline_add_stage(pipeline, "source", 1, 0, source, NULL);
+  nonogram_pipeline_add_stage(pipeline, "sink", 1, 4, slow_sink, NULL);
+  assert(nonogram_pipeline_start(pipeline));
+  nonogram_pipeline_stop(pipeline);
+  assert(nonogram_pipeline_wait(pipeline, 0));
+  nonogram_pipeline_get_stats(pipeline, 0, &stats);
+  assert(stats.emitted < ITEMS);
+  nonogram_pipeline_destroy(pipeline);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,100 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <assert.h>
+
+#include "./queue.h"
+
+/**
+ * Number of producers and of consumers.
+ */
+#define THREADS 4
+
+/**
+ * Number of items pushed by each producer.
+ */
+#define ITEMS 20000
+
+/**
+ * Queue shared by the threads and sum of the popped items.
+ */
+static NonoGramQueue *queue;
+static atomic_long sum;
+static atomic_long popped;
+
+/**
+ * Push the items 1 to ITEMS, shifted by the producer index.
+ */
+static void *produce(void *data) {
+  intptr_t first = (intptr_t) data * ITEMS;
+  for (intptr_t item = 1; item <= ITEMS; item++) {
+    assert(nonogram_queue_push(queue, (void *) (first + item)));
+  }
+  return NULL;
+}
+
+/**
+ * Pop and sum items until the queue is closed.
+ */
+static void *consume(void *data) {
+  (void) data;
+  void *item;
+  while ((item = nonogram_queue_pop(queue))) {
+    atomic_fetch_add(&sum, (intptr_t) item);
+    atomic_fetch_add(&popped, 1);
+  }
+  return NULL;
+}
+
+int main(void) {
+  // Single thread: bounded, first in first out
+  queue = nonogram_queue_create(3);
+  assert(nonogram_queue_get_capacity(queue) == 4);
+  for (intptr_t item = 1; item <= 4; item++) {
+    assert(nonogram_queue_try_push(queue, (void *) item));
+  }
+  assert(!nonogram_queue_try_push(queue, (void *) 5));
+  assert(nonogram_queue_get_depth(queue) == 4);
+  assert(nonogram_queue_try_pop(queue) == (void *) 1);
+  assert(nonogram_queue_try_push(queue, (void *) 5));
+  for (intptr_t item = 2; item <= 5; item++) {
+    assert(nonogram_queue_pop(queue) == (void *) item);
+  }
+  assert(!nonogram_queue_try_pop(queue));
+  assert(nonogram_queue_try_push(queue, (void *) 6));
+  nonogram_queue_close(queue);
+  assert(!nonogram_queue_push(queue, (void *) 7));
+  assert(nonogram_queue_pop(queue) == (void *) 6);
+  assert(!nonogram_queue_pop(queue));
+  nonogram_queue_destroy(queue);
+
+  // Several producers and consumers through a small queue
+  queue = nonogram_queue_create(16);
+  atomic_init(&sum, 0);
+  atomic_init(&popped, 0);
+  pthread_t producers[THREADS];
+  pthread_t consumers[THREADS];
+  for (intptr_t thread = 0; thread < THREADS; thread++) {
+    assert(!pthread_create(&producers[thread], NULL, produce, (void *) thread));
+    assert(!pthread_create(&consumers[thread], NULL, consume, NULL));
+  }
+  for (int thread = 0; thread < THREADS; thread++) {
+    pthread_join(producers[thread], NULL);
+  }
+  nonogram_queue_close(queue);
+  for (int thread = 0; thread < THREADS; thread++) {
+    pthread_join(consumers[thread], NULL);
+  }
+  long count = (long) THREADS * ITEMS;
+  assert(atomic_load(&popped) == count);
+  assert(atomic_load(&sum) == count * (count + 1) / 2);
+  nonogram_queue_destroy(queue);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,118 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <assert.h>
+
+#include "./nonogram.h"
+#include "./repair.h"
+#include "./nonogram.inc"
+
+/**
+ * Size of the large puzzle of the test.
+ */
+#define LARGE 300
+
+/**
+ * Bound of the repair of the large puzzle in seconds, loose enough for
+ * valgrind.
+ */
+#define LARGE_SECONDS 30
+
+int main(void) {
+  int rows_count = 3;
+  int cols_count = 3;
+  int **board = malloc(rows_count * sizeof(int *));
+  int **repaired = malloc(rows_count * sizeof(int *));
+  for (int row = 0; row < rows_count; row++) {
+    board[row] = malloc(cols_count * sizeof(int));
+    repaired[row] = malloc(cols_count * sizeof(int));
+    for (int col = 0; col < cols_count; col++) {
+      board[row][col] = row != 1 || col != 1;
+    }
+  }
+  /**
+   * Board and hints:
+   *      3 1 3
+   *        1
+   *     +-----
+   *   3 |■ ■ ■
+   * 1 1 |■   ■
+   *   3 |■ ■ ■
+   */
+  NonoGramHints *hints = nonogram_hints_create(board, rows_count, cols_count);
+  bool suspects[6];
+
+  // Consistent hints are solved
+  assert(nonogram_repair(hints, 0, 1.0, repaired, suspects) == 0);
+  for (int line = 0; line < rows_count + cols_count; line++) {
+    assert(!suspects[line]);
+  }
+
+  // A wrong col clue is reported and the board satisfies the other clues
+  hints->cols[1][1] = 0;
+  assert(nonogram_repair(hints, 0, 1.0, repaired, suspects) == 1);
+  assert(suspects[rows_count + 1]);
+  for (int row = 0; row < rows_count; row++) {
+    for (int col = 0; col < cols_count; col++) {
+      assert(repaired[row][col] == board[row][col]);
+    }
+  }
+
+  // Two wrong clues
+  hints->rows[1][0] = 2;
+  hints->rows[1][1] = 0;
+  assert(nonogram_repair(hints, 0, 1.0, repaired, suspects) == 2);
+  int count = 0;
+  for (int line = 0; line < rows_count + cols_count; line++) {
+    count += suspects[line];
+  }
+  assert(count == 2);
+
+  nonogram_hints_destroy(hints);
+  for (int row = 0; row < rows_count; row++) {
+    free(board[row]);
+    free(repaired[row]);
+  }
+  free(board);
+  free(repaired);
+
+  // A large puzzle with wrong clues gets a board within a tiny time limit,
+  // even when the exact repair overruns its half
+  int size = LARGE;
+  board = malloc(size * sizeof(int *));
+  repaired = malloc(size * sizeof(int *));
+  srand(5);
+  for (int row = 0; row < size; row++) {
+    board[row] = malloc(size * sizeof(int));
+    repaired[row] = malloc(size * sizeof(int));
+    for (int col = 0; col < size; col++) {
+      board[row][col] = rand() % 5 < 3;
+    }
+  }
+  hints = nonogram_hints_create(board, size, size);
+  for (int row = 0; row < size; row += size / 3) {
+    hints->rows[row][0]++;
+  }
+  bool *large_suspects = malloc(2 * size * sizeof(bool));
+  struct timespec start;
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  assert(nonogram_repair(hints, 0, 0.01, repaired, large_suspects) > 0);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  assert(end.tv_sec - start.tv_sec < LARGE_SECONDS);
+  free(large_suspects);
+  nonogram_hints_destroy(hints);
+  for (int row = 0; row < size; row++) {
+    free(board[row]);
+    free(repaired[row]);
+  }
+  free(board);
+  free(repaired);
+  return EXIT_SUCCESS;
+}
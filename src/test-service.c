@@ -0,0 +1,268 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <assert.h>
+
+#include "./cache.h"
+#include "./histogram.h"
+#include "./nonogram.h"
+#include "./service.h"
+#include "./solver.h"
+#include "./table.h"
+
+/**
+ * Order in which requests are answered.
+ */
+typedef struct {
+  int indexes[8];  // Indexes of the requests answered
+  int count;       // Number of requests answered
+} Order;
+
+/**
+ * Answer received by a request.
+ */
+typedef struct {
+  NonoGramHints *hints;  // Hints of the request
+  atomic_int calls;      // Number of answers
+  bool valid;            // Whether the board satisfies the hints
+  bool rejected;         // Whether the request has been rejected
+  Order *order;          // Order of the answers, or NULL
+  int index;             // Index of the request
+} Answer;
+
+/**
+ * Check the board of a result against the hints of the request.
+ */
+static void on_result(const NonoGramServiceResult *result, void *data) {
+  Answer *answer = data;
+  answer->rejected = result->rejected;
+  if (answer->order) {
+    answer->order->indexes[answer->order->count++] = answer->index;
+  }
+  int rows_count = result->rows_count;
+  int cols_count = result->cols_count;
+  answer->valid = result->status == NONOGRAM_SOLVER_SOLVED
+    && rows_count == nonogram_hints_get_rows_count(answer->hints)
+    && cols_count == nonogram_hints_get_cols_count(answer->hints);
+  if (answer->valid) {
+    int **board = malloc(rows_count * sizeof(int *));
+    for (int row = 0; row < rows_count; row++) {
+      board[row] = malloc(cols_count * sizeof(int));
+      for (int col = 0; col < cols_count; col++) {
+        board[row][col] = result->cells[row * cols_count + col];
+      }
+    }
+    NonoGramHints *solved =
+      nonogram_hints_create(board, rows_count, cols_count);
+    answer->valid = nonogram_hints_equal(answer->hints, solved);
+    nonogram_hints_destroy(solved);
+    for (int row = 0; row < rows_count; row++) {
+      free(board[row]);
+    }
+    free(board);
+  }
+  atomic_fetch_add(&answer->calls, 1);
+}
+
+/**
+ * Create the hints of a random board.
+ */
+static NonoGramHints *random_hints(int size, unsigned int seed) {
+  int **board = malloc(size * sizeof(int *));
+  srand(seed);
+  for (int row = 0; row < size; row++) {
+    board[row] = malloc(size * sizeof(int));
+    for (int col = 0; col < size; col++) {
+      board[row][col] = rand() % 2;
+    }
+  }
+  NonoGramHints *hints = nonogram_hints_create(board, size, size);
+  for (int row = 0; row < size; row++) {
+    free(board[row]);
+  }
+  free(board);
+  return hints;
+}
+
+/**
+ * Copy hints through their JSON representation.
+ */
+static NonoGramHints *copy_hints(NonoGramHints *hints) {
+  const char *string = nonogram_hints_to_string(hints);
+  return nonogram_hints_parse(string, strlen(string));
+}
+
+int main(void) {
+  NonoGramHints *first = random_hints(12, 3);
+  NonoGramHints *second = random_hints(10, 5);
+  int count = 8;
+  Answer answers[9];
+  for (int index = 0; index <= count; index++) {
+    answers[index].hints = index < count ? first : second;
+    atomic_init(&answers[index].calls, 0);
+    answers[index].valid = false;
+    answers[index].order = NULL;
+  }
+
+  // Requests submitted before the threads start are all in flight together
+  NonoGramService *service = nonogram_service_create(2, 16);
+  assert(service);
+  for (int index = 0; index <= count; index++) {
+    NonoGramHints *copy = copy_hints(answers[index].hints);
+    assert(copy);
+    assert(nonogram_service_submit(
+      service, copy, NONOGRAM_PRIORITY_NORMAL, 0.0, on_result,
+      &answers[index]));
+  }
+  NonoGramServiceStats stats;
+  nonogram_service_get_stats(service, &stats);
+  assert(stats.requests == count + 1);
+  assert(stats.coalesced == count - 1);
+  assert(nonogram_service_start(service));
+  while (nonogram_histogram_get_count(
+           nonogram_service_get_solve_histogram(service)) < 2) {
+  }
+  assert(nonogram_histogram_get_count(
+           nonogram_service_get_wait_histogram(service)) == 2);
+  nonogram_service_destroy(service);
+
+  // Every request is answered once with a valid board, by two solves
+  for (int index = 0; index <= count; index++) {
+    assert(atomic_load(&answers[index].calls) == 1);
+    assert(answers[index].valid);
+  }
+
+  // Requests submitted after a solve ended are solved again
+  service = nonogram_service_create(1, 4);
+  assert(nonogram_service_start(service));
+  for (int round = 0; round < 2; round++) {
+    Answer answer = {.hints = first, .valid = false};
+    atomic_init(&answer.calls, 0);
+    NonoGramHints *copy = copy_hints(first);
+    assert(nonogram_service_submit(
+      service, copy, NONOGRAM_PRIORITY_NORMAL, 0.0, on_result, &answer));
+    while (!atomic_load(&answer.calls)) {
+    }
+    assert(answer.valid);
+  }
+  nonogram_service_get_stats(service, &stats);
+  assert(stats.solves == 2);
+  assert(stats.coalesced == 0);
+
+  // Once a solve time is known, a deadline too close is rejected at once
+  Answer late = {.hints = first, .valid = false};
+  atomic_init(&late.calls, 0);
+  assert(nonogram_service_submit(
+    service, copy_hints(first), NONOGRAM_PRIORITY_INTERACTIVE, 1e-9,
+    on_result, &late));
+  assert(atomic_load(&late.calls) == 1);
+  assert(late.rejected && !late.valid);
+  nonogram_service_destroy(service);
+
+  // Waiting solves are taken by class, then by deadline
+  service = nonogram_service_create(1, 4);
+  Order order = {.count = 0};
+  Answer ordered[4];
+  NonoGramPriority priorities[] = {
+    NONOGRAM_PRIORITY_BULK, NONOGRAM_PRIORITY_NORMAL,
+    NONOGRAM_PRIORITY_INTERACTIVE, NONOGRAM_PRIORITY_NORMAL
+  };
+  double deadlines[] = {0.0, 60.0, 0.0, 30.0};
+  for (int index = 0; index < 4; index++) {
+    ordered[index].hints = random_hints(8, 11 + index);
+    ordered[index].valid = false;
+    ordered[index].order = &order;
+    ordered[index].index = index;
+    atomic_init(&ordered[index].calls, 0);
+    assert(nonogram_service_submit(
+      service, copy_hints(ordered[index].hints), priorities[index],
+      deadlines[index], on_result, &ordered[index]));
+  }
+  // The queue is full
+  Answer full = {.hints = first, .valid = false};
+  atomic_init(&full.calls, 0);
+  assert(nonogram_service_submit(
+    service, copy_hints(first), NONOGRAM_PRIORITY_INTERACTIVE, 0.0,
+    on_result, &full));
+  assert(atomic_load(&full.calls) == 1 && full.rejected);
+  assert(nonogram_service_start(service));
+  nonogram_service_destroy(service);
+  int expected[] = {2, 3, 1, 0};
+  assert(order.count == 4);
+  for (int index = 0; index < 4; index++) {
+    assert(order.indexes[index] == expected[index]);
+    assert(ordered[index].valid);
+    nonogram_hints_destroy(ordered[index].hints);
+  }
+
+  // A solve whose deadline passed while waiting is not run
+  service = nonogram_service_create(1, 4);
+  Answer expired = {.hints = first, .valid = false};
+  atomic_init(&expired.calls, 0);
+  assert(nonogram_service_submit(
+    service, copy_hints(first), NONOGRAM_PRIORITY_NORMAL, 1e-3, on_result,
+    &expired));
+  struct timespec delay = {0, 20000000};
+  nanosleep(&delay, NULL);
+  assert(nonogram_service_start(service));
+  nonogram_service_destroy(service);
+  assert(atomic_load(&expired.calls) == 1 && expired.rejected);
+
+  // Services sharing a cache answer the puzzles solved by any of them
+  NonoGramCache *cache = nonogram_cache_create(16);
+  service = nonogram_service_create(1, 4);
+  nonogram_service_set_cache(service, cache);
+  assert(nonogram_service_start(service));
+  Answer solved = {.hints = first, .valid = false};
+  atomic_init(&solved.calls, 0);
+  assert(nonogram_service_submit(
+    service, copy_hints(first), NONOGRAM_PRIORITY_NORMAL, 0.0, on_result,
+    &solved));
+  nonogram_service_destroy(service);
+  assert(solved.valid && nonogram_cache_get_count(cache) == 1);
+  service = nonogram_service_create(1, 4);
+  nonogram_service_set_cache(service, cache);
+  Answer cached = {.hints = first, .valid = false};
+  atomic_init(&cached.calls, 0);
+  // Not started, the answer can only come from the cache
+  assert(nonogram_service_submit(
+    service, copy_hints(first), NONOGRAM_PRIORITY_NORMAL, 0.0, on_result,
+    &cached));
+  assert(atomic_load(&cached.calls) == 1 && cached.valid);
+  nonogram_service_get_stats(service, &stats);
+  assert(stats.requests == 1 && stats.cached == 1 && stats.queued == 0);
+  nonogram_service_destroy(service);
+  nonogram_cache_destroy(cache);
+
+  // Tiny puzzles are answered from the table, without a started service
+  assert(nonogram_table_write("test-service.table", 3));
+  NonoGramTable *table = nonogram_table_open("test-service.table");
+  service = nonogram_service_create(1, 4);
+  nonogram_service_set_table(service, table);
+  NonoGramHints *tiny = random_hints(3, 5);
+  Answer tabled = {.hints = tiny, .valid = false};
+  atomic_init(&tabled.calls, 0);
+  assert(nonogram_service_submit(
+    service, copy_hints(tiny), NONOGRAM_PRIORITY_NORMAL, 0.0, on_result,
+    &tabled));
+  assert(atomic_load(&tabled.calls) == 1 && tabled.valid);
+  nonogram_service_get_stats(service, &stats);
+  assert(stats.requests == 1 && stats.tabled == 1 && stats.queued == 0);
+  nonogram_service_destroy(service);
+  nonogram_table_close(table);
+  nonogram_hints_destroy(tiny);
+  unlink("test-service.table");
+
+  nonogram_hints_destroy(first);
+  nonogram_hints_destroy(second);
+  nonogram_hints_to_string(NULL);
+  return EXIT_SUCCESS;
+}
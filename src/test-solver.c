@@ -0,0 +1,136 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <assert.h>
+
+#include "./nonogram.h"
+#include "./solver.h"
+#include "./nonogram.inc"
+
+/**
+ * Solve a puzzle with an engine and check the hints of the solution.
+ */
+static void check_engine(NonoGramHints *hints, NonoGramEngine engine) {
+  int rows_count = nonogram_hints_get_rows_count(hints);
+  int cols_count = nonogram_hints_get_cols_count(hints);
+  NonoGramSolver *solver = nonogram_solver_create(hints);
+  assert(solver);
+  assert(nonogram_solver_solve(solver, engine) == NONOGRAM_SOLVER_SOLVED);
+  int **board = malloc(rows_count * sizeof(int *));
+  for (int row = 0; row < rows_count; row++) {
+    board[row] = malloc(cols_count * sizeof(int));
+    for (int col = 0; col < cols_count; col++) {
+      board[row][col] = nonogram_solver_get_cell(solver, row, col);
+      assert(board[row][col] == 0 || board[row][col] == 1);
+    }
+  }
+  NonoGramHints *solved = nonogram_hints_create(board, rows_count, cols_count);
+  char *expected = strdup(nonogram_hints_to_string(hints));
+  assert(strcmp(nonogram_hints_to_string(solved), expected) == 0);
+  free(expected);
+  nonogram_hints_destroy(solved);
+  for (int row = 0; row < rows_count; row++) {
+    free(board[row]);
+  }
+  free(board);
+  nonogram_solver_destroy(solver);
+}
+
+int main(void) {
+  int rows_count = 5;
+  int cols_count = 5;
+  int **board = malloc(rows_count * sizeof(int *));
+  for (int row = 0; row < rows_count; row++) {
+    board[row] = calloc(cols_count, sizeof(int));
+  }
+  /**
+   * Board and hints (two solutions):
+   *      1 1 1 1 1
+   *     +---------
+   *   1 |■
+   *   1 |  ■
+   *   1 |    ■
+   *   1 |      ■
+   *   1 |        ■
+   */
+  for (int index = 0; index < rows_count; index++) {
+    board[index][index] = 1;
+  }
+  NonoGramHints *hints = nonogram_hints_create(board, rows_count, cols_count);
+  check_engine(hints, NONOGRAM_ENGINE_DFS);
+  check_engine(hints, NONOGRAM_ENGINE_PROBE);
+  check_engine(hints, NONOGRAM_ENGINE_AUTO);
+
+  NonoGramFeatures features;
+  NonoGramSolver *solver = nonogram_solver_create(hints);
+  assert(nonogram_solver_features(solver, &features));
+  assert(features.rows_count == rows_count);
+  assert(features.cols_count == cols_count);
+  assert(features.max_blocks == 1);
+  assert(features.settled == 0.0);
+  assert(nonogram_solver_select_engine(&features) == NONOGRAM_ENGINE_DFS);
+  assert(nonogram_solver_solve(solver, NONOGRAM_ENGINE_LINE)
+         == NONOGRAM_SOLVER_FAILED);
+  nonogram_solver_destroy(solver);
+  nonogram_hints_destroy(hints);
+
+  /**
+   * Board and hints (settled by propagation):
+   *      3 1 3
+   *        1
+   *     +-----
+   *   3 |■ ■ ■
+   * 1 1 |■   ■
+   *   3 |■ ■ ■
+   */
+  for (int row = 0; row < rows_count; row++) {
+    free(board[row]);
+  }
+  rows_count = 3;
+  cols_count = 3;
+  for (int row = 0; row < rows_count; row++) {
+    board[row] = malloc(cols_count * sizeof(int));
+    for (int col = 0; col < cols_count; col++) {
+      board[row][col] = row != 1 || col != 1;
+    }
+  }
+  hints = nonogram_hints_create(board, rows_count, cols_count);
+  solver = nonogram_solver_create(hints);
+  assert(nonogram_solver_features(solver, &features));
+  assert(features.settled == 1.0);
+  assert(nonogram_solver_select_engine(&features) == NONOGRAM_ENGINE_LINE);
+  assert(nonogram_solver_solve(solver, NONOGRAM_ENGINE_LINE)
+         == NONOGRAM_SOLVER_SOLVED);
+  assert(nonogram_solver_get_stats(solver)->nodes == 0);
+  nonogram_solver_destroy(solver);
+  check_engine(hints, NONOGRAM_ENGINE_LINE);
+
+  /**
+   * Unsolvable hints.
+   */
+  hints->rows[1][0] = 2;
+  solver = nonogram_solver_create(hints);
+  assert(!nonogram_solver_features(solver, &features));
+  assert(nonogram_solver_solve(solver, NONOGRAM_ENGINE_DFS)
+         == NONOGRAM_SOLVER_FAILED);
+  nonogram_solver_destroy(solver);
+  nonogram_hints_destroy(hints);
+
+  for (int row = 0; row < rows_count; row++) {
+    free(board[row]);
+  }
+  free(board);
+
+  NonoGramEngine engine;
+  assert(nonogram_engine_from_string("probe", &engine));
+  assert(engine == NONOGRAM_ENGINE_PROBE);
+  assert(!nonogram_engine_from_string("unknown", &engine));
+  assert(strcmp(nonogram_engine_to_string(NONOGRAM_ENGINE_DFS), "dfs") == 0);
+
+  return EXIT_SUCCESS;
+}
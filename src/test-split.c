@@ -0,0 +1,151 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <assert.h>
+
+#include "./nonogram.h"
+#include "./solver.h"
+
+/**
+ * Size of the puzzle of the test, whose solution is not unique.
+ */
+#define SIZE 6
+
+/**
+ * Largest number of parts of the test.
+ */
+#define PARTS 64
+
+/**
+ * Parts of the puzzle.
+ */
+typedef struct {
+  signed char cells[PARTS][SIZE * SIZE];  // Cells settled in each part
+  int count;                              // Number of parts
+  int stop_at;                            // Number of parts to stop at
+} Parts;
+
+/**
+ * Keep a part.
+ */
+static bool keep(const signed char *cells, void *data) {
+  Parts *parts = data;
+  assert(parts->count < PARTS);
+  memcpy(parts->cells[parts->count++], cells, SIZE * SIZE);
+  return parts->count != parts->stop_at;
+}
+
+int main(void) {
+  int **board = malloc(SIZE * sizeof(int *));
+  for (int row = 0; row < SIZE; row++) {
+    board[row] = calloc(SIZE, sizeof(int));
+    board[row][row] = 1;
+  }
+  NonoGramHints *hints = nonogram_hints_create(board, SIZE, SIZE);
+
+  // Every permutation matrix solves the puzzle, parts split them
+  NonoGramSolver *solver = nonogram_solver_create(hints);
+  Parts parts = {.stop_at = -1};
+  long count = nonogram_solver_split(solver, 3, keep, &parts);
+  assert(count == parts.count);
+  assert(count > 1);
+  // The solver is back to the cells settled before any decision
+  for (int cell = 0; cell < SIZE * SIZE; cell++) {
+    assert(nonogram_solver_get_cell(solver, cell / SIZE, cell % SIZE) == -1);
+  }
+  assert(nonogram_solver_solve(solver, NONOGRAM_ENGINE_DFS)
+         == NONOGRAM_SOLVER_SOLVED);
+  nonogram_solver_destroy(solver);
+
+  // Parts are disjoint
+  for (int first = 0; first < parts.count; first++) {
+    for (int second = first + 1; second < parts.count; second++) {
+      bool differ = false;
+      for (int cell = 0; cell < SIZE * SIZE; cell++) {
+        differ = differ
+          || (parts.cells[first][cell] >= 0 && parts.cells[second][cell] >= 0
+              && parts.cells[first][cell] != parts.cells[second][cell]);
+      }
+      assert(differ);
+    }
+  }
+
+  // Each part is a puzzle whose solutions keep its given cells
+  NonoGramEngine engines[] = {
+    NONOGRAM_ENGINE_DFS, NONOGRAM_ENGINE_PROBE, NONOGRAM_ENGINE_LOCAL
+  };
+  for (int part = 0; part < parts.count; part++) {
+    assert(nonogram_hints_set_given(hints, parts.cells[part]));
+    solver = nonogram_solver_create(hints);
+    assert(nonogram_solver_solve(solver, engines[part % 3])
+           == NONOGRAM_SOLVER_SOLVED);
+    for (int cell = 0; cell < SIZE * SIZE; cell++) {
+      int value = nonogram_solver_get_cell(solver, cell / SIZE, cell % SIZE);
+      assert(parts.cells[part][cell] < 0 || value == parts.cells[part][cell]);
+    }
+    nonogram_solver_destroy(solver);
+  }
+
+  // The file of a part keeps its given cells when solved by nonogram-solve
+  char filename[] = "test-split-XXXXXX";
+  int fd = mkstemp(filename);
+  assert(fd >= 0);
+  for (int part = 0; part < parts.count; part++) {
+    assert(nonogram_hints_set_given(hints, parts.cells[part]));
+    const char *string = nonogram_hints_to_string(hints);
+    assert(string);
+    assert(pwrite(fd, string, strlen(string), 0) == (ssize_t) strlen(string));
+    assert(ftruncate(fd, strlen(string)) == 0);
+    char command[64];
+    snprintf(command, sizeof command, "./nonogram-solve %s", filename);
+    FILE *output = popen(command, "r");
+    assert(output);
+    for (int cell = 0; cell < SIZE * SIZE; cell++) {
+      int value;
+      assert(fscanf(output, "%d", &value) == 1);
+      assert(parts.cells[part][cell] < 0 || value == parts.cells[part][cell]);
+    }
+    assert(pclose(output) == 0);
+  }
+  nonogram_hints_to_string(NULL);
+  close(fd);
+  unlink(filename);
+
+  // Given cells contradicting the clues make the puzzle fail
+  signed char cells[SIZE * SIZE];
+  memset(cells, -1, sizeof cells);
+  cells[0] = 1;
+  cells[1] = 1;
+  assert(nonogram_hints_set_given(hints, cells));
+  solver = nonogram_solver_create(hints);
+  assert(nonogram_solver_solve(solver, NONOGRAM_ENGINE_DFS)
+         == NONOGRAM_SOLVER_FAILED);
+  nonogram_solver_destroy(solver);
+  solver = nonogram_solver_create(hints);
+  parts.count = 0;
+  assert(nonogram_solver_split(solver, 3, keep, &parts) == 0);
+  nonogram_solver_destroy(solver);
+
+  // The callback stops the split
+  assert(nonogram_hints_set_given(hints, NULL));
+  solver = nonogram_solver_create(hints);
+  parts.count = 0;
+  parts.stop_at = 2;
+  assert(nonogram_solver_split(solver, 3, keep, &parts) == 2);
+  nonogram_solver_destroy(solver);
+
+  nonogram_hints_destroy(hints);
+  for (int row = 0; row < SIZE; row++) {
+    free(board[row]);
+  }
+  free(board);
+  return EXIT_SUCCESS;
+}
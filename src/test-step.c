@@ -0,0 +1,113 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+#include <stdlib.h>
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <assert.h>
+
+#include "./nonogram.h"
+#include "./solver.h"
+#include "./nonogram.inc"
+
+/**
+ * Step a solve to its end and return its status and number of steps.
+ */
+static NonoGramStatus run_steps(
+  NonoGramSolver *solver,
+  long budget,
+  int *steps
+) {
+  NonoGramStatus status;
+  *steps = 0;
+  do {
+    status = nonogram_solver_step(solver, budget);
+    (*steps)++;
+  } while (status == NONOGRAM_SOLVER_IN_PROGRESS);
+  return status;
+}
+
+/**
+ * Check that every row of a solved diagonal puzzle has one filled cell.
+ */
+static void check_diagonal(NonoGramSolver *solver, int size) {
+  for (int row = 0; row < size; row++) {
+    int filled = 0;
+    for (int col = 0; col < size; col++) {
+      int cell = nonogram_solver_get_cell(solver, row, col);
+      assert(cell == 0 || cell == 1);
+      filled += cell;
+    }
+    assert(filled == 1);
+  }
+}
+
+int main(void) {
+  int size = 5;
+  int **board = malloc(size * sizeof(int *));
+  for (int row = 0; row < size; row++) {
+    board[row] = calloc(size, sizeof(int));
+    board[row][row] = 1;
+  }
+  NonoGramHints *hints = nonogram_hints_create(board, size, size);
+
+  // Steps of one line solve interleave with nothing lost
+  NonoGramEngine engines[] = {
+    NONOGRAM_ENGINE_AUTO, NONOGRAM_ENGINE_DFS, NONOGRAM_ENGINE_PROBE,
+    NONOGRAM_ENGINE_LOCAL
+  };
+  for (int index = 0; index < 4; index++) {
+    NonoGramSolver *first = nonogram_solver_create(hints);
+    NonoGramSolver *second = nonogram_solver_create(hints);
+    nonogram_solver_set_engine(first, engines[index]);
+    nonogram_solver_set_engine(second, engines[index]);
+    NonoGramStatus first_status = NONOGRAM_SOLVER_IN_PROGRESS;
+    NonoGramStatus second_status = NONOGRAM_SOLVER_IN_PROGRESS;
+    int steps = 0;
+    while (first_status == NONOGRAM_SOLVER_IN_PROGRESS
+           || second_status == NONOGRAM_SOLVER_IN_PROGRESS) {
+      if (first_status == NONOGRAM_SOLVER_IN_PROGRESS) {
+        first_status = nonogram_solver_step(first, 1);
+      }
+      if (second_status == NONOGRAM_SOLVER_IN_PROGRESS) {
+        second_status = nonogram_solver_step(second, 3);
+      }
+      steps++;
+    }
+    assert(first_status == NONOGRAM_SOLVER_SOLVED);
+    assert(second_status == NONOGRAM_SOLVER_SOLVED);
+    assert(steps > 10);
+    check_diagonal(first, size);
+    check_diagonal(second, size);
+    // A solved puzzle stays solved
+    assert(nonogram_solver_step(first, 1) == NONOGRAM_SOLVER_SOLVED);
+    nonogram_solver_destroy(first);
+    nonogram_solver_destroy(second);
+  }
+
+  // A step makes at most its budget of line solves
+  NonoGramSolver *solver = nonogram_solver_create(hints);
+  nonogram_solver_set_engine(solver, NONOGRAM_ENGINE_DFS);
+  assert(nonogram_solver_step(solver, 4) == NONOGRAM_SOLVER_IN_PROGRESS);
+  assert(nonogram_solver_get_stats(solver)->propagations == 4);
+  int steps;
+  assert(run_steps(solver, 4, &steps) == NONOGRAM_SOLVER_SOLVED);
+  assert(nonogram_solver_get_stats(solver)->propagations <= 4 * (steps + 1));
+  nonogram_solver_destroy(solver);
+
+  // An unsolvable puzzle fails in steps
+  hints->cols[0][0] = 2;
+  solver = nonogram_solver_create(hints);
+  assert(run_steps(solver, 2, &steps) == NONOGRAM_SOLVER_FAILED);
+  assert(steps > 1);
+  assert(nonogram_solver_step(solver, 2) == NONOGRAM_SOLVER_FAILED);
+  nonogram_solver_destroy(solver);
+
+  nonogram_hints_destroy(hints);
+  for (int row = 0; row < size; row++) {
+    free(board[row]);
+  }
+  free(board);
+  return EXIT_SUCCESS;
+}
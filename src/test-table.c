@@ -0,0 +1,139 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <assert.h>
+
+#include "./nonogram.h"
+#include "./solver.h"
+#include "./table.h"
+
+/**
+ * Size of the table of the test.
+ */
+#define SIZE 5
+
+/**
+ * Table file of the test.
+ */
+#define TABLE "test-table.table"
+
+/**
+ * Count the solutions of a puzzle.
+ */
+static bool tally(const unsigned char *bits, void *data) {
+  (void) bits;
+  (void) data;
+  return true;
+}
+
+/**
+ * Check the lookup of the puzzle of a board against the solver.
+ */
+static void check(NonoGramTable *table, unsigned board, int rows, int cols) {
+  int **cells = malloc(rows * sizeof(int *));
+  for (int row = 0; row < rows; row++) {
+    cells[row] = malloc(cols * sizeof(int));
+    for (int col = 0; col < cols; col++) {
+      cells[row][col] = board >> (row * cols + col) & 1;
+    }
+  }
+  NonoGramHints *hints = nonogram_hints_create(cells, rows, cols);
+  signed char solution[SIZE * SIZE];
+  int solutions = nonogram_table_lookup(table, hints, solution);
+  NonoGramSolver *solver = nonogram_solver_create(hints);
+  bool complete;
+  assert(solutions == nonogram_solver_enumerate(solver, 2, tally, NULL,
+                                                &complete));
+  nonogram_solver_destroy(solver);
+
+  // The solution found has the clues of the board
+  int **found = malloc(rows * sizeof(int *));
+  for (int row = 0; row < rows; row++) {
+    found[row] = malloc(cols * sizeof(int));
+    for (int col = 0; col < cols; col++) {
+      found[row][col] = solution[row * cols + col];
+    }
+  }
+  NonoGramHints *other = nonogram_hints_create(found, rows, cols);
+  assert(nonogram_hints_equal(hints, other));
+  if (solutions == 1) {
+    for (int row = 0; row < rows; row++) {
+      assert(!memcmp(found[row], cells[row], cols * sizeof(int)));
+    }
+  }
+  nonogram_hints_destroy(other);
+  nonogram_hints_destroy(hints);
+  for (int row = 0; row < rows; row++) {
+    free(found[row]);
+    free(cells[row]);
+  }
+  free(found);
+  free(cells);
+}
+
+int main(void) {
+  assert(!nonogram_table_write(TABLE, 0));
+  assert(!nonogram_table_write(TABLE, NONOGRAM_TABLE_SIZE_MAX + 1));
+  assert(nonogram_table_write(TABLE, SIZE));
+  NonoGramTable *table = nonogram_table_open(TABLE);
+  assert(table && nonogram_table_get_size(table) == SIZE);
+
+  // Every puzzle of up to 10 cells, and random ones of the largest size,
+  // have as many solutions in the table as for the solver
+  for (int rows = 1; rows <= SIZE; rows++) {
+    for (int cols = 1; cols <= SIZE; cols++) {
+      for (unsigned board = 0;
+           rows * cols <= 10 && board < 1u << (rows * cols); board++) {
+        check(table, board, rows, cols);
+      }
+    }
+  }
+  srand(1);
+  for (int puzzle = 0; puzzle < 300; puzzle++) {
+    check(table, (unsigned) rand() & ((1u << 16) - 1), 4, 4);
+    check(table, (unsigned) rand() & ((1u << 25) - 1), SIZE, SIZE);
+  }
+
+  // Clues that do not fit have no solution, larger puzzles and puzzles
+  // having given cells are not in the table
+  const char *string = "{\"rows\":[[2],[1]],\"cols\":[[2],[2]]}";
+  NonoGramHints *hints = nonogram_hints_parse(string, strlen(string));
+  signed char cells[(SIZE + 1) * (SIZE + 1)];
+  assert(nonogram_table_lookup(table, hints, cells) == 0);
+  nonogram_hints_destroy(hints);
+  string = "{\"rows\":[[6],[],[],[],[],[]],"
+           "\"cols\":[[1],[1],[1],[1],[1],[1]]}";
+  hints = nonogram_hints_parse(string, strlen(string));
+  assert(nonogram_table_lookup(table, hints, cells) == -1);
+  nonogram_hints_destroy(hints);
+  string = "{\"rows\":[[1],[]],\"cols\":[[1],[]]}";
+  hints = nonogram_hints_parse(string, strlen(string));
+  assert(nonogram_table_lookup(table, hints, cells) == 1);
+  const signed char given[] = {1, -1, -1, -1};
+  assert(nonogram_hints_set_given(hints, given));
+  assert(nonogram_table_lookup(table, hints, cells) == -1);
+  nonogram_hints_destroy(hints);
+  nonogram_table_close(table);
+
+  // A missing or truncated table has no puzzle
+  assert(truncate(TABLE, 100) == 0);
+  table = nonogram_table_open(TABLE);
+  assert(!nonogram_table_get_size(table));
+  nonogram_table_close(table);
+  unlink(TABLE);
+  table = nonogram_table_open(TABLE);
+  string = "{\"rows\":[[1]],\"cols\":[[1]]}";
+  hints = nonogram_hints_parse(string, strlen(string));
+  assert(nonogram_table_lookup(table, hints, cells) == -1);
+  nonogram_hints_destroy(hints);
+  nonogram_table_close(table);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,163 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <assert.h>
+
+#include "./writer.h"
+
+/**
+ * Number of writing threads.
+ */
+#define THREADS 4
+
+/**
+ * Number of results.
+ */
+#define RESULTS 50000
+
+/**
+ * Seconds shorter than the delay before the writer writes its buffer.
+ */
+#define SHORT 0.02
+
+/**
+ * Writer shared by the threads.
+ */
+static NonoGramWriter *writer;
+
+/**
+ * Write the results whose id modulo THREADS is the thread index, each one
+ * reserved first as a producer would.
+ */
+static void *produce(void *data) {
+  intptr_t thread = (intptr_t) data;
+  char line[32];
+  for (long id = thread; id < RESULTS; id += THREADS) {
+    assert(nonogram_writer_reserve(writer, id));
+    int length = snprintf(line, sizeof line, "%ld\n", id);
+    assert(nonogram_writer_write(writer, id, line, length));
+  }
+  return NULL;
+}
+
+/**
+ * Get the time of a monotonic clock in seconds.
+ */
+static double now(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+/**
+ * Wait until the output reaches a size, a second at most, and get it.
+ */
+static off_t wait_output(int fd, off_t size) {
+  for (int tick = 0; tick < 1000 && lseek(fd, 0, SEEK_END) < size; tick++) {
+    usleep(1000);
+  }
+  return lseek(fd, 0, SEEK_END);
+}
+
+/**
+ * Write the results from several threads and read them back.
+ */
+static void check(bool ordered) {
+  char filename[] = "test-writer-XXXXXX";
+  int fd = mkstemp(filename);
+  assert(fd >= 0);
+  writer = nonogram_writer_create(fd, 16, ordered);
+  assert(writer);
+  pthread_t threads[THREADS];
+  for (intptr_t thread = 0; thread < THREADS; thread++) {
+    assert(!pthread_create(&threads[thread], NULL, produce, (void *) thread));
+  }
+  for (int thread = 0; thread < THREADS; thread++) {
+    pthread_join(threads[thread], NULL);
+  }
+  assert(nonogram_writer_get_pending(writer) == 0);
+  assert(nonogram_writer_close(writer));
+  close(fd);
+
+  char *seen = calloc(RESULTS, 1);
+  FILE *file = fopen(filename, "r");
+  long id;
+  long count = 0;
+  while (fscanf(file, "%ld", &id) == 1) {
+    assert(id >= 0 && id < RESULTS && !seen[id]);
+    assert(!ordered || id == count);
+    seen[id] = 1;
+    count++;
+  }
+  assert(count == RESULTS);
+  fclose(file);
+  free(seen);
+  unlink(filename);
+}
+
+int main(void) {
+  // Results out of order wait for the missing ones
+  char filename[] = "test-writer-XXXXXX";
+  int fd = mkstemp(filename);
+  assert(fd >= 0);
+  writer = nonogram_writer_create(fd, 4, true);
+  char head[5] = {0};
+  assert(nonogram_writer_write(writer, 2, "c", 1));
+  assert(nonogram_writer_write(writer, 1, "b", 1));
+  assert(nonogram_writer_get_pending(writer) == 2);
+  assert(lseek(fd, 0, SEEK_END) == 0);
+  assert(nonogram_writer_write(writer, 0, "a", 1));
+  assert(nonogram_writer_get_pending(writer) == 0);
+  // The output does not wait for the close, the results drained together
+  // are written at once
+  assert(wait_output(fd, 1) == 3);
+  assert(pread(fd, head, 4, 0) == 3);
+  assert(strcmp(head, "abc") == 0);
+  assert(nonogram_writer_write(writer, 4, "e", 1));
+  assert(nonogram_writer_write(writer, 3, "", 0));
+  assert(wait_output(fd, 4) == 4);
+  assert(pread(fd, head, 4, 0) == 4);
+  assert(strcmp(head, "abce") == 0);
+  // Larger than the output buffer
+  size_t size = 3 * 1024 * 1024;
+  char *large = malloc(size);
+  memset(large, 'f', size);
+  assert(nonogram_writer_write(writer, 5, large, size));
+  assert(nonogram_writer_close(writer));
+  assert((size_t) lseek(fd, 0, SEEK_END) == 4 + size);
+  assert(pread(fd, head, 4, 0) == 4);
+  assert(strcmp(head, "abce") == 0);
+  assert(pread(fd, head, 1, 4 + size - 1) == 1 && head[0] == 'f');
+  close(fd);
+  unlink(filename);
+  free(large);
+
+  // Results written in a row share a single system call
+  char other[] = "test-writer-XXXXXX";
+  fd = mkstemp(other);
+  assert(fd >= 0);
+  writer = nonogram_writer_create(fd, 4, false);
+  double start = now();
+  for (long id = 0; id < 100; id++) {
+    assert(nonogram_writer_write(writer, id, "result\n", 7));
+  }
+  assert(now() - start > SHORT || lseek(fd, 0, SEEK_END) == 0);
+  assert(wait_output(fd, 1) == 700);
+  assert(nonogram_writer_close(writer));
+  close(fd);
+  unlink(other);
+
+  check(true);
+  check(false);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,275 @@
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+/**
+ * @file writer.c
+ * @brief Implementation of the shared result writer.
+ *
+ * Results are appended to a large buffer which is written with a single
+ * system call when full, or by a flusher thread a short delay after it
+ * starts filling: the output does not lag behind while the workers are
+ * busy, and results arriving together share a system call. In id order, a
+ * result whose predecessors are not all written waits in a ring of slots;
+ * writing the next id drains every following result that is ready.
+ */
+#include "./writer.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "./writer.inc"
+
+/**
+ * @brief Size of the output buffer
+ */
+#define WRITER_BUFFER_SIZE (1024 * 1024)
+
+/**
+ * @brief Delay in milliseconds before the content of the buffer is written
+ */
+#define WRITER_FLUSH_DELAY 50
+
+/**
+ * @brief Write data to the output
+ * @param writer The writer, locked
+ * @param data The data
+ * @param length The length of the data
+ */
+static void _write(NonoGramWriter *writer, const char *data, size_t length) {
+  size_t written = 0;
+  while (!writer->failed && written < length) {
+    ssize_t size = write(writer->fd, data + written, length - written);
+    if (size < 0 && errno != EINTR) {
+      writer->failed = true;
+    } else if (size > 0) {
+      written += size;
+    }
+  }
+}
+
+/**
+ * @brief Write the output buffer
+ * @param writer The writer, locked
+ */
+static void _flush(NonoGramWriter *writer) {
+  _write(writer, writer->buffer, writer->length);
+  writer->length = 0;
+}
+
+/**
+ * @brief Append a result to the output buffer
+ * @param writer The writer, locked
+ * @param data The content of the result
+ * @param length The length of the content
+ */
+static void _append(NonoGramWriter *writer, const char *data, size_t length) {
+  if (writer->length + length > WRITER_BUFFER_SIZE) {
+    _flush(writer);
+  }
+  if (length > WRITER_BUFFER_SIZE) {
+    _write(writer, data, length);
+  } else if (length) {
+    if (!writer->length) {
+      // The flusher writes the buffer once the delay has passed
+      clock_gettime(CLOCK_REALTIME, &writer->deadline);
+      writer->deadline.tv_nsec += WRITER_FLUSH_DELAY * 1000000L;
+      if (writer->deadline.tv_nsec >= 1000000000L) {
+        writer->deadline.tv_sec++;
+        writer->deadline.tv_nsec -= 1000000000L;
+      }
+      pthread_cond_signal(&writer->filled);
+    }
+    memcpy(writer->buffer + writer->length, data, length);
+    writer->length += length;
+  }
+}
+
+/**
+ * @brief Write the buffer a delay after it starts filling
+ * @param data The writer
+ * @return NULL
+ */
+static void *_flusher(void *data) {
+  NonoGramWriter *writer = data;
+  pthread_mutex_lock(&writer->lock);
+  while (!writer->closing) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    bool passed = now.tv_sec > writer->deadline.tv_sec
+      || (now.tv_sec == writer->deadline.tv_sec
+          && now.tv_nsec >= writer->deadline.tv_nsec);
+    if (writer->length && passed) {
+      _flush(writer);
+    } else if (writer->length) {
+      pthread_cond_timedwait(&writer->filled, &writer->lock,
+                             &writer->deadline);
+    } else {
+      pthread_cond_wait(&writer->filled, &writer->lock);
+    }
+  }
+  pthread_mutex_unlock(&writer->lock);
+  return NULL;
+}
+
+/**
+ * @brief Create a new writer
+ * @param fd The file descriptor of the output, not closed by the writer
+ * @param window The number of results the reorder buffer can hold
+ * @param ordered true to write the results in id order
+ * @return A new writer, or NULL if memory allocation fails or if its
+ *         flusher thread cannot be started
+ */
+NonoGramWriter *nonogram_writer_create(int fd, size_t window, bool ordered) {
+  NonoGramWriter *writer = calloc(1, sizeof(NonoGramWriter));
+  if (!writer) {
+    return NULL;
+  }
+  writer->fd = fd;
+  writer->ordered = ordered;
+  writer->window = window ? window : 1;
+  writer->buffer = malloc(WRITER_BUFFER_SIZE);
+  writer->slots = ordered
+    ? calloc(writer->window, sizeof(NonoGramWriterSlot))
+    : NULL;
+  if (!writer->buffer || (ordered && !writer->slots)) {
+    free(writer->buffer);
+    free(writer);
+    return NULL;
+  }
+  pthread_mutex_init(&writer->lock, NULL);
+  pthread_cond_init(&writer->room, NULL);
+  pthread_cond_init(&writer->filled, NULL);
+  if (pthread_create(&writer->flusher, NULL, _flusher, writer)) {
+    pthread_cond_destroy(&writer->filled);
+    pthread_cond_destroy(&writer->room);
+    pthread_mutex_destroy(&writer->lock);
+    free(writer->slots);
+    free(writer->buffer);
+    free(writer);
+    return NULL;
+  }
+  return writer;
+}
+
+/**
+ * @brief Flush and destroy a writer
+ * @param writer The writer
+ * @return false if a write has failed
+ */
+bool nonogram_writer_close(NonoGramWriter *writer) {
+  pthread_mutex_lock(&writer->lock);
+  writer->closing = true;
+  pthread_cond_signal(&writer->filled);
+  pthread_mutex_unlock(&writer->lock);
+  pthread_join(writer->flusher, NULL);
+  _flush(writer);
+  bool succeeded = !writer->failed;
+  if (writer->slots) {
+    for (size_t index = 0; index < writer->window; index++) {
+      free(writer->slots[index].data);
+    }
+    free(writer->slots);
+  }
+  pthread_cond_destroy(&writer->filled);
+  pthread_cond_destroy(&writer->room);
+  pthread_mutex_destroy(&writer->lock);
+  free(writer->buffer);
+  free(writer);
+  return succeeded;
+}
+
+/**
+ * @brief Wait until an id fits in the reorder buffer
+ * @param writer The writer, locked
+ * @param id The id
+ */
+static void _wait_room(NonoGramWriter *writer, long id) {
+  while (!writer->failed && id - writer->next >= (long) writer->window) {
+    pthread_cond_wait(&writer->room, &writer->lock);
+  }
+}
+
+/**
+ * @brief Wait until a result fits in the reorder buffer
+ * @param writer The writer
+ * @param id The id of the result
+ * @return false if a write has failed
+ */
+bool nonogram_writer_reserve(NonoGramWriter *writer, long id) {
+  if (!writer->ordered) {
+    return true;
+  }
+  pthread_mutex_lock(&writer->lock);
+  _wait_room(writer, id);
+  bool succeeded = !writer->failed;
+  pthread_mutex_unlock(&writer->lock);
+  return succeeded;
+}
+
+/**
+ * @brief Write a result
+ * @param writer The writer
+ * @param id The id of the result
+ * @param data The content of the result
+ * @param length The length of the content
+ * @return false if memory allocation or a write has failed
+ */
+bool nonogram_writer_write(
+  NonoGramWriter *writer,
+  long id,
+  const char *data,
+  size_t length
+) {
+  pthread_mutex_lock(&writer->lock);
+  bool succeeded = true;
+  if (!writer->ordered) {
+    _append(writer, data, length);
+  } else {
+    _wait_room(writer, id);
+    if (id != writer->next) {
+      NonoGramWriterSlot *slot = &writer->slots[id % writer->window];
+      slot->data = malloc(length ? length : 1);
+      if (slot->data) {
+        memcpy(slot->data, data, length);
+        slot->length = length;
+        slot->ready = true;
+        writer->pending++;
+      }
+      succeeded = slot->data != NULL;
+    } else {
+      _append(writer, data, length);
+      writer->next++;
+      NonoGramWriterSlot *slot = &writer->slots[writer->next % writer->window];
+      while (slot->ready) {
+        _append(writer, slot->data, slot->length);
+        free(slot->data);
+        slot->data = NULL;
+        slot->ready = false;
+        writer->pending--;
+        writer->next++;
+        slot = &writer->slots[writer->next % writer->window];
+      }
+      pthread_cond_broadcast(&writer->room);
+    }
+  }
+  succeeded = succeeded && !writer->failed;
+  pthread_mutex_unlock(&writer->lock);
+  return succeeded;
+}
+
+/**
+ * @brief Get the number of results waiting in the reorder buffer
+ * @param writer The writer
+ * @return The number of results waiting for a smaller id
+ */
+size_t nonogram_writer_get_pending(NonoGramWriter *writer) {
+  pthread_mutex_lock(&writer->lock);
+  size_t pending = writer->pending;
+  pthread_mutex_unlock(&writer->lock);
+  return pending;
+}
@@ -0,0 +1,75 @@
+#ifndef WRITER_H_
+#define WRITER_H_
+// Copyright © Christophe Demko <christophe.demko@univ-lr.fr>, 2024
+// Licensed under the BSD-3 License. See the LICENSE file for details.
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * NonoGramWriter is a opaque structure that represents an output shared by
+ * several threads, which writes numbered results either in id order or in
+ * completion order through a large buffer.
+ */
+typedef struct _NonoGramWriter NonoGramWriter;
+
+/**
+ * @brief Create a new writer
+ * @param fd The file descriptor of the output, not closed by the writer
+ * @param window The number of results the reorder buffer can hold
+ * @param ordered true to write the results in id order, false to write
+ *        them as soon as they are complete
+ * @return A new writer, or NULL if memory allocation fails or if its
+ *         flusher thread cannot be started
+ * @note Ids start at 0 and every id must be written exactly once in
+ *       ordered mode
+ */
+extern NonoGramWriter *nonogram_writer_create(
+  int fd,
+  size_t window,
+  bool ordered
+);
+/**
+ * @brief Flush and destroy a writer
+ * @param writer The writer
+ * @return false if a write has failed
+ * @note Results still waiting for a missing id are dropped
+ */
+extern bool nonogram_writer_close(NonoGramWriter *writer);
+
+/**
+ * @brief Wait until a result fits in the reorder buffer
+ * @param writer The writer
+ * @param id The id of the result
+ * @return false if a write has failed
+ * @note Producers call this before handing an id over to the workers, so
+ *       that at most window results are in flight and writes never wait
+ * @note In completion order, this returns at once
+ */
+extern bool nonogram_writer_reserve(NonoGramWriter *writer, long id);
+/**
+ * @brief Write a result
+ * @param writer The writer
+ * @param id The id of the result
+ * @param data The content of the result, copied if it has to wait
+ * @param length The length of the content
+ * @return false if memory allocation or a write has failed
+ * @note This waits while the id does not fit in the reorder buffer
+ * @note The output is written when the buffer is full, or a short delay
+ *       after the buffer starts filling
+ */
+extern bool nonogram_writer_write(
+  NonoGramWriter *writer,
+  long id,
+  const char *data,
+  size_t length
+);
+
+/**
+ * @brief Get the number of results waiting in the reorder buffer
+ * @param writer The writer
+ * @return The number of results waiting for a smaller id
+ */
+extern size_t nonogram_writer_get_pending(NonoGramWriter *writer);
+
+#endif  // WRITER_H_